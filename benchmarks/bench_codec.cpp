@@ -0,0 +1,183 @@
+#include "nanomq/compression.hpp"
+#include "nanomq/message.hpp"
+#include "nanomq/record_batch.hpp"
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace nanomq;
+
+// Representative payloads, 64 KB each (arg 0)
+enum PayloadKind { JSON_EVENTS = 0, LOG_LINES = 1, RANDOM_BYTES = 2 };
+
+static std::vector<uint8_t> make_payload(int kind) {
+    const size_t size = 65536;
+    std::string text;
+    uint32_t state = 2463534242u;
+    auto next = [&state]() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    };
+
+    if (kind == JSON_EVENTS) {
+        static const char* symbols[] = {"ACME", "GLOBX", "INITECH", "UMBRL"};
+        for (uint64_t seq = 0; text.size() < size; ++seq) {
+            text += "{\"type\":\"trade\",\"symbol\":\"" + std::string(symbols[next() % 4]) +
+                    "\",\"seq\":" + std::to_string(seq) +
+                    ",\"price\":" + std::to_string(100 + next() % 50) + "." +
+                    std::to_string(next() % 100) +
+                    ",\"qty\":" + std::to_string(next() % 1000) +
+                    ",\"side\":\"" + (next() % 2 ? "buy" : "sell") +
+                    "\",\"venue\":\"XNAS\",\"ts\":" + std::to_string(1700000000000ull + seq * 137) +
+                    "}\n";
+        }
+    } else if (kind == LOG_LINES) {
+        static const char* levels[] = {"INFO", "WARN", "DEBUG"};
+        for (uint64_t line = 0; text.size() < size; ++line) {
+            text += "2024-05-01T12:00:" + std::to_string(10 + line % 50) + "." +
+                    std::to_string(next() % 1000) + "Z " + levels[next() % 3] +
+                    " broker: delivered batch to consumer group orders-" +
+                    std::to_string(next() % 8) + " partition " +
+                    std::to_string(next() % 16) + " offset " + std::to_string(line * 64) +
+                    "\n";
+        }
+    } else {
+        while (text.size() < size) {
+            text.push_back(static_cast<char>(next()));
+        }
+    }
+    text.resize(size);
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+static const char* payload_name(int kind) {
+    return kind == JSON_EVENTS ? "json" : kind == LOG_LINES ? "logs" : "random";
+}
+
+// Benchmark: compression speed and ratio
+static void BM_LZ4Compress(benchmark::State& state) {
+    const std::vector<uint8_t> input = make_payload(state.range(0));
+    std::vector<uint8_t> output(lz4_compress_bound(input.size()));
+
+    size_t compressed = 0;
+    for (auto _ : state) {
+        compressed = lz4_compress(input.data(), input.size(), output.data(), output.size());
+        benchmark::DoNotOptimize(compressed);
+    }
+
+    state.SetLabel(payload_name(state.range(0)));
+    state.SetBytesProcessed(state.iterations() * input.size());
+    state.counters["ratio"] = static_cast<double>(input.size()) / compressed;
+}
+BENCHMARK(BM_LZ4Compress)->Arg(JSON_EVENTS)->Arg(LOG_LINES)->Arg(RANDOM_BYTES);
+
+// Benchmark: decompression speed (bytes are uncompressed bytes)
+static void BM_LZ4Decompress(benchmark::State& state) {
+    const std::vector<uint8_t> input = make_payload(state.range(0));
+    std::vector<uint8_t> compressed(lz4_compress_bound(input.size()));
+    compressed.resize(lz4_compress(input.data(), input.size(), compressed.data(),
+                                   compressed.size()));
+    std::vector<uint8_t> output(input.size());
+
+    for (auto _ : state) {
+        size_t n = lz4_decompress(compressed.data(), compressed.size(),
+                                  output.data(), output.size());
+        benchmark::DoNotOptimize(n);
+    }
+
+    state.SetLabel(payload_name(state.range(0)));
+    state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_LZ4Decompress)->Arg(JSON_EVENTS)->Arg(LOG_LINES)->Arg(RANDOM_BYTES);
+
+// Benchmark: a publisher batch of 256 JSON events, packed into a record
+// batch with its records compressed
+static void BM_CompressBatch(benchmark::State& state) {
+    std::vector<std::string> events;
+    size_t payload_bytes = 0;
+    for (int i = 0; i < 256; ++i) {
+        events.push_back("{\"type\":\"trade\",\"symbol\":\"ACME\",\"seq\":" +
+                         std::to_string(i) + ",\"price\":101." + std::to_string(i % 100) +
+                         ",\"qty\":" + std::to_string(100 + i) + ",\"side\":\"buy\"}");
+        payload_bytes += events.back().size();
+    }
+
+    MessageBatch batch;
+    size_t wire_bytes = 0;
+    for (auto _ : state) {
+        batch.clear();
+        for (int i = 0; i < 256; ++i) {
+            batch.add(1000 + i, 1700000000000000000ull + i * 900, events[i].data(),
+                      events[i].size());
+        }
+        const Message message = batch.finish(true);
+        wire_bytes = message.header.size;
+        benchmark::DoNotOptimize(message.data);
+    }
+
+    state.SetItemsProcessed(state.iterations() * events.size());
+    state.counters["wire_bytes_per_msg"] = static_cast<double>(wire_bytes) / events.size();
+    state.counters["payload_bytes_per_msg"] = static_cast<double>(payload_bytes) / events.size();
+}
+BENCHMARK(BM_CompressBatch);
+
+// Benchmark: 256 small messages as a record batch (build, then iterate)
+// against one checksummed 64-byte header per message
+static void BM_RecordBatch(benchmark::State& state) {
+    const bool batched = state.range(0) != 0;
+    const size_t SIZE = 64;
+    std::vector<uint8_t> payload(SIZE, 0x5A);
+    MessageBatch batch;
+    std::vector<uint8_t> flat(MessageBatch::MAX_BATCH_SIZE * (sizeof(MessageHeader) + SIZE));
+    size_t wire_bytes = 0;
+
+    for (auto _ : state) {
+        uint64_t checksum = 0;
+        if (batched) {
+            batch.clear();
+            for (size_t i = 0; i < MessageBatch::MAX_BATCH_SIZE; ++i) {
+                batch.add(1000 + i, 1700000000000000000ull, payload.data(), SIZE);
+            }
+            const Message message = batch.finish();
+            wire_bytes = sizeof(MessageHeader) + message.header.size;
+            RecordBatchReader reader;
+            Message record;
+            if (reader.reset(message)) {
+                while (reader.next(record)) {
+                    checksum += record.header.id;
+                }
+            }
+        } else {
+            // Header and payload copied out per message, as into a ring
+            uint8_t* out = flat.data();
+            for (size_t i = 0; i < MessageBatch::MAX_BATCH_SIZE; ++i) {
+                Message msg(1000 + i, 1700000000000000000ull, 0, payload.data(), SIZE);
+                std::memcpy(out, &msg.header, sizeof(MessageHeader));
+                std::memcpy(out + sizeof(MessageHeader), payload.data(), SIZE);
+                out += sizeof(MessageHeader) + SIZE;
+            }
+            const uint8_t* in = flat.data();
+            for (size_t i = 0; i < MessageBatch::MAX_BATCH_SIZE; ++i) {
+                Message msg;
+                std::memcpy(&msg.header, in, sizeof(MessageHeader));
+                msg.data = const_cast<uint8_t*>(in) + sizeof(MessageHeader);
+                checksum += msg.verify_checksum() ? msg.header.id : 0;
+                in += sizeof(MessageHeader) + SIZE;
+            }
+            wire_bytes = flat.size();
+        }
+        benchmark::DoNotOptimize(checksum);
+    }
+
+    state.SetLabel(batched ? "record batch" : "per message");
+    state.SetItemsProcessed(state.iterations() * MessageBatch::MAX_BATCH_SIZE);
+    state.counters["wire_bytes_per_msg"] =
+        static_cast<double>(wire_bytes) / MessageBatch::MAX_BATCH_SIZE;
+}
+BENCHMARK(BM_RecordBatch)->Arg(0)->Arg(1);
+
+BENCHMARK_MAIN();
@@ -1,7 +1,11 @@
 #include "nanomq/queue.hpp"
 #include "nanomq/message.hpp"
 #include <benchmark/benchmark.h>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
 #include <thread>
+#include <vector>
 
 using namespace nanomq;
 
@@ -60,17 +64,6 @@ static void BM_IdleBehavior(benchmark::State& state) {
 }
 BENCHMARK(BM_IdleBehavior);
 
-// CPU pause instruction (platform-independent)
-inline void cpu_pause() {
-#if defined(__x86_64__) || defined(_M_X64)
-    __builtin_ia32_pause();  // x86 PAUSE
-#elif defined(__aarch64__) || defined(_M_ARM64)
-    __asm__ __volatile__("yield");  // ARM YIELD
-#else
-    std::atomic_signal_fence(std::memory_order_seq_cst);
-#endif
-}
-
 // Benchmark: Contention with spinning
 static void BM_ContentionSpinning(benchmark::State& state) {
     SPSCQueue<int, 1024> queue;  // Smaller queue for more contention
@@ -105,5 +98,64 @@ static void BM_ContentionSpinning(benchmark::State& state) {
 }
 BENCHMARK(BM_ContentionSpinning)->Threads(2);
 
+// CPU time consumed by the calling thread
+static uint64_t thread_cpu_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Benchmark: consumer CPU time and wake latency per wait strategy
+// The producer publishes one timestamp every 50us; the consumer blocks in
+// pop_wait() and records how long after the push it woke up.
+template <typename Strategy>
+static void BM_WaitStrategy(benchmark::State& state) {
+    SPSCQueue<uint64_t, 1024, Strategy> queue;
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> consumer_cpu{0};
+    std::vector<uint64_t> latencies;
+    latencies.reserve(1 << 16);
+
+    std::thread consumer([&]() {
+        const uint64_t cpu_start = thread_cpu_ns();
+        uint64_t sent_at;
+        while (!stop.load(std::memory_order_relaxed)) {
+            if (queue.pop_wait(sent_at, 1000)) {
+                latencies.push_back(steady_ns() - sent_at);
+            }
+        }
+        consumer_cpu = thread_cpu_ns() - cpu_start;
+    });
+
+    const uint64_t wall_start = steady_ns();
+    for (auto _ : state) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        while (!queue.try_push(steady_ns())) {
+            std::this_thread::yield();
+        }
+    }
+    stop = true;
+    consumer.join();
+    const uint64_t wall_ns = steady_ns() - wall_start;
+
+    std::sort(latencies.begin(), latencies.end());
+    if (!latencies.empty()) {
+        state.counters["wake_p50_ns"] = latencies[latencies.size() / 2];
+        state.counters["wake_p99_ns"] = latencies[latencies.size() * 99 / 100];
+    }
+    state.counters["consumer_cpu_pct"] = 100.0 * consumer_cpu / wall_ns;
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_WaitStrategy, BusySpinWait)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_WaitStrategy, SpinYieldWait)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_WaitStrategy, BackoffWait)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_WaitStrategy, FutexParkWait)->UseRealTime();
+
 BENCHMARK_MAIN();
 
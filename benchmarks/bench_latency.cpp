@@ -1,7 +1,20 @@
 #include "nanomq/queue.hpp"
+#include "nanomq/clock.hpp"
+#include "nanomq/crc32c.hpp"
 #include "nanomq/message.hpp"
+#include "nanomq/protocol.hpp"
+#include "nanomq/shm_transport.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
 #include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstring>
+#include <string>
 #include <thread>
+#include <vector>
 
 using namespace nanomq;
 
@@ -42,6 +55,28 @@ static void BM_MessagePushPop(benchmark::State& state) {
 }
 BENCHMARK(BM_MessagePushPop);
 
+// Benchmark: Message claim/publish + peek/release (no struct copies)
+static void BM_MessageClaimPublish(benchmark::State& state) {
+    SPSCQueue<Message, 65536> queue;
+    const uint64_t timestamp = get_timestamp_ns();
+    
+    for (auto _ : state) {
+        QueueSpan<Message> slot = queue.claim(1);
+        slot[0].header.id = 1;
+        slot[0].header.timestamp = timestamp;
+        slot[0].header.size = 1024;
+        slot[0].data = nullptr;
+        queue.publish(1);
+
+        QueueSpan<Message> ready = queue.peek(1);
+        benchmark::DoNotOptimize(ready[0].header.id);
+        queue.release(1);
+    }
+    
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MessageClaimPublish);
+
 // Benchmark: Producer-consumer latency
 static void BM_ProducerConsumerLatency(benchmark::State& state) {
     SPSCQueue<uint64_t, 65536> queue;
@@ -62,8 +97,7 @@ static void BM_ProducerConsumerLatency(benchmark::State& state) {
     });
     
     for (auto _ : state) {
-        uint64_t timestamp = std::chrono::high_resolution_clock::now()
-                                .time_since_epoch().count();
+        uint64_t timestamp = Clock::now_ns();
         while (!queue.try_push(timestamp)) {
             std::this_thread::yield();
         }
@@ -98,6 +132,113 @@ static void BM_BatchPushPop(benchmark::State& state) {
 }
 BENCHMARK(BM_BatchPushPop)->Arg(16)->Arg(64)->Arg(256);
 
+// Benchmark: Batch operations on 64-byte-header messages
+static void BM_BatchPushPopMessage(benchmark::State& state) {
+    SPSCQueue<Message, 65536> queue;
+    const size_t batch_size = state.range(0);
+    
+    std::vector<Message> data(batch_size);
+    for (size_t i = 0; i < batch_size; ++i) {
+        data[i].header.id = i;
+    }
+    
+    std::vector<Message> output(batch_size);
+    
+    for (auto _ : state) {
+        queue.try_push_batch(data.data(), batch_size);
+        queue.try_pop_batch(output.data(), batch_size);
+        benchmark::DoNotOptimize(output.data());
+    }
+    
+    state.SetItemsProcessed(state.iterations() * batch_size);
+}
+BENCHMARK(BM_BatchPushPopMessage)->Arg(16)->Arg(64)->Arg(256);
+
+// Batch of tick-sized messages for the encoding benchmarks
+static std::vector<Message> make_ticks(size_t payload_size, std::vector<uint8_t>& payload) {
+    payload.assign(payload_size, 0x42);
+    std::vector<Message> ticks(256);
+    const uint64_t start = get_timestamp_ns();
+    for (size_t i = 0; i < ticks.size(); ++i) {
+        ticks[i] = Message(1000000 + i, start + i * 800, 3, payload.data(), payload.size());
+        ticks[i].data = payload.data();
+    }
+    return ticks;
+}
+
+// Benchmark: full 64-byte header plus payload per message (baseline)
+static void BM_EncodeFullHeader(benchmark::State& state) {
+    std::vector<uint8_t> payload;
+    const std::vector<Message> ticks = make_ticks(state.range(0), payload);
+    std::vector<uint8_t> buffer(ticks.size() * (sizeof(MessageHeader) + payload.size()));
+
+    size_t bytes = 0;
+    for (auto _ : state) {
+        bytes = 0;
+        for (const Message& msg : ticks) {
+            std::memcpy(buffer.data() + bytes, &msg.header, sizeof(MessageHeader));
+            std::memcpy(buffer.data() + bytes + sizeof(MessageHeader), msg.data,
+                        msg.header.size);
+            bytes += sizeof(MessageHeader) + msg.header.size;
+        }
+        benchmark::DoNotOptimize(buffer.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * ticks.size());
+    state.counters["bytes_per_msg"] = static_cast<double>(bytes) / ticks.size();
+}
+BENCHMARK(BM_EncodeFullHeader)->Arg(32)->Arg(200);
+
+// Benchmark: compact encoding against the batch's first message
+static void BM_EncodeCompact(benchmark::State& state) {
+    std::vector<uint8_t> payload;
+    const std::vector<Message> ticks = make_ticks(state.range(0), payload);
+    std::vector<uint8_t> buffer(ticks.size() * (MAX_COMPACT_HEADER_SIZE + payload.size()));
+    EncodingBase base;
+    base.id = ticks[0].header.id;
+    base.timestamp = ticks[0].header.timestamp;
+
+    size_t bytes = 0;
+    for (auto _ : state) {
+        bytes = 0;
+        for (const Message& msg : ticks) {
+            bytes += encode_message(msg, buffer.data() + bytes, buffer.size() - bytes, base);
+        }
+        benchmark::DoNotOptimize(buffer.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * ticks.size());
+    state.counters["bytes_per_msg"] = static_cast<double>(bytes) / ticks.size();
+}
+BENCHMARK(BM_EncodeCompact)->Arg(32)->Arg(200);
+
+// Benchmark: decoding the compact batch (payloads stay in place)
+static void BM_DecodeCompact(benchmark::State& state) {
+    std::vector<uint8_t> payload;
+    const std::vector<Message> ticks = make_ticks(state.range(0), payload);
+    std::vector<uint8_t> buffer(ticks.size() * (MAX_COMPACT_HEADER_SIZE + payload.size()));
+    EncodingBase base;
+    base.id = ticks[0].header.id;
+    base.timestamp = ticks[0].header.timestamp;
+
+    size_t bytes = 0;
+    for (const Message& msg : ticks) {
+        bytes += encode_message(msg, buffer.data() + bytes, buffer.size() - bytes, base);
+    }
+
+    Message msg;
+    for (auto _ : state) {
+        size_t offset = 0;
+        while (offset < bytes) {
+            offset += decode_message(buffer.data() + offset, bytes - offset, msg, base);
+            benchmark::DoNotOptimize(msg.header.id);
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * ticks.size());
+}
+BENCHMARK(BM_DecodeCompact)->Arg(32)->Arg(200);
+
 // Benchmark: CRC32 calculation
 static void BM_CRC32Calculation(benchmark::State& state) {
     const size_t size = state.range(0);
@@ -112,5 +253,174 @@ static void BM_CRC32Calculation(benchmark::State& state) {
 }
 BENCHMARK(BM_CRC32Calculation)->Arg(64)->Arg(1024)->Arg(4096)->Arg(65536);
 
+// Benchmark: CRC32C per implementation (second arg is Crc32cImpl)
+static void BM_CRC32CCalculation(benchmark::State& state) {
+    const size_t size = state.range(0);
+    const Crc32cImpl impl = static_cast<Crc32cImpl>(state.range(1));
+    std::vector<uint8_t> data(size, 0xAA);
+
+    const Crc32cImpl original = crc32c_implementation();
+    if (!crc32c_set_implementation(impl)) {
+        state.SkipWithError("not supported on this CPU");
+        return;
+    }
+    state.SetLabel(crc32c_implementation_name(impl));
+
+    for (auto _ : state) {
+        uint32_t crc = crc32c(data.data(), data.size());
+        benchmark::DoNotOptimize(crc);
+    }
+
+    crc32c_set_implementation(original);
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_CRC32CCalculation)
+    ->ArgsProduct({{64, 1024, 4096, 65536},
+                   {static_cast<int>(Crc32cImpl::SOFTWARE),
+                    static_cast<int>(Crc32cImpl::SSE42),
+                    static_cast<int>(Crc32cImpl::SSE42_PCLMUL)}});
+
+// Benchmark: timestamp sources (0 = Clock::now_ns, 1 = coarse, 2 = clock_gettime)
+static void BM_Timestamp(benchmark::State& state) {
+    const int source = static_cast<int>(state.range(0));
+    static const char* const LABELS[] = {"tsc", "coarse", "clock_gettime"};
+    state.SetLabel(source == 0 && !Clock::uses_tsc() ? "tsc (unavailable)" : LABELS[source]);
+
+    for (auto _ : state) {
+        uint64_t now;
+        if (source == 0) {
+            now = Clock::now_ns();
+        } else if (source == 1) {
+            now = Clock::coarse_now_ns();
+        } else {
+            now = Clock::realtime_ns();
+        }
+        benchmark::DoNotOptimize(now);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Timestamp)->DenseRange(0, 2);
+
+// Benchmark: same-host round trip through two shared-memory rings
+// The echo side maps the segments separately, as another process would
+static void BM_RoundTripShm(benchmark::State& state) {
+    const size_t message_size = state.range(0);
+    const size_t capacity = 1 << 16;
+    const std::string prefix = "/nanomq.bench-" + std::to_string(getpid());
+    auto ping = ShmSegment::create(prefix + ".ping", ShmRing::segment_size(capacity));
+    auto pong = ShmSegment::create(prefix + ".pong", ShmRing::segment_size(capacity));
+    if (!ping || !pong) {
+        state.SkipWithError("shm_open failed");
+        return;
+    }
+    ShmRing::initialize(ping->data(), capacity);
+    ShmRing::initialize(pong->data(), capacity);
+
+    std::atomic<bool> stop{false};
+    std::thread echo([&]() {
+        auto in_segment = ShmSegment::open(prefix + ".ping");
+        auto out_segment = ShmSegment::open(prefix + ".pong");
+        ShmRing in;
+        ShmRing out;
+        in.attach(in_segment->data(), in_segment->size());
+        out.attach(out_segment->data(), out_segment->size());
+        Message msg;
+        while (!stop.load(std::memory_order_relaxed)) {
+            if (!in.try_read(msg)) {
+                in.wait(1000000);
+                continue;
+            }
+            while (!out.try_write(msg.header, msg.data)) {
+            }
+            in.release();
+        }
+    });
+
+    ShmRing request;
+    ShmRing reply;
+    request.attach(ping->data(), ping->size());
+    reply.attach(pong->data(), pong->size());
+    std::vector<uint8_t> payload(message_size, 0x42);
+    MessageHeader header;
+    header.size = static_cast<uint32_t>(message_size);
+
+    for (auto _ : state) {
+        request.try_write(header, payload.data());
+        Message msg;
+        while (!reply.try_read(msg)) {
+            reply.wait(1000000);
+        }
+        benchmark::DoNotOptimize(msg.data[0]);
+        reply.release();
+    }
+
+    stop = true;
+    MessageHeader wake;
+    request.try_write(wake, nullptr);
+    echo.join();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RoundTripShm)->Arg(64)->Arg(1024)->UseRealTime();
+
+// Benchmark: same-host round trip over loopback TCP (the path shm replaces)
+static void BM_RoundTripTcp(benchmark::State& state) {
+    const size_t frame_size = sizeof(MessageHeader) + state.range(0);
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;  // Any free port
+    socklen_t len = sizeof(addr);
+    if (listener < 0 || bind(listener, (sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(listener, 1) < 0 || getsockname(listener, (sockaddr*)&addr, &len) < 0) {
+        state.SkipWithError("loopback listen failed");
+        return;
+    }
+
+    auto read_full = [](int fd, uint8_t* buffer, size_t size) {
+        size_t done = 0;
+        while (done < size) {
+            ssize_t n = recv(fd, buffer + done, size - done, 0);
+            if (n <= 0) {
+                return false;
+            }
+            done += static_cast<size_t>(n);
+        }
+        return true;
+    };
+
+    std::thread echo([&]() {
+        int fd = accept(listener, nullptr, nullptr);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        std::vector<uint8_t> frame(frame_size);
+        while (read_full(fd, frame.data(), frame_size)) {
+            send(fd, frame.data(), frame_size, 0);
+        }
+        close(fd);
+    });
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        state.SkipWithError("loopback connect failed");
+    } else {
+        std::vector<uint8_t> frame(frame_size, 0x42);
+        for (auto _ : state) {
+            send(fd, frame.data(), frame_size, 0);
+            read_full(fd, frame.data(), frame_size);
+            benchmark::DoNotOptimize(frame[0]);
+        }
+    }
+
+    close(fd);
+    echo.join();
+    close(listener);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RoundTripTcp)->Arg(64)->Arg(1024)->UseRealTime();
+
 BENCHMARK_MAIN();
 
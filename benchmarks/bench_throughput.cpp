@@ -1,7 +1,14 @@
 #include "nanomq/queue.hpp"
+#include "nanomq/broadcast_ring.hpp"
 #include "nanomq/message.hpp"
+#include "nanomq/message_ref.hpp"
+#include "nanomq/payload_pool.hpp"
+#include "nanomq/record_ring.hpp"
+#include <cstdlib>
+#include <cstring>
 #include <benchmark/benchmark.h>
 #include <thread>
+#include <vector>
 
 using namespace nanomq;
 
@@ -47,6 +54,218 @@ BENCHMARK(BM_ThroughputVaryingSize)
     ->Arg(64)->Arg(256)->Arg(1024)->Arg(4096)->Arg(65536)
     ->Threads(2);
 
+// Benchmark: Sustained throughput writing/reading messages in place
+// Same shape as BM_ThroughputVaryingSize, using claim/publish + peek/release
+static void BM_ThroughputInPlace(benchmark::State& state) {
+    SPSCQueue<Message, 65536> queue;
+    const size_t message_size = state.range(0);
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> consumed{0};
+    
+    // Consumer thread
+    std::thread consumer([&]() {
+        while (!stop || !queue.is_empty()) {
+            QueueSpan<Message> ready = queue.peek(1);
+            if (!ready.empty()) {
+                benchmark::DoNotOptimize(ready[0].header.id);
+                queue.release(1);
+                ++consumed;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+    
+    // Producer (measured)
+    for (auto _ : state) {
+        QueueSpan<Message> slot = queue.claim(1);
+        while (slot.empty()) {
+            std::this_thread::yield();
+            slot = queue.claim(1);
+        }
+        slot[0].header.id = 1;
+        slot[0].header.timestamp = get_timestamp_ns();
+        slot[0].header.size = message_size;
+        slot[0].data = nullptr;
+        queue.publish(1);
+    }
+    
+    stop = true;
+    consumer.join();
+    
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * message_size);
+}
+BENCHMARK(BM_ThroughputInPlace)
+    ->Arg(64)->Arg(256)->Arg(1024)->Arg(4096)->Arg(65536)
+    ->Threads(2);
+
+// Benchmark: payloads in heap buffers handed through an SPSCQueue
+// Baseline for BM_PayloadInRecordRing: one malloc/free pair per message
+static void BM_PayloadHeapAllocated(benchmark::State& state) {
+    SPSCQueue<Message, 65536> queue;
+    const size_t message_size = state.range(0);
+    std::vector<uint8_t> source(message_size, 0x5a);
+    std::atomic<bool> stop{false};
+
+    std::thread consumer([&]() {
+        Message msg;
+        while (!stop || !queue.is_empty()) {
+            if (queue.try_pop(msg)) {
+                benchmark::DoNotOptimize(msg.data[msg.header.size - 1]);
+                free(msg.data);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    for (auto _ : state) {
+        Message msg;
+        msg.header.size = static_cast<uint32_t>(message_size);
+        msg.data = static_cast<uint8_t*>(malloc(message_size));
+        std::memcpy(msg.data, source.data(), message_size);
+        while (!queue.try_push(msg)) {
+            std::this_thread::yield();
+        }
+    }
+
+    stop = true;
+    consumer.join();
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * message_size);
+}
+BENCHMARK(BM_PayloadHeapAllocated)
+    ->Arg(64)->Arg(512)->Arg(4096)
+    ->UseRealTime();
+
+// Benchmark: same cross-thread pattern with PayloadPool buffers
+// The producer allocates, the consumer frees
+static void BM_PayloadPooled(benchmark::State& state) {
+    SPSCQueue<Message, 65536> queue;
+    const size_t message_size = state.range(0);
+    std::vector<uint8_t> source(message_size, 0x5a);
+    std::atomic<bool> stop{false};
+
+    std::thread consumer([&]() {
+        Message msg;
+        while (!stop || !queue.is_empty()) {
+            if (queue.try_pop(msg)) {
+                benchmark::DoNotOptimize(msg.data[msg.header.size - 1]);
+                PayloadPool::deallocate(msg.data, msg.header.size);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    for (auto _ : state) {
+        Message msg;
+        msg.header.size = static_cast<uint32_t>(message_size);
+        msg.data = PayloadPool::allocate(message_size);
+        std::memcpy(msg.data, source.data(), message_size);
+        while (!queue.try_push(msg)) {
+            std::this_thread::yield();
+        }
+    }
+
+    stop = true;
+    consumer.join();
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * message_size);
+}
+BENCHMARK(BM_PayloadPooled)
+    ->Arg(64)->Arg(512)->Arg(4096)
+    ->UseRealTime();
+
+// Benchmark: copy and drop a MessageRef (second arg 1 = shared buffer)
+// Unshared buffers count with plain loads and stores, shared ones with
+// atomic read-modify-writes
+static void BM_MessageRefCopy(benchmark::State& state) {
+    std::vector<uint8_t> payload(64, 0x5a);
+    MessageRef ref(1, 0, 0, payload.data(), payload.size());
+    if (state.range(0) != 0) {
+        ref.share();
+    }
+    state.SetLabel(state.range(0) != 0 ? "shared" : "owner thread");
+
+    for (auto _ : state) {
+        MessageRef copy = ref;
+        benchmark::DoNotOptimize(copy);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MessageRefCopy)->Arg(0)->Arg(1);
+
+// Benchmark: one payload fanned out to four consumers by reference,
+// against a private payload copy per consumer
+static void BM_FanOut(benchmark::State& state) {
+    const bool by_reference = state.range(1) != 0;
+    const size_t message_size = state.range(0);
+    const int CONSUMERS = 4;
+    std::vector<uint8_t> source(message_size, 0x5a);
+    std::vector<Message> inbox(CONSUMERS);
+
+    for (auto _ : state) {
+        if (by_reference) {
+            MessageRef ref(1, 0, 0, source.data(), message_size);
+            for (int c = 0; c < CONSUMERS; ++c) {
+                inbox[c] = MessageRef(ref).detach();
+            }
+            for (int c = 0; c < CONSUMERS; ++c) {
+                MessageRef::adopt(inbox[c]);
+            }
+        } else {
+            for (int c = 0; c < CONSUMERS; ++c) {
+                PooledMessage copy(1, 0, 0, source.data(), message_size);
+                benchmark::DoNotOptimize(copy.message.data);
+            }
+        }
+    }
+    state.SetLabel(by_reference ? "MessageRef" : "copy per consumer");
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FanOut)->ArgsProduct({{64, 4096}, {0, 1}});
+
+// Benchmark: header and payload written contiguously into a RecordRing
+static void BM_PayloadInRecordRing(benchmark::State& state) {
+    RecordRing<1 << 22> ring;
+    const size_t message_size = state.range(0);
+    std::vector<uint8_t> source(message_size, 0x5a);
+    std::atomic<bool> stop{false};
+
+    std::thread consumer([&]() {
+        Message msg;
+        while (!stop || !ring.is_empty()) {
+            if (ring.try_read(msg)) {
+                benchmark::DoNotOptimize(msg.data[msg.header.size - 1]);
+                ring.release();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    MessageHeader header;
+    header.size = static_cast<uint32_t>(message_size);
+    for (auto _ : state) {
+        while (!ring.try_write(header, source.data())) {
+            std::this_thread::yield();
+        }
+    }
+
+    stop = true;
+    consumer.join();
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * message_size);
+}
+BENCHMARK(BM_PayloadInRecordRing)
+    ->Arg(64)->Arg(512)->Arg(4096)
+    ->UseRealTime();
+
 // Benchmark: Batch throughput
 static void BM_BatchThroughput(benchmark::State& state) {
     SPSCQueue<int, 65536> queue;
@@ -104,5 +323,153 @@ static void BM_MaxThroughput(benchmark::State& state) {
 }
 BENCHMARK(BM_MaxThroughput);
 
+// Benchmark: MPSC producer scaling (1/2/4/8 producers, one consumer)
+static void BM_MPSCProducerScaling(benchmark::State& state) {
+    const int num_producers = state.range(0);
+    const uint64_t items_per_producer = 100000;
+
+    for (auto _ : state) {
+        MPSCQueue<uint64_t, 65536> queue;
+        std::vector<std::thread> producers;
+
+        for (int p = 0; p < num_producers; ++p) {
+            producers.emplace_back([&]() {
+                for (uint64_t i = 0; i < items_per_producer; ++i) {
+                    while (!queue.try_push(i)) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+
+        // Consumer (measured thread)
+        const uint64_t total = items_per_producer * num_producers;
+        uint64_t consumed = 0;
+        uint64_t out[64];
+        while (consumed < total) {
+            size_t n = queue.try_pop_batch(out, 64);
+            if (n == 0) {
+                std::this_thread::yield();
+            }
+            consumed += n;
+        }
+        benchmark::DoNotOptimize(out);
+
+        for (auto& t : producers) {
+            t.join();
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * items_per_producer *
+                            num_producers);
+}
+BENCHMARK(BM_MPSCProducerScaling)
+    ->Arg(1)->Arg(2)->Arg(4)->Arg(8)
+    ->UseRealTime();
+
+// Benchmark: MPMC consumer scaling (one producer, 1..N consumers)
+static void BM_MPMCConsumerScaling(benchmark::State& state) {
+    const int num_consumers = state.range(0);
+    const uint64_t total = 400000;
+
+    for (auto _ : state) {
+        MPMCQueue<uint64_t, 65536> queue;
+        std::atomic<uint64_t> consumed{0};
+        std::vector<std::thread> consumers;
+
+        for (int c = 0; c < num_consumers; ++c) {
+            consumers.emplace_back([&]() {
+                uint64_t out[64];
+                while (consumed.load(std::memory_order_relaxed) < total) {
+                    size_t n = queue.try_pop_batch(out, 64);
+                    if (n == 0) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    benchmark::DoNotOptimize(out);
+                    consumed.fetch_add(n, std::memory_order_relaxed);
+                }
+            });
+        }
+
+        // Producer (measured thread)
+        uint64_t batch[64];
+        for (size_t i = 0; i < 64; ++i) {
+            batch[i] = i;
+        }
+        uint64_t produced = 0;
+        while (produced < total) {
+            size_t want = (total - produced < 64) ? total - produced : 64;
+            size_t n = queue.try_push_batch(batch, want);
+            if (n == 0) {
+                std::this_thread::yield();
+            }
+            produced += n;
+        }
+
+        for (auto& t : consumers) {
+            t.join();
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * total);
+}
+BENCHMARK(BM_MPMCConsumerScaling)
+    ->Arg(1)->Arg(2)->Arg(4)->Arg(8)
+    ->UseRealTime();
+
+// Benchmark: broadcast fan-out (one producer, 1..N readers on one ring)
+static void BM_BroadcastFanOut(benchmark::State& state) {
+    const int num_readers = state.range(0);
+    const uint64_t total = 200000;
+
+    for (auto _ : state) {
+        BroadcastRing<Message, 65536> ring;
+        std::vector<int> ids;
+        for (int r = 0; r < num_readers; ++r) {
+            ids.push_back(ring.add_reader());
+        }
+
+        std::vector<std::thread> readers;
+        for (int r = 0; r < num_readers; ++r) {
+            readers.emplace_back([&, r]() {
+                Message out[64];
+                uint64_t seen = 0;
+                while (seen < total) {
+                    size_t n = ring.try_read_batch(ids[r], out, 64);
+                    if (n == 0) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    benchmark::DoNotOptimize(out);
+                    seen += n;
+                }
+            });
+        }
+
+        // Producer (measured thread): each message is written once
+        Message batch[64];
+        uint64_t produced = 0;
+        while (produced < total) {
+            size_t want = (total - produced < 64) ? total - produced : 64;
+            size_t n = ring.try_push_batch(batch, want);
+            if (n == 0) {
+                std::this_thread::yield();
+            }
+            produced += n;
+        }
+
+        for (auto& t : readers) {
+            t.join();
+        }
+    }
+
+    // Deliveries: every reader receives every message
+    state.SetItemsProcessed(state.iterations() * total * num_readers);
+}
+BENCHMARK(BM_BroadcastFanOut)
+    ->Arg(1)->Arg(8)->Arg(32)
+    ->UseRealTime();
+
 BENCHMARK_MAIN();
 
@@ -0,0 +1,523 @@
+#include "nanomq/clock.hpp"
+#include "nanomq/compaction.hpp"
+#include "nanomq/log_streamer.hpp"
+#include "nanomq/message.hpp"
+#include "nanomq/mmap_file.hpp"
+#include "nanomq/protocol.hpp"
+#include "nanomq/recovery.hpp"
+#include "nanomq/segment.hpp"
+#include "nanomq/tiered_storage.hpp"
+#include "nanomq/wal.hpp"
+#include <dirent.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace nanomq;
+
+namespace {
+
+// Policies by benchmark argument
+WALSyncPolicy policy_for(int64_t arg) {
+    switch (arg) {
+    case 0: return WALSyncPolicy::always();
+    case 1: return WALSyncPolicy::every_ms(10);
+    case 2: return WALSyncPolicy::every_bytes(1024 * 1024);
+    default: return WALSyncPolicy::never();
+    }
+}
+
+const char* policy_name(int64_t arg) {
+    static const char* const NAMES[] = {"always", "every 10 ms", "every 1 MB", "never"};
+    return NAMES[arg < 3 ? arg : 3];
+}
+
+WALIoBackend backend_for(int64_t arg) {
+    return arg == 0 ? WALIoBackend::SYSCALLS : WALIoBackend::IO_URING;
+}
+
+WALWriteMode write_mode_for(int64_t arg) {
+    return arg == 0 ? WALWriteMode::BUFFERED : WALWriteMode::DIRECT;
+}
+
+void remove_directory(const std::string& dir) {
+    if (DIR* d = opendir(dir.c_str())) {
+        while (struct dirent* entry = readdir(d)) {
+            if (entry->d_name[0] != '.') {
+                unlink((dir + "/" + entry->d_name).c_str());
+            }
+        }
+        closedir(d);
+    }
+    rmdir(dir.c_str());
+}
+
+// Shared by the benchmark threads; thread 0 sets up and tears down
+std::unique_ptr<WAL> g_wal;
+std::string g_directory;
+std::mutex g_samples_mutex;
+std::vector<std::pair<uint64_t, uint64_t>> g_samples;  // LSN, append time
+std::atomic<bool> g_observing{false};
+std::vector<uint64_t> g_lags;  // Observer thread only
+std::thread g_observer;
+
+// Time from append to durable, for sampled appends: poll the durable LSN
+void observe() {
+    size_t next = 0;
+    while (g_observing.load(std::memory_order_relaxed)) {
+        const uint64_t durable = g_wal->durable_lsn();
+        const uint64_t now = Clock::now_ns();
+        std::lock_guard<std::mutex> lock(g_samples_mutex);
+        // Samples from several threads are not sorted; scan what is new
+        for (; next < g_samples.size(); ++next) {
+            if (g_samples[next].first > durable) {
+                break;
+            }
+            g_lags.push_back(now - g_samples[next].second);
+        }
+        g_samples.erase(g_samples.begin(), g_samples.begin() + next);
+        next = 0;
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+}  // namespace
+
+// Benchmark: appends per second under each sync policy, with the time
+// until an append is durable (durable_lag_us, sampled) and the time
+// append() itself takes (appender threads share group commits); the second
+// argument picks the syscall (0) or io_uring (1) backend, the third
+// buffered (0) or O_DIRECT (1) writes
+static void BM_WALAppend(benchmark::State& state) {
+    const int64_t policy = state.range(0);
+    const WALIoBackend backend = backend_for(state.range(1));
+    const WALWriteMode write_mode = write_mode_for(state.range(2));
+    const size_t SIZE = 128;
+    const uint64_t SAMPLE_EVERY = 64;
+
+    if (state.thread_index() == 0) {
+        g_directory = "bench-wal-" + std::to_string(getpid());
+        remove_directory(g_directory);
+        g_wal = std::make_unique<WAL>(g_directory, policy_for(policy), backend, write_mode);
+        g_samples.clear();
+        g_lags.clear();
+        g_observing = true;
+        g_observer = std::thread(observe);
+    }
+
+    std::vector<uint8_t> payload(SIZE, 0x5a);
+    Message msg(1, get_timestamp_ns(), 1, payload.data(), SIZE);
+    msg.data = payload.data();
+    uint64_t count = 0;
+    uint64_t append_ns = 0;
+
+    for (auto _ : state) {
+        const uint64_t start = Clock::now_ns();
+        const uint64_t lsn = g_wal->append(msg);
+        const uint64_t end = Clock::now_ns();
+        append_ns += end - start;
+        if (++count % SAMPLE_EVERY == 0) {
+            std::lock_guard<std::mutex> lock(g_samples_mutex);
+            g_samples.emplace_back(lsn, start);
+        }
+        ++msg.header.id;
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * SIZE);
+    state.counters["append_us"] = benchmark::Counter(
+        static_cast<double>(append_ns) / 1000.0 / static_cast<double>(count),
+        benchmark::Counter::kAvgThreads);
+
+    if (state.thread_index() == 0) {
+        // Let the last interval pass so lagging samples resolve
+        g_wal->flush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        g_observing = false;
+        g_observer.join();
+        double lag = 0;
+        for (uint64_t sample : g_lags) {
+            lag += static_cast<double>(sample);
+        }
+        state.counters["durable_lag_us"] =
+            g_lags.empty() ? 0.0 : lag / 1000.0 / static_cast<double>(g_lags.size());
+        state.SetLabel(std::string(policy_name(policy)) +
+                       (g_wal->io_backend() == WALIoBackend::IO_URING ? ", io_uring"
+                                                                      : ", syscalls") +
+                       (write_mode == WALWriteMode::DIRECT ? ", direct" : ""));
+        g_wal.reset();
+        remove_directory(g_directory);
+    }
+}
+BENCHMARK(BM_WALAppend)
+    ->ArgsProduct({{0, 1, 2, 3}, {0, 1}, {0, 1}})
+    ->Threads(1)
+    ->Threads(4)
+    ->UseRealTime();
+
+// Benchmark: rotate() plus the append that opens the next segment; in
+// DIRECT mode the segment was created and preallocated in the background
+// (spare = 1) or is created by the append (spare = 0, every other rotation
+// comes too soon for the flusher)
+static void BM_WALRotate(benchmark::State& state) {
+    const WALWriteMode write_mode = write_mode_for(state.range(0));
+    const bool spare = state.range(1) != 0;
+    const std::string dir = "bench-wal-rotate-" + std::to_string(getpid());
+    remove_directory(dir);
+    std::vector<uint8_t> payload(128, 0x5a);
+    Message msg(1, get_timestamp_ns(), 1, payload.data(), payload.size());
+    msg.data = payload.data();
+    {
+        WAL wal(dir, WALSyncPolicy::never(), WALIoBackend::SYSCALLS, write_mode);
+        wal.append(msg);
+        for (auto _ : state) {
+            if (spare) {
+                state.PauseTiming();
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                state.ResumeTiming();
+            }
+            wal.rotate();
+            ++msg.header.id;
+            benchmark::DoNotOptimize(wal.append(msg));
+        }
+    }
+    remove_directory(dir);
+    state.SetLabel(std::string(write_mode == WALWriteMode::DIRECT ? "direct" : "buffered") +
+                   (spare ? ", idle flusher" : ", back to back"));
+}
+BENCHMARK(BM_WALRotate)->ArgsProduct({{0, 1}, {0, 1}})->Iterations(200);
+
+// Benchmark: seek to a random id and read that record in a 1M-record log,
+// through the sparse indexes (indexed = 1) or by scanning the segments
+static void BM_WALSeek(benchmark::State& state) {
+    const bool indexed = state.range(0) != 0;
+    const uint64_t COUNT = 1000000;
+    const std::string dir = "bench-wal-seek-" + std::to_string(getpid());
+    remove_directory(dir);
+    {
+        std::vector<uint8_t> payload(100, 0x5a);
+        WAL wal(dir, WALSyncPolicy::never());
+        for (uint64_t id = 1; id <= COUNT; ++id) {
+            Message msg(id, id * 1000, 1, payload.data(), payload.size());
+            msg.data = payload.data();
+            wal.append(msg);
+        }
+        wal.flush();
+    }
+    if (!indexed) {
+        for (const auto& segment : segment_files(dir)) {
+            unlink(offset_index_path(segment.second).c_str());
+        }
+    }
+
+    LogReader reader(dir);
+    Message msg;
+    uint64_t target = 1;
+    for (auto _ : state) {
+        target = (target * 6364136223846793005ULL + 1442695040888963407ULL);
+        const uint64_t id = target % COUNT + 1;
+        if (!reader.seek(id) || !reader.next(msg) || msg.header.id != id) {
+            state.SkipWithError("seek failed");
+            break;
+        }
+    }
+    remove_directory(dir);
+    state.SetLabel(indexed ? "indexed" : "scan");
+}
+BENCHMARK(BM_WALSeek)->Arg(1)->Arg(0)->Unit(benchmark::kMicrosecond);
+
+// Benchmark: recover a clean 400 MB log (four 1 KB-record segments) on
+// state.range(0) threads; reports seconds per GB with the log in the
+// page cache
+static void BM_WALRecovery(benchmark::State& state) {
+    const unsigned threads = static_cast<unsigned>(state.range(0));
+    const uint64_t SEGMENTS = 4;
+    const uint64_t PER_SEGMENT = 100000;
+    const std::string dir = "bench-wal-recovery-" + std::to_string(getpid());
+    remove_directory(dir);
+    {
+        std::vector<uint8_t> payload(1000, 0x5a);
+        WAL wal(dir, WALSyncPolicy::never());
+        for (uint64_t id = 1; id <= SEGMENTS * PER_SEGMENT; ++id) {
+            Message msg(id, id * 1000, static_cast<uint32_t>(id % 8), payload.data(),
+                        payload.size());
+            msg.data = payload.data();
+            wal.append(msg);
+            if (id % PER_SEGMENT == 0) {
+                wal.rotate();
+            }
+        }
+        wal.flush();
+    }
+
+    uint64_t bytes = 0;
+    uint64_t elapsed_ns = 0;
+    for (auto _ : state) {
+        const RecoveryReport report = recover(dir, threads);
+        if (report.records != SEGMENTS * PER_SEGMENT) {
+            state.SkipWithError("records lost");
+            break;
+        }
+        bytes += report.bytes;
+        elapsed_ns += report.elapsed_ns;
+    }
+    remove_directory(dir);
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.counters["s_per_GB"] = bytes > 0 ? static_cast<double>(elapsed_ns) / bytes : 0;
+    state.SetLabel(std::to_string(threads) + " thread(s)");
+}
+BENCHMARK(BM_WALRecovery)->Arg(1)->Arg(2)->Arg(4)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// Benchmark: replay a log of 400K updates to state.range(0) keys over
+// five segments, as written (state.range(1) = 0) or compacted (1)
+static void BM_WALCompactedReplay(benchmark::State& state) {
+    const uint64_t keys = static_cast<uint64_t>(state.range(0));
+    const bool compacted = state.range(1) != 0;
+    const uint64_t COUNT = 400000;
+    const std::string dir = "bench-wal-compact-" + std::to_string(getpid());
+    remove_directory(dir);
+    {
+        WAL wal(dir, WALSyncPolicy::never());
+        std::vector<uint8_t> value(100, 0x5a);
+        uint8_t payload[256];
+        for (uint64_t id = 1; id <= COUNT; ++id) {
+            const std::string key = "key-" + std::to_string(id % keys);
+            const size_t size = make_keyed_payload(payload, key.data(),
+                                                   static_cast<uint16_t>(key.size()),
+                                                   value.data(), value.size());
+            Message msg(id, id * 1000, 1, payload, size);
+            msg.data = payload;
+            msg.set_flag(MSG_FLAG_KEYED);
+            wal.append(msg);
+            if (id % (COUNT / 5) == 0 && id < COUNT) {
+                wal.rotate();
+            }
+        }
+        wal.flush();
+    }
+    double compact_ms = 0;
+    if (compacted) {
+        CompactionPolicy policy;
+        policy.max_bytes_per_sec = 0;
+        const auto start = std::chrono::steady_clock::now();
+        LogCompactor(dir, policy).run_once();
+        compact_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+    uint64_t bytes = 0;
+    for (const SegmentInfo& segment : SegmentManager(dir).list_segments()) {
+        bytes += segment.end;
+    }
+
+    WAL wal(dir, WALSyncPolicy::never());
+    size_t records = 0;
+    for (auto _ : state) {
+        records = wal.replay([](const Message& msg) { benchmark::DoNotOptimize(msg.header.id); });
+    }
+    remove_directory(dir);
+    state.counters["records"] = static_cast<double>(records);
+    state.counters["log_MB"] = static_cast<double>(bytes) / (1024 * 1024);
+    state.counters["compact_ms"] = compact_ms;
+    state.SetLabel(compacted ? "compacted" : "full history");
+}
+BENCHMARK(BM_WALCompactedReplay)
+    ->ArgsProduct({{100, 10000}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+// Benchmark: append 4 KB to a 100 MB mapped file and sync it, with the
+// whole mapping msync()ed (dirty = 0) or only the pages marked dirty (1)
+static void BM_MMapAppendSync(benchmark::State& state) {
+    const bool tracked = state.range(0) != 0;
+    const size_t SIZE = 100 * 1024 * 1024;
+    const size_t CHUNK = 4096;
+    const std::string path = "bench-mmap-" + std::to_string(getpid()) + ".dat";
+    {
+        MMapFile file(path.c_str(), SIZE);
+        std::vector<uint8_t> chunk(CHUNK, 0x5a);
+        size_t offset = 0;
+        for (auto _ : state) {
+            std::memcpy(static_cast<uint8_t*>(file.data()) + offset, chunk.data(), CHUNK);
+            if (tracked) {
+                file.mark_dirty(offset, CHUNK);
+            }
+            file.sync();
+            offset = (offset + CHUNK) % SIZE;
+        }
+    }
+    unlink(path.c_str());
+    state.SetLabel(tracked ? "dirty pages" : "whole mapping");
+}
+BENCHMARK(BM_MMapAppendSync)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+// Benchmark: fetch an archived 20 MB segment from a local archive store
+// into an empty cache (decompress, verify, write)
+static void BM_ArchiveFetch(benchmark::State& state) {
+    const uint64_t PER_SEGMENT = 100000;
+    const std::string dir = "bench-wal-tier-" + std::to_string(getpid());
+    const std::string archive = dir + "-archive";
+    remove_directory(dir);
+    remove_directory(archive);
+    uint64_t segment_bytes = 0;
+    {
+        WAL wal(dir, WALSyncPolicy::never());
+        std::vector<uint8_t> payload(200);
+        for (uint64_t id = 1; id <= 3 * PER_SEGMENT; ++id) {
+            for (size_t i = 0; i < payload.size(); i += sizeof(id)) {
+                std::memcpy(payload.data() + i, &id, sizeof(id));  // Somewhat compressible
+            }
+            Message msg(id, id * 1000, 1, payload.data(), payload.size());
+            msg.data = payload.data();
+            wal.append(msg);
+            if (id % PER_SEGMENT == 0) {
+                wal.rotate();
+            }
+        }
+        wal.flush();
+    }
+    TierPolicy policy;
+    policy.archive_after_ms = 0;
+    policy.cache_bytes = 0;  // Keeps only the latest fetch
+    policy.cache_directory = dir + "-cache";
+    auto store = std::make_shared<LocalArchiveStore>(archive);
+    uint64_t archived_bytes = 0;
+    {
+        TieredStorage tier(dir, store, policy);
+        segment_bytes = SegmentManager(dir).list_segments()[0].end;
+        tier.archive_old_segments();
+        std::vector<uint8_t> object;
+        store->get(TieredStorage::object_name(1), object);
+        archived_bytes = object.size();
+
+        uint32_t number = 1;
+        for (auto _ : state) {
+            number = 3 - number;  // 1, 2, 1, ...: always a miss
+            const int fd = tier.fetch(number);
+            if (fd < 0) {
+                state.SkipWithError("fetch failed");
+                break;
+            }
+            close(fd);
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * segment_bytes));
+    state.counters["ratio"] = archived_bytes > 0 ? static_cast<double>(segment_bytes) / archived_bytes : 0;
+    remove_directory(policy.cache_directory);
+    remove_directory(archive);
+    remove_directory(dir);
+}
+BENCHMARK(BM_ArchiveFetch)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// Benchmark: a lagging consumer replaying the log over loopback TCP, read
+// through LogReader and re-encoded in user space (0) or sent from the
+// segment files with LogStreamer's sendfile() (1). CPU time is the
+// sender's; a thread drains the socket
+static void BM_CatchUpDelivery(benchmark::State& state) {
+    const uint64_t COUNT = 200000;
+    const std::string dir = "bench-wal-stream-" + std::to_string(getpid());
+    remove_directory(dir);
+    {
+        WAL wal(dir, WALSyncPolicy::never());
+        std::vector<uint8_t> payload(512, 0x5a);
+        for (uint64_t id = 1; id <= COUNT; ++id) {
+            Message msg(id, id * 1000, 1, payload.data(), payload.size());
+            msg.data = payload.data();
+            wal.append(msg);
+        }
+        wal.flush();
+    }
+
+    // Loopback connection with a reader that discards everything
+    const int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    listen(listener, 1);
+    getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length);
+    const int sender = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(sender, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        state.SkipWithError("connect failed");
+        close(sender);
+        close(listener);
+        remove_directory(dir);
+        return;
+    }
+    const int receiver = accept(listener, nullptr, nullptr);
+    std::thread drain([receiver] {
+        std::vector<uint8_t> buffer(256 * 1024);
+        while (recv(receiver, buffer.data(), buffer.size(), 0) > 0) {
+        }
+    });
+
+    const bool zero_copy = state.range(0) == 1;
+    uint64_t bytes = 0;
+    LogStreamer streamer(dir);
+    LogReader reader(dir);
+    std::vector<uint8_t> frame(LogStreamer::DEFAULT_FRAME_BYTES + MAX_COMPACT_HEADER_SIZE + 64);
+    for (auto _ : state) {
+        if (zero_copy) {
+            streamer.seek(LogPosition{0, 0});
+            ssize_t n;
+            while ((n = streamer.send_to(sender)) > 0) {
+                bytes += static_cast<uint64_t>(n);
+            }
+            continue;
+        }
+        // Same frames, built from decoded messages
+        reader.seek(LogPosition{0, 0});
+        Message msg;
+        size_t used = LogStreamer::FRAME_HEADER_SIZE;
+        EncodingBase base;
+        const auto send_frame = [&] {
+            const uint32_t header[2] = {MSG_TYPE_LOG_DATA, static_cast<uint32_t>(used - 8)};
+            std::memcpy(frame.data(), header, sizeof(header));
+            std::memcpy(frame.data() + 8, &base.id, 8);
+            std::memcpy(frame.data() + 16, &base.timestamp, 8);
+            for (size_t done = 0; done < used;) {
+                const ssize_t n = send(sender, frame.data() + done, used - done, 0);
+                if (n <= 0) {
+                    break;
+                }
+                done += static_cast<size_t>(n);
+            }
+            bytes += used - LogStreamer::FRAME_HEADER_SIZE;
+            used = LogStreamer::FRAME_HEADER_SIZE;
+        };
+        while (reader.next(msg)) {
+            if (used == LogStreamer::FRAME_HEADER_SIZE) {
+                base = EncodingBase{msg.header.id, msg.header.timestamp};
+            }
+            const size_t size = encoded_size(msg, base);
+            used += encode_varint(size, frame.data() + used);
+            used += encode_message(msg, frame.data() + used, frame.size() - used, base);
+            if (used >= LogStreamer::DEFAULT_FRAME_BYTES) {
+                send_frame();
+            }
+        }
+        if (used > LogStreamer::FRAME_HEADER_SIZE) {
+            send_frame();
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+
+    shutdown(sender, SHUT_WR);
+    drain.join();
+    close(sender);
+    close(receiver);
+    close(listener);
+    remove_directory(dir);
+}
+BENCHMARK(BM_CatchUpDelivery)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
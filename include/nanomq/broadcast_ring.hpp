@@ -0,0 +1,261 @@
+#pragma once
+
+#include "nanomq/queue.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
+#include <type_traits>
+
+namespace nanomq {
+
+// What the producer does when the slowest reader is a full ring behind
+enum class SlowReaderPolicy : uint8_t {
+    BLOCK_PRODUCER,  // try_push fails until the slowest reader catches up
+    DROP_READER,     // Cut the lagging readers loose and keep publishing
+};
+
+// Single-writer, multi-reader broadcast ring buffer
+//
+// Every reader sees every item: the producer writes each item once and each
+// reader advances its own cursor over the same storage, so fan-out to N
+// readers costs one write plus N cursor reads instead of N copies.
+// Positions are monotonic; the producer may not write position p until
+// every active cursor is past p - Capacity. It caches that gate and only
+// rescans the cursors when it reaches it.
+//
+// Cursor registration and the producer's rescan share a small spinlock, so
+// a new reader starts at the current head without ever being lapped. The
+// lock is never taken on the per-item path.
+template <typename T, size_t Capacity, size_t MaxReaders = 64>
+class BroadcastRing {
+public:
+    static_assert((Capacity & (Capacity - 1)) == 0,
+                  "Capacity must be a power of 2");
+    // Dropped readers may copy a slot while it is being overwritten and
+    // then discard it, which is only sound for trivially copyable items
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "BroadcastRing items must be trivially copyable");
+
+    explicit BroadcastRing(SlowReaderPolicy policy = SlowReaderPolicy::BLOCK_PRODUCER)
+        : policy_(policy), cached_gate_(Capacity), head_(0),
+          registry_lock_(false) {
+        void* ptr = nullptr;
+        if (posix_memalign(&ptr, CACHE_LINE_SIZE, sizeof(T) * Capacity) != 0) {
+            ptr = nullptr;
+        }
+        storage_ = static_cast<T*>(ptr);
+        for (size_t i = 0; i < MaxReaders; ++i) {
+            readers_[i].cursor.store(0, std::memory_order_relaxed);
+            readers_[i].state.store(READER_FREE, std::memory_order_relaxed);
+        }
+    }
+
+    ~BroadcastRing() {
+        free(storage_);
+    }
+
+    // Disable copy and move
+    BroadcastRing(const BroadcastRing&) = delete;
+    BroadcastRing& operator=(const BroadcastRing&) = delete;
+
+    // Publish a single item to every reader (producer side)
+    // Returns false if the slowest reader is a full ring behind and the
+    // policy is BLOCK_PRODUCER
+    bool try_push(const T& item) {
+        return try_push_batch(&item, 1) == 1;
+    }
+
+    // Publish up to max_count items to every reader (producer side)
+    // Returns number of items actually published
+    size_t try_push_batch(const T* items, size_t max_count) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        size_t available = cached_gate_ - head;
+        if (available < max_count) {
+            cached_gate_ = refresh_gate(head + max_count);
+            available = cached_gate_ - head;
+        }
+        const size_t count = (max_count < available) ? max_count : available;
+
+        for (size_t i = 0; i < count; ++i) {
+            storage_[(head + i) & INDEX_MASK] = items[i];
+        }
+        if (count > 0) {
+            head_.store(head + count, std::memory_order_release);
+        }
+        return count;
+    }
+
+    // Register a reader that starts at the next published item
+    // Returns the reader id, or -1 if all MaxReaders cursors are taken
+    int add_reader() {
+        lock_registry();
+        int id = -1;
+        for (size_t i = 0; i < MaxReaders; ++i) {
+            if (readers_[i].state.load(std::memory_order_relaxed) == READER_FREE) {
+                readers_[i].cursor.store(head_.load(std::memory_order_acquire),
+                                         std::memory_order_relaxed);
+                readers_[i].state.store(READER_ACTIVE, std::memory_order_release);
+                id = static_cast<int>(i);
+                break;
+            }
+        }
+        unlock_registry();
+        return id;
+    }
+
+    // Release a reader's cursor so it no longer gates the producer
+    void remove_reader(int reader) {
+        lock_registry();
+        readers_[reader].state.store(READER_FREE, std::memory_order_release);
+        unlock_registry();
+    }
+
+    // Read the reader's next item
+    // Returns false if nothing is new or the reader has been dropped
+    bool try_read(int reader, T& item) {
+        return try_read_batch(reader, &item, 1) == 1;
+    }
+
+    // Read up to max_count items for a reader
+    // Returns number of items actually read (0 if dropped)
+    size_t try_read_batch(int reader, T* items, size_t max_count) {
+        ReaderSlot& slot = readers_[reader];
+        const size_t cursor = slot.cursor.load(std::memory_order_relaxed);
+        const size_t head = head_.load(std::memory_order_acquire);
+
+        size_t available = head - cursor;
+        const size_t count = (max_count < available) ? max_count : available;
+        if (count == 0) {
+            return 0;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            items[i] = storage_[(cursor + i) & INDEX_MASK];
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (is_dropped(reader)) {
+            return 0;  // Producer may have overwritten what we copied
+        }
+        slot.cursor.store(cursor + count, std::memory_order_release);
+        return count;
+    }
+
+    // Get up to max_count contiguous unread items for in-place reads
+    // The span stops at the wrap point. With DROP_READER, check
+    // is_dropped() after processing before trusting the contents.
+    QueueSpan<const T> peek(int reader, size_t max_count) const {
+        const size_t cursor = readers_[reader].cursor.load(std::memory_order_relaxed);
+        const size_t head = head_.load(std::memory_order_acquire);
+
+        size_t available = head - cursor;
+        const size_t index = cursor & INDEX_MASK;
+        if (available > Capacity - index) {
+            available = Capacity - index;
+        }
+        return QueueSpan<const T>{storage_ + index,
+                                  (max_count < available) ? max_count : available};
+    }
+
+    // Advance a reader past the first count items of its last peek()
+    void release(int reader, size_t count) {
+        ReaderSlot& slot = readers_[reader];
+        const size_t cursor = slot.cursor.load(std::memory_order_relaxed);
+        slot.cursor.store(cursor + count, std::memory_order_release);
+    }
+
+    // Whether the producer has cut this reader loose (DROP_READER policy)
+    bool is_dropped(int reader) const {
+        return readers_[reader].state.load(std::memory_order_acquire) ==
+               READER_DROPPED;
+    }
+
+    // Number of published items the reader has not read yet
+    size_t lag(int reader) const {
+        return head_.load(std::memory_order_acquire) -
+               readers_[reader].cursor.load(std::memory_order_acquire);
+    }
+
+    // Number of registered readers (dropped ones included until removed)
+    size_t reader_count() const {
+        size_t count = 0;
+        for (size_t i = 0; i < MaxReaders; ++i) {
+            if (readers_[i].state.load(std::memory_order_relaxed) != READER_FREE) {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    // Total items published so far
+    size_t published() const { return head_.load(std::memory_order_acquire); }
+
+    // Get capacity
+    static constexpr size_t capacity() { return Capacity; }
+    static constexpr size_t max_readers() { return MaxReaders; }
+
+private:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    static constexpr size_t INDEX_MASK = Capacity - 1;
+
+    static constexpr uint32_t READER_FREE = 0;
+    static constexpr uint32_t READER_ACTIVE = 1;
+    static constexpr uint32_t READER_DROPPED = 2;
+
+    // One cache line per reader so cursor updates never false-share
+    struct alignas(CACHE_LINE_SIZE) ReaderSlot {
+        std::atomic<size_t> cursor;    // Next position this reader reads
+        std::atomic<uint32_t> state;   // READER_FREE/ACTIVE/DROPPED
+    };
+
+    void lock_registry() {
+        while (registry_lock_.exchange(true, std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    void unlock_registry() {
+        registry_lock_.store(false, std::memory_order_release);
+    }
+
+    // Rescan the reader cursors; with DROP_READER, first drop every reader
+    // that would stop the producer from reaching wanted_head
+    // Returns the first position the producer may not write
+    size_t refresh_gate(size_t wanted_head) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        lock_registry();
+        size_t min_cursor = head;
+        for (size_t i = 0; i < MaxReaders; ++i) {
+            ReaderSlot& slot = readers_[i];
+            if (slot.state.load(std::memory_order_relaxed) != READER_ACTIVE) {
+                continue;
+            }
+            const size_t cursor = slot.cursor.load(std::memory_order_acquire);
+            if (policy_ == SlowReaderPolicy::DROP_READER &&
+                cursor + Capacity < wanted_head) {
+                slot.state.store(READER_DROPPED, std::memory_order_release);
+                continue;
+            }
+            if (cursor < min_cursor) {
+                min_cursor = cursor;
+            }
+        }
+        unlock_registry();
+        // Make sure drop marks are visible before slots are overwritten
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return min_cursor + Capacity;
+    }
+
+    T* storage_;  // Ring buffer storage (read-only after construction)
+    const SlowReaderPolicy policy_;
+
+    // Producer-only cache of refresh_gate()
+    alignas(CACHE_LINE_SIZE) size_t cached_gate_;
+    std::atomic<size_t> head_;  // Producer writes
+
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> registry_lock_;
+    ReaderSlot readers_[MaxReaders];
+};
+
+}  // namespace nanomq
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+namespace nanomq {
+
+// Wall-clock time source for message stamping
+//
+// With an invariant TSC, now_ns() is rdtsc plus a fixed-point multiply
+// (a few ns) instead of a clock_gettime() call. The TSC is calibrated
+// against CLOCK_REALTIME on first use; a background thread then refines
+// the frequency over a growing baseline and slews the clock towards
+// CLOCK_REALTIME so drift is corrected without going backwards. Without a
+// usable TSC every call falls back to clock_gettime(). A forked child
+// starts over with a thread of its own on first use.
+class Clock {
+public:
+    static constexpr uint64_t COARSE_INTERVAL_NS = 1000000;  // 1 ms
+
+    // Nanoseconds since the epoch
+    static uint64_t now_ns() {
+#if defined(__x86_64__)
+        const Calibration& c = calibration_;
+        uint32_t sequence;
+        uint64_t tsc_base, ns_base, mult, tsc;
+        do {
+            sequence = c.sequence.load(std::memory_order_acquire);
+            if (sequence == 0) {
+                return slow_now_ns();  // Not calibrated (yet), or no TSC
+            }
+            tsc_base = c.tsc_base.load(std::memory_order_relaxed);
+            ns_base = c.ns_base.load(std::memory_order_relaxed);
+            mult = c.mult.load(std::memory_order_relaxed);
+            tsc = __rdtsc();
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((sequence & 1) != 0 ||
+                 c.sequence.load(std::memory_order_relaxed) != sequence);
+
+        // rdtsc is not ordered against the loads above
+        const uint64_t ticks = tsc > tsc_base ? tsc - tsc_base : 0;
+        return ns_base + static_cast<uint64_t>(
+            (static_cast<unsigned __int128>(ticks) * mult) >> MULT_SHIFT);
+#else
+        return slow_now_ns();
+#endif
+    }
+
+    // Nanoseconds since the epoch, refreshed every COARSE_INTERVAL_NS
+    // A single load: for stamping batches where ordering within the batch
+    // comes from message ids. The first call makes the background thread
+    // wake every COARSE_INTERVAL_NS from then on
+    static uint64_t coarse_now_ns() {
+        const uint64_t coarse = coarse_ns_.load(std::memory_order_relaxed);
+        return coarse != 0 ? coarse : start_coarse_clock();
+    }
+
+    // CLOCK_REALTIME directly
+    static uint64_t realtime_ns();
+
+    // Whether now_ns() runs on the TSC
+    static bool uses_tsc();
+
+    // Calibrated TSC frequency (0 without a TSC)
+    static uint64_t tsc_hz();
+
+    // Recalibrate now against CLOCK_REALTIME (normally done in background)
+    static void recalibrate();
+
+private:
+    static constexpr int MULT_SHIFT = 32;  // mult is ns per tick in 32.32
+
+    // Seqlock-protected conversion: ns = ns_base + (tsc - tsc_base) * mult
+    // sequence is odd while being updated and 0 until calibrated
+    struct alignas(64) Calibration {
+        std::atomic<uint32_t> sequence{0};
+        std::atomic<uint64_t> tsc_base{0};
+        std::atomic<uint64_t> ns_base{0};
+        std::atomic<uint64_t> mult{0};
+    };
+
+    // Starts calibration on first use; clock_gettime() without a TSC
+    static uint64_t slow_now_ns();
+
+    // Starts refreshing coarse_ns_; returns now_ns()
+    static uint64_t start_coarse_clock();
+
+    friend class ClockCalibrator;
+
+    static Calibration calibration_;
+    alignas(64) static std::atomic<uint64_t> coarse_ns_;
+};
+
+}  // namespace nanomq
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace nanomq {
+
+class TieredStorage;
+
+// What the background pass of a LogCompactor does
+struct CompactionPolicy {
+    uint64_t retention_ms = 0;       // Delete segments older than this; 0 keeps them
+    uint64_t retention_bytes = 0;    // Delete the oldest beyond this much; 0 for no limit
+    bool compact_keys = true;        // Keep only the latest record per key
+    uint64_t max_bytes_per_sec = 32 * 1024 * 1024;  // Compaction I/O budget; 0 for none
+    uint64_t interval_ms = 60000;    // Between passes
+};
+
+struct CompactionStats {
+    size_t segments_deleted = 0;     // By retention or left empty by compaction
+    size_t segments_compacted = 0;   // Rewritten
+    size_t segments_archived = 0;    // Moved to the archive tier
+    uint64_t records_removed = 0;    // Superseded by a later record with the same key
+                                     // (batch records counted one by one)
+    uint64_t bytes_reclaimed = 0;    // Of records, segments deleted by retention excluded
+};
+
+// Retention and key-based compaction of a WAL directory
+//
+// Compaction works on sealed segments, those before the last one with a
+// record, as Kafka's log cleaner does: a first pass maps every key
+// (topic_id plus Message::key()) to its latest record in the whole log, a
+// second rewrites each sealed segment holding an older version into
+// NNNNNNNN.cleaned.wal with fresh indexes, then renames it over the
+// original. Unkeyed records are always kept. The records of a record batch
+// count one by one: a batch with superseded ones is rebuilt from the rest
+// and dropped once none are left. The old indexes are deleted
+// before the swap so readers fall back to scanning rather than follow
+// stale positions; a segment left empty is deleted. Reads and writes are
+// throttled to max_bytes_per_sec.
+//
+// Given the directory's TieredStorage, a pass also archives old segments,
+// and retention covers archived ones; compaction is local only.
+class LogCompactor {
+public:
+    LogCompactor(const std::string& directory, const CompactionPolicy& policy,
+                 std::shared_ptr<TieredStorage> tier = nullptr);
+    ~LogCompactor();
+
+    LogCompactor(const LogCompactor&) = delete;
+    LogCompactor& operator=(const LogCompactor&) = delete;
+
+    // Run passes every interval_ms on a background thread
+    void start();
+    void stop();
+
+    // One pass of retention and compaction on the calling thread
+    CompactionStats run_once();
+
+    // Sum over all passes so far
+    CompactionStats totals() const;
+
+private:
+    void run();
+    void compact(CompactionStats& stats);
+
+    std::string directory_;
+    const CompactionPolicy policy_;
+    const std::shared_ptr<TieredStorage> tier_;
+
+    std::mutex pass_mutex_;  // One pass at a time
+    mutable std::mutex mutex_;
+    std::condition_variable wakeup_;
+    bool stopping_;
+    CompactionStats totals_;
+    std::atomic<bool> cancel_;  // Abandon the current pass
+    std::thread thread_;
+};
+
+}  // namespace nanomq
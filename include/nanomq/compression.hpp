@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace nanomq {
+
+// LZ4 block compression (built in-tree, LZ4 block format compatible)
+//
+// Greedy single-pass compressor with a 4K-entry hash table and the usual
+// skip acceleration on incompressible input; the decompressor checks
+// every length and offset against both buffers.
+
+// Largest compressed size of size input bytes
+constexpr size_t lz4_compress_bound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+// Compress src into dst (dst_capacity >= lz4_compress_bound(src_size))
+// Returns the compressed size, 0 if dst is too small or src exceeds 4 GB
+size_t lz4_compress(const void* src, size_t src_size, void* dst, size_t dst_capacity);
+
+// Decompress a block; returns the decompressed size, 0 if src is malformed
+// or does not fit in dst_capacity
+size_t lz4_decompress(const void* src, size_t src_size, void* dst, size_t dst_capacity);
+
+// Record batches use this for MSG_FLAG_COMPRESSED, see record_batch.hpp
+
+}  // namespace nanomq
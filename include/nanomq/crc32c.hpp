@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace nanomq {
+
+// CRC32C (Castagnoli) checksums
+//
+// The implementation is picked once, on first use, from what the CPU
+// supports: the SSE4.2 crc32 instruction over three interleaved streams
+// with PCLMUL to merge them, the same without PCLMUL (table-driven merge),
+// or portable slicing-by-8.
+
+enum class Crc32cImpl {
+    SOFTWARE,      // Slicing-by-8 tables
+    SSE42,         // crc32 instruction, 3 streams, table merge
+    SSE42_PCLMUL,  // crc32 instruction, 3 streams, carry-less multiply merge
+};
+
+// CRC32C of a buffer
+uint32_t crc32c(const void* data, size_t size);
+
+// Continue a CRC32C: crc32c(a + b) == crc32c_extend(crc32c(a), b)
+uint32_t crc32c_extend(uint32_t crc, const void* data, size_t size);
+
+// Implementation in use and its name (for logs and benchmarks)
+Crc32cImpl crc32c_implementation();
+const char* crc32c_implementation_name(Crc32cImpl impl);
+
+// Whether this CPU can run impl
+bool crc32c_supported(Crc32cImpl impl);
+
+// Switch implementations (tests and benchmarks); false if unsupported
+bool crc32c_set_implementation(Crc32cImpl impl);
+
+}  // namespace nanomq
@@ -0,0 +1,385 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace nanomq {
+
+// Lock-free SPSC ring buffer with a capacity chosen at runtime
+//
+// The queue reserves virtual address space for max_capacity items on the
+// first push, but the producer only walks a window at the front of it, so
+// only the pages of that window are ever committed. The window starts at
+// one page and doubles when the ring fills up (a hot topic grows); resize()
+// and trim() let the producer shrink it again and hand pages back to the
+// kernel (a cold topic costs a few hundred bytes plus at most a page).
+//
+// Instead of masking indices, the producer jumps explicitly: when it reaches
+// the end of the window it records a jump from that point to slot 0 and
+// restarts there, and the consumer follows once it reaches the recorded
+// point. This is what lets the window change size without moving items that
+// are in flight. If the wrapped ring fills while the window may still grow,
+// the producer records a second jump back to where it wrapped and carries on
+// above the items the consumer has not reached yet, so a lagging consumer
+// does not cap the queue below max_capacity.
+template <typename T>
+class ElasticSPSCQueue {
+public:
+    explicit ElasticSPSCQueue(size_t max_capacity, size_t initial_capacity = 0)
+        : storage_(nullptr),
+          max_capacity_(max_capacity < 2 ? 2 : max_capacity),
+          window_(0),
+          high_water_(0),
+          phase_(Phase::LINEAR),
+          wrap_(0),
+          extend_(0),
+          head_(0),
+          jump_count_(0),
+          tail_(0),
+          jumps_taken_(0) {
+        window_ = clamp_capacity(initial_capacity == 0 ? slots_per_page()
+                                                       : initial_capacity);
+    }
+
+    ~ElasticSPSCQueue() {
+        if (storage_ == nullptr) {
+            return;
+        }
+        // Destroy the items still queued in place, following the jumps
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t head = head_.load(std::memory_order_relaxed);
+        while (tail != head) {
+            tail = follow_jumps(tail);
+            storage_[tail].~T();
+            ++tail;
+        }
+        munmap(storage_, reserved_bytes());
+    }
+
+    // Disable copy and move
+    ElasticSPSCQueue(const ElasticSPSCQueue&) = delete;
+    ElasticSPSCQueue& operator=(const ElasticSPSCQueue&) = delete;
+
+    // Try to push a single item (producer side)
+    // Returns true if successful, false if queue is full at max_capacity
+    bool try_push(const T& item) {
+        size_t slot;
+        if (!claim_slot(slot)) {
+            return false;
+        }
+        new (&storage_[slot]) T(item);
+        pushed_.store(pushed_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        head_.store(slot + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Try to pop a single item (consumer side)
+    // Returns true if successful, false if queue is empty
+    bool try_pop(T& item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t head = head_.load(std::memory_order_acquire);
+
+        if (tail == head) {
+            return false;  // Queue is empty
+        }
+        tail = follow_jumps(tail);
+
+        item = std::move(storage_[tail]);
+        storage_[tail].~T();
+        popped_.store(popped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Batch push (up to max_count items)
+    // Returns number of items actually pushed
+    size_t try_push_batch(const T* items, size_t max_count) {
+        size_t count = 0;
+        while (count < max_count && try_push(items[count])) {
+            ++count;
+        }
+        return count;
+    }
+
+    // Batch pop (up to max_count items)
+    // Returns number of items actually popped
+    size_t try_pop_batch(T* items, size_t max_count) {
+        size_t count = 0;
+        while (count < max_count && try_pop(items[count])) {
+            ++count;
+        }
+        return count;
+    }
+
+    // Set the window the producer walks before wrapping (producer side)
+    // Growing takes effect immediately; shrinking takes effect at the next
+    // wrap, which is also when the pages above the new window are released
+    void resize(size_t capacity) {
+        window_ = clamp_capacity(capacity);
+    }
+
+    // Release every committed page that holds no queued item (producer side)
+    // Meant for topics that have gone quiet; the next push faults pages back
+    void trim() {
+        if (storage_ == nullptr) {
+            return;
+        }
+        const size_t head = head_.load(std::memory_order_relaxed);
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        update_phase(head, tail);
+
+        switch (phase_) {
+        case Phase::LINEAR:
+            // Live items in [tail, head)
+            release_slots(0, tail);
+            release_slots(head, high_water_);
+            high_water_ = head;
+            break;
+        case Phase::WRAPPED:
+            // Live items in [tail, wrap) and [0, head)
+            release_slots(head, tail);
+            release_slots(wrap_, high_water_);
+            high_water_ = wrap_;
+            break;
+        case Phase::EXTENDED:
+            // Live items in [tail, wrap), [0, extend) and [wrap, head), the
+            // first gone once the consumer has wrapped
+            if (tail <= extend_) {
+                release_slots(0, tail);
+                release_slots(extend_, wrap_);
+            } else {
+                release_slots(extend_, tail);
+            }
+            release_slots(head, high_water_);
+            high_water_ = head;
+            break;
+        }
+    }
+
+    // Check if queue is empty
+    bool is_empty() const {
+        return tail_.load(std::memory_order_acquire) ==
+               head_.load(std::memory_order_acquire);
+    }
+
+    // Get current size (approximate, may be stale)
+    size_t size() const {
+        const size_t popped = popped_.load(std::memory_order_relaxed);
+        const size_t pushed = pushed_.load(std::memory_order_relaxed);
+        return pushed > popped ? pushed - popped : 0;
+    }
+
+    // Current window in items (producer view, approximate elsewhere)
+    size_t capacity() const { return window_; }
+
+    // Upper bound the window may grow to
+    size_t max_capacity() const { return max_capacity_; }
+
+    // Bytes of address space reserved by the first push
+    size_t reserved_bytes() const {
+        return round_up_to_page(max_capacity_ * sizeof(T));
+    }
+
+private:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    static constexpr size_t MAX_JUMPS = 2;  // A wrap and an extension
+
+    // Where the producer's items continue (from) after the consumer reaches to
+    struct Jump {
+        std::atomic<size_t> from{0};
+        std::atomic<size_t> to{0};
+    };
+
+    // Layout of the live items, from the producer's side
+    enum class Phase {
+        LINEAR,    // [tail, head)
+        WRAPPED,   // [tail, wrap) then [0, head)
+        EXTENDED,  // [tail, wrap) then [0, extend) then [wrap, head)
+    };
+
+    static size_t page_size() {
+        static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        return size;
+    }
+
+    static size_t round_up_to_page(size_t bytes) {
+        const size_t page = page_size();
+        return (bytes + page - 1) / page * page;
+    }
+
+    static size_t slots_per_page() {
+        const size_t slots = page_size() / sizeof(T);
+        return slots < 2 ? 2 : slots;
+    }
+
+    size_t clamp_capacity(size_t capacity) const {
+        if (capacity < 2) {
+            return 2;
+        }
+        return capacity > max_capacity_ ? max_capacity_ : capacity;
+    }
+
+    // Reserve address space; pages are committed on first touch
+    bool reserve() {
+        void* ptr = mmap(nullptr, reserved_bytes(), PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (ptr == MAP_FAILED) {
+            return false;
+        }
+        storage_ = static_cast<T*>(ptr);
+        return true;
+    }
+
+    // Return whole pages inside [begin, end) slots to the kernel
+    void release_slots(size_t begin, size_t end) {
+        const size_t page = page_size();
+        const size_t first = round_up_to_page(begin * sizeof(T));
+        const size_t last = (end * sizeof(T)) / page * page;
+        if (first < last) {
+            madvise(reinterpret_cast<char*>(storage_) + first, last - first,
+                    MADV_DONTNEED);
+        }
+    }
+
+    // Record a jump for the consumer; published by the next head_ store
+    void add_jump(size_t from, size_t to) {
+        const size_t count = jump_count_.load(std::memory_order_relaxed);
+        jumps_[count % MAX_JUMPS].from.store(from, std::memory_order_relaxed);
+        jumps_[count % MAX_JUMPS].to.store(to, std::memory_order_relaxed);
+        jump_count_.store(count + 1, std::memory_order_release);
+    }
+
+    // Slot of the next item at or after tail (consumer side). Jumps are
+    // recorded at the head, so one at tail has items behind it
+    size_t follow_jumps(size_t tail) {
+        while (jumps_taken_ != jump_count_.load(std::memory_order_acquire)) {
+            const Jump& jump = jumps_[jumps_taken_ % MAX_JUMPS];
+            if (tail != jump.from.load(std::memory_order_relaxed)) {
+                break;
+            }
+            tail = jump.to.load(std::memory_order_relaxed);
+            ++jumps_taken_;
+        }
+        return tail;
+    }
+
+    // Drop the jumps the consumer has taken. The runs of a phase hold
+    // disjoint tail values (tail is stored past the slot it read), so tail
+    // alone says which run the consumer is in; a stale one only delays this
+    void update_phase(size_t head, size_t tail) {
+        if (phase_ == Phase::WRAPPED && tail <= head) {
+            phase_ = Phase::LINEAR;
+        } else if (phase_ == Phase::EXTENDED && tail > wrap_) {
+            phase_ = Phase::LINEAR;
+        }
+    }
+
+    // Pick the slot for the next push, growing, wrapping or extending
+    bool claim_slot(size_t& slot) {
+        if (storage_ == nullptr && !reserve()) {
+            return false;
+        }
+
+        const size_t head = head_.load(std::memory_order_relaxed);
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        update_phase(head, tail);
+
+        if (phase_ == Phase::WRAPPED) {
+            // Keep one free slot so head never catches tail
+            if (head + 1 < tail) {
+                slot = head;
+                return true;
+            }
+            if (wrap_ >= max_capacity_) {
+                return false;  // Queue is full
+            }
+            // Continue above the wrap point rather than wait for the consumer
+            add_jump(head, wrap_);
+            extend_ = head;
+            phase_ = Phase::EXTENDED;
+            if (window_ <= wrap_) {
+                window_ = clamp_capacity(wrap_ * 2);
+            }
+            slot = wrap_;
+            note_touched(slot);
+            return true;
+        }
+        if (phase_ == Phase::EXTENDED) {
+            // Slot 0 is busy until the consumer is past the wrap point
+            if (head >= max_capacity_) {
+                return false;  // Queue is full
+            }
+            if (head >= window_) {
+                window_ = clamp_capacity(window_ * 2);
+            }
+            slot = head;
+            note_touched(head);
+            return true;
+        }
+
+        if (head < window_) {
+            slot = head;
+            note_touched(head);
+            return true;
+        }
+
+        // End of the window: wrap if the consumer has freed the front and
+        // the ring is not backed up, otherwise grow
+        const bool can_wrap = tail > 1;
+        const bool backed_up = (head - tail) > window_ / 2;
+        if (can_wrap && (!backed_up || window_ >= max_capacity_ ||
+                         head >= max_capacity_)) {
+            add_jump(head, 0);
+            wrap_ = head;
+            phase_ = Phase::WRAPPED;
+            // Pages past the wrap point stay unused until the window grows
+            if (high_water_ > head) {
+                release_slots(head, high_water_);
+                high_water_ = head;
+            }
+            slot = 0;
+            return true;
+        }
+        if (head < max_capacity_) {
+            if (window_ < max_capacity_) {
+                window_ = clamp_capacity(window_ * 2);
+            }
+            slot = head;
+            note_touched(head);
+            return true;
+        }
+        return false;  // Queue is full
+    }
+
+    void note_touched(size_t slot) {
+        if (slot + 1 > high_water_) {
+            high_water_ = slot + 1;
+        }
+    }
+
+    T* storage_;               // Reserved region (producer maps it)
+    const size_t max_capacity_;
+
+    // Producer-only state
+    size_t window_;            // Slots walked before wrapping
+    size_t high_water_;        // One past the highest slot possibly committed
+    Phase phase_;
+    size_t wrap_;              // Where the producer last wrapped
+    size_t extend_;            // Where it jumped back to wrap_ (EXTENDED)
+
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_;  // Producer writes
+    std::atomic<size_t> pushed_{0};
+    std::atomic<size_t> jump_count_;  // Jumps recorded (producer writes)
+    Jump jumps_[MAX_JUMPS];           // Jump i in jumps_[i % MAX_JUMPS]
+
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_;  // Consumer writes
+    std::atomic<size_t> popped_{0};
+    size_t jumps_taken_;       // Consumer-only
+};
+
+}  // namespace nanomq
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace nanomq {
+
+// Minimal io_uring instance on the raw syscalls (no liburing)
+//
+// One submission and one completion queue mapped from the kernel; enough
+// for file writes and fsyncs from a single thread. Not thread-safe.
+class IoUring {
+public:
+    // Set up a ring with at least entries submission slots
+    // is_open() is false if the kernel refuses (old kernel, seccomp, ...)
+    explicit IoUring(unsigned entries);
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    bool is_open() const { return fd_ >= 0; }
+
+    // Whether this process can use io_uring at all (probed once)
+    static bool supported();
+
+    // Pin buffers for IORING_OP_WRITE_FIXED (buf_index = position in iovs)
+    bool register_buffers(const struct iovec* iovs, unsigned count);
+    bool unregister_buffers();
+
+    // Register a file table for IOSQE_FIXED_FILE; -1 marks an empty slot
+    bool register_files(const int* fds, unsigned count);
+
+    // Replace the file in a registered slot
+    bool update_file(unsigned index, int fd);
+
+    // Next free submission entry, zeroed; nullptr if the queue is full
+    struct io_uring_sqe* get_sqe();
+
+    // Write len bytes at offset; buf_index < 0 for an unregistered buffer
+    static void prep_write(struct io_uring_sqe* sqe, int file, const void* buf,
+                           unsigned len, uint64_t offset, int buf_index,
+                           uint64_t user_data);
+
+    static void prep_fdatasync(struct io_uring_sqe* sqe, int file, uint64_t user_data);
+
+    // Hand queued entries to the kernel and wait for at least wait_nr
+    // completions. Returns the number submitted, or -errno
+    int submit(unsigned wait_nr = 0);
+
+    // Oldest unconsumed completion, nullptr if there is none
+    struct io_uring_cqe* peek_cqe();
+
+    // Consume the completion returned by peek_cqe()
+    void cqe_seen();
+
+private:
+    int fd_;
+    unsigned entries_;
+
+    void* sq_ring_;
+    size_t sq_ring_size_;
+    void* cq_ring_;
+    size_t cq_ring_size_;
+    struct io_uring_sqe* sqes_;
+    size_t sqes_size_;
+
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned* sq_mask_;
+    unsigned* sq_array_;
+    unsigned sqe_tail_;  // Entries handed out by get_sqe()
+    unsigned sqe_head_;  // Entries submitted
+
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned* cq_mask_;
+    struct io_uring_cqe* cqes_;
+};
+
+}  // namespace nanomq
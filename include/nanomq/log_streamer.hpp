@@ -0,0 +1,76 @@
+#pragma once
+
+#include "nanomq/message.hpp"
+#include "nanomq/segment.hpp"
+#include <sys/types.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace nanomq {
+
+class TieredStorage;
+
+// Catch-up delivery of the log to a subscriber socket
+//
+// Segment records are already in the wire encoding, so a consumer that
+// has fallen behind the live stream is sent whole ranges of them straight
+// from the segment files with sendfile(), without copying them through
+// user space. Each range goes out as one frame
+//   [4 bytes: MSG_TYPE_LOG_DATA] [4 bytes: payload length]
+//   [8 bytes: base id] [8 bytes: base timestamp]    (of the segment)
+//   records: varint length, message encoded against that base
+// Range ends come from the segment's offset index and a walk over record
+// lengths; payloads are never read.
+class LogStreamer {
+public:
+    static constexpr size_t FRAME_HEADER_SIZE = 24;
+    static constexpr size_t DEFAULT_FRAME_BYTES = 1024 * 1024;
+
+    explicit LogStreamer(const std::string& directory,
+                         std::shared_ptr<TieredStorage> tier = nullptr);
+
+    LogStreamer(const LogStreamer&) = delete;
+    LogStreamer& operator=(const LogStreamer&) = delete;
+
+    // As LogReader; a frame in progress is dropped
+    bool seek(uint64_t message_id);
+    bool seek_to_timestamp(uint64_t timestamp_ns);
+    void seek(const LogPosition& position);
+    LogPosition position() const { return position_; }
+
+    // Send the records after position() to fd as a frame of up to max_bytes
+    // of records (one record if it alone is larger). Returns the record
+    // bytes sent, 0 when caught up, -1 with errno set on error. On a
+    // non-blocking fd a frame may go out over several calls (-1 with
+    // EAGAIN when none of it could); position() moves once it is complete
+    ssize_t send_to(int fd, size_t max_bytes = DEFAULT_FRAME_BYTES);
+
+    uint64_t bytes_sent() const { return bytes_sent_; }  // Records, frame headers excluded
+
+private:
+    bool next_frame(size_t max_bytes);
+    ssize_t copy_range(int fd, size_t size);  // Where sendfile() cannot
+
+    SegmentManager segments_;
+    LogPosition position_;
+    std::unique_ptr<SegmentScanner> segment_;  // Only for its fd and header
+    std::string path_;                         // Of segment_, as in SegmentManager::files()
+
+    // Frame in progress
+    bool in_frame_;
+    uint8_t frame_header_[FRAME_HEADER_SIZE];
+    size_t header_sent_;
+    uint64_t offset_;  // Next byte of the segment to send
+    uint64_t end_;
+    bool copy_;        // fd takes no sendfile()
+    uint64_t bytes_sent_;
+};
+
+// Decode the records of a LOG_DATA frame payload into out; msg.data points
+// into payload. False if it is malformed or a record fails its CRC
+bool decode_log_data(const uint8_t* payload, size_t size, std::vector<Message>& out);
+
+}  // namespace nanomq
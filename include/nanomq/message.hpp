@@ -1,8 +1,10 @@
 #pragma once
 
+#include "nanomq/clock.hpp"
 #include <cstdint>
 #include <cstring>
 #include <string>
+#include <ctime>
 
 namespace nanomq {
 
@@ -18,7 +20,7 @@ struct alignas(CACHE_LINE_SIZE) MessageHeader {
     uint64_t timestamp;       // Unix timestamp in nanoseconds (8 bytes)
     uint32_t topic_id;        // Topic identifier (4 bytes)
     uint32_t size;            // Payload size in bytes (4 bytes)
-    uint32_t crc32;           // CRC32 checksum of payload (4 bytes)
+    uint32_t crc32;           // Payload checksum, see MSG_FLAG_CRC32C (4 bytes)
     uint32_t flags;           // Message flags (4 bytes)
     uint8_t padding[28];      // Pad to 64 bytes
 
@@ -38,6 +40,10 @@ enum MessageFlags : uint32_t {
     MSG_FLAG_ENCRYPTED = 1 << 1,     // Payload is encrypted
     MSG_FLAG_PERSISTENT = 1 << 2,    // Must be persisted to disk
     MSG_FLAG_PRIORITY = 1 << 3,      // High-priority message
+    MSG_FLAG_CRC32C = 1 << 4,        // crc32 holds CRC32C, else legacy CRC32
+    MSG_FLAG_BATCH = 1 << 5,         // Payload is a record batch
+    MSG_FLAG_KEYED = 1 << 6,         // Payload starts with a key, see Message::key()
+    MSG_FLAG_PADDING = 1u << 31,     // Ring filler record, never delivered
 };
 
 // Message structure with zero-copy design
@@ -55,15 +61,27 @@ struct Message {
         header.timestamp = timestamp;
         header.topic_id = topic_id;
         header.size = static_cast<uint32_t>(payload_size);
-        header.flags = MSG_FLAG_NONE;
-        header.crc32 = calculate_crc32(payload, payload_size);
+        set_checksum(payload);
     }
 
-    // Calculate CRC32 checksum
+    // Calculate CRC32 checksum (legacy, byte-at-a-time)
     static uint32_t calculate_crc32(const void* data, size_t size);
 
+    // Calculate CRC32C checksum (hardware-accelerated where available)
+    static uint32_t calculate_crc32c(const void* data, size_t size);
+
+    // Store the CRC32C of payload (header.size bytes) in the header
+    void set_checksum(const void* payload) {
+        header.crc32 = calculate_crc32c(payload, header.size);
+        header.flags |= MSG_FLAG_CRC32C;
+    }
+
     // Verify message integrity
+    // Headers without MSG_FLAG_CRC32C were written with the old CRC32.
     bool verify_checksum() const {
+        if (header.flags & MSG_FLAG_CRC32C) {
+            return header.crc32 == calculate_crc32c(data, header.size);
+        }
         return header.crc32 == calculate_crc32(data, header.size);
     }
 
@@ -80,35 +98,33 @@ struct Message {
 
     // Clear a flag
     void clear_flag(MessageFlags flag) { header.flags &= ~flag; }
-};
-
-// Batch message container for efficient batch operations
-struct MessageBatch {
-    static constexpr size_t MAX_BATCH_SIZE = 256;
 
-    Message messages[MAX_BATCH_SIZE];
-    size_t count;
-
-    MessageBatch() : count(0) {}
-
-    bool is_full() const { return count >= MAX_BATCH_SIZE; }
-    bool is_empty() const { return count == 0; }
-
-    void add(const Message& msg) {
-        if (!is_full()) {
-            messages[count++] = msg;
+    // Key of a MSG_FLAG_KEYED message, whose payload is a little-endian
+    // uint16 key size, the key and the value. False if it has none
+    bool key(const uint8_t*& key_data, size_t& key_size) const {
+        if (!(header.flags & MSG_FLAG_KEYED) || header.size < 2) {
+            return false;
         }
+        key_size = static_cast<size_t>(data[0]) | static_cast<size_t>(data[1]) << 8;
+        key_data = data + 2;
+        return key_size > 0 && key_size <= header.size - 2;
     }
-
-    void clear() { count = 0; }
 };
 
+// Lay out a MSG_FLAG_KEYED payload in out; returns its size
+// out needs room for 2 + key_size + value_size bytes
+inline size_t make_keyed_payload(uint8_t* out, const void* key, uint16_t key_size,
+                                 const void* value, size_t value_size) {
+    out[0] = static_cast<uint8_t>(key_size);
+    out[1] = static_cast<uint8_t>(key_size >> 8);
+    std::memcpy(out + 2, key, key_size);
+    std::memcpy(out + 2 + key_size, value, value_size);
+    return 2 + key_size + value_size;
+}
+
 // Get current time in nanoseconds (for timestamps)
 inline uint64_t get_timestamp_ns() {
-    struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
-    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL +
-           static_cast<uint64_t>(ts.tv_nsec);
+    return Clock::now_ns();
 }
 
 }  // namespace nanomq
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "nanomq/message.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace nanomq {
+
+// Payload buffer with an intrusive reference count
+//
+// The count sits in a 16-byte header right in front of the payload, so a
+// plain Message whose data points at the payload can be turned back into
+// a reference (MessageRef::adopt). A new buffer belongs to the thread that
+// created it and counts with plain loads and stores; share() switches it
+// to atomic counting for good and must be called before a reference is
+// handed to another thread (the hand-off itself, e.g. a queue push,
+// publishes the switch).
+class SharedBuffer {
+public:
+    // Buffer of size bytes with one reference, or nullptr if out of memory
+    // Comes from PayloadPool unless it is too large for the pool
+    static SharedBuffer* create(size_t size);
+
+    // Buffer whose payload starts at data
+    static SharedBuffer* from_data(const uint8_t* data) {
+        return reinterpret_cast<SharedBuffer*>(const_cast<uint8_t*>(data)) - 1;
+    }
+
+    uint8_t* data() { return reinterpret_cast<uint8_t*>(this + 1); }
+    size_t size() const { return size_; }
+
+    void retain() {
+        if (!shared_.load(std::memory_order_relaxed)) {
+            refs_.store(refs_.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+        } else {
+            refs_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Drop a reference; the last one frees the buffer
+    void release() {
+        if (!shared_.load(std::memory_order_relaxed)) {
+            const uint32_t refs = refs_.load(std::memory_order_relaxed) - 1;
+            if (refs == 0) {
+                destroy();
+                return;
+            }
+            refs_.store(refs, std::memory_order_relaxed);
+        } else if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            destroy();
+        }
+    }
+
+    // Allow references on other threads from now on
+    void share() { shared_.store(true, std::memory_order_relaxed); }
+    bool is_shared() const { return shared_.load(std::memory_order_relaxed); }
+
+    uint32_t use_count() const { return refs_.load(std::memory_order_relaxed); }
+
+    SharedBuffer(const SharedBuffer&) = delete;
+    SharedBuffer& operator=(const SharedBuffer&) = delete;
+
+private:
+    SharedBuffer(uint32_t size, uint32_t allocated)
+        : refs_(1), shared_(false), size_(size), allocated_(allocated) {}
+
+    void destroy();
+
+    std::atomic<uint32_t> refs_;
+    std::atomic<bool> shared_;
+    uint32_t size_;
+    uint32_t allocated_;  // Pool bytes, 0 for a heap allocation
+};
+
+static_assert(sizeof(SharedBuffer) == 16, "payload follows a 16-byte header");
+
+// Message that pins its payload until every copy is gone
+//
+// Copies share the payload: the broker ring, the WAL writer and each
+// subscriber connection can hold one without duplicating the bytes.
+// Message stays a trivially copyable non-owning view for the rings;
+// detach() and adopt() carry a reference through them.
+class MessageRef {
+public:
+    MessageRef() : buffer_(nullptr) {}
+
+    // Copy payload into a new shared buffer and checksum it
+    // The result is empty if memory runs out
+    MessageRef(uint64_t id, uint64_t timestamp, uint32_t topic_id,
+               const void* payload, size_t size)
+        : buffer_(SharedBuffer::create(size)) {
+        if (buffer_ == nullptr) {
+            return;
+        }
+        message_.header.id = id;
+        message_.header.timestamp = timestamp;
+        message_.header.topic_id = topic_id;
+        message_.header.size = static_cast<uint32_t>(size);
+        message_.data = buffer_->data();
+        if (size > 0) {
+            std::memcpy(message_.data, payload, size);
+        }
+        message_.set_checksum(message_.data);
+    }
+
+    ~MessageRef() { reset(); }
+
+    MessageRef(const MessageRef& other)
+        : message_(other.message_), buffer_(other.buffer_) {
+        if (buffer_ != nullptr) {
+            buffer_->retain();
+        }
+    }
+
+    MessageRef& operator=(const MessageRef& other) {
+        if (this != &other) {
+            MessageRef copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    MessageRef(MessageRef&& other) noexcept
+        : message_(other.message_), buffer_(other.buffer_) {
+        other.buffer_ = nullptr;
+        other.message_ = Message();
+    }
+
+    MessageRef& operator=(MessageRef&& other) noexcept {
+        if (this != &other) {
+            reset();
+            swap(other);
+        }
+        return *this;
+    }
+
+    const Message& message() const { return message_; }
+    const MessageHeader& header() const { return message_.header; }
+    const uint8_t* data() const { return message_.data; }
+    size_t size() const { return message_.header.size; }
+    explicit operator bool() const { return buffer_ != nullptr; }
+
+    // See SharedBuffer::share(); needed before copies cross threads
+    MessageRef& share() {
+        if (buffer_ != nullptr) {
+            buffer_->share();
+        }
+        return *this;
+    }
+
+    uint32_t use_count() const { return buffer_ != nullptr ? buffer_->use_count() : 0; }
+
+    // Drop this reference now
+    void reset() {
+        if (buffer_ != nullptr) {
+            buffer_->release();
+            buffer_ = nullptr;
+            message_ = Message();
+        }
+    }
+
+    // Turn this reference into a plain Message (e.g. to push it through a
+    // ring); exactly one adopt() on the receiving side takes it back
+    Message detach() {
+        const Message msg = message_;
+        buffer_ = nullptr;
+        message_ = Message();
+        return msg;
+    }
+
+    // Take over the reference carried by a detach()ed Message
+    static MessageRef adopt(const Message& msg) {
+        MessageRef ref;
+        if (msg.data != nullptr) {
+            ref.message_ = msg;
+            ref.buffer_ = SharedBuffer::from_data(msg.data);
+        }
+        return ref;
+    }
+
+    void swap(MessageRef& other) noexcept {
+        std::swap(message_, other.message_);
+        std::swap(buffer_, other.buffer_);
+    }
+
+private:
+    Message message_;
+    SharedBuffer* buffer_;
+};
+
+}  // namespace nanomq
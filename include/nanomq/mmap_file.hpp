@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+
+namespace nanomq {
+
+// Optional mapping behaviour
+struct MMapOptions {
+    bool populate = false;    // Fault every page in up front (MAP_POPULATE)
+    bool huge_pages = false;  // Ask for transparent huge pages; a hint the
+                              // kernel ignores where the filesystem has none
+};
+
+// Expected access pattern, passed to madvise()
+enum class MMapAdvice {
+    NORMAL,
+    SEQUENTIAL,  // Read ahead aggressively, drop pages behind
+    RANDOM,      // No read-ahead
+    WILLNEED,    // Start reading the range in now
+    DONTNEED,    // Drop the range from the page cache mapping
+};
+
+// Memory-mapped file for zero-copy persistence
+//
+// Writers that report what they touch with mark_dirty() get syncs of just
+// those pages; without it sync() covers the whole mapping.
+class MMapFile {
+public:
+    // Map path read-write; with create the file is created if missing and
+    // sized to size, otherwise the whole existing file is mapped.
+    // Throws std::runtime_error on failure.
+    MMapFile(const char* path, size_t size, bool create = true,
+             const MMapOptions& options = MMapOptions());
+    ~MMapFile();
+
+    MMapFile(const MMapFile&) = delete;
+    MMapFile& operator=(const MMapFile&) = delete;
+
+    void* data() { return data_; }
+    const void* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    // Grow or shrink the file and the mapping (mremap); data() may move.
+    // Throws std::runtime_error on failure, leaving the mapping as it was
+    void resize(size_t size);
+
+    // Note bytes [offset, offset + length) as written
+    void mark_dirty(size_t offset, size_t length);
+
+    // Bytes (whole pages) marked dirty and not synced yet
+    size_t dirty_bytes() const { return dirty_end_ - dirty_begin_; }
+
+    // Write the pages holding [offset, offset + length) to disk
+    bool sync_range(size_t offset, size_t length, bool async = false);
+
+    // Sync to disk: the dirty pages, or everything if nothing was ever marked
+    void sync();
+
+    // Async sync
+    void async_sync();
+
+    // Access pattern hint for [offset, offset + length), the whole mapping
+    // for length 0
+    bool advise(MMapAdvice advice, size_t offset = 0, size_t length = 0);
+
+private:
+    void sync_dirty(bool async);
+
+    int fd_;
+    void* data_;
+    size_t size_;
+    MMapOptions options_;
+    bool tracking_;      // mark_dirty() has been called
+    size_t dirty_begin_;  // Page-aligned; empty when equal
+    size_t dirty_end_;
+};
+
+}  // namespace nanomq
@@ -3,6 +3,8 @@
 // Main NanoMQ header - include this to use the library
 
 #include "nanomq/message.hpp"
+#include "nanomq/message_ref.hpp"
+#include "nanomq/record_batch.hpp"
 #include "nanomq/publisher.hpp"
 #include "nanomq/subscriber.hpp"
 #include "nanomq/queue.hpp"
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "nanomq/message.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace nanomq {
+
+// Slab pool for message payload buffers
+//
+// Buffers come in power-of-two size classes from 64 bytes up to
+// MAX_PAYLOAD_SIZE. Each thread keeps a small cache per class, so the
+// common allocate/free pair touches no shared state. When a cache runs dry
+// or overflows it trades a whole batch of buffers with a lock-free global
+// free list (one CAS per batch), which is what makes the producer-allocates,
+// consumer-frees pattern cheap: the consumer's cache fills up and hands full
+// batches back to the producer's side. Slab memory is kept for the life of
+// the process.
+class PayloadPool {
+public:
+    static constexpr size_t MIN_BLOCK_SHIFT = 6;  // 64-byte smallest class
+    static constexpr size_t MIN_BLOCK_SIZE = size_t(1) << MIN_BLOCK_SHIFT;
+    static constexpr size_t NUM_SIZE_CLASSES = 11;  // 64 B .. 64 KB
+    static constexpr size_t MAX_BLOCK_SIZE =
+        MIN_BLOCK_SIZE << (NUM_SIZE_CLASSES - 1);
+    static_assert(MAX_BLOCK_SIZE == MAX_PAYLOAD_SIZE,
+                  "size classes must cover MAX_PAYLOAD_SIZE");
+
+    // Get a buffer of at least size bytes (cache-line aligned)
+    // Returns nullptr if size exceeds MAX_PAYLOAD_SIZE or memory runs out
+    static uint8_t* allocate(size_t size);
+
+    // Return a buffer; size is the size it was allocated with
+    // May be called from any thread
+    static void deallocate(void* buffer, size_t size);
+
+    // Size class serving size bytes (size must not exceed MAX_BLOCK_SIZE)
+    static size_t size_class(size_t size) {
+        if (size <= MIN_BLOCK_SIZE) {
+            return 0;
+        }
+        // Index of the highest bit of size - 1, relative to the 64 B class
+        return 64 - __builtin_clzll(size - 1) - MIN_BLOCK_SHIFT;
+    }
+
+    // Bytes of each buffer in a size class
+    static constexpr size_t class_size(size_t cls) {
+        return MIN_BLOCK_SIZE << cls;
+    }
+
+    // Total slab memory obtained from the system so far
+    static size_t reserved_bytes();
+};
+
+// Owning handle for a pool buffer; returns it to the pool when destroyed
+class PayloadBuffer {
+public:
+    PayloadBuffer() : data_(nullptr), size_(0) {}
+
+    explicit PayloadBuffer(size_t size)
+        : data_(PayloadPool::allocate(size)), size_(size) {}
+
+    ~PayloadBuffer() { reset(); }
+
+    PayloadBuffer(PayloadBuffer&& other) noexcept
+        : data_(other.data_), size_(other.size_) {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    PayloadBuffer& operator=(PayloadBuffer&& other) noexcept {
+        if (this != &other) {
+            reset();
+            data_ = other.data_;
+            size_ = other.size_;
+            other.data_ = nullptr;
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    PayloadBuffer(const PayloadBuffer&) = delete;
+    PayloadBuffer& operator=(const PayloadBuffer&) = delete;
+
+    uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    explicit operator bool() const { return data_ != nullptr; }
+
+    // Return the buffer to the pool now
+    void reset() {
+        if (data_ != nullptr) {
+            PayloadPool::deallocate(data_, size_);
+            data_ = nullptr;
+            size_ = 0;
+        }
+    }
+
+    // Give up ownership; the caller must PayloadPool::deallocate(ptr, size)
+    uint8_t* release() {
+        uint8_t* data = data_;
+        data_ = nullptr;
+        size_ = 0;
+        return data;
+    }
+
+private:
+    uint8_t* data_;
+    size_t size_;
+};
+
+// Message whose payload lives in a pool buffer
+// Message itself stays trivially copyable for the rings; this move-only
+// wrapper carries the ownership. Queues that move Message values by copy
+// hand ownership over with release() and
+// PayloadPool::deallocate(msg.data, msg.header.size) on the other side.
+struct PooledMessage {
+    Message message;
+    PayloadBuffer buffer;
+
+    PooledMessage() = default;
+
+    PooledMessage(uint64_t id, uint64_t timestamp, uint32_t topic_id,
+                  const void* payload, size_t payload_size)
+        : message(id, timestamp, topic_id, payload, payload_size),
+          buffer(payload_size) {
+        message.data = buffer.data();
+        if (message.data != nullptr && payload_size > 0) {
+            std::memcpy(message.data, payload, payload_size);
+        }
+    }
+
+    explicit operator bool() const { return static_cast<bool>(buffer); }
+};
+
+}  // namespace nanomq
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "nanomq/message.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace nanomq {
+
+// Binary protocol for network communication
+// Frame format:
+// [4 bytes: message type] [4 bytes: payload length] [N bytes: payload]
+
+enum MessageType : uint32_t {
+    MSG_TYPE_PUBLISH = 1,
+    MSG_TYPE_SUBSCRIBE = 2,
+    MSG_TYPE_UNSUBSCRIBE = 3,
+    MSG_TYPE_ACK = 4,
+    MSG_TYPE_DATA = 5,
+    MSG_TYPE_LOG_DATA = 6,  // Records from the log, see log_streamer.hpp
+};
+
+// Compact message encoding (wire and WAL)
+//
+// MessageHeader stays the 64-byte in-memory form; on the wire and on disk
+// a message is
+//   varint  id - base.id              (zigzag)
+//   varint  timestamp - base.timestamp (zigzag)
+//   varint  topic_id
+//   varint  flags
+//   varint  size
+//   4 bytes crc32 (little-endian)
+//   size bytes payload
+// which is 10-15 header bytes for a batch of consecutive messages.
+
+// Values the id and timestamp deltas are taken against, usually the first
+// message of a batch
+struct EncodingBase {
+    uint64_t id = 0;
+    uint64_t timestamp = 0;
+};
+
+constexpr size_t MAX_VARINT_SIZE = 10;
+constexpr size_t MAX_COMPACT_HEADER_SIZE = 2 * MAX_VARINT_SIZE + 3 * 5 + 4;
+
+// Append value as a LEB128 varint; returns bytes written
+inline size_t encode_varint(uint64_t value, uint8_t* out) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = static_cast<uint8_t>(value) | 0x80;
+        value >>= 7;
+    }
+    out[n++] = static_cast<uint8_t>(value);
+    return n;
+}
+
+// Read a varint from [in, end); returns bytes read, 0 if truncated or invalid
+inline size_t decode_varint(const uint8_t* in, const uint8_t* end, uint64_t& value) {
+    uint64_t result = 0;
+    for (size_t n = 0; n < MAX_VARINT_SIZE && in + n < end; ++n) {
+        const uint8_t byte = in[n];
+        result |= static_cast<uint64_t>(byte & 0x7f) << (7 * n);
+        if ((byte & 0x80) == 0) {
+            value = result;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+inline size_t varint_size(uint64_t value) {
+    size_t n = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++n;
+    }
+    return n;
+}
+
+inline uint64_t zigzag_encode(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t zigzag_decode(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Bytes encode_message() needs for msg
+size_t encoded_size(const Message& msg, const EncodingBase& base = EncodingBase());
+
+// Encode a message; returns bytes written, 0 if buffer_size is too small
+size_t encode_message(const Message& msg, uint8_t* buffer, size_t buffer_size,
+                      const EncodingBase& base = EncodingBase());
+
+// Decode a message; msg.data points into buffer (zero-copy)
+// Returns bytes consumed, 0 if the buffer is truncated or malformed
+size_t decode_message(const uint8_t* buffer, size_t buffer_size, Message& msg,
+                      const EncodingBase& base = EncodingBase());
+
+}  // namespace nanomq
@@ -12,7 +12,8 @@ class BrokerClient;
 // Publisher API for sending messages to topics
 class Publisher {
 public:
-    // Connect to broker at specified address
+    // Connect to broker at specified address ("host:port" or "shm://name")
+    // shm:// brokers on the same host are reached through shared memory
     explicit Publisher(const std::string& broker_address = "127.0.0.1:9000");
     ~Publisher();
 
@@ -37,7 +38,9 @@ public:
     // Force immediate send of buffered messages
     void flush();
 
-    // Set compression for large payloads (threshold in bytes)
+    // Set compression for large payloads (threshold in bytes, 0 = off)
+    // Batches (or single messages) with at least threshold payload bytes
+    // travel LZ4-compressed to the subscriber, which expands them
     void set_compression_threshold(size_t threshold);
 
     // Enable/disable batching (default: enabled)
@@ -1,21 +1,48 @@
 #pragma once
 
+#include "nanomq/wait_strategy.hpp"
+#include <sys/mman.h>
+#include <unistd.h>
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 namespace nanomq {
 
+// Contiguous run of ring buffer slots handed out by claim() and peek()
+template <typename T>
+struct QueueSpan {
+    T* data;
+    size_t size;
+
+    T* begin() const { return data; }
+    T* end() const { return data + size; }
+    T& operator[](size_t i) const { return data[i]; }
+    bool empty() const { return size == 0; }
+};
+
 // Lock-free SPSC (Single Producer Single Consumer) ring buffer
 // Uses atomic operations with acquire/release semantics for synchronization
-template <typename T, size_t Capacity>
+// Each side keeps a cached copy of the other side's index and only reloads
+// it when the cached value says the queue is full/empty, so the common path
+// never touches the other side's cache line.
+// WaitStrategy decides how pop_wait() waits for data (see wait_strategy.hpp).
+// Items are constructed in place on push and destroyed on pop, so T need not
+// be default-constructible; batches of trivially copyable T are moved with
+// at most two memcpy calls, one on each side of the wrap point.
+template <typename T, size_t Capacity, typename WaitStrategy = BusySpinWait>
 class SPSCQueue {
 public:
     static_assert((Capacity & (Capacity - 1)) == 0,
                   "Capacity must be a power of 2");
 
-    SPSCQueue() : head_(0), tail_(0) {
+    SPSCQueue() : head_(0), cached_tail_(0), tail_(0), cached_head_(0) {
         // Pre-allocate storage with cache-line alignment
 #ifdef _WIN32
         storage_ = static_cast<T*>(_aligned_malloc(sizeof(T) * Capacity, CACHE_LINE_SIZE));
@@ -30,6 +57,13 @@ public:
     }
 
     ~SPSCQueue() {
+        if (!std::is_trivially_destructible<T>::value && storage_ != nullptr) {
+            const size_t head = head_.load(std::memory_order_relaxed);
+            for (size_t i = tail_.load(std::memory_order_relaxed); i != head;
+                 i = (i + 1) & INDEX_MASK) {
+                storage_[i].~T();
+            }
+        }
 #ifdef _WIN32
         _aligned_free(storage_);
 #else
@@ -44,15 +78,32 @@ public:
     // Try to push a single item (producer side)
     // Returns true if successful, false if queue is full
     bool try_push(const T& item) {
+        return try_emplace(item);
+    }
+
+    // Try to push a single item by moving it (producer side)
+    // item is left untouched if the queue is full
+    bool try_push(T&& item) {
+        return try_emplace(std::move(item));
+    }
+
+    // Try to construct an item in place from args (producer side)
+    // Returns true if successful, false if queue is full
+    template <typename... Args>
+    bool try_emplace(Args&&... args) {
         const size_t head = head_.load(std::memory_order_relaxed);
         const size_t next_head = (head + 1) & INDEX_MASK;
         
-        if (next_head == tail_.load(std::memory_order_acquire)) {
-            return false;  // Queue is full
+        if (next_head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (next_head == cached_tail_) {
+                return false;  // Queue is full
+            }
         }
 
-        storage_[head] = item;
+        new (&storage_[head]) T(std::forward<Args>(args)...);
         head_.store(next_head, std::memory_order_release);
+        wait_strategy_.notify();
         return true;
     }
 
@@ -61,11 +112,15 @@ public:
     bool try_pop(T& item) {
         const size_t tail = tail_.load(std::memory_order_relaxed);
         
-        if (tail == head_.load(std::memory_order_acquire)) {
-            return false;  // Queue is empty
+        if (tail == cached_head_) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail == cached_head_) {
+                return false;  // Queue is empty
+            }
         }
 
-        item = storage_[tail];
+        item = std::move(storage_[tail]);
+        storage_[tail].~T();
         tail_.store((tail + 1) & INDEX_MASK, std::memory_order_release);
         return true;
     }
@@ -74,22 +129,20 @@ public:
     // Returns number of items actually pushed
     size_t try_push_batch(const T* items, size_t max_count) {
         const size_t head = head_.load(std::memory_order_relaxed);
-        const size_t tail = tail_.load(std::memory_order_acquire);
-        
-        size_t available = (tail - head - 1) & INDEX_MASK;
+        size_t available = (cached_tail_ - head - 1) & INDEX_MASK;
+        if (available < max_count) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            available = (cached_tail_ - head - 1) & INDEX_MASK;
+        }
         size_t count = (max_count < available) ? max_count : available;
         
         if (count == 0) {
             return 0;
         }
 
-        size_t new_head = head;
-        for (size_t i = 0; i < count; ++i) {
-            storage_[new_head] = items[i];
-            new_head = (new_head + 1) & INDEX_MASK;
-        }
-
-        head_.store(new_head, std::memory_order_release);
+        write_items(head, items, count);
+        head_.store((head + count) & INDEX_MASK, std::memory_order_release);
+        wait_strategy_.notify();
         return count;
     }
 
@@ -97,23 +150,97 @@ public:
     // Returns number of items actually popped
     size_t try_pop_batch(T* items, size_t max_count) {
         const size_t tail = tail_.load(std::memory_order_relaxed);
-        const size_t head = head_.load(std::memory_order_acquire);
-        
-        size_t available = (head - tail) & INDEX_MASK;
+        size_t available = (cached_head_ - tail) & INDEX_MASK;
+        if (available < max_count) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            available = (cached_head_ - tail) & INDEX_MASK;
+        }
         size_t count = (max_count < available) ? max_count : available;
         
         if (count == 0) {
             return 0;
         }
 
-        size_t new_tail = tail;
-        for (size_t i = 0; i < count; ++i) {
-            items[i] = storage_[new_tail];
-            new_tail = (new_tail + 1) & INDEX_MASK;
+        read_items(tail, items, count);
+        tail_.store((tail + count) & INDEX_MASK, std::memory_order_release);
+        return count;
+    }
+
+    // Pop a single item, waiting up to timeout_us for one to arrive
+    // (consumer side). Returns false on timeout.
+    bool pop_wait(T& item, uint64_t timeout_us) {
+        if (try_pop(item)) {
+            return true;
         }
+        return wait_for_data(timeout_us) && try_pop(item);
+    }
 
-        tail_.store(new_tail, std::memory_order_release);
-        return count;
+    // Batch pop, waiting up to timeout_us for at least one item
+    // Returns number of items actually popped (0 on timeout)
+    size_t pop_batch_wait(T* items, size_t max_count, uint64_t timeout_us) {
+        const size_t count = try_pop_batch(items, max_count);
+        if (count > 0 || !wait_for_data(timeout_us)) {
+            return count;
+        }
+        return try_pop_batch(items, max_count);
+    }
+
+    // Reserve up to max_count contiguous slots for in-place writes
+    // (producer side). The span stops at the wrap point, so it may be
+    // shorter than requested even when more space is free; call again
+    // after publish() to get the rest. Returns an empty span if full.
+    // Slots are raw storage: types that are not trivially copyable must be
+    // constructed with placement new before publish().
+    QueueSpan<T> claim(size_t max_count) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        size_t available = (cached_tail_ - head - 1) & INDEX_MASK;
+        if (available < max_count) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            available = (cached_tail_ - head - 1) & INDEX_MASK;
+        }
+        const size_t contiguous = Capacity - head;
+        if (available > contiguous) {
+            available = contiguous;
+        }
+        return QueueSpan<T>{storage_ + head,
+                            (max_count < available) ? max_count : available};
+    }
+
+    // Make the first count slots of the last claim() visible to the consumer
+    void publish(size_t count) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        head_.store((head + count) & INDEX_MASK, std::memory_order_release);
+        wait_strategy_.notify();
+    }
+
+    // Get up to max_count contiguous ready items for in-place reads
+    // (consumer side). Like claim(), the span stops at the wrap point.
+    // Returns an empty span if the queue is empty.
+    QueueSpan<T> peek(size_t max_count) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t available = (cached_head_ - tail) & INDEX_MASK;
+        if (available < max_count) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            available = (cached_head_ - tail) & INDEX_MASK;
+        }
+        const size_t contiguous = Capacity - tail;
+        if (available > contiguous) {
+            available = contiguous;
+        }
+        return QueueSpan<T>{storage_ + tail,
+                            (max_count < available) ? max_count : available};
+    }
+
+    // Destroy the first count items of the last peek() and hand their
+    // slots back to the producer
+    void release(size_t count) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (!std::is_trivially_destructible<T>::value) {
+            for (size_t i = 0; i < count; ++i) {
+                storage_[tail + i].~T();
+            }
+        }
+        tail_.store((tail + count) & INDEX_MASK, std::memory_order_release);
     }
 
     // Check if queue is empty
@@ -143,11 +270,469 @@ private:
     static constexpr size_t CACHE_LINE_SIZE = 64;
     static constexpr size_t INDEX_MASK = Capacity - 1;
 
-    // Cache-line aligned atomics to prevent false sharing
+    // Copy count items into the ring starting at slot index
+    void write_items(size_t index, const T* items, size_t count) {
+        const size_t first = (count < Capacity - index) ? count : Capacity - index;
+        if (std::is_trivially_copyable<T>::value) {
+            std::memcpy(static_cast<void*>(storage_ + index), items, first * sizeof(T));
+            std::memcpy(static_cast<void*>(storage_), items + first,
+                        (count - first) * sizeof(T));
+            return;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            new (&storage_[(index + i) & INDEX_MASK]) T(items[i]);
+        }
+    }
+
+    // Move count items out of the ring starting at slot index
+    void read_items(size_t index, T* items, size_t count) {
+        const size_t first = (count < Capacity - index) ? count : Capacity - index;
+        if (std::is_trivially_copyable<T>::value) {
+            std::memcpy(static_cast<void*>(items), storage_ + index, first * sizeof(T));
+            std::memcpy(static_cast<void*>(items + first), storage_,
+                        (count - first) * sizeof(T));
+            return;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            T& slot = storage_[(index + i) & INDEX_MASK];
+            items[i] = std::move(slot);
+            slot.~T();
+        }
+    }
+
+    // Block per WaitStrategy until the producer has published something
+    bool wait_for_data(uint64_t timeout_us) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        return wait_strategy_.wait_until(
+            [this, tail]() {
+                return head_.load(std::memory_order_acquire) != tail;
+            },
+            timeout_us * 1000);
+    }
+
+    T* storage_;  // Ring buffer storage (read-only after construction)
+
+    // Cache-line aligned atomics to prevent false sharing; each index shares
+    // its line only with its owner's cached copy of the other index
     alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_;  // Producer writes
+    size_t cached_tail_;                                  // Producer only
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_;  // Consumer writes
+    size_t cached_head_;                                  // Consumer only
+
+    WaitStrategy wait_strategy_;
+};
+
+// Slot storage for MPSCQueue and MPMCQueue: address space reserved by the
+// first push of any thread, whose pages read as zeros until a slot on them
+// is first written. A queue that is never used costs no committed memory.
+class LazySlotRegion {
+public:
+    explicit LazySlotRegion(size_t bytes) : bytes_(round_up_to_page(bytes)), base_(nullptr) {}
+
+    ~LazySlotRegion() {
+        void* base = base_.load(std::memory_order_relaxed);
+        if (base != nullptr) {
+            munmap(base, bytes_);
+        }
+    }
+
+    LazySlotRegion(const LazySlotRegion&) = delete;
+    LazySlotRegion& operator=(const LazySlotRegion&) = delete;
+
+    // The region, reserving it if no thread has yet; nullptr if mmap fails
+    void* get() {
+        void* base = base_.load(std::memory_order_acquire);
+        if (base != nullptr) {
+            return base;
+        }
+        void* fresh = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (fresh == MAP_FAILED) {
+            return nullptr;
+        }
+        // Racing first pushes: one mapping wins, the others go
+        if (!base_.compare_exchange_strong(base, fresh, std::memory_order_acq_rel,
+                                           std::memory_order_acquire)) {
+            munmap(fresh, bytes_);
+            return base;
+        }
+        return fresh;
+    }
+
+    // The region if it has been reserved, else nullptr
+    void* peek() const { return base_.load(std::memory_order_acquire); }
+
+    size_t bytes() const { return bytes_; }
+
+private:
+    static size_t round_up_to_page(size_t bytes) {
+        static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        return (bytes + page - 1) / page * page;
+    }
+
+    const size_t bytes_;
+    std::atomic<void*> base_;
+};
+
+// Smallest power of 2 >= capacity (at least 2)
+inline size_t ring_capacity(size_t capacity) {
+    size_t rounded = 2;
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+    return rounded;
+}
+
+// Lock-free MPSC (Multi Producer Single Consumer) ring buffer
+// Producers claim positions with a CAS on head_ (a batch claims all of its
+// slots with one CAS) and publish each slot through a per-slot sequence
+// number, so the consumer never has to wait on a lock or on the whole batch.
+// Unlike SPSCQueue, all capacity slots are usable.
+// The capacity is chosen at runtime (rounded up to a power of 2, Capacity
+// by default) and slots are committed page by page as positions first
+// reach them, see LazySlotRegion.
+template <typename T, size_t Capacity>
+class MPSCQueue {
+public:
+    static_assert((Capacity & (Capacity - 1)) == 0,
+                  "Capacity must be a power of 2");
+
+    explicit MPSCQueue(size_t capacity = Capacity)
+        : capacity_(ring_capacity(capacity)), index_mask_(capacity_ - 1),
+          head_(0), tail_(0), region_(capacity_ * sizeof(Slot)) {}
+
+    ~MPSCQueue() {
+        Slot* slots = static_cast<Slot*>(region_.peek());
+        if (slots == nullptr) {
+            return;
+        }
+        const size_t head = head_.load(std::memory_order_relaxed);
+        for (size_t pos = tail_.load(std::memory_order_relaxed); pos != head; ++pos) {
+            Slot& slot = slots[pos & index_mask_];
+            if (slot.sequence.load(std::memory_order_relaxed) == lap(pos) + 1) {
+                slot.item()->~T();
+            }
+        }
+    }
+
+    // Disable copy and move
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    // Try to push a single item (any producer thread)
+    // Returns true if successful, false if queue is full
+    bool try_push(const T& item) {
+        Slot* slots = static_cast<Slot*>(region_.get());
+        size_t head;
+        if (slots == nullptr || claim(1, head) == 0) {
+            return false;  // Queue is full
+        }
+
+        Slot& slot = slots[head & index_mask_];
+        new (slot.item()) T(item);
+        slot.sequence.store(lap(head) + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Try to pop a single item (consumer side)
+    // Returns true if successful, false if queue is empty or the producer
+    // that claimed the next slot has not published it yet
+    bool try_pop(T& item) {
+        return try_pop_batch(&item, 1) == 1;
+    }
+
+    // Batch push (up to max_count items, claimed with a single CAS)
+    // Returns number of items actually pushed
+    size_t try_push_batch(const T* items, size_t max_count) {
+        Slot* slots = static_cast<Slot*>(region_.get());
+        size_t head;
+        const size_t count = slots != nullptr ? claim(max_count, head) : 0;
+
+        for (size_t i = 0; i < count; ++i) {
+            Slot& slot = slots[(head + i) & index_mask_];
+            new (slot.item()) T(items[i]);
+            slot.sequence.store(lap(head + i) + 1, std::memory_order_release);
+        }
+        return count;
+    }
+
+    // Batch pop (up to max_count items)
+    // Stops at the first slot that has been claimed but not yet published
+    // Returns number of items actually popped
+    size_t try_pop_batch(T* items, size_t max_count) {
+        Slot* slots = static_cast<Slot*>(region_.peek());
+        if (slots == nullptr) {
+            return 0;  // Nothing was ever pushed
+        }
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+
+        size_t count = 0;
+        while (count < max_count) {
+            const size_t pos = tail + count;
+            Slot& slot = slots[pos & index_mask_];
+            if (slot.sequence.load(std::memory_order_acquire) != lap(pos) + 1) {
+                break;
+            }
+            items[count] = std::move(*slot.item());
+            slot.item()->~T();
+            slot.sequence.store(lap(pos) + capacity_, std::memory_order_relaxed);
+            ++count;
+        }
+
+        if (count > 0) {
+            tail_.store(tail + count, std::memory_order_release);
+        }
+        return count;
+    }
+
+    // Check if queue is empty
+    bool is_empty() const {
+        return tail_.load(std::memory_order_acquire) ==
+               head_.load(std::memory_order_acquire);
+    }
+
+    // Check if queue is full
+    bool is_full() const {
+        return size() >= capacity_;
+    }
+
+    // Get current size (approximate, may be stale)
+    // Includes slots that are claimed but not yet published
+    size_t size() const {
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        const size_t head = head_.load(std::memory_order_acquire);
+        return head - tail;
+    }
+
+    // Get capacity
+    size_t capacity() const { return capacity_; }
+
+    // Bytes of address space the first push reserves
+    size_t reserved_bytes() const { return region_.bytes(); }
+
+private:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    // Position p is ready to pop once its slot's sequence is lap(p) + 1; the
+    // consumer then stores lap(p) + capacity, which no later position of
+    // the same lap matches. Sequences count laps rather than positions so
+    // that an untouched (zero) slot is free for the first lap.
+    struct Slot {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* item() { return reinterpret_cast<T*>(storage); }
+    };
+
+    // Position p minus its slot index
+    size_t lap(size_t pos) const { return pos & ~index_mask_; }
+
+    // Claim up to max_count contiguous positions starting at head
+    // Returns the number of positions claimed (0 if full)
+    size_t claim(size_t max_count, size_t& head) {
+        head = head_.load(std::memory_order_relaxed);
+        for (;;) {
+            const size_t tail = tail_.load(std::memory_order_acquire);
+            const size_t available = capacity_ - (head - tail);
+            const size_t count = (max_count < available) ? max_count : available;
+
+            if (count == 0) {
+                return 0;
+            }
+            if (head_.compare_exchange_weak(head, head + count,
+                                            std::memory_order_relaxed,
+                                            std::memory_order_relaxed)) {
+                return count;
+            }
+        }
+    }
+
+    const size_t capacity_;
+    const size_t index_mask_;
+
+    // Monotonic positions; the slot index is position & index_mask_
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_;  // Producers CAS
     alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_;  // Consumer writes
-    
-    T* storage_;  // Ring buffer storage
+
+    LazySlotRegion region_;  // Ring buffer storage
+};
+
+// Lock-free bounded MPMC (Multi Producer Multi Consumer) ring buffer
+// Same per-slot sequence protocol as MPSCQueue, but consumers also claim
+// positions with a CAS on tail_, so any number of threads can pop. Batch
+// operations scan ahead for free/ready slots and claim them with one CAS.
+// Sized at runtime and committed lazily like MPSCQueue.
+template <typename T, size_t Capacity>
+class MPMCQueue {
+public:
+    static_assert((Capacity & (Capacity - 1)) == 0,
+                  "Capacity must be a power of 2");
+
+    explicit MPMCQueue(size_t capacity = Capacity)
+        : capacity_(ring_capacity(capacity)), index_mask_(capacity_ - 1),
+          head_(0), tail_(0), region_(capacity_ * sizeof(Slot)) {}
+
+    ~MPMCQueue() {
+        Slot* slots = static_cast<Slot*>(region_.peek());
+        if (slots == nullptr) {
+            return;
+        }
+        const size_t head = head_.load(std::memory_order_relaxed);
+        for (size_t pos = tail_.load(std::memory_order_relaxed); pos != head; ++pos) {
+            Slot& slot = slots[pos & index_mask_];
+            if (slot.sequence.load(std::memory_order_relaxed) == lap(pos) + 1) {
+                slot.item()->~T();
+            }
+        }
+    }
+
+    // Disable copy and move
+    MPMCQueue(const MPMCQueue&) = delete;
+    MPMCQueue& operator=(const MPMCQueue&) = delete;
+
+    // Try to push a single item (any producer thread)
+    // Returns true if successful, false if queue is full
+    bool try_push(const T& item) {
+        return try_push_batch(&item, 1) == 1;
+    }
+
+    // Try to pop a single item (any consumer thread)
+    // Returns true if successful, false if queue is empty
+    bool try_pop(T& item) {
+        return try_pop_batch(&item, 1) == 1;
+    }
+
+    // Batch push (up to max_count items)
+    // Returns number of items actually pushed
+    size_t try_push_batch(const T* items, size_t max_count) {
+        Slot* slots = static_cast<Slot*>(region_.get());
+        if (slots == nullptr) {
+            return 0;
+        }
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t count;
+        for (;;) {
+            // Free slots for position p have sequence == lap(p)
+            count = 0;
+            while (count < max_count &&
+                   slots[(head + count) & index_mask_].sequence.load(
+                       std::memory_order_acquire) == lap(head + count)) {
+                ++count;
+            }
+            if (count == 0) {
+                const size_t seq =
+                    slots[head & index_mask_].sequence.load(std::memory_order_acquire);
+                if (seq < lap(head)) {
+                    return 0;  // Queue is full
+                }
+                head = head_.load(std::memory_order_relaxed);  // Lost a race
+                continue;
+            }
+            if (head_.compare_exchange_weak(head, head + count,
+                                            std::memory_order_relaxed,
+                                            std::memory_order_relaxed)) {
+                break;
+            }
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            Slot& slot = slots[(head + i) & index_mask_];
+            new (slot.item()) T(items[i]);
+            slot.sequence.store(lap(head + i) + 1, std::memory_order_release);
+        }
+        return count;
+    }
+
+    // Batch pop (up to max_count items)
+    // Returns number of items actually popped
+    size_t try_pop_batch(T* items, size_t max_count) {
+        Slot* slots = static_cast<Slot*>(region_.peek());
+        if (slots == nullptr) {
+            return 0;  // Nothing was ever pushed
+        }
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t count;
+        for (;;) {
+            // Ready slots for position p have sequence == lap(p) + 1
+            count = 0;
+            while (count < max_count &&
+                   slots[(tail + count) & index_mask_].sequence.load(
+                       std::memory_order_acquire) == lap(tail + count) + 1) {
+                ++count;
+            }
+            if (count == 0) {
+                const size_t seq =
+                    slots[tail & index_mask_].sequence.load(std::memory_order_acquire);
+                if (seq < lap(tail) + 1) {
+                    return 0;  // Queue is empty
+                }
+                tail = tail_.load(std::memory_order_relaxed);  // Lost a race
+                continue;
+            }
+            if (tail_.compare_exchange_weak(tail, tail + count,
+                                            std::memory_order_relaxed,
+                                            std::memory_order_relaxed)) {
+                break;
+            }
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            Slot& slot = slots[(tail + i) & index_mask_];
+            items[i] = std::move(*slot.item());
+            slot.item()->~T();
+            slot.sequence.store(lap(tail + i) + capacity_, std::memory_order_release);
+        }
+        return count;
+    }
+
+    // Check if queue is empty
+    bool is_empty() const {
+        return size() == 0;
+    }
+
+    // Check if queue is full
+    bool is_full() const {
+        return size() >= capacity_;
+    }
+
+    // Get current size (approximate, may be stale)
+    size_t size() const {
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        const size_t head = head_.load(std::memory_order_acquire);
+        return head > tail ? head - tail : 0;
+    }
+
+    // Get capacity
+    size_t capacity() const { return capacity_; }
+
+    // Bytes of address space the first push reserves
+    size_t reserved_bytes() const { return region_.bytes(); }
+
+private:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    // Position p may be written once its slot's sequence is lap(p), and
+    // read once it is lap(p) + 1; the consumer then stores lap(p) +
+    // capacity, which frees the slot for the next lap. An untouched (zero)
+    // slot is free for the first lap.
+    struct Slot {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* item() { return reinterpret_cast<T*>(storage); }
+    };
+
+    // Position p minus its slot index
+    size_t lap(size_t pos) const { return pos & ~index_mask_; }
+
+    const size_t capacity_;
+    const size_t index_mask_;
+
+    // Monotonic positions; the slot index is position & index_mask_
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_;  // Producers CAS
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_;  // Consumers CAS
+
+    LazySlotRegion region_;  // Ring buffer storage
 };
 
 }  // namespace nanomq
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "nanomq/message.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nanomq {
+
+// Record batch (header flag MSG_FLAG_BATCH)
+//
+// Many messages travel as one: the batch's MessageHeader carries the base
+// id, base timestamp, payload size, a single CRC32C over the payload and
+// the attributes (flags), and the payload is
+//   4 bytes record count
+//   4 bytes records size, the bytes of the packed records
+//   4 bytes last id delta, highest record id - base id
+//   8 bytes max timestamp, highest record timestamp
+//   the packed records, or with MSG_FLAG_COMPRESSED an LZ4 block of them
+// (integers little-endian)
+// where each packed record is
+//   varint  id - base id
+//   varint  timestamp - base timestamp (zigzag)
+//   varint  size << 1 | keyed (1 for a MSG_FLAG_KEYED record)
+//   size bytes payload
+// Records have no checksum of their own, keep only the keyed flag and
+// inherit the batch's topic; verify the batch, not the records. The broker ring and the WAL
+// carry the batch unchanged, compressed or not; only readers of records
+// expand it. The last id delta and max timestamp let logs index a batch
+// without reading its records.
+
+constexpr size_t RECORD_BATCH_PREFIX_SIZE = 20;
+
+// Largest records size a reader expands a compressed batch to
+constexpr size_t MAX_RECORD_BATCH_RECORDS_SIZE = 16 * 1024 * 1024;
+
+// Builds a record batch in memory
+class MessageBatch {
+public:
+    static constexpr size_t MAX_BATCH_SIZE = 256;
+
+    // max_bytes bounds the batch payload (e.g. a ring's max_payload())
+    explicit MessageBatch(size_t max_bytes = MAX_PAYLOAD_SIZE);
+
+    bool is_full() const { return count_ >= MAX_BATCH_SIZE; }
+    bool is_empty() const { return count_ == 0; }
+    size_t count() const { return count_; }
+
+    // Payload bytes so far, uncompressed
+    size_t size() const { return size_; }
+
+    // Append a copy of a message; the first one sets the base id, timestamp
+    // and topic. Returns false if the batch is full, the record does not
+    // fit in max_bytes (nor do ids below the base or 2^32 and more above it)
+    // or it has flags a record cannot keep (any but MSG_FLAG_KEYED, and
+    // MSG_FLAG_CRC32C, whose checksum the batch's replaces)
+    bool add(const Message& msg);
+    bool add(uint64_t id, uint64_t timestamp, const void* data, size_t size,
+             uint32_t flags = MSG_FLAG_NONE);
+
+    void clear();
+    void set_max_bytes(size_t max_bytes);
+
+    // The batch as one message, checksummed; data points into this object
+    // and stays valid until the next add() or clear(). With compress the
+    // records are LZ4 compressed (MSG_FLAG_COMPRESSED) if that makes the
+    // batch smaller
+    Message finish(bool compress = false);
+
+private:
+    MessageHeader header_;
+    std::vector<uint8_t> buffer_;      // Prefix and records, max_bytes long
+    std::vector<uint8_t> compressed_;  // Prefix and LZ4 block
+    size_t size_;
+    size_t count_;
+    size_t max_bytes_;
+    uint64_t last_id_;
+    uint64_t max_timestamp_;
+};
+
+// Highest id and timestamp among the messages msg stands for: its own, or
+// those of its records for a MSG_FLAG_BATCH batch, read from the batch
+// prefix without checking the CRC (a batch too short for one counts as its
+// header). Logs key their indexes and seeks on these, since the WAL stores
+// a batch as one entry
+void message_bounds(const Message& msg, uint64_t& last_id, uint64_t& max_timestamp);
+
+// Iterates the records of a batch in place
+class RecordBatchReader {
+public:
+    RecordBatchReader() : p_(nullptr), end_(nullptr), remaining_(0) {}
+
+    // Check the batch's CRC and framing; false if it is not a valid batch
+    // The records of a compressed batch are expanded into records (by
+    // default a buffer of the reader's own), which the messages next()
+    // returns point into; those of others point into the batch payload
+    bool reset(const Message& batch);
+    bool reset(const Message& batch, std::vector<uint8_t>& records);
+
+    // Next record, flagged MSG_FLAG_KEYED if it was added so
+    // Returns false at the end, or at a malformed record
+    bool next(Message& msg);
+
+    size_t remaining() const { return remaining_; }
+
+private:
+    MessageHeader base_;
+    const uint8_t* p_;
+    const uint8_t* end_;
+    size_t remaining_;
+    std::vector<uint8_t> expanded_;
+};
+
+}  // namespace nanomq
@@ -0,0 +1,196 @@
+#pragma once
+
+#include "nanomq/message.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace nanomq {
+
+// Lock-free SPSC ring of variable-length message records
+//
+// Each record is a MessageHeader followed directly by its payload, padded
+// to a cache line, so the payload is owned by the ring instead of a
+// separate allocation and sits on the cache lines right behind its header.
+// A record never straddles the end of the buffer: when the next record does
+// not fit, the producer fills the tail with a padding record (flagged
+// MSG_FLAG_PADDING, size = bytes skipped) and restarts at offset 0.
+//
+// Positions are monotonic byte offsets. The consumer reads records in place;
+// their data pointers stay valid until release() hands the space back.
+template <size_t Capacity>
+class RecordRing {
+public:
+    static_assert((Capacity & (Capacity - 1)) == 0,
+                  "Capacity must be a power of 2");
+    static_assert(Capacity >= 4 * CACHE_LINE_SIZE, "Capacity too small");
+    static_assert(Capacity <= UINT32_MAX, "Padding sizes must fit in 32 bits");
+
+    // Largest payload a single record may carry; keeps padding plus record
+    // within the ring so a write always succeeds once the consumer catches up
+    static constexpr size_t MAX_RECORD_PAYLOAD =
+        Capacity / 2 - sizeof(MessageHeader);
+
+    RecordRing()
+        : head_(0), pending_(0), cached_tail_(0),
+          tail_(0), read_(0), cached_head_(0) {
+        void* ptr = nullptr;
+        if (posix_memalign(&ptr, CACHE_LINE_SIZE, Capacity) != 0) {
+            ptr = nullptr;
+        }
+        buffer_ = static_cast<uint8_t*>(ptr);
+    }
+
+    ~RecordRing() {
+        free(buffer_);
+    }
+
+    // Disable copy and move
+    RecordRing(const RecordRing&) = delete;
+    RecordRing& operator=(const RecordRing&) = delete;
+
+    // Reserve a record with room for size payload bytes (producer side)
+    // Returns the record's header with size filled in and the payload at
+    // payload(header), or nullptr if the ring is full or size is larger
+    // than MAX_RECORD_PAYLOAD. Several records may be claimed before one
+    // publish() makes all of them visible.
+    MessageHeader* claim(uint32_t size) {
+        if (size > MAX_RECORD_PAYLOAD) {
+            return nullptr;
+        }
+        const size_t need = record_bytes(size);
+        size_t pos = pending_;
+        const size_t index = pos & INDEX_MASK;
+        const size_t pad = (index + need > Capacity) ? Capacity - index : 0;
+
+        if (pos + pad + need - cached_tail_ > Capacity) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (pos + pad + need - cached_tail_ > Capacity) {
+                return nullptr;  // Ring is full
+            }
+        }
+
+        if (pad > 0) {
+            MessageHeader* filler = new (buffer_ + index) MessageHeader();
+            filler->size = static_cast<uint32_t>(pad);
+            filler->flags = MSG_FLAG_PADDING;
+            pos += pad;
+        }
+        MessageHeader* header = new (buffer_ + (pos & INDEX_MASK)) MessageHeader();
+        header->size = size;
+        pending_ = pos + need;
+        return header;
+    }
+
+    // Make every claimed record visible to the consumer (producer side)
+    void publish() {
+        head_.store(pending_, std::memory_order_release);
+    }
+
+    // Copy a header and its payload into the ring and publish it
+    // Returns false if the ring is full or the payload is too large
+    bool try_write(const MessageHeader& header, const void* payload) {
+        MessageHeader* record = claim(header.size);
+        if (record == nullptr) {
+            return false;
+        }
+        *record = header;
+        if (header.size > 0) {
+            std::memcpy(this->payload(record), payload, header.size);
+        }
+        publish();
+        return true;
+    }
+
+    bool try_write(const Message& msg) {
+        return try_write(msg.header, msg.data);
+    }
+
+    // Read the next record in place (consumer side)
+    // msg.data points into the ring and stays valid until release()
+    // Returns false if no record is available
+    bool try_read(Message& msg) {
+        size_t pos = read_;
+        for (;;) {
+            if (pos == cached_head_) {
+                cached_head_ = head_.load(std::memory_order_acquire);
+                if (pos == cached_head_) {
+                    read_ = pos;
+                    return false;  // Ring is empty
+                }
+            }
+            uint8_t* record = buffer_ + (pos & INDEX_MASK);
+            const MessageHeader* header = reinterpret_cast<const MessageHeader*>(record);
+            if ((header->flags & MSG_FLAG_PADDING) != 0) {
+                pos += header->size;  // Skip to the start of the buffer
+                continue;
+            }
+            msg.header = *header;
+            msg.data = record + sizeof(MessageHeader);
+            read_ = pos + record_bytes(header->size);
+            return true;
+        }
+    }
+
+    // Read up to max_count records in place (consumer side)
+    // Returns number of records read
+    size_t try_read_batch(Message* messages, size_t max_count) {
+        size_t count = 0;
+        while (count < max_count && try_read(messages[count])) {
+            ++count;
+        }
+        return count;
+    }
+
+    // Hand every record read so far back to the producer (consumer side)
+    // Invalidates the data pointers of those records
+    void release() {
+        tail_.store(read_, std::memory_order_release);
+    }
+
+    // Payload of a claimed record
+    static uint8_t* payload(MessageHeader* header) {
+        return reinterpret_cast<uint8_t*>(header + 1);
+    }
+
+    // Check if ring is empty (published records all released)
+    bool is_empty() const {
+        return tail_.load(std::memory_order_acquire) ==
+               head_.load(std::memory_order_acquire);
+    }
+
+    // Bytes held by published, unreleased records (approximate)
+    size_t used_bytes() const {
+        return head_.load(std::memory_order_acquire) -
+               tail_.load(std::memory_order_acquire);
+    }
+
+    // Get capacity in bytes
+    static constexpr size_t capacity() { return Capacity; }
+
+    // Ring bytes taken by a record with size payload bytes
+    static constexpr size_t record_bytes(size_t size) {
+        return (sizeof(MessageHeader) + size + CACHE_LINE_SIZE - 1) &
+               ~(CACHE_LINE_SIZE - 1);
+    }
+
+private:
+    static constexpr size_t INDEX_MASK = Capacity - 1;
+
+    uint8_t* buffer_;  // Record storage (read-only after construction)
+
+    // Producer cache line
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_;  // Published end
+    size_t pending_;      // End of claimed, unpublished records
+    size_t cached_tail_;  // Producer's copy of tail_
+
+    // Consumer cache line
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_;  // Released end
+    size_t read_;         // End of records handed out by try_read()
+    size_t cached_head_;  // Consumer's copy of head_
+};
+
+}  // namespace nanomq
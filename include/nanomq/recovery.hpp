@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace nanomq {
+
+// Outcome of recover()
+struct RecoveryReport {
+    size_t segments = 0;          // Segments with a valid header
+    uint64_t records = 0;         // Records whose CRC checked out
+    uint64_t bytes = 0;           // Up to the last valid record, headers included
+    size_t corrupt_segments = 0;  // Sealed segments with a bad record before their end
+    uint64_t truncated_bytes = 0; // Torn or corrupt tail cut off the log
+    size_t removed_segments = 0;  // Trailing files without a valid header
+    size_t indexes_rebuilt = 0;
+    uint64_t max_id = 0;
+    uint64_t max_timestamp = 0;
+    std::unordered_map<uint32_t, uint64_t> last_ids;  // Highest id per topic_id
+    uint64_t elapsed_ns = 0;
+
+    // Highest recovered id of a topic, 0 if it has none
+    uint64_t last_id(uint32_t topic_id) const {
+        auto it = last_ids.find(topic_id);
+        return it == last_ids.end() ? 0 : it->second;
+    }
+};
+
+// Bring the WAL in directory back to a consistent state after a crash
+//
+// Every segment is read and its record CRCs checked, on up to threads
+// threads (0 for one per core), one segment per thread at a time. The log
+// ends after the last valid record of the last segment holding one: a torn
+// or corrupt tail there is truncated and trailing files with no valid
+// header are deleted. Sealed segments with a bad record in the middle are
+// only reported, as the records after it may still be wanted. Indexes
+// that no longer match their segment are rebuilt.
+//
+// Call before opening a WAL on the directory; restore topic id counters
+// from the report with Topic::restore_message_id().
+RecoveryReport recover(const std::string& directory, unsigned threads = 0);
+
+}  // namespace nanomq
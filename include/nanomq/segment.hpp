@@ -0,0 +1,276 @@
+#pragma once
+
+#include "nanomq/message.hpp"
+#include "nanomq/protocol.hpp"
+#include "nanomq/wal.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace nanomq {
+
+class MMapFile;
+class TieredStorage;
+
+// Entry of a segment's sparse index
+//
+// Every segment NNNNNNNN.wal has two, in the manner of Kafka's .index and
+// .timeindex: NNNNNNNN.index keyed by message id and NNNNNNNN.timeindex
+// keyed by timestamp, both mapping to a byte position in the segment. The
+// key is the largest id (timestamp) of the records up to and including the
+// one at position, so keys never decrease even when producers interleave:
+// every record before the last entry with key < target has a smaller key,
+// and the first record with id (timestamp) >= target is found by a binary
+// search plus a scan of at most INTERVAL_BYTES.
+struct IndexEntry {
+    uint64_t key;
+    uint64_t position;  // Of a record in the segment; 0 marks unused space
+};
+
+static_assert(sizeof(IndexEntry) == 16, "index entries are 16 bytes");
+
+// Segment files (NNNNNNNN.wal) in directory, by number
+std::vector<std::pair<uint32_t, std::string>> segment_files(const std::string& directory);
+
+// Stubs of archived segments (NNNNNNNN.archived), see tiered_storage.hpp
+std::vector<std::pair<uint32_t, std::string>> archived_segment_files(const std::string& directory);
+
+// Index files of the segment at segment_path
+std::string offset_index_path(const std::string& segment_path);
+std::string time_index_path(const std::string& segment_path);
+
+// Delete the segment at segment_path and its indexes
+void remove_segment(const std::string& segment_path);
+
+// Reads the records of one segment from any record position on
+class SegmentScanner {
+public:
+    SegmentScanner();
+    ~SegmentScanner();
+
+    SegmentScanner(const SegmentScanner&) = delete;
+    SegmentScanner& operator=(const SegmentScanner&) = delete;
+
+    // False if the segment is missing or its header is not (yet) valid
+    bool open(const std::string& path, uint32_t number);
+
+    // The same for a segment already open as fd, which the scanner takes
+    // over (and closes, also on failure)
+    bool open(int fd, uint32_t number);
+
+    uint32_t number() const { return number_; }
+    const WALSegmentHeader& header() const { return header_; }
+    int fd() const { return fd_; }
+
+    // Position of the next record
+    uint64_t position() const { return position_; }
+    void seek(uint64_t position);
+
+    // Next complete record; false at the end of what has been written, a
+    // torn record or padding. msg.data is valid until the next call
+    bool next(Message& msg);
+
+    // Whether nothing but zeros (or the end of the file) follows position()
+    // for the length of a record: true at a clean end, false at a torn or
+    // corrupt one
+    bool at_end();
+
+    // Encoded bytes of the record next() returned, valid until the next call
+    const uint8_t* record() const { return current() - record_size_; }
+    size_t record_size() const { return record_size_; }
+
+private:
+    const uint8_t* current() const { return buffer_.data() + (position_ - buffer_start_); }
+
+    // Make up to want bytes from position_ on readable at current()
+    size_t available(size_t want);
+
+    int fd_;
+    uint32_t number_;
+    WALSegmentHeader header_;
+    EncodingBase base_;
+    std::vector<uint8_t> buffer_;
+    uint64_t buffer_start_;  // File position of buffer_[0]
+    size_t buffer_size_;
+    uint64_t position_;
+    size_t record_size_;
+};
+
+// Writes both indexes of one segment while it is appended to
+//
+// The files are mapped at their full size up front so add() is a store;
+// the destructor trims them to the entries written. Files of a crashed
+// writer keep zeroed unused space, which readers ignore.
+class SegmentIndexWriter {
+public:
+    static constexpr size_t INTERVAL_BYTES = 4096;  // Between index entries
+
+    // Create (truncate) the indexes for a segment of up to max_bytes
+    // Throws std::runtime_error on failure
+    SegmentIndexWriter(const std::string& segment_path, size_t max_bytes);
+    ~SegmentIndexWriter();
+
+    SegmentIndexWriter(const SegmentIndexWriter&) = delete;
+    SegmentIndexWriter& operator=(const SegmentIndexWriter&) = delete;
+
+    // Note the record at position; indexes it if INTERVAL_BYTES have passed
+    void add(uint64_t id, uint64_t timestamp, uint64_t position) {
+        max_id_ = id > max_id_ ? id : max_id_;
+        max_timestamp_ = timestamp > max_timestamp_ ? timestamp : max_timestamp_;
+        if (position >= next_position_ && count_ < capacity_) {
+            offsets_[count_] = IndexEntry{max_id_, position};
+            times_[count_] = IndexEntry{max_timestamp_, position};
+            ++count_;
+            next_position_ = position + INTERVAL_BYTES;
+        }
+    }
+
+    size_t entries() const { return count_; }
+
+private:
+    std::string offset_path_;
+    std::string time_path_;
+    std::unique_ptr<MMapFile> offset_file_;
+    std::unique_ptr<MMapFile> time_file_;
+    IndexEntry* offsets_;
+    IndexEntry* times_;
+    size_t capacity_;
+    size_t count_;
+    uint64_t next_position_;
+    uint64_t max_id_;
+    uint64_t max_timestamp_;
+};
+
+// A segment of a log directory and the range of its records
+struct SegmentInfo {
+    uint32_t number;
+    std::string path;
+    uint64_t base_id;
+    uint64_t base_timestamp;
+    uint64_t max_id;         // 0 if the segment has no records
+    uint64_t max_timestamp;
+    uint64_t end;            // Byte position after the last complete record
+    size_t index_entries;
+    bool archived;           // path is the stub of an archived segment
+};
+
+// Place in a log: segment number and byte position of a record in it
+struct LogPosition {
+    uint32_t segment;
+    uint64_t position;
+};
+
+// Segments and indexes of a WAL directory
+//
+// Given the directory's TieredStorage, archived segments count as part of
+// the log and are fetched when a seek or read needs their records.
+class SegmentManager {
+public:
+    explicit SegmentManager(const std::string& directory,
+                            std::shared_ptr<TieredStorage> tier = nullptr);
+
+    const std::string& directory() const { return directory_; }
+
+    // Local segment files and, with a tier, archived segment stubs
+    std::vector<std::pair<uint32_t, std::string>> files() const;
+
+    // Open a segment from files(), fetching it if archived
+    bool open_segment(uint32_t number, const std::string& path, SegmentScanner& scanner) const;
+
+    // Open the first readable segment numbered number or later into
+    // scanner, at its first record; path (if given) gets its files() path
+    bool open_from(uint32_t number, SegmentScanner& scanner,
+                   std::string* path = nullptr) const;
+
+    // For a reader that found nothing more at its place in segment number:
+    // true if it is done with that segment, with the next one opened into
+    // next as by open_from(). The WAL writes out the tail of a segment
+    // before any record of the next one, so that is once the next one has
+    // a record and more_in_current(), asked after that, still finds none
+    bool advance_segment(uint32_t number, SegmentScanner& next,
+                         const std::function<bool()>& more_in_current,
+                         std::string* path = nullptr) const;
+
+    // Open a segment from files() read-only, fetching it if archived;
+    // returns an fd for the caller to close, -1 if it cannot be opened
+    int open_file(uint32_t number, const std::string& path) const;
+
+    // End of the whole records of segment path (open as fd) from the record
+    // at from up to limit, at least one record if there is one; from if
+    // there is none. Skips ahead through the offset index and reads only
+    // record lengths, not payloads
+    uint64_t records_end(int fd, const std::string& path, uint64_t from, uint64_t limit) const;
+
+    // Segments in order, with their bounds (found through the indexes,
+    // scanning only past the last entry)
+    std::vector<SegmentInfo> list_segments() const;
+
+    // Write the indexes of local segments whose index files are missing or
+    // do not match the segment; returns the number of segments reindexed
+    size_t rebuild_indexes() const;
+
+    // The same for one segment; true if its indexes were rewritten
+    bool rebuild_index(uint32_t number, const std::string& path) const;
+
+    // Position of the first record with id >= message_id (timestamp >=
+    // timestamp_ns); false if there is none (yet). A batch record counts
+    // with its last id (largest timestamp), so a target inside a batch
+    // lands on the batch
+    bool seek(uint64_t message_id, LogPosition& position) const;
+    bool seek_to_timestamp(uint64_t timestamp_ns, LogPosition& position) const;
+
+    // Retention: delete whole segments whose newest record is more than
+    // retention_ms old, or the oldest ones until the records of the log
+    // take at most max_bytes. Segments from the last one with a record on
+    // are never deleted. Return the number deleted
+    size_t cleanup_old_segments(uint64_t retention_ms) const;
+    size_t cleanup_to_size(uint64_t max_bytes) const;
+
+private:
+    enum class Key { ID, TIMESTAMP };
+
+    bool seek_by(Key key, uint64_t target, LogPosition& position) const;
+    void remove(const SegmentInfo& info) const;
+
+    std::string directory_;
+    std::shared_ptr<TieredStorage> tier_;
+};
+
+// Sequential reader over the records of a log directory
+//
+// Follows the log as it grows: next() returns false at the current end
+// and picks up records appended (and written out) later.
+class LogReader {
+public:
+    explicit LogReader(const std::string& directory,
+                       std::shared_ptr<TieredStorage> tier = nullptr);
+    ~LogReader();
+
+    LogReader(const LogReader&) = delete;
+    LogReader& operator=(const LogReader&) = delete;
+
+    // Continue at the first record with id >= message_id (timestamp >=
+    // timestamp_ns), a batch holding it included; false, leaving the
+    // position alone, if there is none
+    bool seek(uint64_t message_id);
+    bool seek_to_timestamp(uint64_t timestamp_ns);
+
+    // Continue at position (the start of the log by default); positions
+    // in a segment are void once it is compacted
+    void seek(const LogPosition& position);
+    LogPosition position() const { return position_; }
+
+    // Next record; msg.data is valid until the next call
+    bool next(Message& msg);
+
+private:
+    SegmentManager segments_;
+    LogPosition position_;
+    std::unique_ptr<SegmentScanner> segment_;
+};
+
+}  // namespace nanomq
@@ -0,0 +1,228 @@
+#pragma once
+
+#include "nanomq/message.hpp"
+#include "nanomq/wait_strategy.hpp"
+#include <sys/types.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace nanomq {
+
+// Shared-memory transport for publishers and subscribers on the broker host
+//
+// The broker publishes a registry segment named after its shm:// address.
+// A client claims a channel slot in the registry (topic + direction), the
+// broker creates a ring segment for it and marks the slot ready, and the
+// client maps the ring. From then on messages move through the ring with
+// the SPSC head/tail protocol and a futex doorbell, without any syscalls
+// on the hot path.
+//
+// Crash safety: ring names are unlinked as soon as the client has mapped
+// them, so nothing outlives the two processes; the broker reaps channels
+// whose client process is gone, and clients notice a dead broker through
+// the pid in the registry. Records are only made visible after they are
+// fully written, so a peer dying mid-write never exposes a torn record.
+
+constexpr const char* SHM_SCHEME = "shm://";
+constexpr size_t SHM_DEFAULT_RING_BYTES = 1 << 20;
+constexpr size_t SHM_MAX_CHANNELS = 64;
+constexpr size_t SHM_MAX_TOPIC_LENGTH = 127;
+
+// Direction of a channel, seen from the client
+enum class ShmDirection : uint32_t {
+    PUBLISH = 1,    // Client writes, broker reads
+    SUBSCRIBE = 2,  // Broker writes, client reads
+};
+
+// Whether address uses the shm:// scheme; name receives the segment name
+bool parse_shm_address(const std::string& address, std::string& name);
+
+// Whether the process with this pid still exists
+bool process_alive(pid_t pid);
+
+// POSIX shared memory segment mapped into this process
+// The creator unlinks the name on destruction unless unlink() ran earlier.
+class ShmSegment {
+public:
+    ~ShmSegment();
+
+    ShmSegment(const ShmSegment&) = delete;
+    ShmSegment& operator=(const ShmSegment&) = delete;
+
+    // Create and map a zero-filled segment; fails if the name exists
+    static std::unique_ptr<ShmSegment> create(const std::string& name, size_t size);
+
+    // Map an existing segment at its full size
+    static std::unique_ptr<ShmSegment> open(const std::string& name);
+
+    // Remove the name; existing mappings stay valid
+    void unlink();
+
+    void* data() const { return data_; }
+    size_t size() const { return size_; }
+    const std::string& name() const { return name_; }
+
+private:
+    ShmSegment(const std::string& name, void* data, size_t size, bool owner);
+
+    std::string name_;
+    void* data_;
+    size_t size_;
+    bool linked_;  // We created the name and have not unlinked it yet
+};
+
+// Control block at the start of a ring segment
+// Producer and consumer fields sit on separate cache lines.
+struct ShmRingControl {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;  // Record area bytes (power of 2)
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> head;  // Producer writes
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> tail;  // Consumer writes
+    SharedFutexParkWait doorbell;  // Consumer parks here when empty
+};
+
+// One side of a variable-length record ring living in a shared segment
+//
+// Records use the RecordRing layout: a MessageHeader followed by the
+// payload, padded to a cache line, with MSG_FLAG_PADDING filler records at
+// the wrap point. Indices are taken from the other process, so the
+// consumer validates every record before handing it out and marks the ring
+// broken instead of reading out of bounds.
+class ShmRing {
+public:
+    ShmRing() : control_(nullptr), records_(nullptr), capacity_(0),
+                pending_(0), cached_tail_(0), read_(0), last_read_(0),
+                cached_head_(0), broken_(false) {}
+
+    // Segment bytes needed for a ring with capacity record bytes
+    static size_t segment_size(size_t capacity);
+
+    // Format a fresh ring in memory of segment_size(capacity) bytes
+    static void initialize(void* memory, size_t capacity);
+
+    // Attach to a formatted ring; returns false if the layout is not valid
+    bool attach(void* memory, size_t size);
+
+    // Producer side (see RecordRing)
+    MessageHeader* claim(uint32_t size);
+    void publish();
+    bool try_write(const MessageHeader& header, const void* payload);
+    bool has_room(uint32_t size);
+
+    // Consumer side; msg.data points into the ring until release()
+    bool try_read(Message& msg);
+    void unread();  // Put back the record of the last successful try_read()
+    void release();
+
+    // Wait up to timeout_ns for a record (consumer side)
+    bool wait(uint64_t timeout_ns);
+
+    // Payload of a claimed record
+    static uint8_t* payload(MessageHeader* header) {
+        return reinterpret_cast<uint8_t*>(header + 1);
+    }
+
+    bool is_attached() const { return control_ != nullptr; }
+    bool is_broken() const { return broken_; }
+    size_t capacity() const { return capacity_; }
+    size_t max_payload() const { return capacity_ / 2 - sizeof(MessageHeader); }
+
+private:
+    ShmRingControl* control_;
+    uint8_t* records_;
+    size_t capacity_;
+
+    // Process-local state of whichever side this process is
+    uint64_t pending_;      // Producer: end of claimed records
+    uint64_t cached_tail_;  // Producer: copy of tail
+    uint64_t read_;         // Consumer: end of records handed out
+    uint64_t last_read_;    // Consumer: read_ before the last try_read()
+    uint64_t cached_head_;  // Consumer: copy of head
+    bool broken_;           // Consumer: peer wrote an invalid record
+};
+
+// Broker side: owns the registry and one ring segment per channel
+class ShmServer {
+public:
+    struct Channel {
+        ShmDirection direction;
+        std::string topic;
+        pid_t client_pid;
+        std::unique_ptr<ShmSegment> segment;
+        ShmRing ring;
+        bool attached;  // Client has mapped the ring, name is unlinked
+    };
+
+    explicit ShmServer(const std::string& name,
+                       size_t ring_bytes = SHM_DEFAULT_RING_BYTES);
+    ~ShmServer();
+
+    ShmServer(const ShmServer&) = delete;
+    ShmServer& operator=(const ShmServer&) = delete;
+
+    // Create the registry segment (replacing one left by a dead broker)
+    bool start();
+
+    // shm:// address clients connect to
+    std::string address() const { return SHM_SCHEME + name_; }
+
+    // Accept requested channels and reap closed or orphaned ones
+    // Returns the number of channel state changes
+    size_t poll_channels();
+
+    // Move records from publish channels to the subscribe channels of the
+    // same topic; a publisher is held back while any subscriber is full
+    // Returns the number of records moved
+    size_t route();
+
+    size_t channel_count() const;
+
+    // Channel in a registry slot, nullptr if the slot is not in use
+    Channel* channel(size_t slot) { return channels_[slot].get(); }
+
+private:
+    void open_channel(size_t slot);
+    void close_channel(size_t slot);
+
+    std::string name_;
+    size_t ring_bytes_;
+    std::unique_ptr<ShmSegment> registry_;
+    std::unique_ptr<Channel> channels_[SHM_MAX_CHANNELS];
+};
+
+// Client side: one channel to the broker for one topic
+class ShmChannel {
+public:
+    ~ShmChannel();
+
+    ShmChannel(const ShmChannel&) = delete;
+    ShmChannel& operator=(const ShmChannel&) = delete;
+
+    // Ask the broker behind name for a channel; waits up to timeout_us
+    // Returns nullptr if there is no live broker or no free slot
+    static std::unique_ptr<ShmChannel> connect(const std::string& name,
+                                               const std::string& topic,
+                                               ShmDirection direction,
+                                               uint64_t timeout_us = 1000000);
+
+    ShmRing& ring() { return ring_; }
+
+    // Whether the broker process still exists (costs a syscall)
+    bool broker_alive() const;
+
+private:
+    ShmChannel() : slot_(0), broker_pid_(0) {}
+
+    std::unique_ptr<ShmSegment> registry_;
+    std::unique_ptr<ShmSegment> segment_;
+    ShmRing ring_;
+    size_t slot_;
+    pid_t broker_pid_;
+};
+
+}  // namespace nanomq
@@ -13,7 +13,8 @@ class BrokerClient;
 // Subscriber API for receiving messages from topics
 class Subscriber {
 public:
-    // Connect to broker at specified address
+    // Connect to broker at specified address ("host:port" or "shm://name"),
+    // or read the WAL directory at "file://path" from its first record
     explicit Subscriber(const std::string& broker_address = "127.0.0.1:9000",
                        const std::string& consumer_group = "");
     ~Subscriber();
@@ -32,6 +33,8 @@ public:
 
     // Poll for a single message (blocks up to timeout_us microseconds)
     // Returns empty Message (id=0) if timeout or no messages
+    // With a shm:// broker, data points into shared memory and stays valid
+    // until the next poll() or poll_batch()
     Message poll(uint64_t timeout_us = 1000000);  // Default 1 second
 
     // Poll for a batch of messages (up to max_msgs)
@@ -47,9 +50,11 @@ public:
     void commit_batch(const std::vector<uint64_t>& message_ids);
 
     // Seek to a specific message ID (replay from this point)
+    // Needs a file:// log; false if no message has that ID or a later one
     bool seek(uint64_t message_id);
 
     // Seek to a specific timestamp (replay from this time)
+    // Needs a file:// log; false if no message is that recent
     bool seek_to_timestamp(uint64_t timestamp_ns);
 
     // Get connection status
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "nanomq/message.hpp"
+#include <string>
+
+namespace nanomq {
+
+class Topic;
+
+// Subscription tracking
+// Members of a consumer group each hold a Subscription on the same
+// CONSUMER_GROUP topic and pull directly from its shared MPMC ring, so
+// work is spread across the group without a broker-side lock.
+// Subscriptions without a group on a BROADCAST topic own a reader cursor
+// on the topic's broadcast ring and see every message. SINGLE_PRODUCER and
+// MULTI_PRODUCER topics have single-consumer queues, so only one plain
+// subscription at a time can attach to them; fan-out needs BROADCAST.
+class Subscription {
+public:
+    Subscription(Topic& topic, const std::string& consumer_group);
+    ~Subscription();
+
+    Subscription(const Subscription&) = delete;
+    Subscription& operator=(const Subscription&) = delete;
+
+    // False if a BROADCAST topic had no free reader cursor left, or if
+    // another subscription already reads a single-consumer topic
+    bool is_attached() const;
+
+    const std::string& topic() const;
+    const std::string& consumer_group() const { return consumer_group_; }
+
+    // Pull up to max_count messages from the topic's ring buffer
+    // Returns number of messages written to messages (0 once dropped)
+    size_t poll(Message* messages, size_t max_count);
+
+    // Whether a BROADCAST topic with SlowReaderPolicy::DROP_READER has cut
+    // this subscription loose for falling a full ring behind; it gets
+    // nothing more until reattach()
+    bool is_dropped() const;
+
+    // Give a dropped subscription a new cursor at the topic's head; the
+    // messages it missed are gone. False if no cursor is free
+    bool reattach();
+
+    uint64_t position() const { return position_; }
+    void set_position(uint64_t pos) { position_ = pos; }
+
+private:
+    Topic* topic_;
+    std::string consumer_group_;
+    int reader_;         // Broadcast cursor, -1 when reading a queue
+    bool queue_reader_;  // Holds the topic's single-consumer queue
+    uint64_t position_;  // Last committed message ID
+};
+
+}  // namespace nanomq
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "nanomq/wal.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace nanomq {
+
+// Object store holding archived segments, named like keys in a bucket
+//
+// Implementations must be safe to call from several threads. A remote
+// store (S3 and the like) plugs in here; LocalArchiveStore keeps the
+// objects in a directory.
+class ArchiveStore {
+public:
+    virtual ~ArchiveStore() = default;
+
+    // Store data as name, replacing any object of that name
+    virtual bool put(const std::string& name, const std::vector<uint8_t>& data) = 0;
+
+    // Read the object name into data; false if there is none
+    virtual bool get(const std::string& name, std::vector<uint8_t>& data) = 0;
+
+    virtual bool remove(const std::string& name) = 0;
+
+    // Names of all objects
+    virtual std::vector<std::string> list() = 0;
+};
+
+// ArchiveStore on a local (or mounted) directory
+class LocalArchiveStore : public ArchiveStore {
+public:
+    // Throws std::runtime_error if directory cannot be created
+    explicit LocalArchiveStore(const std::string& directory);
+
+    bool put(const std::string& name, const std::vector<uint8_t>& data) override;
+    bool get(const std::string& name, std::vector<uint8_t>& data) override;
+    bool remove(const std::string& name) override;
+    std::vector<std::string> list() override;
+
+private:
+    std::string directory_;
+};
+
+// Local stand-in for an archived segment: NNNNNNNN.archived next to the
+// segment's indexes, which stay local
+struct ArchivedSegment {
+    static constexpr uint32_t MAGIC = 0x41514e4e;  // "NNQA"
+
+    uint32_t magic;
+    uint32_t reserved;
+    WALSegmentHeader header;  // Of the segment
+    uint64_t max_id;
+    uint64_t max_timestamp;
+    uint64_t end;             // Bytes archived: up to the last record
+};
+
+static_assert(sizeof(ArchivedSegment) == 64, "archive stubs are 64 bytes");
+
+struct TierPolicy {
+    uint64_t archive_after_ms = 24 * 3600 * 1000;  // Age of a segment's newest record
+    uint64_t cache_bytes = 1024 * 1024 * 1024;     // Fetched segments kept locally
+    std::string cache_directory;  // Default: archive-cache in the log directory
+};
+
+// Archive tier of a WAL directory
+//
+// archive_old_segments() moves sealed segments (those before the last one
+// with a record) whose newest record is older than archive_after_ms into
+// the store as LZ4-compressed objects named NNNNNNNN.wal.lz4, leaving an
+// ArchivedSegment stub and the indexes behind. SegmentManager and
+// LogReader given the tier treat archived segments as part of the log,
+// reading bounds from the stubs and fetching a segment through fetch()
+// only when a seek or read lands in it. Fetched segments live in a cache
+// directory bounded to cache_bytes, least recently used evicted first.
+class TieredStorage {
+public:
+    // Throws std::runtime_error if the cache directory cannot be created
+    TieredStorage(const std::string& log_directory, std::shared_ptr<ArchiveStore> store,
+                  const TierPolicy& policy = TierPolicy());
+
+    TieredStorage(const TieredStorage&) = delete;
+    TieredStorage& operator=(const TieredStorage&) = delete;
+
+    // Archive segments past archive_after_ms; returns the number archived
+    size_t archive_old_segments();
+
+    // Archive one local segment now; false on failure (it stays local)
+    bool archive_segment(uint32_t number, const std::string& path);
+
+    // Open a local copy of archived segment number, fetched into the cache
+    // if needed. The download, decompression and write run outside the
+    // cache lock; concurrent fetches of the same segment wait for the one
+    // in flight instead of downloading it again. The copy is opened before
+    // it can be evicted, so a later fetch may evict it but not pull it
+    // from under the caller. Returns a read-only fd for the caller to
+    // close, -1 if it cannot be fetched
+    int fetch(uint32_t number);
+
+    // Drop an archived segment: object, stub, cached copy and indexes
+    // The store and files are removed outside the cache lock
+    void remove(uint32_t number);
+
+    // Read a stub; false if path is not a valid one
+    static bool read_stub(const std::string& path, ArchivedSegment& stub);
+
+    static std::string object_name(uint32_t number);
+
+    const std::string& log_directory() const { return log_directory_; }
+    uint64_t cached_bytes() const;
+    uint64_t fetches() const;  // From the store, cache hits excluded
+
+private:
+    struct CacheEntry {
+        uint32_t number;
+        uint64_t size;
+    };
+
+    std::string stub_path(uint32_t number) const;
+    std::string cache_path(uint32_t number) const;
+    void evict(uint64_t incoming);  // mutex_ held
+
+    const std::string log_directory_;
+    const std::shared_ptr<ArchiveStore> store_;
+    const TierPolicy policy_;
+    std::string cache_directory_;
+
+    mutable std::mutex mutex_;
+    std::list<CacheEntry> lru_;  // Most recently used first
+    std::unordered_map<uint32_t, std::list<CacheEntry>::iterator> cached_;
+    uint64_t cached_bytes_;
+    uint64_t fetches_;
+    std::unordered_set<uint32_t> fetching_;  // Segments being downloaded or removed
+    std::condition_variable fetched_;        // One of fetching_ is done
+};
+
+}  // namespace nanomq
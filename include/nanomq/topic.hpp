@@ -0,0 +1,109 @@
+#pragma once
+
+#include "nanomq/broadcast_ring.hpp"
+#include "nanomq/elastic_queue.hpp"
+#include "nanomq/message.hpp"
+#include "nanomq/queue.hpp"
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace nanomq {
+
+// Ring buffer flavour backing a topic, chosen at construction
+enum class TopicMode : uint8_t {
+    SINGLE_PRODUCER,  // One publisher connection per topic (ElasticSPSCQueue)
+    MULTI_PRODUCER,   // Many publisher connections per topic (MPSCQueue)
+    CONSUMER_GROUP,   // Many publishers, work shared by group (MPMCQueue)
+    BROADCAST,        // One publisher, every subscription sees every
+                      // message (BroadcastRing with a cursor per reader)
+};
+
+// Topic management
+class Topic {
+public:
+    static constexpr size_t QUEUE_CAPACITY = 65536;
+
+    // capacity sizes the ring at runtime, and only the pages the ring
+    // actually fills are committed. Throws std::invalid_argument if the mode
+    // cannot honour capacity, see supports_capacity()
+    explicit Topic(const std::string& name,
+                   TopicMode mode = TopicMode::SINGLE_PRODUCER,
+                   size_t capacity = QUEUE_CAPACITY,
+                   SlowReaderPolicy slow_reader_policy =
+                       SlowReaderPolicy::BLOCK_PRODUCER);
+
+    // Whether a topic of mode can have a ring of capacity messages: any
+    // size for SINGLE_PRODUCER, a power of 2 for the MPSC/MPMC rings, and
+    // only QUEUE_CAPACITY for BROADCAST
+    static bool supports_capacity(TopicMode mode, size_t capacity);
+
+    const std::string& name() const { return name_; }
+    TopicMode mode() const { return mode_; }
+
+    // Add a message to the topic
+    // Returns false if the ring buffer is full
+    bool add_message(const Message& msg);
+
+    // Take the next message from the topic (not for BROADCAST topics)
+    // Only CONSUMER_GROUP topics may be polled from several threads; the
+    // others have a single reader, see claim_queue_reader()
+    // Returns false if no message is available
+    bool poll_message(Message& msg);
+
+    // Take up to max_count messages from the topic
+    // Returns number of messages written to messages
+    size_t poll_batch(Message* messages, size_t max_count);
+
+    // Become the one reader of a SINGLE_PRODUCER or MULTI_PRODUCER topic's
+    // queue; false if another one holds it. Always true for CONSUMER_GROUP
+    bool claim_queue_reader();
+    void release_queue_reader();
+
+    // Register a fan-out reader on a BROADCAST topic
+    // Returns the reader id, or -1 if the topic is not BROADCAST or full
+    int add_reader();
+    void remove_reader(int reader);
+
+    // Read up to max_count messages for a BROADCAST reader
+    size_t read_batch(int reader, Message* messages, size_t max_count);
+
+    // Whether a BROADCAST reader was cut loose (SlowReaderPolicy::DROP_READER)
+    bool is_reader_dropped(int reader) const;
+
+    // Resize a SINGLE_PRODUCER topic's ring window (publisher thread only)
+    // Shrinking a cold topic takes effect at its next wrap
+    void resize_queue(size_t capacity);
+
+    // Give unused ring pages back to the kernel (publisher thread only)
+    void trim();
+
+    // Get next message ID (safe to call from every producer)
+    uint64_t next_message_id() {
+        return message_id_counter_.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    // Continue ids after last_id, e.g. the highest one recovered from the
+    // WAL; never moves the counter back
+    void restore_message_id(uint64_t last_id) {
+        uint64_t current = message_id_counter_.load(std::memory_order_relaxed);
+        while (current < last_id &&
+               !message_id_counter_.compare_exchange_weak(current, last_id,
+                                                          std::memory_order_relaxed)) {
+        }
+    }
+
+private:
+    std::string name_;
+    TopicMode mode_;
+    std::atomic<uint64_t> message_id_counter_;
+    std::atomic<bool> queue_reader_;  // Single-consumer queue is claimed
+
+    // Exactly one of these is allocated, depending on mode_
+    std::unique_ptr<ElasticSPSCQueue<Message>> spsc_queue_;
+    std::unique_ptr<MPSCQueue<Message, QUEUE_CAPACITY>> mpsc_queue_;
+    std::unique_ptr<MPMCQueue<Message, QUEUE_CAPACITY>> mpmc_queue_;
+    std::unique_ptr<BroadcastRing<Message, QUEUE_CAPACITY>> broadcast_ring_;
+};
+
+}  // namespace nanomq
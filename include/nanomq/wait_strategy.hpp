@@ -0,0 +1,233 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+#endif
+
+namespace nanomq {
+
+// CPU pause instruction (platform-independent)
+inline void cpu_pause() {
+#if defined(__x86_64__) || defined(_M_X64)
+    __builtin_ia32_pause();  // x86 PAUSE
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    __asm__ __volatile__("yield");  // ARM YIELD
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+// Pause 2^attempt times (capped at 2^MAX_BACKOFF_SHIFT)
+constexpr uint32_t MAX_BACKOFF_SHIFT = 10;
+
+inline void backoff_pause(uint32_t attempt) {
+    const uint32_t shift = attempt < MAX_BACKOFF_SHIFT ? attempt : MAX_BACKOFF_SHIFT;
+    for (uint32_t i = 0; i < (1u << shift); ++i) {
+        cpu_pause();
+    }
+}
+
+// Wait strategies for queue consumers
+//
+// A strategy is a policy type plugged into a queue (see SPSCQueue's third
+// template parameter). The consumer calls wait_until(ready, timeout_ns),
+// which returns true once ready() does and false on timeout; the producer
+// calls notify() after every publish. Only FutexParkWait keeps any state,
+// so notify() is a no-op for the others and costs nothing on the hot path.
+
+namespace detail {
+
+inline uint64_t wait_clock_ns() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+// Only read the clock every few hundred polls
+constexpr uint32_t CLOCK_CHECK_INTERVAL = 256;
+
+}  // namespace detail
+
+// Spin on PAUSE; lowest wake latency, burns a full core while idle
+struct BusySpinWait {
+    template <typename Ready>
+    bool wait_until(Ready&& ready, uint64_t timeout_ns) {
+        const uint64_t deadline = detail::wait_clock_ns() + timeout_ns;
+        for (uint32_t i = 1;; ++i) {
+            if (ready()) {
+                return true;
+            }
+            if (i % detail::CLOCK_CHECK_INTERVAL == 0 &&
+                detail::wait_clock_ns() >= deadline) {
+                return false;
+            }
+            cpu_pause();
+        }
+    }
+
+    void notify() {}
+};
+
+// Spin briefly, then yield the CPU between polls
+struct SpinYieldWait {
+    static constexpr uint32_t SPIN_LIMIT = 1000;
+
+    template <typename Ready>
+    bool wait_until(Ready&& ready, uint64_t timeout_ns) {
+        const uint64_t deadline = detail::wait_clock_ns() + timeout_ns;
+        for (uint32_t i = 1;; ++i) {
+            if (ready()) {
+                return true;
+            }
+            if (i < SPIN_LIMIT) {
+                cpu_pause();
+                continue;
+            }
+            if (detail::wait_clock_ns() >= deadline) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    void notify() {}
+};
+
+// Exponential backoff: 1, 2, 4 ... 1024 pauses between polls, then sleep in
+// growing steps up to MAX_SLEEP_NS
+struct BackoffWait {
+    static constexpr uint64_t MAX_SLEEP_NS = 100000;
+
+    template <typename Ready>
+    bool wait_until(Ready&& ready, uint64_t timeout_ns) {
+        const uint64_t deadline = detail::wait_clock_ns() + timeout_ns;
+        uint64_t sleep_ns = 1000;
+        for (uint32_t attempt = 0;; ++attempt) {
+            if (ready()) {
+                return true;
+            }
+            if (attempt <= MAX_BACKOFF_SHIFT) {
+                backoff_pause(attempt);
+                continue;
+            }
+            const uint64_t now = detail::wait_clock_ns();
+            if (now >= deadline) {
+                return false;
+            }
+            const uint64_t remaining = deadline - now;
+            std::this_thread::sleep_for(std::chrono::nanoseconds(
+                sleep_ns < remaining ? sleep_ns : remaining));
+            sleep_ns = (sleep_ns * 2 < MAX_SLEEP_NS) ? sleep_ns * 2 : MAX_SLEEP_NS;
+        }
+    }
+
+    void notify() {}
+};
+
+// Spin briefly, then park on a futex; no CPU while idle, microsecond wakes
+//
+// The consumer announces itself in parked_ before its final ready() check,
+// and the producer checks parked_ after publishing (both behind a seq_cst
+// fence), so either the consumer sees the item or the producer sees the
+// waiter. notify() costs a fence and a relaxed load unless someone is
+// parked; only then does it pay for the FUTEX_WAKE syscall.
+//
+// ProcessShared selects the shared futex ops so the strategy also works
+// when it lives in memory mapped by two processes (see shm_transport.hpp).
+template <bool ProcessShared>
+class BasicFutexParkWait {
+public:
+    static constexpr uint32_t SPIN_LIMIT = 2000;
+
+    BasicFutexParkWait() : sequence_(0), parked_(0) {}
+
+    template <typename Ready>
+    bool wait_until(Ready&& ready, uint64_t timeout_ns) {
+        // On a single CPU the producer cannot run while we spin
+        static const uint32_t spin_limit =
+            std::thread::hardware_concurrency() > 1 ? SPIN_LIMIT : 0;
+        for (uint32_t i = 0; i < spin_limit; ++i) {
+            if (ready()) {
+                return true;
+            }
+            cpu_pause();
+        }
+
+        const uint64_t deadline = detail::wait_clock_ns() + timeout_ns;
+        for (;;) {
+            const uint32_t seq = sequence_.load(std::memory_order_acquire);
+            parked_.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (ready()) {
+                parked_.store(0, std::memory_order_relaxed);
+                return true;
+            }
+
+            const uint64_t now = detail::wait_clock_ns();
+            if (now >= deadline) {
+                parked_.store(0, std::memory_order_relaxed);
+                return false;
+            }
+            park(seq, deadline - now);
+            parked_.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked_.load(std::memory_order_relaxed) != 0) {
+            sequence_.fetch_add(1, std::memory_order_release);
+            wake();
+        }
+    }
+
+private:
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+#ifdef __linux__
+    static constexpr int WAIT_OP = ProcessShared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE;
+    static constexpr int WAKE_OP = ProcessShared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE;
+#endif
+
+    void park(uint32_t seq, uint64_t timeout_ns) {
+#ifdef __linux__
+        struct timespec ts;
+        ts.tv_sec = static_cast<time_t>(timeout_ns / 1000000000ULL);
+        ts.tv_nsec = static_cast<long>(timeout_ns % 1000000000ULL);
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&sequence_),
+                WAIT_OP, seq, &ts, nullptr, 0);
+#else
+        (void)seq;
+        std::this_thread::sleep_for(std::chrono::nanoseconds(
+            timeout_ns < 50000 ? timeout_ns : 50000));
+#endif
+    }
+
+    void wake() {
+#ifdef __linux__
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&sequence_),
+                WAKE_OP, 1, nullptr, nullptr, 0);
+#endif
+    }
+
+    // Own cache line: the producer reads parked_ on every notify()
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> sequence_;  // Futex word
+    std::atomic<uint32_t> parked_;  // Consumer is (about to be) asleep
+};
+
+using FutexParkWait = BasicFutexParkWait<false>;
+using SharedFutexParkWait = BasicFutexParkWait<true>;
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "futex word must be a plain 32-bit integer");
+
+}  // namespace nanomq
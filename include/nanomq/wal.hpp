@@ -0,0 +1,235 @@
+#pragma once
+
+#include "nanomq/message.hpp"
+#include "nanomq/protocol.hpp"
+#include <sys/uio.h>
+#include <cstdlib>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace nanomq {
+
+// When the WAL flusher fsyncs
+struct WALSyncPolicy {
+    enum Mode : uint8_t {
+        ALWAYS,    // Before append() returns (concurrent appends share an fsync)
+        INTERVAL,  // Every interval_ms
+        BYTES,     // Once bytes have accumulated since the last fsync
+        NEVER,     // Only on flush()/wait_durable(); writes go to the page cache
+    };
+
+    Mode mode;
+    uint64_t interval_ms;
+    uint64_t bytes;
+
+    static WALSyncPolicy always() { return WALSyncPolicy{ALWAYS, 0, 0}; }
+    static WALSyncPolicy every_ms(uint64_t ms) { return WALSyncPolicy{INTERVAL, ms, 0}; }
+    static WALSyncPolicy every_bytes(uint64_t n) { return WALSyncPolicy{BYTES, 0, n}; }
+    static WALSyncPolicy never() { return WALSyncPolicy{NEVER, 0, 0}; }
+};
+
+// How the WAL flusher talks to the disk
+enum class WALIoBackend : uint8_t {
+    SYSCALLS,  // write() and fdatasync() from the flusher thread
+    IO_URING,  // Linked write->fdatasync submissions on registered buffers
+               // and files, several batches in flight; falls back to
+               // SYSCALLS where io_uring is unavailable
+};
+
+// How segment files are written
+enum class WALWriteMode : uint8_t {
+    BUFFERED,  // Through the page cache
+    DIRECT,    // O_DIRECT in whole pages into preallocated segments
+};
+
+class IoUring;
+class SegmentIndexWriter;
+
+// Write-Ahead Log for durability
+//
+// The log is a directory of numbered segment files (00000001.wal, ...).
+// A segment starts with a WALSegmentHeader whose base id and timestamp are
+// those of its first message; each record after it is
+//   varint record length, compact message (see protocol.hpp)
+// with id and timestamp encoded as deltas against the segment base.
+//
+// Appends are group-committed: append() encodes the record into a staged
+// buffer under a short lock and returns its log sequence number (LSN, 1 for
+// the first record). A flusher thread swaps the staged buffer out, writes
+// it and fsyncs according to the WALSyncPolicy, then publishes the durable
+// LSN that wait_durable() blocks on. append() may be called from several
+// threads.
+//
+// In WALWriteMode::DIRECT segments are fallocate()d to SEGMENT_SIZE and
+// written with O_DIRECT from page-aligned buffers. A batch ending inside a
+// page is padded with zeros, and that page is written again, with the
+// records that follow, by the next batch; a record length of 0 marks the
+// end of the records in a segment. With IO_URING a batch's write is only
+// submitted once the previous one has completed, since io_uring does not
+// order them and the older, padded copy of the shared page must not land
+// last. The flusher creates the next segment ahead of time so switching
+// segments is a rename.
+//
+// Each segment gets a sparse .index and .timeindex (see segment.hpp),
+// filled in as records are appended.
+class WAL {
+public:
+    static constexpr size_t SEGMENT_SIZE = 100 * 1024 * 1024;  // 100MB
+    static constexpr size_t WRITE_BUFFER_SIZE = 64 * 1024;
+    static constexpr size_t DIRECT_ALIGNMENT = 4096;  // O_DIRECT offsets and sizes
+
+    // Open the log in directory (created if missing); appends go to a new
+    // segment after any existing ones. Throws std::runtime_error on failure.
+    explicit WAL(const std::string& directory,
+                 WALSyncPolicy policy = WALSyncPolicy::every_ms(10),
+                 WALIoBackend backend = WALIoBackend::SYSCALLS,
+                 WALWriteMode write_mode = WALWriteMode::BUFFERED);
+    ~WAL();
+
+    WAL(const WAL&) = delete;
+    WAL& operator=(const WAL&) = delete;
+
+    // Append a message; returns its LSN, 0 after a write error
+    // With WALSyncPolicy::ALWAYS it returns once the record is durable
+    uint64_t append(const Message& msg);
+
+    // Block until every record up to lsn is on disk, syncing now if the
+    // policy would not soon. Returns false after a write error
+    bool wait_durable(uint64_t lsn);
+
+    // Write and fsync everything appended so far
+    bool flush();
+
+    // Start a new segment with the next append
+    void rotate();
+
+    // Visit every record of every segment in order; msg.data is only valid
+    // during the call. Stops at the first truncated or corrupt record of a
+    // segment. Returns the number of messages visited.
+    size_t replay(const std::function<void(const Message&)>& visit) const;
+
+    const std::string& directory() const { return directory_; }
+
+    // Backend in use (SYSCALLS if IO_URING was asked for but unavailable)
+    WALIoBackend io_backend() const {
+        return ring_ ? WALIoBackend::IO_URING : WALIoBackend::SYSCALLS;
+    }
+
+    WALWriteMode write_mode() const { return write_mode_; }
+
+    // Bytes of records appended so far, headers included
+    uint64_t bytes_written() const;
+
+    // LSN of the last appended record, and of the last one known durable
+    uint64_t last_lsn() const;
+    uint64_t durable_lsn() const;
+
+private:
+    // Staged bytes from offset on belong to the segment open as fd
+    struct SegmentStart {
+        size_t offset;
+        int fd;
+    };
+
+    // Staged buffers are page aligned for O_DIRECT
+    template <typename T>
+    struct PageAllocator {
+        using value_type = T;
+
+        PageAllocator() = default;
+        template <typename U>
+        PageAllocator(const PageAllocator<U>&) {}
+
+        T* allocate(size_t n) {
+            void* ptr = nullptr;
+            if (posix_memalign(&ptr, DIRECT_ALIGNMENT, n * sizeof(T)) != 0) {
+                throw std::bad_alloc();
+            }
+            return static_cast<T*>(ptr);
+        }
+        void deallocate(T* ptr, size_t) { free(ptr); }
+
+        bool operator==(const PageAllocator&) const { return true; }
+        bool operator!=(const PageAllocator&) const { return false; }
+    };
+    using Buffer = std::vector<uint8_t, PageAllocator<uint8_t>>;
+
+    using SyncClock = std::chrono::steady_clock;
+
+    bool open_segment(const Message& first);
+    int create_segment_file(const std::string& path) const;
+    std::string spare_segment_path() const;
+    void prepare_spare_segment(std::unique_lock<std::mutex>& lock);
+    size_t staged_bytes() const { return staged_.size() - staged_carry_; }
+    void run_flusher();
+    void run_uring_flusher();
+    bool setup_uring();
+    bool sync_due(SyncClock::time_point next_sync) const;
+    bool flusher_ready(SyncClock::time_point next_sync) const;
+    void wait_for_work(std::unique_lock<std::mutex>& lock, SyncClock::time_point& next_sync);
+    uint64_t take_staged(Buffer& buffer, std::vector<SegmentStart>& segments,
+                         bool sync, SyncClock::time_point& next_sync);
+    std::vector<std::string> segment_paths() const;
+
+    std::string directory_;
+    const WALSyncPolicy policy_;
+    const WALWriteMode write_mode_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable flusher_wakeup_;  // Work for the flusher
+    std::condition_variable durable_changed_;
+
+    // Appender side, guarded by mutex_
+    uint32_t next_segment_;
+    size_t offset_;  // Bytes in the current segment, staged ones included
+    bool segment_open_;
+    EncodingBase base_;
+    std::unique_ptr<SegmentIndexWriter> index_;  // Of the current segment
+    Buffer staged_;
+    size_t staged_carry_;  // Head of staged_ already written once (DIRECT)
+    std::vector<SegmentStart> staged_segments_;
+    uint64_t bytes_written_;
+    uint64_t last_lsn_;
+    uint64_t sync_requested_lsn_;  // Someone waits for this LSN
+    bool stopping_;
+    int spare_fd_;       // Next segment, created ahead (DIRECT)
+    bool spare_wanted_;  // The flusher should create it
+
+    // Flusher side, guarded by mutex_
+    uint64_t durable_lsn_;
+    uint64_t sync_covered_lsn_;  // Covered by a finished or pending fsync
+    uint64_t unsynced_bytes_;    // Handed to the disk since the last fsync
+    bool failed_;
+
+    int fd_;  // Segment being written; flusher only after construction
+    uint64_t file_offset_;  // Write position in fd_
+    std::unique_ptr<IoUring> ring_;
+    std::vector<Buffer> spare_buffers_;  // io_uring batches
+    std::vector<struct iovec> registered_buffers_;  // As first allocated
+    std::thread flusher_;
+};
+
+// On-disk header at the start of every segment
+struct WALSegmentHeader {
+    static constexpr uint32_t MAGIC = 0x574d514e;  // "NQMW"
+    static constexpr uint32_t VERSION = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint64_t base_id;
+    uint64_t base_timestamp;
+    uint64_t reserved;
+};
+
+static_assert(sizeof(WALSegmentHeader) == 32, "WAL segment header is 32 bytes");
+
+}  // namespace nanomq
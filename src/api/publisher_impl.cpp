@@ -1,5 +1,10 @@
 #include "nanomq/publisher.hpp"
 #include "nanomq/message.hpp"
+#include "nanomq/protocol.hpp"
+#include "nanomq/record_batch.hpp"
+#include "nanomq/shm_transport.hpp"
+#include <unordered_map>
+#include <vector>
 
 namespace nanomq {
 
@@ -8,7 +13,13 @@ class Publisher::Impl {
 public:
     explicit Impl(const std::string& broker_address)
         : broker_address_(broker_address), connected_(false),
-          messages_sent_(0), bytes_sent_(0), messages_failed_(0) {
+          compression_threshold_(0), messages_sent_(0), bytes_sent_(0),
+          messages_failed_(0) {
+        if (parse_shm_address(broker_address_, shm_name_)) {
+            // Channels are opened per topic on first publish
+            connected_ = true;
+            return;
+        }
         // TODO: Connect to broker
     }
 
@@ -17,6 +28,12 @@ public:
     }
 
     uint64_t publish(const std::string& topic, const void* data, size_t size) {
+        if (!shm_name_.empty()) {
+            if (compression_threshold_ > 0 && size >= compression_threshold_) {
+                return publish_batch(topic, &data, &size, 1) == 1 ? messages_sent_ : 0;
+            }
+            return publish_shm(topic, data, size);
+        }
         // TODO: Send message to broker
         (void)topic;
         (void)data;
@@ -25,15 +42,139 @@ public:
         return messages_sent_;
     }
 
+    size_t publish_batch(const std::string& topic, const void** data_array,
+                         const size_t* size_array, size_t count) {
+        size_t total = 0;
+        for (size_t i = 0; i < count; ++i) {
+            total += size_array[i];
+        }
+        const bool compress = compression_threshold_ > 0 && total >= compression_threshold_;
+        if (!shm_name_.empty() && (count > 1 || compress)) {
+            return publish_records_shm(topic, data_array, size_array, count, compress);
+        }
+
+        size_t published = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (publish(topic, data_array[i], size_array[i]) > 0) {
+                published++;
+            }
+        }
+        return published;
+    }
+
     void flush() {
         // TODO: Flush buffered messages
     }
 
+    void set_compression_threshold(size_t threshold) {
+        compression_threshold_ = threshold;
+    }
+
     bool is_connected() const { return connected_; }
 
 private:
+    // Write the message straight into the topic's shared-memory ring
+    uint64_t publish_shm(const std::string& topic, const void* data,
+                         size_t size) {
+        ShmChannel* channel = shm_channel(topic);
+        if (channel == nullptr || size > channel->ring().max_payload()) {
+            messages_failed_++;
+            return 0;
+        }
+
+        MessageHeader header;
+        header.id = messages_sent_ + 1;
+        header.timestamp = get_timestamp_ns();
+        header.size = static_cast<uint32_t>(size);
+        header.crc32 = Message::calculate_crc32c(data, size);
+        header.flags = MSG_FLAG_CRC32C;
+        if (!write_shm(channel, header, data)) {
+            messages_failed_++;
+            return 0;
+        }
+        messages_sent_++;
+        bytes_sent_ += size;
+        return header.id;
+    }
+
+    // Send the batch as record batches (see record_batch.hpp), as many
+    // messages per ring record as fit; with compress each batch's records
+    // travel LZ4-compressed where that makes it smaller
+    size_t publish_records_shm(const std::string& topic, const void** data_array,
+                               const size_t* size_array, size_t count, bool compress) {
+        ShmChannel* channel = shm_channel(topic);
+        if (channel == nullptr) {
+            messages_failed_ += count;
+            return 0;
+        }
+        records_.set_max_bytes(channel->ring().max_payload());
+
+        size_t published = 0;
+        while (published < count) {
+            const uint64_t timestamp = Clock::coarse_now_ns();
+            records_.clear();
+            size_t next = published;
+            while (next < count &&
+                   records_.add(messages_sent_ + records_.count() + 1, timestamp,
+                                data_array[next], size_array[next])) {
+                ++next;
+            }
+            if (records_.is_empty()) {
+                // Too large for a batch: send it on its own (or fail)
+                if (publish_shm(topic, data_array[next], size_array[next]) == 0) {
+                    messages_failed_ += count - next - 1;
+                    return published;
+                }
+                published++;
+                continue;
+            }
+
+            const Message batch = records_.finish(compress);
+            if (!write_shm(channel, batch.header, batch.data)) {
+                messages_failed_ += count - published;
+                return published;
+            }
+            messages_sent_ += records_.count();
+            bytes_sent_ += batch.header.size;
+            published = next;
+        }
+        return published;
+    }
+
+    bool write_shm(ShmChannel* channel, const MessageHeader& header,
+                   const void* payload) {
+        if (!channel->ring().try_write(header, payload)) {
+            // Full ring: the broker is behind, or gone
+            if (!channel->broker_alive()) {
+                connected_ = false;
+                shm_channels_.clear();
+            }
+            return false;
+        }
+        return true;
+    }
+
+    ShmChannel* shm_channel(const std::string& topic) {
+        auto it = shm_channels_.find(topic);
+        if (it != shm_channels_.end()) {
+            return it->second.get();
+        }
+        auto channel = ShmChannel::connect(shm_name_, topic, ShmDirection::PUBLISH);
+        connected_ = (channel != nullptr);
+        if (!channel) {
+            return nullptr;
+        }
+        return (shm_channels_[topic] = std::move(channel)).get();
+    }
+
     std::string broker_address_;
+    std::string shm_name_;  // Set for shm:// addresses
+    std::unordered_map<std::string, std::unique_ptr<ShmChannel>> shm_channels_;
     bool connected_;
+    size_t compression_threshold_;  // 0 = off
+
+    MessageBatch records_;  // Batch being built by publish_records_shm
+
     uint64_t messages_sent_;
     uint64_t bytes_sent_;
     uint64_t messages_failed_;
@@ -56,13 +197,7 @@ uint64_t Publisher::publish(const std::string& topic, const void* data,
 size_t Publisher::publish_batch(const std::string& topic,
                                const void** data_array,
                                const size_t* size_array, size_t count) {
-    size_t published = 0;
-    for (size_t i = 0; i < count; ++i) {
-        if (publish(topic, data_array[i], size_array[i]) > 0) {
-            published++;
-        }
-    }
-    return published;
+    return impl_->publish_batch(topic, data_array, size_array, count);
 }
 
 uint64_t Publisher::publish_message(const std::string& topic,
@@ -73,8 +208,7 @@ uint64_t Publisher::publish_message(const std::string& topic,
 void Publisher::flush() { impl_->flush(); }
 
 void Publisher::set_compression_threshold(size_t threshold) {
-    (void)threshold;
-    // TODO: Implement
+    impl_->set_compression_threshold(threshold);
 }
 
 void Publisher::set_batching_enabled(bool enabled) {
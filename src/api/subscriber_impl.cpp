@@ -1,5 +1,10 @@
 #include "nanomq/subscriber.hpp"
 #include "nanomq/message.hpp"
+#include "nanomq/record_batch.hpp"
+#include "nanomq/segment.hpp"
+#include "nanomq/shm_transport.hpp"
+#include <chrono>
+#include <thread>
 
 namespace nanomq {
 
@@ -8,7 +13,18 @@ class Subscriber::Impl {
 public:
     Impl(const std::string& broker_address, const std::string& consumer_group)
         : broker_address_(broker_address), consumer_group_(consumer_group),
-          connected_(false), messages_received_(0), position_(0) {
+          connected_(false), messages_received_(0), position_(0),
+          next_channel_(0), records_channel_(nullptr),
+          log_min_id_(0), log_min_timestamp_(0) {
+        if (parse_shm_address(broker_address_, shm_name_)) {
+            connected_ = true;  // Channels are opened by subscribe()
+            return;
+        }
+        if (broker_address_.compare(0, LOG_PREFIX_LENGTH, LOG_PREFIX) == 0) {
+            log_ = std::make_unique<LogReader>(broker_address_.substr(LOG_PREFIX_LENGTH));
+            connected_ = true;
+            return;
+        }
         // TODO: Connect to broker
     }
 
@@ -17,12 +33,63 @@ public:
     }
 
     bool subscribe(const std::string& topic) {
+        if (log_) {
+            return true;  // A log holds what was written to it, any topic
+        }
+        if (!shm_name_.empty()) {
+            auto channel = ShmChannel::connect(shm_name_, topic,
+                                               ShmDirection::SUBSCRIBE);
+            if (!channel) {
+                return false;
+            }
+            shm_topics_.push_back(topic);
+            shm_channels_.push_back(std::move(channel));
+            return true;
+        }
         // TODO: Send subscribe request to broker
         (void)topic;
         return true;
     }
 
+    bool unsubscribe(const std::string& topic) {
+        for (size_t i = 0; i < shm_topics_.size(); ++i) {
+            if (shm_topics_[i] == topic) {
+                if (records_channel_ == shm_channels_[i].get()) {
+                    records_ = RecordBatchReader();  // Its ring goes away
+                }
+                shm_topics_.erase(shm_topics_.begin() + i);
+                shm_channels_.erase(shm_channels_.begin() + i);
+                next_channel_ = 0;
+                return true;
+            }
+        }
+        // TODO: Send unsubscribe request to broker
+        return shm_name_.empty();
+    }
+
+    // Give back the ring space of messages returned by earlier polls
+    void release_delivered() {
+        // Records of a batch still being handed out point into the ring
+        if (records_.remaining() == 0) {
+            for (auto& channel : shm_channels_) {
+                channel->ring().release();
+            }
+        }
+        // Keep the buffer behind records of a batch not yet handed out
+        const size_t keep = records_.remaining() > 0 ? 1 : 0;
+        while (raw_buffers_.size() > keep) {
+            spare_buffers_.push_back(std::move(raw_buffers_.front()));
+            raw_buffers_.erase(raw_buffers_.begin());
+        }
+    }
+
     Message poll(uint64_t timeout_us) {
+        if (!shm_name_.empty()) {
+            return poll_shm(timeout_us);
+        }
+        if (log_) {
+            return poll_log(timeout_us);
+        }
         // TODO: Poll for messages from broker
         (void)timeout_us;
         return Message{};
@@ -33,15 +100,173 @@ public:
         position_ = message_id;
     }
 
+    // Only a log can be replayed; a ring holds just what is in flight.
+    // A seek may land on a batch; its records before the target are skipped
+    bool seek(uint64_t message_id) {
+        if (!log_ || !log_->seek(message_id)) {
+            return false;
+        }
+        drop_log_batch();
+        log_min_id_ = message_id;
+        return true;
+    }
+    bool seek_to_timestamp(uint64_t timestamp_ns) {
+        if (!log_ || !log_->seek_to_timestamp(timestamp_ns)) {
+            return false;
+        }
+        drop_log_batch();
+        log_min_timestamp_ = timestamp_ns;
+        return true;
+    }
+
     bool is_connected() const { return connected_; }
     uint64_t position() const { return position_; }
 
 private:
+    // Read the next message in place from any subscribed ring
+    Message poll_shm(uint64_t timeout_us) {
+        Message msg;
+        if (records_.next(msg)) {
+            messages_received_++;
+            return msg;
+        }
+        if (shm_channels_.empty()) {
+            return Message{};
+        }
+        const auto deadline = std::chrono::steady_clock::now() +
+                              std::chrono::microseconds(timeout_us);
+        for (;;) {
+            for (size_t i = 0; i < shm_channels_.size(); ++i) {
+                // Round-robin so one busy topic cannot starve the rest
+                const size_t channel = next_channel_;
+                ShmRing& ring = shm_channels_[channel]->ring();
+                next_channel_ = (next_channel_ + 1) % shm_channels_.size();
+                if (ring.try_read(msg)) {
+                    if (msg.has_flag(MSG_FLAG_BATCH)) {
+                        if (!start_batch(msg) || !records_.next(msg)) {
+                            continue;  // Corrupt or empty batch: skip it
+                        }
+                        records_channel_ = shm_channels_[channel].get();
+                    }
+                    messages_received_++;
+                    return msg;
+                }
+            }
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= deadline) {
+                return Message{};
+            }
+            if (shm_channels_.size() == 1) {
+                // Park on the ring's doorbell until the broker publishes
+                shm_channels_[0]->ring().wait(static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        deadline - now).count()));
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Read the next message of the log, waiting for the WAL to write more;
+    // batch records are unpacked like those from a ring
+    Message poll_log(uint64_t timeout_us) {
+        Message msg;
+        const auto deadline = std::chrono::steady_clock::now() +
+                              std::chrono::microseconds(timeout_us);
+        for (;;) {
+            if (!records_.next(msg)) {
+                if (!log_->next(msg)) {
+                    if (std::chrono::steady_clock::now() >= deadline) {
+                        return Message{};
+                    }
+                    std::this_thread::sleep_for(
+                        std::chrono::microseconds(LOG_POLL_INTERVAL_US));
+                    continue;
+                }
+                if (msg.has_flag(MSG_FLAG_BATCH) && msg.has_flag(MSG_FLAG_COMPRESSED)) {
+                    start_batch(msg);  // Expanded into a buffer of its own
+                    continue;          // A corrupt batch is skipped
+                }
+                // The reader's buffer moves on with the next record; keep a
+                // copy until the message is released like expanded batches
+                std::vector<uint8_t> payload = take_buffer();
+                payload.assign(msg.data, msg.data + msg.header.size);
+                msg.data = payload.data();
+                raw_buffers_.push_back(std::move(payload));
+                if (msg.has_flag(MSG_FLAG_BATCH)) {
+                    records_.reset(msg);  // A corrupt batch is skipped
+                    continue;
+                }
+            }
+            // Records of the batch a seek landed on that precede its target
+            if (msg.header.id < log_min_id_ || msg.header.timestamp < log_min_timestamp_) {
+                continue;
+            }
+            log_min_id_ = 0;
+            log_min_timestamp_ = 0;
+            messages_received_++;
+            return msg;
+        }
+    }
+
+    // Forget the batch being handed out from the log before a seek
+    void drop_log_batch() {
+        records_ = RecordBatchReader();
+        log_min_id_ = 0;
+        log_min_timestamp_ = 0;
+    }
+
+    // Hand out the records of a batch next; those of a compressed one are
+    // expanded into a buffer kept until they are released
+    bool start_batch(const Message& batch) {
+        if (!batch.has_flag(MSG_FLAG_COMPRESSED)) {
+            return records_.reset(batch);
+        }
+        std::vector<uint8_t> records = take_buffer();
+        if (!records_.reset(batch, records)) {
+            spare_buffers_.push_back(std::move(records));
+            return false;
+        }
+        raw_buffers_.push_back(std::move(records));  // Moving keeps the bytes in place
+        return true;
+    }
+
+    std::vector<uint8_t> take_buffer() {
+        std::vector<uint8_t> buffer;
+        if (!spare_buffers_.empty()) {
+            buffer = std::move(spare_buffers_.back());
+            spare_buffers_.pop_back();
+        }
+        return buffer;
+    }
+
+    static constexpr const char* LOG_PREFIX = "file://";
+    static constexpr size_t LOG_PREFIX_LENGTH = 7;
+    static constexpr uint64_t LOG_POLL_INTERVAL_US = 100;
+
     std::string broker_address_;
     std::string consumer_group_;
     bool connected_;
     uint64_t messages_received_;
     uint64_t position_;
+
+    std::string shm_name_;  // Set for shm:// addresses
+    std::vector<std::string> shm_topics_;
+    std::vector<std::unique_ptr<ShmChannel>> shm_channels_;
+    size_t next_channel_;
+
+    // Buffers that delivered messages point into (copied log records and
+    // expanded batches); they return to spare_buffers_ once released
+    std::vector<std::vector<uint8_t>> raw_buffers_;
+    std::vector<std::vector<uint8_t>> spare_buffers_;
+
+    // Record batch being handed out, read in place from a ring or the log
+    RecordBatchReader records_;
+    ShmChannel* records_channel_;
+
+    std::unique_ptr<LogReader> log_;  // Set for file:// addresses
+    uint64_t log_min_id_;             // Skip messages below these after a seek
+    uint64_t log_min_timestamp_;
 };
 
 // Subscriber API implementation
@@ -59,12 +284,11 @@ bool Subscriber::subscribe(const std::string& topic) {
 }
 
 bool Subscriber::unsubscribe(const std::string& topic) {
-    (void)topic;
-    // TODO: Implement
-    return true;
+    return impl_->unsubscribe(topic);
 }
 
 Message Subscriber::poll(uint64_t timeout_us) {
+    impl_->release_delivered();
     return impl_->poll(timeout_us);
 }
 
@@ -72,9 +296,11 @@ std::vector<Message> Subscriber::poll_batch(size_t max_msgs,
                                             uint64_t timeout_us) {
     std::vector<Message> messages;
     messages.reserve(max_msgs);
+    impl_->release_delivered();
     
     for (size_t i = 0; i < max_msgs; ++i) {
-        Message msg = poll(timeout_us);
+        // Only wait for the first message; return what is ready after that
+        Message msg = impl_->poll(i == 0 ? timeout_us : 0);
         if (msg.header.id == 0) {
             break;
         }
@@ -93,15 +319,11 @@ void Subscriber::commit_batch(const std::vector<uint64_t>& message_ids) {
 }
 
 bool Subscriber::seek(uint64_t message_id) {
-    (void)message_id;
-    // TODO: Implement
-    return true;
+    return impl_->seek(message_id);
 }
 
 bool Subscriber::seek_to_timestamp(uint64_t timestamp_ns) {
-    (void)timestamp_ns;
-    // TODO: Implement
-    return true;
+    return impl_->seek_to_timestamp(timestamp_ns);
 }
 
 bool Subscriber::is_connected() const { return impl_->is_connected(); }
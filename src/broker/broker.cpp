@@ -1,5 +1,7 @@
 #include "nanomq/message.hpp"
-#include "nanomq/queue.hpp"
+#include "nanomq/subscription.hpp"
+#include "nanomq/topic.hpp"
+#include <vector>
 #include <string>
 #include <unordered_map>
 #include <memory>
@@ -12,40 +14,78 @@ public:
     Broker() {}
 
     // Create a new topic
-    bool create_topic(const std::string& name) {
-        // TODO: Create topic with ring buffer
-        (void)name;
+    // Topics written by several publisher connections need MULTI_PRODUCER.
+    // Returns false if the topic exists or mode cannot have a ring of
+    // capacity messages (see Topic::supports_capacity())
+    bool create_topic(const std::string& name,
+                      TopicMode mode = TopicMode::MULTI_PRODUCER,
+                      size_t capacity = Topic::QUEUE_CAPACITY) {
+        if (topics_.count(name) != 0 || !Topic::supports_capacity(mode, capacity)) {
+            return false;
+        }
+        topics_.emplace(name, std::make_unique<Topic>(name, mode, capacity));
         return true;
     }
 
     // Delete a topic
     bool delete_topic(const std::string& name) {
-        // TODO: Delete topic and cleanup
-        (void)name;
+        auto it = topics_.find(name);
+        if (it == topics_.end()) {
+            return false;
+        }
+        // Drop subscriptions that point at the topic
+        for (size_t i = 0; i < subscriptions_.size();) {
+            if (subscriptions_[i]->topic() == name) {
+                subscriptions_[i] = std::move(subscriptions_.back());
+                subscriptions_.pop_back();
+            } else {
+                ++i;
+            }
+        }
+        topics_.erase(it);
         return true;
     }
 
     // Publish a message to a topic
     bool publish(const std::string& topic, const Message& msg) {
-        // TODO: Route message to topic's ring buffer
-        (void)topic;
-        (void)msg;
-        return true;
+        auto it = topics_.find(topic);
+        if (it == topics_.end()) {
+            return false;
+        }
+        return it->second->add_message(msg);
     }
 
     // Subscribe to a topic
-    bool subscribe(const std::string& topic, const std::string& consumer_group) {
-        // TODO: Register consumer for topic
-        (void)topic;
-        (void)consumer_group;
-        return true;
+    // Group members all pull from the topic's shared ring, which must have
+    // been created with TopicMode::CONSUMER_GROUP; plain subscriptions on a
+    // BROADCAST topic each get their own cursor. Other topics have a
+    // single-consumer queue: a second plain subscription is refused (nullptr)
+    // while the first exists, since both would race on it
+    Subscription* subscribe(const std::string& topic,
+                            const std::string& consumer_group) {
+        auto it = topics_.find(topic);
+        if (it == topics_.end()) {
+            return nullptr;
+        }
+        if (!consumer_group.empty() &&
+            it->second->mode() != TopicMode::CONSUMER_GROUP) {
+            return nullptr;
+        }
+        auto subscription =
+            std::make_unique<Subscription>(*it->second, consumer_group);
+        if (!subscription->is_attached()) {
+            return nullptr;
+        }
+        subscriptions_.push_back(std::move(subscription));
+        return subscriptions_.back().get();
     }
 
 private:
-    // Topic name -> ring buffer
-    std::unordered_map<std::string, 
-        std::unique_ptr<SPSCQueue<Message, 65536>>> topics_;
+    // Topic name -> topic (owns the ring buffer)
+    std::unordered_map<std::string, std::unique_ptr<Topic>> topics_;
+
+    // Active subscriptions (reference topics_)
+    std::vector<std::unique_ptr<Subscription>> subscriptions_;
 };
 
 }  // namespace nanomq
-
@@ -1,25 +1,54 @@
-#include <string>
-#include <vector>
+#include "nanomq/subscription.hpp"
+#include "nanomq/topic.hpp"
 
 namespace nanomq {
 
-// Subscription tracking
-class Subscription {
-public:
-    Subscription(const std::string& topic, const std::string& consumer_group)
-        : topic_(topic), consumer_group_(consumer_group), position_(0) {}
+Subscription::Subscription(Topic& topic, const std::string& consumer_group)
+    : topic_(&topic), consumer_group_(consumer_group), reader_(-1),
+      queue_reader_(false), position_(0) {
+    if (topic.mode() == TopicMode::BROADCAST) {
+        if (consumer_group_.empty()) {
+            reader_ = topic.add_reader();
+        }
+    } else {
+        queue_reader_ = topic.claim_queue_reader();
+    }
+}
 
-    const std::string& topic() const { return topic_; }
-    const std::string& consumer_group() const { return consumer_group_; }
-    
-    uint64_t position() const { return position_; }
-    void set_position(uint64_t pos) { position_ = pos; }
+Subscription::~Subscription() {
+    topic_->remove_reader(reader_);
+    if (queue_reader_ && topic_->mode() != TopicMode::CONSUMER_GROUP) {
+        topic_->release_queue_reader();
+    }
+}
 
-private:
-    std::string topic_;
-    std::string consumer_group_;
-    uint64_t position_;  // Last committed message ID
-};
+bool Subscription::is_attached() const {
+    return reader_ >= 0 || queue_reader_;
+}
 
-}  // namespace nanomq
+const std::string& Subscription::topic() const { return topic_->name(); }
+
+bool Subscription::is_dropped() const {
+    return topic_->is_reader_dropped(reader_);
+}
+
+bool Subscription::reattach() {
+    if (reader_ < 0) {
+        return false;
+    }
+    topic_->remove_reader(reader_);
+    reader_ = topic_->add_reader();
+    return reader_ >= 0;
+}
 
+size_t Subscription::poll(Message* messages, size_t max_count) {
+    if (reader_ >= 0) {
+        return topic_->read_batch(reader_, messages, max_count);
+    }
+    if (!queue_reader_) {
+        return 0;
+    }
+    return topic_->poll_batch(messages, max_count);
+}
+
+}  // namespace nanomq
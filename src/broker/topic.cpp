@@ -1,35 +1,120 @@
-#include "nanomq/message.hpp"
-#include "nanomq/queue.hpp"
-#include <string>
-#include <vector>
+#include "nanomq/topic.hpp"
+#include <stdexcept>
 
 namespace nanomq {
 
-// Topic management
-class Topic {
-public:
-    explicit Topic(const std::string& name)
-        : name_(name), message_id_counter_(0) {}
+Topic::Topic(const std::string& name, TopicMode mode, size_t capacity,
+             SlowReaderPolicy slow_reader_policy)
+    : name_(name), mode_(mode), message_id_counter_(0), queue_reader_(false) {
+    if (!supports_capacity(mode_, capacity)) {
+        throw std::invalid_argument("Unsupported capacity for topic " + name);
+    }
+    switch (mode_) {
+    case TopicMode::MULTI_PRODUCER:
+        mpsc_queue_ = std::make_unique<MPSCQueue<Message, QUEUE_CAPACITY>>(capacity);
+        break;
+    case TopicMode::CONSUMER_GROUP:
+        mpmc_queue_ = std::make_unique<MPMCQueue<Message, QUEUE_CAPACITY>>(capacity);
+        break;
+    case TopicMode::BROADCAST:
+        broadcast_ring_ = std::make_unique<BroadcastRing<Message, QUEUE_CAPACITY>>(
+            slow_reader_policy);
+        break;
+    default:
+        spsc_queue_ = std::make_unique<ElasticSPSCQueue<Message>>(capacity);
+        break;
+    }
+}
+
+bool Topic::supports_capacity(TopicMode mode, size_t capacity) {
+    switch (mode) {
+    case TopicMode::MULTI_PRODUCER:
+    case TopicMode::CONSUMER_GROUP:
+        return capacity >= 2 && (capacity & (capacity - 1)) == 0;
+    case TopicMode::BROADCAST:
+        return capacity == QUEUE_CAPACITY;
+    default:
+        return capacity > 0;
+    }
+}
 
-    const std::string& name() const { return name_; }
+bool Topic::add_message(const Message& msg) {
+    if (mpsc_queue_) {
+        return mpsc_queue_->try_push(msg);
+    }
+    if (mpmc_queue_) {
+        return mpmc_queue_->try_push(msg);
+    }
+    if (broadcast_ring_) {
+        return broadcast_ring_->try_push(msg);
+    }
+    return spsc_queue_->try_push(msg);
+}
+
+bool Topic::poll_message(Message& msg) {
+    return poll_batch(&msg, 1) == 1;
+}
+
+size_t Topic::poll_batch(Message* messages, size_t max_count) {
+    if (mpsc_queue_) {
+        return mpsc_queue_->try_pop_batch(messages, max_count);
+    }
+    if (mpmc_queue_) {
+        return mpmc_queue_->try_pop_batch(messages, max_count);
+    }
+    if (spsc_queue_) {
+        return spsc_queue_->try_pop_batch(messages, max_count);
+    }
+    return 0;  // BROADCAST topics are read through reader cursors
+}
 
-    // Add a message to the topic
-    bool add_message(const Message& msg) {
-        // TODO: Add to ring buffer
-        (void)msg;
+bool Topic::claim_queue_reader() {
+    if (mpmc_queue_) {
         return true;
     }
+    if (broadcast_ring_) {
+        return false;
+    }
+    bool expected = false;
+    return queue_reader_.compare_exchange_strong(expected, true,
+                                                 std::memory_order_acq_rel);
+}
+
+void Topic::release_queue_reader() {
+    queue_reader_.store(false, std::memory_order_release);
+}
 
-    // Get next message ID
-    uint64_t next_message_id() {
-        return ++message_id_counter_;
+int Topic::add_reader() {
+    return broadcast_ring_ ? broadcast_ring_->add_reader() : -1;
+}
+
+void Topic::remove_reader(int reader) {
+    if (broadcast_ring_ && reader >= 0) {
+        broadcast_ring_->remove_reader(reader);
     }
+}
 
-private:
-    std::string name_;
-    uint64_t message_id_counter_;
-    SPSCQueue<Message, 65536> queue_;
-};
+size_t Topic::read_batch(int reader, Message* messages, size_t max_count) {
+    if (!broadcast_ring_ || reader < 0) {
+        return 0;
+    }
+    return broadcast_ring_->try_read_batch(reader, messages, max_count);
+}
 
-}  // namespace nanomq
+bool Topic::is_reader_dropped(int reader) const {
+    return broadcast_ring_ && reader >= 0 && broadcast_ring_->is_dropped(reader);
+}
 
+void Topic::resize_queue(size_t capacity) {
+    if (spsc_queue_) {
+        spsc_queue_->resize(capacity);
+    }
+}
+
+void Topic::trim() {
+    if (spsc_queue_) {
+        spsc_queue_->trim();
+    }
+}
+
+}  // namespace nanomq
@@ -1,3 +1,4 @@
+#include "nanomq/wait_strategy.hpp"
 #include <atomic>
 #include <cstdint>
 
@@ -44,17 +45,12 @@ void memory_barrier_full() {
     std::atomic_thread_fence(std::memory_order_seq_cst);
 }
 
-// Spin wait with exponential backoff
+// Spin wait: pause iterations times
+// For exponential backoff from a retry loop use backoff_pause()
+// (wait_strategy.hpp)
 void spin_wait(uint32_t iterations) {
     for (uint32_t i = 0; i < iterations; ++i) {
-#if defined(__x86_64__) || defined(_M_X64)
-        __builtin_ia32_pause();  // x86 PAUSE instruction
-#elif defined(__aarch64__) || defined(_M_ARM64)
-        __asm__ __volatile__("yield");  // ARM YIELD instruction
-#else
-        // Generic busy wait
-        std::atomic_signal_fence(std::memory_order_seq_cst);
-#endif
+        cpu_pause();
     }
 }
 
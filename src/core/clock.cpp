@@ -0,0 +1,299 @@
+#include "nanomq/clock.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <mutex>
+#include <thread>
+#include <pthread.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+namespace nanomq {
+
+Clock::Calibration Clock::calibration_;
+std::atomic<uint64_t> Clock::coarse_ns_{0};
+
+// Owns the calibration state and the background refresh thread
+class ClockCalibrator {
+public:
+    static constexpr uint64_t INITIAL_WINDOW_NS = 1000000;       // 1 ms
+    static constexpr uint64_t RECALIBRATE_NS = 1000000000;       // 1 s
+    static constexpr int64_t STEP_THRESHOLD_NS = 1000000;        // 1 ms
+
+    ClockCalibrator() : stop_(false), coarse_wanted_(false), anchor_{0, 0} {
+#if defined(__x86_64__)
+        if (invariant_tsc()) {
+            calibrate_initial();
+        }
+#endif
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    ~ClockCalibrator() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wakeup_.notify_all();
+        thread_.join();
+    }
+
+    // Back to "not calibrated" and no coarse clock, as before first use
+    static void reset_clock_state() {
+        Clock::calibration_.sequence.store(0, std::memory_order_relaxed);
+        Clock::coarse_ns_.store(0, std::memory_order_relaxed);
+    }
+
+    // Keep Clock::coarse_ns_ fresh from now on
+    void start_coarse() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!coarse_wanted_) {
+                coarse_wanted_ = true;
+                Clock::coarse_ns_.store(current_ns(), std::memory_order_relaxed);
+            }
+        }
+        wakeup_.notify_all();
+    }
+
+    // Re-measure against CLOCK_REALTIME; with slew, steer towards it over
+    // horizon_ns instead of jumping
+    void recalibrate(bool slew, uint64_t horizon_ns) {
+        std::lock_guard<std::mutex> lock(update_mutex_);
+        const Clock::Calibration& c = Clock::calibration_;
+        if (c.sequence.load(std::memory_order_relaxed) == 0) {
+            return;  // No TSC
+        }
+#if defined(__x86_64__)
+        const Sample now = take_sample();
+        if (now.ns <= anchor_.ns || now.tsc <= anchor_.tsc) {
+            anchor_ = now;  // CLOCK_REALTIME was set back; restart the baseline
+            return;
+        }
+
+        // Frequency over the whole baseline
+        const uint64_t mult = static_cast<uint64_t>(
+            (static_cast<unsigned __int128>(now.ns - anchor_.ns) << Clock::MULT_SHIFT) /
+            (now.tsc - anchor_.tsc));
+
+        const uint64_t tsc_base = c.tsc_base.load(std::memory_order_relaxed);
+        const uint64_t predicted = c.ns_base.load(std::memory_order_relaxed) +
+            static_cast<uint64_t>((static_cast<unsigned __int128>(now.tsc - tsc_base) *
+                                   c.mult.load(std::memory_order_relaxed)) >>
+                                  Clock::MULT_SHIFT);
+        const int64_t error = static_cast<int64_t>(now.ns - predicted);
+
+        if (!slew || error > STEP_THRESHOLD_NS || error < -STEP_THRESHOLD_NS) {
+            // Large error: the wall clock was stepped, follow it
+            if (error > STEP_THRESHOLD_NS || error < -STEP_THRESHOLD_NS) {
+                anchor_ = now;
+            }
+            store(now.tsc, now.ns, mult);
+            return;
+        }
+        // Run slightly fast or slow until the error is gone by the next
+        // recalibration; the clock stays continuous
+        const int64_t horizon = static_cast<int64_t>(horizon_ns);
+        const uint64_t slewed = static_cast<uint64_t>(
+            static_cast<__int128>(mult) * (horizon + error) / horizon);
+        store(now.tsc, predicted, slewed);
+#else
+        (void)slew;
+        (void)horizon_ns;
+#endif
+    }
+
+private:
+    struct Sample {
+        uint64_t tsc;
+        uint64_t ns;
+    };
+
+#if defined(__x86_64__)
+    static bool invariant_tsc() {
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007) {
+            return false;
+        }
+        __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+        return (edx & (1u << 8)) != 0;
+    }
+
+    // TSC and CLOCK_REALTIME read as close together as possible
+    static Sample take_sample() {
+        Sample best{0, 0};
+        uint64_t best_window = UINT64_MAX;
+        for (int i = 0; i < 5; ++i) {
+            const uint64_t before = __rdtsc();
+            const uint64_t ns = Clock::realtime_ns();
+            const uint64_t after = __rdtsc();
+            if (after - before < best_window) {
+                best_window = after - before;
+                best.tsc = before + (after - before) / 2;
+                best.ns = ns;
+            }
+        }
+        return best;
+    }
+
+    // Rough frequency from a short window; refined by run()
+    void calibrate_initial() {
+        anchor_ = take_sample();
+        Sample end = anchor_;
+        while (end.ns - anchor_.ns < INITIAL_WINDOW_NS) {
+            end = take_sample();
+        }
+        if (end.tsc <= anchor_.tsc) {
+            return;  // TSC not usable after all
+        }
+        const uint64_t mult = static_cast<uint64_t>(
+            (static_cast<unsigned __int128>(end.ns - anchor_.ns) << Clock::MULT_SHIFT) /
+            (end.tsc - anchor_.tsc));
+        store(end.tsc, end.ns, mult);
+    }
+#endif
+
+    // now_ns() without re-entering initialization
+    static uint64_t current_ns() {
+        return Clock::calibration_.sequence.load(std::memory_order_acquire) != 0
+                   ? Clock::now_ns()
+                   : Clock::realtime_ns();
+    }
+
+    static void store(uint64_t tsc_base, uint64_t ns_base, uint64_t mult) {
+        Clock::Calibration& c = Clock::calibration_;
+        const uint32_t sequence = c.sequence.load(std::memory_order_relaxed);
+        c.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        c.tsc_base.store(tsc_base, std::memory_order_relaxed);
+        c.ns_base.store(ns_base, std::memory_order_relaxed);
+        c.mult.store(mult, std::memory_order_relaxed);
+        // Skip 0, which means "not calibrated"
+        const uint32_t next = sequence + 2 == 0 ? 2 : sequence + 2;
+        c.sequence.store(next, std::memory_order_release);
+    }
+
+    // Recalibrate after 10 ms, 100 ms, then every second as the baseline
+    // grows; once someone reads the coarse clock, also refresh it every
+    // COARSE_INTERVAL_NS
+    void run() {
+        uint64_t horizon = 10 * Clock::COARSE_INTERVAL_NS;
+        uint64_t next_recalibration = current_ns() + horizon;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_) {
+            const uint64_t now = current_ns();
+            const uint64_t wait = coarse_wanted_ ? Clock::COARSE_INTERVAL_NS
+                                  : next_recalibration > now ? next_recalibration - now : 0;
+            wakeup_.wait_for(lock, std::chrono::nanoseconds(wait));
+            if (stop_) {
+                break;
+            }
+            const uint64_t woken = current_ns();
+            if (woken >= next_recalibration) {
+                horizon = horizon * 10 < RECALIBRATE_NS ? horizon * 10 : RECALIBRATE_NS;
+                recalibrate(true, horizon);
+                next_recalibration = woken + horizon;
+            }
+            if (coarse_wanted_) {
+                Clock::coarse_ns_.store(current_ns(), std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::mutex mutex_;          // Guards stop_ and coarse_wanted_
+    std::mutex update_mutex_;   // Serializes recalibrations
+    std::condition_variable wakeup_;
+    bool stop_;
+    bool coarse_wanted_;
+    Sample anchor_;             // Start of the frequency baseline
+    std::thread thread_;
+};
+
+namespace {
+
+// The calibrator of this process; a forked child starts its own
+std::mutex g_clock_mutex;  // Guards creating g_calibrator
+std::atomic<ClockCalibrator*> g_calibrator{nullptr};
+
+// Stops the calibrator at exit
+struct CalibratorOwner {
+    ~CalibratorOwner() { delete g_calibrator.exchange(nullptr); }
+} g_calibrator_owner;
+
+void lock_clock() {
+    g_clock_mutex.lock();
+}
+
+void unlock_clock() {
+    g_clock_mutex.unlock();
+}
+
+// The calibrator thread does not exist in a forked child: abandon its
+// state (a seqlock update may have been cut short) so the next use starts
+// a new one
+void reset_clock_in_child() {
+    g_calibrator.store(nullptr, std::memory_order_relaxed);  // Its thread is gone; leak it
+    ClockCalibrator::reset_clock_state();
+    g_clock_mutex.unlock();
+}
+
+ClockCalibrator* start_clock() {
+    ClockCalibrator* calibrator = g_calibrator.load(std::memory_order_acquire);
+    if (calibrator != nullptr) {
+        return calibrator;
+    }
+    std::lock_guard<std::mutex> lock(g_clock_mutex);
+    calibrator = g_calibrator.load(std::memory_order_relaxed);
+    if (calibrator == nullptr) {
+        static const bool registered =
+            pthread_atfork(lock_clock, unlock_clock, reset_clock_in_child) == 0;
+        (void)registered;
+        calibrator = new ClockCalibrator();
+        g_calibrator.store(calibrator, std::memory_order_release);
+    }
+    return calibrator;
+}
+
+}  // namespace
+
+uint64_t Clock::start_coarse_clock() {
+    start_clock()->start_coarse();
+    return now_ns();
+}
+
+uint64_t Clock::slow_now_ns() {
+    start_clock();
+    if (calibration_.sequence.load(std::memory_order_acquire) != 0) {
+        return now_ns();
+    }
+    return realtime_ns();
+}
+
+uint64_t Clock::realtime_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL +
+           static_cast<uint64_t>(ts.tv_nsec);
+}
+
+bool Clock::uses_tsc() {
+    start_clock();
+    return calibration_.sequence.load(std::memory_order_acquire) != 0;
+}
+
+uint64_t Clock::tsc_hz() {
+    if (!uses_tsc()) {
+        return 0;
+    }
+    const uint64_t mult = calibration_.mult.load(std::memory_order_relaxed);
+    return mult == 0 ? 0 : static_cast<uint64_t>(
+        (static_cast<unsigned __int128>(1000000000ULL) << MULT_SHIFT) / mult);
+}
+
+void Clock::recalibrate() {
+    start_clock()->recalibrate(false, 0);
+}
+
+}  // namespace nanomq
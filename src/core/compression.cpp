@@ -0,0 +1,257 @@
+#include "nanomq/compression.hpp"
+#include <cstring>
+
+namespace nanomq {
+
+namespace {
+
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t LAST_LITERALS = 5;  // The block always ends in literals
+constexpr size_t MF_LIMIT = 12;      // No match starts in the last 12 bytes
+constexpr size_t MAX_DISTANCE = 65535;
+constexpr int HASH_LOG = 12;
+constexpr int SKIP_TRIGGER = 6;      // Search step grows every 64 misses
+constexpr size_t WILDCOPY = 16;      // Decoder copy granule
+
+inline uint32_t read32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t read64(const uint8_t* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint32_t hash4(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_LOG);
+}
+
+// Length beyond the 4-bit token field: runs of 255 plus a final byte
+inline uint8_t* write_length(uint8_t* op, size_t length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = static_cast<uint8_t>(length);
+    return op;
+}
+
+inline bool read_length(const uint8_t*& ip, const uint8_t* iend, size_t& length) {
+    uint8_t byte;
+    do {
+        if (ip >= iend) {
+            return false;
+        }
+        byte = *ip++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// Bytes in common at ip and match, stopping at limit
+inline size_t common_length(const uint8_t* ip, const uint8_t* match,
+                            const uint8_t* limit) {
+    const uint8_t* start = ip;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (ip + 8 <= limit) {
+        const uint64_t diff = read64(ip) ^ read64(match);
+        if (diff != 0) {
+            return static_cast<size_t>(ip - start) + (__builtin_ctzll(diff) >> 3);
+        }
+        ip += 8;
+        match += 8;
+    }
+#endif
+    while (ip < limit && *ip == *match) {
+        ++ip;
+        ++match;
+    }
+    return static_cast<size_t>(ip - start);
+}
+
+inline uint8_t* write_literals(uint8_t* op, uint8_t* token,
+                               const uint8_t* literals, size_t length) {
+    if (length >= 15) {
+        *token = 15 << 4;
+        op = write_length(op, length - 15);
+    } else {
+        *token = static_cast<uint8_t>(length << 4);
+    }
+    std::memcpy(op, literals, length);
+    return op + length;
+}
+
+}  // namespace
+
+size_t lz4_compress(const void* src, size_t src_size, void* dst, size_t dst_capacity) {
+    if (dst_capacity < lz4_compress_bound(src_size) || src_size > UINT32_MAX) {
+        return 0;
+    }
+    const uint8_t* const base = static_cast<const uint8_t*>(src);
+    const uint8_t* const iend = base + src_size;
+    const uint8_t* ip = base;
+    const uint8_t* anchor = base;
+    uint8_t* op = static_cast<uint8_t*>(dst);
+
+    if (src_size > MF_LIMIT) {
+        const uint8_t* const mflimit = iend - MF_LIMIT;
+        const uint8_t* const matchlimit = iend - LAST_LITERALS;
+        uint32_t table[1 << HASH_LOG];  // Position of the last 4-byte sequence
+        std::memset(table, 0, sizeof(table));
+
+        ++ip;
+        for (;;) {
+            // Find a match, stepping faster through data that does not repeat
+            const uint8_t* match;
+            size_t attempts = size_t(1) << SKIP_TRIGGER;
+            for (;;) {
+                const uint32_t h = hash4(read32(ip));
+                match = base + table[h];
+                table[h] = static_cast<uint32_t>(ip - base);
+                if (match < ip && static_cast<size_t>(ip - match) <= MAX_DISTANCE &&
+                    read32(match) == read32(ip)) {
+                    break;
+                }
+                ip += attempts++ >> SKIP_TRIGGER;
+                if (ip > mflimit) {
+                    goto last_literals;
+                }
+            }
+
+            // Extend backwards over bytes not yet emitted
+            while (ip > anchor && match > base && ip[-1] == match[-1]) {
+                --ip;
+                --match;
+            }
+
+            uint8_t* token = op++;
+            op = write_literals(op, token, anchor, static_cast<size_t>(ip - anchor));
+
+            for (;;) {
+                const uint16_t offset = static_cast<uint16_t>(ip - match);
+                *op++ = static_cast<uint8_t>(offset);
+                *op++ = static_cast<uint8_t>(offset >> 8);
+
+                const size_t length =
+                    common_length(ip + MIN_MATCH, match + MIN_MATCH, matchlimit);
+                ip += MIN_MATCH + length;
+                if (length >= 15) {
+                    *token += 15;
+                    op = write_length(op, length - 15);
+                } else {
+                    *token += static_cast<uint8_t>(length);
+                }
+                anchor = ip;
+                if (ip > mflimit) {
+                    goto last_literals;
+                }
+
+                table[hash4(read32(ip - 2))] = static_cast<uint32_t>(ip - 2 - base);
+
+                // Another match right here needs no literals
+                const uint32_t h = hash4(read32(ip));
+                match = base + table[h];
+                table[h] = static_cast<uint32_t>(ip - base);
+                if (!(match < ip && static_cast<size_t>(ip - match) <= MAX_DISTANCE &&
+                      read32(match) == read32(ip))) {
+                    break;
+                }
+                token = op++;
+                *token = 0;
+            }
+            ++ip;
+            if (ip > mflimit) {
+                break;
+            }
+        }
+    }
+
+last_literals:
+    uint8_t* token = op++;
+    op = write_literals(op, token, anchor, static_cast<size_t>(iend - anchor));
+    return static_cast<size_t>(op - static_cast<uint8_t*>(dst));
+}
+
+size_t lz4_decompress(const void* src, size_t src_size, void* dst, size_t dst_capacity) {
+    const uint8_t* ip = static_cast<const uint8_t*>(src);
+    const uint8_t* const iend = ip + src_size;
+    uint8_t* const ostart = static_cast<uint8_t*>(dst);
+    uint8_t* op = ostart;
+    uint8_t* const oend = ostart + dst_capacity;
+
+    for (;;) {
+        if (ip >= iend) {
+            return 0;
+        }
+        const uint8_t token = *ip++;
+
+        size_t literals = token >> 4;
+        if (literals == 15 && !read_length(ip, iend, literals)) {
+            return 0;
+        }
+        if (literals > static_cast<size_t>(iend - ip) ||
+            literals > static_cast<size_t>(oend - op)) {
+            return 0;
+        }
+        if (literals <= WILDCOPY && iend - ip >= static_cast<ptrdiff_t>(WILDCOPY) &&
+            oend - op >= static_cast<ptrdiff_t>(WILDCOPY)) {
+            std::memcpy(op, ip, WILDCOPY);  // Fixed size: one unaligned move
+        } else {
+            std::memcpy(op, ip, literals);
+        }
+        op += literals;
+        ip += literals;
+        if (ip == iend) {
+            break;  // The last sequence has no match
+        }
+
+        if (iend - ip < 2) {
+            return 0;
+        }
+        const size_t offset = static_cast<size_t>(ip[0]) | static_cast<size_t>(ip[1]) << 8;
+        ip += 2;
+        if (offset == 0 || offset > static_cast<size_t>(op - ostart)) {
+            return 0;
+        }
+
+        size_t length = token & 15;
+        if (length == 15 && !read_length(ip, iend, length)) {
+            return 0;
+        }
+        length += MIN_MATCH;
+        if (length > static_cast<size_t>(oend - op)) {
+            return 0;
+        }
+
+        // Matches may overlap their own output; n-byte steps are safe when
+        // the source is at least n bytes behind. Bytes written past the
+        // match end (room permitting) are overwritten by what follows.
+        const uint8_t* match = op - offset;
+        uint8_t* const match_end = op + length;
+        if (offset >= WILDCOPY && oend - match_end >= static_cast<ptrdiff_t>(WILDCOPY)) {
+            do {
+                std::memcpy(op, match, WILDCOPY);
+                op += WILDCOPY;
+                match += WILDCOPY;
+            } while (op < match_end);
+            op = match_end;
+            continue;
+        }
+        if (offset >= 8) {
+            while (op + 8 <= match_end) {
+                std::memcpy(op, match, 8);
+                op += 8;
+                match += 8;
+            }
+        }
+        while (op < match_end) {
+            *op++ = *match++;
+        }
+    }
+    return static_cast<size_t>(op - ostart);
+}
+
+}  // namespace nanomq
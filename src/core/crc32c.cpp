@@ -0,0 +1,329 @@
+#include "nanomq/crc32c.hpp"
+#include "nanomq/message.hpp"
+#include <atomic>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+namespace nanomq {
+
+namespace {
+
+constexpr uint32_t POLY = 0x82F63B78;  // Castagnoli polynomial, reflected
+
+// Multiply a and b modulo POLY (reflected: bit 31 is x^0)
+constexpr uint32_t multmodp(uint32_t a, uint32_t b) {
+    uint32_t product = 0;
+    for (uint32_t m = 1u << 31; m != 0; m >>= 1) {
+        if (a & m) {
+            product ^= b;
+        }
+        b = (b & 1) ? (b >> 1) ^ POLY : b >> 1;
+    }
+    return product;
+}
+
+// x^n modulo POLY
+constexpr uint32_t xnmodp(uint64_t n) {
+    uint32_t result = 1u << 31;  // x^0
+    uint32_t square = 1u << 30;  // x^1, x^2, x^4, ...
+    while (n != 0) {
+        if (n & 1) {
+            result = multmodp(square, result);
+        }
+        square = multmodp(square, square);
+        n >>= 1;
+    }
+    return result;
+}
+
+// The hardware paths run three independent crc32 chains over adjacent
+// blocks (the instruction has 3-cycle latency but issues every cycle) and
+// merge them by shifting the earlier CRCs over the later blocks' length.
+constexpr size_t LONG_BLOCK = 8192;  // Bytes per stream
+constexpr size_t SHORT_BLOCK = 256;
+
+// Shifting a CRC register over n zero bytes multiplies it by x^(8n)
+struct ShiftTable {
+    uint32_t entries[4][256];
+
+    explicit ShiftTable(size_t bytes) {
+        const uint32_t factor = xnmodp(8 * bytes);
+        for (uint32_t k = 0; k < 4; ++k) {
+            for (uint32_t b = 0; b < 256; ++b) {
+                entries[k][b] = multmodp(factor, b << (8 * k));
+            }
+        }
+    }
+
+    uint32_t shift(uint32_t crc) const {
+        return entries[0][crc & 0xff] ^ entries[1][(crc >> 8) & 0xff] ^
+               entries[2][(crc >> 16) & 0xff] ^ entries[3][crc >> 24];
+    }
+};
+
+struct Tables {
+    uint32_t slice[8][256];  // Slicing-by-8
+    ShiftTable long_shift{LONG_BLOCK};
+    ShiftTable short_shift{SHORT_BLOCK};
+
+    Tables() {
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t crc = n;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 1) ? (crc >> 1) ^ POLY : crc >> 1;
+            }
+            slice[0][n] = crc;
+        }
+        for (uint32_t n = 0; n < 256; ++n) {
+            for (int k = 1; k < 8; ++k) {
+                slice[k][n] = (slice[k - 1][n] >> 8) ^
+                              slice[0][slice[k - 1][n] & 0xff];
+            }
+        }
+    }
+};
+
+const Tables& tables() {
+    static const Tables instance;
+    return instance;
+}
+
+// All extend functions work on the raw register (no pre/post inversion)
+using ExtendFn = uint32_t (*)(uint32_t crc, const uint8_t* data, size_t size);
+
+uint32_t extend_software(uint32_t crc, const uint8_t* data, size_t size) {
+    const Tables& t = tables();
+    while (size > 0 && (reinterpret_cast<uintptr_t>(data) & 7) != 0) {
+        crc = t.slice[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+        --size;
+    }
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (size >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        word ^= crc;
+        crc = t.slice[7][word & 0xff] ^ t.slice[6][(word >> 8) & 0xff] ^
+              t.slice[5][(word >> 16) & 0xff] ^ t.slice[4][(word >> 24) & 0xff] ^
+              t.slice[3][(word >> 32) & 0xff] ^ t.slice[2][(word >> 40) & 0xff] ^
+              t.slice[1][(word >> 48) & 0xff] ^ t.slice[0][word >> 56];
+        data += 8;
+        size -= 8;
+    }
+#endif
+    while (size > 0) {
+        crc = t.slice[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+        --size;
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+
+#define NANOMQ_TARGET_SSE42 __attribute__((target("sse4.2")))
+#define NANOMQ_TARGET_PCLMUL __attribute__((target("sse4.2,pclmul")))
+
+inline uint64_t load64(const uint8_t* p) {
+    uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+// Bytes up to the next 8-byte boundary
+NANOMQ_TARGET_SSE42 __attribute__((always_inline))
+inline uint32_t crc_align(uint32_t crc, const uint8_t*& data, size_t& size) {
+    while (size > 0 && (reinterpret_cast<uintptr_t>(data) & 7) != 0) {
+        crc = _mm_crc32_u8(crc, *data++);
+        --size;
+    }
+    return crc;
+}
+
+// Whatever is left after the three-stream blocks
+NANOMQ_TARGET_SSE42 __attribute__((always_inline))
+inline uint32_t crc_tail(uint32_t crc, const uint8_t* data, size_t size) {
+    uint64_t crc64 = crc;
+    while (size >= 8) {
+        crc64 = _mm_crc32_u64(crc64, load64(data));
+        data += 8;
+        size -= 8;
+    }
+    crc = static_cast<uint32_t>(crc64);
+    while (size > 0) {
+        crc = _mm_crc32_u8(crc, *data++);
+        --size;
+    }
+    return crc;
+}
+
+// Three streams over data[0, block), [block, 2 block), [2 block, 3 block)
+NANOMQ_TARGET_SSE42 __attribute__((always_inline))
+inline void crc_three_way(uint32_t& a, uint32_t& b, uint32_t& c,
+                          const uint8_t* data, size_t block) {
+    uint64_t a64 = a;
+    uint64_t b64 = 0;
+    uint64_t c64 = 0;
+    for (size_t i = 0; i < block; i += 8) {
+        a64 = _mm_crc32_u64(a64, load64(data + i));
+        b64 = _mm_crc32_u64(b64, load64(data + block + i));
+        c64 = _mm_crc32_u64(c64, load64(data + 2 * block + i));
+    }
+    a = static_cast<uint32_t>(a64);
+    b = static_cast<uint32_t>(b64);
+    c = static_cast<uint32_t>(c64);
+}
+
+NANOMQ_TARGET_SSE42
+uint32_t extend_sse42(uint32_t crc, const uint8_t* data, size_t size) {
+    const Tables& t = tables();
+    crc = crc_align(crc, data, size);
+    while (size >= 3 * LONG_BLOCK) {
+        uint32_t b, c;
+        crc_three_way(crc, b, c, data, LONG_BLOCK);
+        crc = t.long_shift.shift(t.long_shift.shift(crc) ^ b) ^ c;
+        data += 3 * LONG_BLOCK;
+        size -= 3 * LONG_BLOCK;
+    }
+    while (size >= 3 * SHORT_BLOCK) {
+        uint32_t b, c;
+        crc_three_way(crc, b, c, data, SHORT_BLOCK);
+        crc = t.short_shift.shift(t.short_shift.shift(crc) ^ b) ^ c;
+        data += 3 * SHORT_BLOCK;
+        size -= 3 * SHORT_BLOCK;
+    }
+    return crc_tail(crc, data, size);
+}
+
+// Shift by carry-less multiplication: crc * key * x^33 mod P, where the
+// x^33 comes from the reflected product (x^1) and the crc32 reduction (x^32)
+constexpr uint32_t LONG_KEY = xnmodp(8 * LONG_BLOCK - 33);
+constexpr uint32_t SHORT_KEY = xnmodp(8 * SHORT_BLOCK - 33);
+
+NANOMQ_TARGET_PCLMUL __attribute__((always_inline))
+inline uint32_t clmul_shift(uint32_t crc, uint32_t key) {
+    const __m128i product = _mm_clmulepi64_si128(
+        _mm_cvtsi32_si128(static_cast<int>(crc)),
+        _mm_cvtsi32_si128(static_cast<int>(key)), 0);
+    return static_cast<uint32_t>(
+        _mm_crc32_u64(0, static_cast<uint64_t>(_mm_cvtsi128_si64(product))));
+}
+
+NANOMQ_TARGET_PCLMUL
+uint32_t extend_pclmul(uint32_t crc, const uint8_t* data, size_t size) {
+    crc = crc_align(crc, data, size);
+    while (size >= 3 * LONG_BLOCK) {
+        uint32_t b, c;
+        crc_three_way(crc, b, c, data, LONG_BLOCK);
+        crc = clmul_shift(clmul_shift(crc, LONG_KEY) ^ b, LONG_KEY) ^ c;
+        data += 3 * LONG_BLOCK;
+        size -= 3 * LONG_BLOCK;
+    }
+    while (size >= 3 * SHORT_BLOCK) {
+        uint32_t b, c;
+        crc_three_way(crc, b, c, data, SHORT_BLOCK);
+        crc = clmul_shift(clmul_shift(crc, SHORT_KEY) ^ b, SHORT_KEY) ^ c;
+        data += 3 * SHORT_BLOCK;
+        size -= 3 * SHORT_BLOCK;
+    }
+    return crc_tail(crc, data, size);
+}
+
+#undef NANOMQ_TARGET_SSE42
+#undef NANOMQ_TARGET_PCLMUL
+
+#endif  // __x86_64__
+
+ExtendFn extend_function(Crc32cImpl impl) {
+    switch (impl) {
+#if defined(__x86_64__)
+        case Crc32cImpl::SSE42_PCLMUL:
+            return extend_pclmul;
+        case Crc32cImpl::SSE42:
+            return extend_sse42;
+#endif
+        default:
+            return extend_software;
+    }
+}
+
+Crc32cImpl best_implementation() {
+    if (crc32c_supported(Crc32cImpl::SSE42_PCLMUL)) {
+        return Crc32cImpl::SSE42_PCLMUL;
+    }
+    if (crc32c_supported(Crc32cImpl::SSE42)) {
+        return Crc32cImpl::SSE42;
+    }
+    return Crc32cImpl::SOFTWARE;
+}
+
+std::atomic<Crc32cImpl> g_impl{best_implementation()};
+std::atomic<ExtendFn> g_extend{extend_function(g_impl.load())};
+
+}  // namespace
+
+bool crc32c_supported(Crc32cImpl impl) {
+    switch (impl) {
+        case Crc32cImpl::SOFTWARE:
+            return true;
+#if defined(__x86_64__)
+        case Crc32cImpl::SSE42:
+            __builtin_cpu_init();  // May run before libgcc's own initializer
+            return __builtin_cpu_supports("sse4.2");
+        case Crc32cImpl::SSE42_PCLMUL:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse4.2") &&
+                   __builtin_cpu_supports("pclmul");
+#endif
+        default:
+            return false;
+    }
+}
+
+uint32_t crc32c_extend(uint32_t crc, const void* data, size_t size) {
+    ExtendFn extend = g_extend.load(std::memory_order_relaxed);
+    if (extend == nullptr) {
+        // Called from another static initializer before ours ran
+        extend = extend_function(best_implementation());
+    }
+    return ~extend(~crc, static_cast<const uint8_t*>(data), size);
+}
+
+uint32_t crc32c(const void* data, size_t size) {
+    return crc32c_extend(0, data, size);
+}
+
+Crc32cImpl crc32c_implementation() {
+    return g_impl.load(std::memory_order_relaxed);
+}
+
+const char* crc32c_implementation_name(Crc32cImpl impl) {
+    switch (impl) {
+        case Crc32cImpl::SSE42_PCLMUL:
+            return "sse4.2+pclmul";
+        case Crc32cImpl::SSE42:
+            return "sse4.2";
+        default:
+            return "slicing-by-8";
+    }
+}
+
+bool crc32c_set_implementation(Crc32cImpl impl) {
+    if (!crc32c_supported(impl)) {
+        return false;
+    }
+    g_impl.store(impl, std::memory_order_relaxed);
+    g_extend.store(extend_function(impl), std::memory_order_relaxed);
+    return true;
+}
+
+uint32_t Message::calculate_crc32c(const void* data, size_t size) {
+    if (!data || size == 0) {
+        return 0;
+    }
+    return crc32c(data, size);
+}
+
+}  // namespace nanomq
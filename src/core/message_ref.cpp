@@ -0,0 +1,37 @@
+#include "nanomq/message_ref.hpp"
+#include "nanomq/payload_pool.hpp"
+#include <cstdlib>
+#include <new>
+
+namespace nanomq {
+
+SharedBuffer* SharedBuffer::create(size_t size) {
+    const size_t total = sizeof(SharedBuffer) + size;
+    if (size > UINT32_MAX - sizeof(SharedBuffer)) {
+        return nullptr;
+    }
+    void* memory;
+    uint32_t allocated = 0;
+    if (total <= PayloadPool::MAX_BLOCK_SIZE) {
+        memory = PayloadPool::allocate(total);
+        allocated = static_cast<uint32_t>(total);
+    } else {
+        memory = std::malloc(total);
+    }
+    if (memory == nullptr) {
+        return nullptr;
+    }
+    return new (memory) SharedBuffer(static_cast<uint32_t>(size), allocated);
+}
+
+void SharedBuffer::destroy() {
+    const uint32_t allocated = allocated_;
+    this->~SharedBuffer();
+    if (allocated != 0) {
+        PayloadPool::deallocate(this, allocated);
+    } else {
+        std::free(this);
+    }
+}
+
+}  // namespace nanomq
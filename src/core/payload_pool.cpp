@@ -0,0 +1,210 @@
+#include "nanomq/payload_pool.hpp"
+#include <atomic>
+#include <cstdlib>
+
+namespace nanomq {
+
+namespace {
+
+constexpr size_t BATCH_SIZE = 32;               // Buffers per global list op
+constexpr size_t CACHE_LIMIT = 2 * BATCH_SIZE;  // Per thread and size class
+
+// Free buffers are threaded through their own first bytes
+struct FreeBlock {
+    FreeBlock* next;        // Next buffer in the same batch or cache list
+    FreeBlock* next_batch;  // Next batch on the global list (batch head only)
+    size_t count;           // Buffers in this batch (batch head only)
+};
+
+static_assert(sizeof(FreeBlock) <= PayloadPool::MIN_BLOCK_SIZE,
+              "free list links must fit in the smallest buffer");
+
+// Lock-free stack of batches (Treiber stack)
+// The top 16 bits of the head word count pushes, so a CAS against a head
+// that was popped and pushed again in the meantime fails (ABA). Slabs are
+// never freed, so reading next_batch of a batch that another thread just
+// took is harmless: the tag makes that CAS fail.
+class BatchStack {
+public:
+    void push(FreeBlock* batch) {
+        uint64_t old_head = head_.load(std::memory_order_relaxed);
+        for (;;) {
+            batch->next_batch = pointer(old_head);
+            const uint64_t new_head = pack(batch, tag(old_head) + 1);
+            if (head_.compare_exchange_weak(old_head, new_head,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+                return;
+            }
+        }
+    }
+
+    FreeBlock* pop() {
+        uint64_t old_head = head_.load(std::memory_order_acquire);
+        for (;;) {
+            FreeBlock* top = pointer(old_head);
+            if (top == nullptr) {
+                return nullptr;
+            }
+            const uint64_t new_head = pack(top->next_batch, tag(old_head) + 1);
+            if (head_.compare_exchange_weak(old_head, new_head,
+                                            std::memory_order_acquire,
+                                            std::memory_order_acquire)) {
+                return top;
+            }
+        }
+    }
+
+private:
+    static constexpr int TAG_SHIFT = 48;  // User-space pointers fit in 48 bits
+    static constexpr uint64_t POINTER_MASK = (uint64_t(1) << TAG_SHIFT) - 1;
+
+    static FreeBlock* pointer(uint64_t word) {
+        return reinterpret_cast<FreeBlock*>(word & POINTER_MASK);
+    }
+    static uint64_t tag(uint64_t word) { return word >> TAG_SHIFT; }
+    static uint64_t pack(FreeBlock* block, uint64_t tag) {
+        return reinterpret_cast<uint64_t>(block) | (tag << TAG_SHIFT);
+    }
+
+    std::atomic<uint64_t> head_{0};
+};
+
+// One global free list per size class, each on its own cache line
+struct alignas(CACHE_LINE_SIZE) SizeClass {
+    BatchStack batches;
+};
+
+SizeClass g_classes[PayloadPool::NUM_SIZE_CLASSES];
+std::atomic<size_t> g_reserved_bytes{0};
+
+// Carve a fresh slab into one batch of buffers
+FreeBlock* carve_slab(size_t cls) {
+    const size_t block_size = PayloadPool::class_size(cls);
+    void* slab = nullptr;
+    if (posix_memalign(&slab, CACHE_LINE_SIZE, block_size * BATCH_SIZE) != 0) {
+        return nullptr;
+    }
+    g_reserved_bytes.fetch_add(block_size * BATCH_SIZE, std::memory_order_relaxed);
+
+    uint8_t* bytes = static_cast<uint8_t*>(slab);
+    for (size_t i = 0; i < BATCH_SIZE; ++i) {
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(bytes + i * block_size);
+        block->next = (i + 1 < BATCH_SIZE)
+            ? reinterpret_cast<FreeBlock*>(bytes + (i + 1) * block_size)
+            : nullptr;
+    }
+    FreeBlock* batch = reinterpret_cast<FreeBlock*>(bytes);
+    batch->count = BATCH_SIZE;
+    return batch;
+}
+
+// Set once this thread's cache is destroyed; buffers released later (from
+// static or other thread_local destructors) go straight to the global
+// stacks. Trivially destructible, so it outlives t_cache
+thread_local bool t_cache_gone = false;
+
+// Per-thread cache: a LIFO list per size class
+struct ThreadCache {
+    FreeBlock* lists[PayloadPool::NUM_SIZE_CLASSES] = {};
+    size_t counts[PayloadPool::NUM_SIZE_CLASSES] = {};
+
+    // Hand everything back so buffers freed by exiting threads are reused
+    ~ThreadCache() {
+        t_cache_gone = true;
+        for (size_t cls = 0; cls < PayloadPool::NUM_SIZE_CLASSES; ++cls) {
+            while (counts[cls] > 0) {
+                spill(cls, counts[cls] < BATCH_SIZE ? counts[cls] : BATCH_SIZE);
+            }
+        }
+    }
+
+    // Move the first count buffers of a list to the global stack
+    void spill(size_t cls, size_t count) {
+        FreeBlock* batch = lists[cls];
+        FreeBlock* last = batch;
+        for (size_t i = 1; i < count; ++i) {
+            last = last->next;
+        }
+        lists[cls] = last->next;
+        last->next = nullptr;
+        counts[cls] -= count;
+        batch->count = count;
+        g_classes[cls].batches.push(batch);
+    }
+};
+
+thread_local ThreadCache t_cache;
+
+// Take one buffer from the global stack, without a thread cache
+uint8_t* allocate_uncached(size_t cls) {
+    FreeBlock* batch = g_classes[cls].batches.pop();
+    if (batch == nullptr) {
+        batch = carve_slab(cls);
+        if (batch == nullptr) {
+            return nullptr;
+        }
+    }
+    if (batch->next != nullptr) {
+        FreeBlock* rest = batch->next;
+        rest->count = batch->count - 1;
+        g_classes[cls].batches.push(rest);
+    }
+    return reinterpret_cast<uint8_t*>(batch);
+}
+
+}  // namespace
+
+uint8_t* PayloadPool::allocate(size_t size) {
+    if (size > MAX_BLOCK_SIZE) {
+        return nullptr;
+    }
+    const size_t cls = size_class(size);
+    if (t_cache_gone) {
+        return allocate_uncached(cls);
+    }
+    ThreadCache& cache = t_cache;
+
+    if (cache.counts[cls] == 0) {
+        FreeBlock* batch = g_classes[cls].batches.pop();
+        if (batch == nullptr) {
+            batch = carve_slab(cls);
+            if (batch == nullptr) {
+                return nullptr;
+            }
+        }
+        cache.lists[cls] = batch;
+        cache.counts[cls] = batch->count;
+    }
+
+    FreeBlock* block = cache.lists[cls];
+    cache.lists[cls] = block->next;
+    --cache.counts[cls];
+    return reinterpret_cast<uint8_t*>(block);
+}
+
+void PayloadPool::deallocate(void* buffer, size_t size) {
+    if (buffer == nullptr) {
+        return;
+    }
+    const size_t cls = size_class(size);
+    FreeBlock* block = static_cast<FreeBlock*>(buffer);
+    if (t_cache_gone) {
+        block->next = nullptr;
+        block->count = 1;
+        g_classes[cls].batches.push(block);
+        return;
+    }
+    ThreadCache& cache = t_cache;
+    block->next = cache.lists[cls];
+    cache.lists[cls] = block;
+    if (++cache.counts[cls] > CACHE_LIMIT) {
+        cache.spill(cls, BATCH_SIZE);
+    }
+}
+
+size_t PayloadPool::reserved_bytes() {
+    return g_reserved_bytes.load(std::memory_order_relaxed);
+}
+
+}  // namespace nanomq
@@ -0,0 +1,220 @@
+#include "nanomq/record_batch.hpp"
+#include "nanomq/compression.hpp"
+#include "nanomq/protocol.hpp"
+#include <cstring>
+
+namespace nanomq {
+
+namespace {
+
+// Records encode three varints before their payload
+constexpr size_t MAX_RECORD_HEADER_SIZE = 3 * MAX_VARINT_SIZE;
+
+inline void put_le32(uint8_t* out, uint32_t value) {
+    for (size_t i = 0; i < 4; ++i) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+inline void put_le64(uint8_t* out, uint64_t value) {
+    for (size_t i = 0; i < 8; ++i) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+inline uint32_t get_le32(const uint8_t* in) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+inline uint64_t get_le64(const uint8_t* in) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+// decode_varint with the one-byte case inline
+inline bool read_varint(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    if (p < end && *p < 0x80) {
+        value = *p++;
+        return true;
+    }
+    const size_t n = decode_varint(p, end, value);
+    p += n;
+    return n != 0;
+}
+
+}  // namespace
+
+MessageBatch::MessageBatch(size_t max_bytes)
+    : size_(RECORD_BATCH_PREFIX_SIZE), count_(0), max_bytes_(0), last_id_(0),
+      max_timestamp_(0) {
+    set_max_bytes(max_bytes);
+}
+
+void MessageBatch::set_max_bytes(size_t max_bytes) {
+    max_bytes_ = max_bytes < RECORD_BATCH_PREFIX_SIZE ? RECORD_BATCH_PREFIX_SIZE : max_bytes;
+    // Slack so a record header can be encoded before its size is checked
+    if (buffer_.size() < max_bytes_ + MAX_RECORD_HEADER_SIZE) {
+        buffer_.resize(max_bytes_ + MAX_RECORD_HEADER_SIZE);
+    }
+}
+
+bool MessageBatch::add(const Message& msg) {
+    if (count_ == 0) {
+        header_.topic_id = msg.header.topic_id;
+    }
+    return add(msg.header.id, msg.header.timestamp, msg.data, msg.header.size,
+               msg.header.flags & ~MSG_FLAG_CRC32C);
+}
+
+bool MessageBatch::add(uint64_t id, uint64_t timestamp, const void* data, size_t size,
+                       uint32_t flags) {
+    if (is_full() || (flags & ~MSG_FLAG_KEYED) != 0) {
+        return false;
+    }
+    if (count_ == 0) {
+        header_.id = id;
+        header_.timestamp = timestamp;
+        last_id_ = id;
+        max_timestamp_ = timestamp;
+    } else if (id < header_.id || id - header_.id > UINT32_MAX) {
+        return false;
+    }
+    uint8_t* const start = buffer_.data() + size_;
+    uint8_t* out = start;
+    out += encode_varint(id - header_.id, out);
+    out += encode_varint(zigzag_encode(static_cast<int64_t>(timestamp - header_.timestamp)),
+                         out);
+    out += encode_varint(static_cast<uint64_t>(size) << 1 | ((flags & MSG_FLAG_KEYED) ? 1 : 0),
+                         out);
+    const size_t record_size = static_cast<size_t>(out - start) + size;
+    if (record_size > max_bytes_ - size_) {
+        return false;
+    }
+    if (size > 0) {
+        std::memcpy(out, data, size);
+    }
+    size_ += record_size;
+    ++count_;
+    last_id_ = id > last_id_ ? id : last_id_;
+    max_timestamp_ = timestamp > max_timestamp_ ? timestamp : max_timestamp_;
+    return true;
+}
+
+void MessageBatch::clear() {
+    header_ = MessageHeader();
+    size_ = RECORD_BATCH_PREFIX_SIZE;
+    count_ = 0;
+    last_id_ = 0;
+    max_timestamp_ = 0;
+}
+
+Message MessageBatch::finish(bool compress) {
+    put_le32(buffer_.data(), static_cast<uint32_t>(count_));
+    put_le32(buffer_.data() + 4, static_cast<uint32_t>(size_ - RECORD_BATCH_PREFIX_SIZE));
+    put_le32(buffer_.data() + 8, static_cast<uint32_t>(last_id_ - header_.id));
+    put_le64(buffer_.data() + 12, max_timestamp_);
+    Message batch;
+    batch.header = header_;
+    batch.header.size = static_cast<uint32_t>(size_);
+    batch.header.flags = MSG_FLAG_BATCH;
+    batch.data = buffer_.data();
+
+    if (compress) {
+        const size_t records = size_ - RECORD_BATCH_PREFIX_SIZE;
+        compressed_.resize(RECORD_BATCH_PREFIX_SIZE + lz4_compress_bound(records));
+        const size_t n = lz4_compress(buffer_.data() + RECORD_BATCH_PREFIX_SIZE, records,
+                                      compressed_.data() + RECORD_BATCH_PREFIX_SIZE,
+                                      compressed_.size() - RECORD_BATCH_PREFIX_SIZE);
+        if (n != 0 && n < records) {
+            std::memcpy(compressed_.data(), buffer_.data(), RECORD_BATCH_PREFIX_SIZE);
+            batch.header.size = static_cast<uint32_t>(RECORD_BATCH_PREFIX_SIZE + n);
+            batch.header.flags |= MSG_FLAG_COMPRESSED;
+            batch.data = compressed_.data();
+        }
+    }
+    batch.set_checksum(batch.data);
+    return batch;
+}
+
+bool RecordBatchReader::reset(const Message& batch) {
+    return reset(batch, expanded_);
+}
+
+bool RecordBatchReader::reset(const Message& batch, std::vector<uint8_t>& records) {
+    remaining_ = 0;
+    if (!batch.has_flag(MSG_FLAG_BATCH) || batch.header.size < RECORD_BATCH_PREFIX_SIZE ||
+        !batch.verify_checksum()) {
+        return false;
+    }
+    const uint32_t count = get_le32(batch.data);
+    const uint32_t records_size = get_le32(batch.data + 4);
+    const uint8_t* p = batch.data + RECORD_BATCH_PREFIX_SIZE;
+    const size_t stored = batch.header.size - RECORD_BATCH_PREFIX_SIZE;
+    if (batch.has_flag(MSG_FLAG_COMPRESSED)) {
+        if (records_size > MAX_RECORD_BATCH_RECORDS_SIZE) {
+            return false;
+        }
+        records.resize(records_size);
+        if (lz4_decompress(p, stored, records.data(), records.size()) != records_size) {
+            return false;
+        }
+        p = records.data();
+    } else if (records_size != stored) {
+        return false;
+    }
+    // Every record takes at least three bytes
+    if (count > records_size / 3) {
+        return false;
+    }
+    base_ = batch.header;
+    p_ = p;
+    end_ = p + records_size;
+    remaining_ = count;
+    return true;
+}
+
+bool RecordBatchReader::next(Message& msg) {
+    if (remaining_ == 0) {
+        return false;
+    }
+    uint64_t id_delta, timestamp_delta, size_keyed;
+    const uint8_t* p = p_;
+    if (!read_varint(p, end_, id_delta) || !read_varint(p, end_, timestamp_delta) ||
+        !read_varint(p, end_, size_keyed) ||
+        (size_keyed >> 1) > static_cast<size_t>(end_ - p)) {
+        remaining_ = 0;
+        return false;
+    }
+    const uint64_t size = size_keyed >> 1;
+
+    msg.header.id = base_.id + id_delta;
+    msg.header.timestamp = base_.timestamp +
+                           static_cast<uint64_t>(zigzag_decode(timestamp_delta));
+    msg.header.topic_id = base_.topic_id;
+    msg.header.size = static_cast<uint32_t>(size);
+    msg.header.crc32 = 0;
+    msg.header.flags = (size_keyed & 1) ? MSG_FLAG_KEYED : MSG_FLAG_NONE;
+    msg.data = const_cast<uint8_t*>(p);
+    p_ = p + size;
+    --remaining_;
+    return true;
+}
+
+void message_bounds(const Message& msg, uint64_t& last_id, uint64_t& max_timestamp) {
+    last_id = msg.header.id;
+    max_timestamp = msg.header.timestamp;
+    if (msg.has_flag(MSG_FLAG_BATCH) && msg.header.size >= RECORD_BATCH_PREFIX_SIZE) {
+        last_id += get_le32(msg.data + 8);
+        const uint64_t timestamp = get_le64(msg.data + 12);
+        max_timestamp = timestamp > max_timestamp ? timestamp : max_timestamp;
+    }
+}
+
+}  // namespace nanomq
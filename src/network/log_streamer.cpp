@@ -0,0 +1,190 @@
+#include "nanomq/log_streamer.hpp"
+#include "nanomq/protocol.hpp"
+#include "nanomq/tiered_storage.hpp"
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace nanomq {
+
+namespace {
+
+constexpr size_t COPY_SIZE = 64 * 1024;
+
+void put_u32(uint8_t* out, uint32_t value) { std::memcpy(out, &value, sizeof(value)); }
+void put_u64(uint8_t* out, uint64_t value) { std::memcpy(out, &value, sizeof(value)); }
+
+// The frame header goes out corked with the records behind it; plain
+// write() for fds that are not sockets
+ssize_t send_header(int fd, const uint8_t* data, size_t size) {
+    const ssize_t n = send(fd, data, size, MSG_MORE | MSG_NOSIGNAL);
+    return n < 0 && errno == ENOTSOCK ? write(fd, data, size) : n;
+}
+
+}  // namespace
+
+LogStreamer::LogStreamer(const std::string& directory, std::shared_ptr<TieredStorage> tier)
+    : segments_(directory, std::move(tier)), position_{0, 0}, in_frame_(false),
+      header_sent_(0), offset_(0), end_(0), copy_(false), bytes_sent_(0) {}
+
+bool LogStreamer::seek(uint64_t message_id) {
+    LogPosition position;
+    if (!segments_.seek(message_id, position)) {
+        return false;
+    }
+    seek(position);
+    return true;
+}
+
+bool LogStreamer::seek_to_timestamp(uint64_t timestamp_ns) {
+    LogPosition position;
+    if (!segments_.seek_to_timestamp(timestamp_ns, position)) {
+        return false;
+    }
+    seek(position);
+    return true;
+}
+
+void LogStreamer::seek(const LogPosition& position) {
+    position_ = position;
+    in_frame_ = false;
+    segment_.reset();
+}
+
+// Start a frame at position_; false when there is nothing after it
+bool LogStreamer::next_frame(size_t max_bytes) {
+    const uint64_t header_end = sizeof(WALSegmentHeader);
+    if (!segment_) {
+        segment_ = std::make_unique<SegmentScanner>();
+        if (!segments_.open_from(position_.segment, *segment_, &path_)) {
+            segment_.reset();
+            return false;
+        }
+        if (segment_->number() != position_.segment || position_.position < header_end) {
+            position_ = LogPosition{segment_->number(), header_end};
+        }
+    }
+    for (;;) {
+        const uint64_t from = position_.position;
+        uint64_t end = from;
+        const auto records = [&] {
+            end = segments_.records_end(segment_->fd(), path_, from, from + max_bytes);
+            return end > from;
+        };
+        if (!records()) {
+            auto following = std::make_unique<SegmentScanner>();
+            std::string path;
+            if (segments_.advance_segment(segment_->number(), *following, records, &path)) {
+                segment_ = std::move(following);
+                path_ = std::move(path);
+                position_ = LogPosition{segment_->number(), header_end};
+                continue;
+            }
+            if (end == from) {
+                return false;
+            }
+        }
+
+        const WALSegmentHeader& header = segment_->header();
+        put_u32(frame_header_, MSG_TYPE_LOG_DATA);
+        put_u32(frame_header_ + 4, static_cast<uint32_t>(16 + end - from));
+        put_u64(frame_header_ + 8, header.base_id);
+        put_u64(frame_header_ + 16, header.base_timestamp);
+        in_frame_ = true;
+        header_sent_ = 0;
+        offset_ = from;
+        end_ = end;
+        return true;
+    }
+}
+
+ssize_t LogStreamer::send_to(int fd, size_t max_bytes) {
+    if (!in_frame_ && !next_frame(max_bytes)) {
+        return 0;
+    }
+    while (header_sent_ < FRAME_HEADER_SIZE) {
+        const ssize_t n = send_header(fd, frame_header_ + header_sent_,
+                                      FRAME_HEADER_SIZE - header_sent_);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -1;
+        }
+        header_sent_ += static_cast<size_t>(n);
+    }
+
+    ssize_t sent = 0;
+    while (offset_ < end_) {
+        const size_t size = static_cast<size_t>(end_ - offset_);
+        ssize_t n;
+        if (copy_) {
+            n = copy_range(fd, size);
+        } else {
+            off_t offset = static_cast<off_t>(offset_);
+            n = sendfile(fd, segment_->fd(), &offset, size);
+            if (n < 0 && (errno == EINVAL || errno == ENOSYS)) {
+                copy_ = true;
+                continue;
+            }
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return sent > 0 ? sent : -1;
+        }
+        if (n == 0) {
+            errno = EIO;  // The segment shrank under us
+            return -1;
+        }
+        offset_ += static_cast<uint64_t>(n);
+        bytes_sent_ += static_cast<uint64_t>(n);
+        sent += n;
+    }
+    in_frame_ = false;
+    position_ = LogPosition{segment_->number(), end_};
+    return sent;
+}
+
+ssize_t LogStreamer::copy_range(int fd, size_t size) {
+    uint8_t buffer[COPY_SIZE];
+    const ssize_t n = pread(segment_->fd(), buffer, std::min(size, sizeof(buffer)),
+                            static_cast<off_t>(offset_));
+    if (n <= 0) {
+        return n;
+    }
+    return write(fd, buffer, static_cast<size_t>(n));
+}
+
+bool decode_log_data(const uint8_t* payload, size_t size, std::vector<Message>& out) {
+    if (size < 16) {
+        return false;
+    }
+    EncodingBase base;
+    std::memcpy(&base.id, payload, 8);
+    std::memcpy(&base.timestamp, payload + 8, 8);
+    const uint8_t* p = payload + 16;
+    const uint8_t* end = payload + size;
+    while (p < end) {
+        uint64_t length = 0;
+        const size_t n = decode_varint(p, end, length);
+        if (n == 0 || length == 0 || length > static_cast<uint64_t>(end - p - n)) {
+            return false;
+        }
+        Message msg;
+        if (decode_message(p + n, static_cast<size_t>(length), msg, base) !=
+                static_cast<size_t>(length) ||
+            !msg.verify_checksum()) {
+            return false;
+        }
+        out.push_back(msg);
+        p += n + length;
+    }
+    return true;
+}
+
+}  // namespace nanomq
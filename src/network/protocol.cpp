@@ -1,53 +1,96 @@
-#include "nanomq/message.hpp"
+#include "nanomq/protocol.hpp"
 #include <cstring>
 
 namespace nanomq {
 
-// Binary protocol for network communication
-// Protocol format:
-// [4 bytes: message type] [4 bytes: payload length] [N bytes: payload]
+namespace {
 
-enum MessageType : uint32_t {
-    MSG_TYPE_PUBLISH = 1,
-    MSG_TYPE_SUBSCRIBE = 2,
-    MSG_TYPE_UNSUBSCRIBE = 3,
-    MSG_TYPE_ACK = 4,
-    MSG_TYPE_DATA = 5,
-};
+int64_t delta(uint64_t value, uint64_t base) {
+    return static_cast<int64_t>(value - base);
+}
+
+}  // namespace
+
+size_t encoded_size(const Message& msg, const EncodingBase& base) {
+    return varint_size(zigzag_encode(delta(msg.header.id, base.id))) +
+           varint_size(zigzag_encode(delta(msg.header.timestamp, base.timestamp))) +
+           varint_size(msg.header.topic_id) +
+           varint_size(msg.header.flags) +
+           varint_size(msg.header.size) +
+           sizeof(uint32_t) + msg.header.size;
+}
 
 // Encode a message to wire format
-size_t encode_message(const Message& msg, uint8_t* buffer, size_t buffer_size) {
-    if (buffer_size < sizeof(MessageHeader) + msg.header.size) {
+size_t encode_message(const Message& msg, uint8_t* buffer, size_t buffer_size,
+                      const EncodingBase& base) {
+    // Only measure exactly when the buffer might be too small
+    if (buffer_size < MAX_COMPACT_HEADER_SIZE + msg.header.size &&
+        buffer_size < encoded_size(msg, base)) {
         return 0;
     }
 
-    // Copy header
-    std::memcpy(buffer, &msg.header, sizeof(MessageHeader));
-    
+    size_t n = 0;
+    n += encode_varint(zigzag_encode(delta(msg.header.id, base.id)), buffer + n);
+    n += encode_varint(zigzag_encode(delta(msg.header.timestamp, base.timestamp)),
+                       buffer + n);
+    n += encode_varint(msg.header.topic_id, buffer + n);
+    n += encode_varint(msg.header.flags, buffer + n);
+    n += encode_varint(msg.header.size, buffer + n);
+
+    const uint32_t crc = msg.header.crc32;
+    buffer[n++] = static_cast<uint8_t>(crc);
+    buffer[n++] = static_cast<uint8_t>(crc >> 8);
+    buffer[n++] = static_cast<uint8_t>(crc >> 16);
+    buffer[n++] = static_cast<uint8_t>(crc >> 24);
+
     // Copy payload
-    std::memcpy(buffer + sizeof(MessageHeader), msg.data, msg.header.size);
-    
-    return sizeof(MessageHeader) + msg.header.size;
+    if (msg.header.size > 0) {
+        std::memcpy(buffer + n, msg.data, msg.header.size);
+    }
+    return n + msg.header.size;
 }
 
 // Decode a message from wire format
-bool decode_message(const uint8_t* buffer, size_t buffer_size, Message& msg) {
-    if (buffer_size < sizeof(MessageHeader)) {
-        return false;
+size_t decode_message(const uint8_t* buffer, size_t buffer_size, Message& msg,
+                      const EncodingBase& base) {
+    const uint8_t* p = buffer;
+    const uint8_t* end = buffer + buffer_size;
+
+    // id delta, timestamp delta, topic_id, flags, size
+    uint64_t fields[5];
+    for (uint64_t& field : fields) {
+        const size_t n = decode_varint(p, end, field);
+        if (n == 0) {
+            return 0;
+        }
+        p += n;
     }
+    const uint64_t topic_id = fields[2];
+    const uint64_t flags = fields[3];
+    const uint64_t size = fields[4];
 
-    // Copy header
-    std::memcpy(&msg.header, buffer, sizeof(MessageHeader));
-    
-    if (buffer_size < sizeof(MessageHeader) + msg.header.size) {
-        return false;
+    if (topic_id > UINT32_MAX || flags > UINT32_MAX ||
+        size > static_cast<size_t>(end - p) ||
+        static_cast<size_t>(end - p) - size < sizeof(uint32_t)) {
+        return 0;
     }
 
+    msg.header = MessageHeader();
+    msg.header.id = base.id + static_cast<uint64_t>(zigzag_decode(fields[0]));
+    msg.header.timestamp =
+        base.timestamp + static_cast<uint64_t>(zigzag_decode(fields[1]));
+    msg.header.topic_id = static_cast<uint32_t>(topic_id);
+    msg.header.flags = static_cast<uint32_t>(flags);
+    msg.header.size = static_cast<uint32_t>(size);
+    msg.header.crc32 = static_cast<uint32_t>(p[0]) |
+                       static_cast<uint32_t>(p[1]) << 8 |
+                       static_cast<uint32_t>(p[2]) << 16 |
+                       static_cast<uint32_t>(p[3]) << 24;
+    p += sizeof(uint32_t);
+
     // Point to payload (zero-copy)
-    msg.data = const_cast<uint8_t*>(buffer + sizeof(MessageHeader));
-    
-    return true;
+    msg.data = const_cast<uint8_t*>(p);
+    return static_cast<size_t>(p - buffer) + size;
 }
 
 }  // namespace nanomq
-
@@ -0,0 +1,621 @@
+#include "nanomq/shm_transport.hpp"
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+namespace nanomq {
+
+namespace {
+
+constexpr uint32_t RING_MAGIC = 0x4E4D5152;      // 'NMQR'
+constexpr uint32_t REGISTRY_MAGIC = 0x4E4D5153;  // 'NMQS'
+constexpr uint32_t SHM_VERSION = 1;
+
+// Channel slot lifecycle; client_pid != 0 marks the slot as taken
+enum SlotState : uint32_t {
+    SLOT_FREE = 0,
+    SLOT_REQUESTED = 1,  // Client filled in topic/direction
+    SLOT_READY = 2,      // Broker created the ring, ring_name is valid
+    SLOT_ATTACHED = 3,   // Client mapped the ring
+    SLOT_CLOSED = 4,     // Client is gone, broker may reap
+    SLOT_FAILED = 5,     // Broker could not create the ring
+};
+
+struct alignas(CACHE_LINE_SIZE) RegistrySlot {
+    std::atomic<uint32_t> state;
+    std::atomic<int32_t> client_pid;
+    uint32_t direction;
+    uint32_t generation;
+    char topic[SHM_MAX_TOPIC_LENGTH + 1];
+    char ring_name[64];
+};
+
+struct Registry {
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<int32_t> broker_pid;
+    RegistrySlot slots[SHM_MAX_CHANNELS];
+};
+
+Registry* as_registry(ShmSegment& segment) {
+    return static_cast<Registry*>(segment.data());
+}
+
+void futex_wait(std::atomic<uint32_t>* word, uint32_t expected,
+                uint64_t timeout_ns) {
+#ifdef __linux__
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(timeout_ns / 1000000000ULL);
+    ts.tv_nsec = static_cast<long>(timeout_ns % 1000000000ULL);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT,
+            expected, &ts, nullptr, 0);
+#else
+    (void)word;
+    (void)expected;
+    std::this_thread::sleep_for(std::chrono::nanoseconds(
+        timeout_ns < 50000 ? timeout_ns : 50000));
+#endif
+}
+
+void futex_wake_all(std::atomic<uint32_t>* word) {
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE,
+            INT32_MAX, nullptr, nullptr, 0);
+#else
+    (void)word;
+#endif
+}
+
+std::string registry_name(const std::string& name) {
+    return "/nanomq." + name;
+}
+
+size_t control_bytes() {
+    return (sizeof(ShmRingControl) + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1);
+}
+
+size_t record_bytes(size_t size) {
+    return (sizeof(MessageHeader) + size + CACHE_LINE_SIZE - 1) &
+           ~(CACHE_LINE_SIZE - 1);
+}
+
+size_t round_up_pow2(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+}  // namespace
+
+bool parse_shm_address(const std::string& address, std::string& name) {
+    const size_t scheme_len = std::strlen(SHM_SCHEME);
+    if (address.compare(0, scheme_len, SHM_SCHEME) != 0) {
+        return false;
+    }
+    name = address.substr(scheme_len);
+    // POSIX shm names are a single path component
+    return !name.empty() && name.find('/') == std::string::npos;
+}
+
+bool process_alive(pid_t pid) {
+    if (pid <= 0) {
+        return false;
+    }
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+// --- ShmSegment -----------------------------------------------------------
+
+ShmSegment::ShmSegment(const std::string& name, void* data, size_t size,
+                       bool owner)
+    : name_(name), data_(data), size_(size), linked_(owner) {}
+
+ShmSegment::~ShmSegment() {
+    munmap(data_, size_);
+    unlink();
+}
+
+std::unique_ptr<ShmSegment> ShmSegment::create(const std::string& name,
+                                               size_t size) {
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        return nullptr;
+    }
+    void* data = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+        data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);  // The mapping keeps the memory alive
+    if (data == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+    return std::unique_ptr<ShmSegment>(new ShmSegment(name, data, size, true));
+}
+
+std::unique_ptr<ShmSegment> ShmSegment::open(const std::string& name) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(nullptr, static_cast<size_t>(st.st_size),
+                    PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        return nullptr;
+    }
+    return std::unique_ptr<ShmSegment>(
+        new ShmSegment(name, data, static_cast<size_t>(st.st_size), false));
+}
+
+void ShmSegment::unlink() {
+    if (linked_) {
+        shm_unlink(name_.c_str());
+        linked_ = false;
+    }
+}
+
+// --- ShmRing --------------------------------------------------------------
+
+size_t ShmRing::segment_size(size_t capacity) {
+    return control_bytes() + capacity;
+}
+
+void ShmRing::initialize(void* memory, size_t capacity) {
+    ShmRingControl* control = new (memory) ShmRingControl();
+    control->magic = RING_MAGIC;
+    control->version = SHM_VERSION;
+    control->capacity = capacity;
+    control->head.store(0, std::memory_order_relaxed);
+    control->tail.store(0, std::memory_order_release);
+}
+
+bool ShmRing::attach(void* memory, size_t size) {
+    ShmRingControl* control = static_cast<ShmRingControl*>(memory);
+    const size_t capacity = control->capacity;
+    if (size < control_bytes() || control->magic != RING_MAGIC ||
+        control->version != SHM_VERSION || capacity < 4 * CACHE_LINE_SIZE ||
+        (capacity & (capacity - 1)) != 0 || segment_size(capacity) > size) {
+        return false;
+    }
+    control_ = control;
+    records_ = static_cast<uint8_t*>(memory) + control_bytes();
+    capacity_ = capacity;
+    pending_ = control_->head.load(std::memory_order_acquire);
+    cached_tail_ = control_->tail.load(std::memory_order_acquire);
+    read_ = cached_tail_;
+    last_read_ = read_;
+    cached_head_ = pending_;
+    broken_ = false;
+    return true;
+}
+
+MessageHeader* ShmRing::claim(uint32_t size) {
+    if (size > max_payload()) {
+        return nullptr;
+    }
+    const size_t need = record_bytes(size);
+    uint64_t pos = pending_;
+    const size_t index = pos & (capacity_ - 1);
+    const size_t pad = (index + need > capacity_) ? capacity_ - index : 0;
+
+    if (pos + pad + need - cached_tail_ > capacity_) {
+        cached_tail_ = control_->tail.load(std::memory_order_acquire);
+        if (pos + pad + need - cached_tail_ > capacity_) {
+            return nullptr;  // Ring is full
+        }
+    }
+
+    if (pad > 0) {
+        MessageHeader* filler = new (records_ + index) MessageHeader();
+        filler->size = static_cast<uint32_t>(pad);
+        filler->flags = MSG_FLAG_PADDING;
+        pos += pad;
+    }
+    MessageHeader* header =
+        new (records_ + (pos & (capacity_ - 1))) MessageHeader();
+    header->size = size;
+    pending_ = pos + need;
+    return header;
+}
+
+void ShmRing::publish() {
+    control_->head.store(pending_, std::memory_order_release);
+    control_->doorbell.notify();
+}
+
+bool ShmRing::try_write(const MessageHeader& header, const void* payload) {
+    MessageHeader* record = claim(header.size);
+    if (record == nullptr) {
+        return false;
+    }
+    *record = header;
+    if (header.size > 0) {
+        std::memcpy(this->payload(record), payload, header.size);
+    }
+    publish();
+    return true;
+}
+
+bool ShmRing::has_room(uint32_t size) {
+    if (size > max_payload()) {
+        return false;
+    }
+    const size_t need = record_bytes(size);
+    const size_t index = pending_ & (capacity_ - 1);
+    const size_t pad = (index + need > capacity_) ? capacity_ - index : 0;
+    cached_tail_ = control_->tail.load(std::memory_order_acquire);
+    return pending_ + pad + need - cached_tail_ <= capacity_;
+}
+
+bool ShmRing::try_read(Message& msg) {
+    if (broken_) {
+        return false;
+    }
+    uint64_t pos = read_;
+    for (;;) {
+        if (pos == cached_head_) {
+            cached_head_ = control_->head.load(std::memory_order_acquire);
+            if (pos == cached_head_) {
+                read_ = pos;
+                return false;  // Ring is empty
+            }
+        }
+        // The peer owns head; never trust it further than one ring
+        if (cached_head_ - pos > capacity_) {
+            broken_ = true;
+            return false;
+        }
+
+        const size_t index = pos & (capacity_ - 1);
+        uint8_t* record = records_ + index;
+        // Validate a private copy so the peer cannot change it underneath us
+        std::memcpy(&msg.header, record, sizeof(MessageHeader));
+        if ((msg.header.flags & MSG_FLAG_PADDING) != 0) {
+            const uint64_t pad = msg.header.size;
+            if (index + pad != capacity_ || pos + pad > cached_head_) {
+                broken_ = true;
+                return false;
+            }
+            pos += pad;  // Skip to the start of the buffer
+            continue;
+        }
+        const size_t bytes = record_bytes(msg.header.size);
+        if (msg.header.size > max_payload() || index + bytes > capacity_ ||
+            pos + bytes > cached_head_) {
+            broken_ = true;
+            return false;
+        }
+        msg.data = record + sizeof(MessageHeader);
+        last_read_ = read_;
+        read_ = pos + bytes;
+        return true;
+    }
+}
+
+void ShmRing::unread() {
+    read_ = last_read_;
+}
+
+void ShmRing::release() {
+    control_->tail.store(read_, std::memory_order_release);
+}
+
+bool ShmRing::wait(uint64_t timeout_ns) {
+    return control_->doorbell.wait_until(
+        [this]() {
+            return control_->head.load(std::memory_order_acquire) != read_;
+        },
+        timeout_ns);
+}
+
+// --- ShmServer ------------------------------------------------------------
+
+ShmServer::ShmServer(const std::string& name, size_t ring_bytes)
+    : name_(name),
+      ring_bytes_(round_up_pow2(ring_bytes < 4096 ? 4096 : ring_bytes)) {}
+
+ShmServer::~ShmServer() {
+    if (!registry_) {
+        return;
+    }
+    for (size_t slot = 0; slot < SHM_MAX_CHANNELS; ++slot) {
+        close_channel(slot);
+    }
+    as_registry(*registry_)->broker_pid.store(0, std::memory_order_release);
+}
+
+bool ShmServer::start() {
+    const std::string path = registry_name(name_);
+    registry_ = ShmSegment::create(path, sizeof(Registry));
+    if (!registry_) {
+        // Take over a registry left behind by a broker that died
+        auto stale = ShmSegment::open(path);
+        if (stale && stale->size() >= sizeof(Registry)) {
+            Registry* old = static_cast<Registry*>(stale->data());
+            if (old->magic == REGISTRY_MAGIC &&
+                process_alive(old->broker_pid.load(std::memory_order_acquire))) {
+                return false;  // Another broker owns this name
+            }
+        }
+        shm_unlink(path.c_str());
+        registry_ = ShmSegment::create(path, sizeof(Registry));
+        if (!registry_) {
+            return false;
+        }
+    }
+
+    Registry* registry = new (registry_->data()) Registry();
+    for (size_t slot = 0; slot < SHM_MAX_CHANNELS; ++slot) {
+        registry->slots[slot].state.store(SLOT_FREE, std::memory_order_relaxed);
+        registry->slots[slot].client_pid.store(0, std::memory_order_relaxed);
+    }
+    registry->version = SHM_VERSION;
+    registry->broker_pid.store(getpid(), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    registry->magic = REGISTRY_MAGIC;
+    return true;
+}
+
+size_t ShmServer::poll_channels() {
+    if (!registry_) {
+        return 0;
+    }
+    route();  // Drain publishers before reaping them
+
+    Registry* registry = as_registry(*registry_);
+    size_t changes = 0;
+    for (size_t slot = 0; slot < SHM_MAX_CHANNELS; ++slot) {
+        RegistrySlot& entry = registry->slots[slot];
+        const pid_t pid = entry.client_pid.load(std::memory_order_acquire);
+        if (pid == 0) {
+            continue;
+        }
+        const uint32_t state = entry.state.load(std::memory_order_acquire);
+
+        if (state == SLOT_CLOSED || !process_alive(pid)) {
+            close_channel(slot);
+            ++changes;
+        } else if (state == SLOT_REQUESTED && !channels_[slot]) {
+            open_channel(slot);
+            ++changes;
+        } else if (state == SLOT_ATTACHED && channels_[slot] &&
+                   !channels_[slot]->attached) {
+            // Both sides have it mapped; the name is no longer needed
+            channels_[slot]->segment->unlink();
+            channels_[slot]->attached = true;
+            ++changes;
+        }
+    }
+    return changes;
+}
+
+void ShmServer::open_channel(size_t slot) {
+    RegistrySlot& entry = as_registry(*registry_)->slots[slot];
+    entry.topic[SHM_MAX_TOPIC_LENGTH] = '\0';
+
+    auto channel = std::make_unique<Channel>();
+    channel->direction = static_cast<ShmDirection>(entry.direction);
+    channel->topic = entry.topic;
+    channel->client_pid = entry.client_pid.load(std::memory_order_relaxed);
+    channel->attached = false;
+
+    ++entry.generation;
+    const std::string ring_name = registry_name(name_) + "." +
+                                  std::to_string(slot) + "." +
+                                  std::to_string(entry.generation);
+    const size_t size = ShmRing::segment_size(ring_bytes_);
+    channel->segment = ShmSegment::create(ring_name, size);
+
+    uint32_t result = SLOT_FAILED;
+    if (channel->segment) {
+        ShmRing::initialize(channel->segment->data(), ring_bytes_);
+        if (channel->ring.attach(channel->segment->data(), size)) {
+            std::strncpy(entry.ring_name, ring_name.c_str(),
+                         sizeof(entry.ring_name) - 1);
+            entry.ring_name[sizeof(entry.ring_name) - 1] = '\0';
+            channels_[slot] = std::move(channel);
+            result = SLOT_READY;
+        }
+    }
+    // The client may have given up waiting in the meantime
+    uint32_t expected = SLOT_REQUESTED;
+    if (!entry.state.compare_exchange_strong(expected, result,
+                                             std::memory_order_acq_rel)) {
+        close_channel(slot);
+        return;
+    }
+    futex_wake_all(&entry.state);
+}
+
+void ShmServer::close_channel(size_t slot) {
+    channels_[slot].reset();  // Unmaps, and unlinks if never attached
+    RegistrySlot& entry = as_registry(*registry_)->slots[slot];
+    if (entry.client_pid.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    entry.state.store(SLOT_FREE, std::memory_order_relaxed);
+    entry.ring_name[0] = '\0';
+    entry.client_pid.store(0, std::memory_order_release);
+    futex_wake_all(&entry.state);
+}
+
+size_t ShmServer::route() {
+    size_t moved = 0;
+    for (size_t p = 0; p < SHM_MAX_CHANNELS; ++p) {
+        Channel* source = channels_[p].get();
+        if (source == nullptr || source->direction != ShmDirection::PUBLISH) {
+            continue;
+        }
+
+        Channel* targets[SHM_MAX_CHANNELS];
+        size_t target_count = 0;
+        for (size_t s = 0; s < SHM_MAX_CHANNELS; ++s) {
+            Channel* target = channels_[s].get();
+            if (target != nullptr && target->direction == ShmDirection::SUBSCRIBE &&
+                target->topic == source->topic) {
+                targets[target_count++] = target;
+            }
+        }
+
+        // Without subscribers messages are dropped, as for a live topic
+        Message msg;
+        while (source->ring.try_read(msg)) {
+            // Only consume a record once every subscriber has room for it
+            bool blocked = false;
+            for (size_t t = 0; t < target_count; ++t) {
+                if (!targets[t]->ring.has_room(msg.header.size)) {
+                    blocked = true;
+                    break;
+                }
+            }
+            if (blocked) {
+                source->ring.unread();
+                break;
+            }
+            for (size_t t = 0; t < target_count; ++t) {
+                MessageHeader* record = targets[t]->ring.claim(msg.header.size);
+                *record = msg.header;
+                std::memcpy(ShmRing::payload(record), msg.data, msg.header.size);
+            }
+            ++moved;
+        }
+        source->ring.release();
+        for (size_t t = 0; t < target_count; ++t) {
+            targets[t]->ring.publish();
+        }
+        if (source->ring.is_broken()) {
+            close_channel(p);  // Client wrote garbage; cut it off
+        }
+    }
+    return moved;
+}
+
+size_t ShmServer::channel_count() const {
+    size_t count = 0;
+    for (size_t slot = 0; slot < SHM_MAX_CHANNELS; ++slot) {
+        if (channels_[slot]) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+// --- ShmChannel -----------------------------------------------------------
+
+ShmChannel::~ShmChannel() {
+    if (!registry_) {
+        return;
+    }
+    RegistrySlot& entry = as_registry(*registry_)->slots[slot_];
+    entry.state.store(SLOT_CLOSED, std::memory_order_release);
+}
+
+std::unique_ptr<ShmChannel> ShmChannel::connect(const std::string& name,
+                                                const std::string& topic,
+                                                ShmDirection direction,
+                                                uint64_t timeout_us) {
+    if (topic.size() > SHM_MAX_TOPIC_LENGTH) {
+        return nullptr;
+    }
+    auto registry = ShmSegment::open(registry_name(name));
+    if (!registry || registry->size() < sizeof(Registry)) {
+        return nullptr;
+    }
+    Registry* reg = as_registry(*registry);
+    const pid_t broker_pid = reg->broker_pid.load(std::memory_order_acquire);
+    if (reg->magic != REGISTRY_MAGIC || reg->version != SHM_VERSION ||
+        !process_alive(broker_pid)) {
+        return nullptr;
+    }
+
+    // Claim a free slot by writing our pid into it
+    const int32_t pid = static_cast<int32_t>(getpid());
+    size_t slot = 0;
+    for (; slot < SHM_MAX_CHANNELS; ++slot) {
+        int32_t expected = 0;
+        if (reg->slots[slot].client_pid.compare_exchange_strong(
+                expected, pid, std::memory_order_acq_rel)) {
+            break;
+        }
+    }
+    if (slot == SHM_MAX_CHANNELS) {
+        return nullptr;
+    }
+
+    RegistrySlot& entry = reg->slots[slot];
+    entry.direction = static_cast<uint32_t>(direction);
+    std::memset(entry.topic, 0, sizeof(entry.topic));
+    std::memcpy(entry.topic, topic.data(), topic.size());
+    entry.state.store(SLOT_REQUESTED, std::memory_order_release);
+
+    // Wait for the broker to create the ring
+    const auto deadline = std::chrono::steady_clock::now() +
+                          std::chrono::microseconds(timeout_us);
+    uint32_t state;
+    while ((state = entry.state.load(std::memory_order_acquire)) == SLOT_REQUESTED) {
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            break;
+        }
+        const uint64_t remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            deadline - now).count();
+        // Wake up now and then to notice a broker that died meanwhile
+        futex_wait(&entry.state, SLOT_REQUESTED,
+                   remaining < 10000000 ? remaining : 10000000);
+        if (!process_alive(broker_pid)) {
+            break;
+        }
+    }
+
+    std::unique_ptr<ShmChannel> channel(new ShmChannel());
+    channel->slot_ = slot;
+    channel->broker_pid_ = broker_pid;
+    if (state == SLOT_READY) {
+        channel->segment_ = ShmSegment::open(entry.ring_name);
+        if (channel->segment_ &&
+            channel->ring_.attach(channel->segment_->data(),
+                                  channel->segment_->size())) {
+            entry.state.store(SLOT_ATTACHED, std::memory_order_release);
+            channel->registry_ = std::move(registry);
+            return channel;
+        }
+    }
+
+    // Give the slot back; a broker that is still working on it reaps it
+    if (state == SLOT_REQUESTED &&
+        entry.state.compare_exchange_strong(state, SLOT_CLOSED,
+                                            std::memory_order_acq_rel)) {
+        return nullptr;
+    }
+    entry.state.store(SLOT_CLOSED, std::memory_order_release);
+    if (state == SLOT_FAILED || !process_alive(broker_pid)) {
+        entry.state.store(SLOT_FREE, std::memory_order_relaxed);
+        entry.client_pid.store(0, std::memory_order_release);
+    }
+    return nullptr;
+}
+
+bool ShmChannel::broker_alive() const {
+    return process_alive(broker_pid_);
+}
+
+}  // namespace nanomq
@@ -0,0 +1,373 @@
+#include "nanomq/compaction.hpp"
+#include "nanomq/protocol.hpp"
+#include "nanomq/record_batch.hpp"
+#include "nanomq/segment.hpp"
+#include "nanomq/tiered_storage.hpp"
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace nanomq {
+
+namespace {
+
+constexpr const char* CLEANED_SUFFIX = ".cleaned.wal";
+constexpr size_t WRITE_SIZE = 64 * 1024;
+
+// Keeps a byte stream under a rate by sleeping
+class IoThrottle {
+public:
+    explicit IoThrottle(uint64_t bytes_per_sec)
+        : rate_(bytes_per_sec), start_(std::chrono::steady_clock::now()), bytes_(0) {}
+
+    void consume(size_t bytes) {
+        if (rate_ == 0) {
+            return;
+        }
+        bytes_ += bytes;
+        // Whole seconds first: bytes_ * 1e9 overflows after about 18 GB
+        const auto due = start_ + std::chrono::seconds(bytes_ / rate_) +
+                         std::chrono::nanoseconds(bytes_ % rate_ * 1000000000 / rate_);
+        if (due > std::chrono::steady_clock::now()) {
+            std::this_thread::sleep_until(due);
+        }
+    }
+
+private:
+    const uint64_t rate_;
+    const std::chrono::steady_clock::time_point start_;
+    uint64_t bytes_;
+};
+
+bool write_all(int fd, const uint8_t* data, size_t size, uint64_t offset) {
+    while (size > 0) {
+        const ssize_t n = pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+void sync_directory(const std::string& directory) {
+    const int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+// Leftovers of a pass that died mid-rewrite
+void remove_cleaned_files(const std::string& directory) {
+    if (DIR* dir = opendir(directory.c_str())) {
+        while (struct dirent* entry = readdir(dir)) {
+            if (std::strstr(entry->d_name, ".cleaned.") != nullptr) {
+                unlink((directory + "/" + entry->d_name).c_str());
+            }
+        }
+        closedir(dir);
+    }
+}
+
+// Compaction key of a record: topic_id and Message::key(); false if unkeyed
+bool compaction_key(const Message& msg, std::string& key) {
+    const uint8_t* data;
+    size_t size;
+    if (!msg.key(data, size)) {
+        return false;
+    }
+    key.assign(reinterpret_cast<const char*>(&msg.header.topic_id), sizeof(msg.header.topic_id));
+    key.append(reinterpret_cast<const char*>(data), size);
+    return true;
+}
+
+// Place of a record in the log; later records compare greater. record is
+// its index in the batch at position, 0 outside batches (segment positions
+// stay below 2^32 and batches compaction opens hold at most 256 records)
+uint64_t log_order(uint32_t segment, uint64_t position, size_t record) {
+    return static_cast<uint64_t>(segment) << 40 | position << 8 | record;
+}
+
+// Start reading the records of a batch entry for compaction; false for a
+// malformed or oversized batch, which is left whole like an unkeyed record
+bool open_batch(const Message& msg, RecordBatchReader& reader) {
+    return msg.has_flag(MSG_FLAG_BATCH) && reader.reset(msg) &&
+           reader.remaining() <= MessageBatch::MAX_BATCH_SIZE;
+}
+
+}  // namespace
+
+LogCompactor::LogCompactor(const std::string& directory, const CompactionPolicy& policy,
+                           std::shared_ptr<TieredStorage> tier)
+    : directory_(directory), policy_(policy), tier_(std::move(tier)), stopping_(false),
+      cancel_(false) {}
+
+LogCompactor::~LogCompactor() {
+    stop();
+}
+
+void LogCompactor::start() {
+    if (thread_.joinable()) {
+        return;
+    }
+    stopping_ = false;
+    cancel_ = false;
+    thread_ = std::thread(&LogCompactor::run, this);
+}
+
+void LogCompactor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cancel_ = true;
+    wakeup_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    cancel_ = false;
+}
+
+void LogCompactor::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        if (wakeup_.wait_for(lock, std::chrono::milliseconds(policy_.interval_ms),
+                             [this] { return stopping_; })) {
+            break;
+        }
+        lock.unlock();
+        run_once();
+        lock.lock();
+    }
+}
+
+CompactionStats LogCompactor::run_once() {
+    std::lock_guard<std::mutex> pass(pass_mutex_);
+    CompactionStats stats;
+    remove_cleaned_files(directory_);
+    SegmentManager segments(directory_, tier_);
+    if (policy_.retention_ms > 0) {
+        stats.segments_deleted += segments.cleanup_old_segments(policy_.retention_ms);
+    }
+    if (policy_.retention_bytes > 0) {
+        stats.segments_deleted += segments.cleanup_to_size(policy_.retention_bytes);
+    }
+    if (tier_) {
+        stats.segments_archived += tier_->archive_old_segments();
+    }
+    if (policy_.compact_keys) {
+        compact(stats);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    totals_.segments_deleted += stats.segments_deleted;
+    totals_.segments_compacted += stats.segments_compacted;
+    totals_.segments_archived += stats.segments_archived;
+    totals_.records_removed += stats.records_removed;
+    totals_.bytes_reclaimed += stats.bytes_reclaimed;
+    return stats;
+}
+
+CompactionStats LogCompactor::totals() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return totals_;
+}
+
+void LogCompactor::compact(CompactionStats& stats) {
+    IoThrottle throttle(policy_.max_bytes_per_sec);
+    const auto files = segment_files(directory_);
+
+    // Latest record of every key, and how many records each segment has
+    // that a later one supersedes
+    std::unordered_map<std::string, uint64_t> latest;
+    std::unordered_map<uint32_t, uint64_t> superseded;
+    size_t sealed = 0;  // Segments before the last one with a record
+    std::string key;
+    Message msg;
+    Message record;
+    RecordBatchReader records;
+    const auto note = [&](const Message& m, uint64_t order) {
+        if (compaction_key(m, key)) {
+            auto entry = latest.emplace(key, order);
+            if (!entry.second) {
+                ++superseded[static_cast<uint32_t>(entry.first->second >> 40)];
+                entry.first->second = order;
+            }
+        }
+    };
+    // Whether a later record has the key of the one at order
+    const auto is_superseded = [&](const Message& m, uint64_t order) {
+        if (!compaction_key(m, key)) {
+            return false;
+        }
+        const auto entry = latest.find(key);
+        return entry != latest.end() && entry->second != order;
+    };
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        SegmentScanner scanner;
+        if (!scanner.open(files[i].second, files[i].first)) {
+            continue;
+        }
+        uint64_t position = scanner.position();
+        while (scanner.next(msg)) {
+            if (cancel_) {
+                return;
+            }
+            throttle.consume(scanner.record_size());
+            sealed = i;
+            if (open_batch(msg, records)) {
+                for (size_t r = 0; records.next(record); ++r) {
+                    note(record, log_order(files[i].first, position, r));
+                }
+            } else if (!msg.has_flag(MSG_FLAG_BATCH)) {
+                note(msg, log_order(files[i].first, position, 0));
+            }
+            position = scanner.position();
+        }
+    }
+
+    for (size_t i = 0; i < sealed && !cancel_; ++i) {
+        const uint32_t number = files[i].first;
+        const std::string& path = files[i].second;
+        if (superseded[number] == 0) {
+            continue;
+        }
+        SegmentScanner scanner;
+        if (!scanner.open(path, number)) {
+            continue;
+        }
+        const std::string cleaned = path.substr(0, path.size() - 4) + CLEANED_SUFFIX;
+        const int fd = ::open(cleaned.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            continue;
+        }
+        std::unique_ptr<SegmentIndexWriter> index;
+        struct stat st;
+        try {
+            index = std::make_unique<SegmentIndexWriter>(
+                cleaned, stat(path.c_str(), &st) == 0 ? static_cast<size_t>(st.st_size) : 0);
+        } catch (const std::runtime_error&) {
+            close(fd);
+            remove_segment(cleaned);
+            continue;
+        }
+
+        // Copy the records still wanted, encoded as they are: the header,
+        // and so the base ids and timestamps, stay the same. A batch with
+        // superseded records is rebuilt from the others, compressed if it
+        // was
+        const EncodingBase base{scanner.header().base_id, scanner.header().base_timestamp};
+        std::vector<uint8_t> out(reinterpret_cast<const uint8_t*>(&scanner.header()),
+                                 reinterpret_cast<const uint8_t*>(&scanner.header()) +
+                                     sizeof(WALSegmentHeader));
+        uint64_t written = 0;
+        uint64_t kept = 0;
+        uint64_t removed = 0;
+        uint64_t reclaimed = 0;
+        MessageBatch rebuilt;
+        bool ok = true;
+        uint64_t position = scanner.position();
+        while (ok && !cancel_ && scanner.next(msg)) {
+            size_t batch_removed = 0;
+            bool rebuilt_ok = true;
+            if (open_batch(msg, records)) {
+                rebuilt.clear();
+                for (size_t r = 0; records.next(record); ++r) {
+                    if (is_superseded(record, log_order(number, position, r))) {
+                        ++batch_removed;
+                    } else {
+                        rebuilt_ok = rebuilt_ok && rebuilt.add(record);
+                    }
+                }
+            }
+
+            if (batch_removed > 0 && rebuilt_ok && rebuilt.is_empty()) {
+                removed += batch_removed;
+                reclaimed += scanner.record_size();
+            } else if (batch_removed > 0 && rebuilt_ok) {
+                const Message batch = rebuilt.finish(msg.has_flag(MSG_FLAG_COMPRESSED));
+                const size_t length = encoded_size(batch, base);
+                const size_t start = out.size();
+                out.resize(start + varint_size(length) + length);
+                uint8_t* p = out.data() + start;
+                p += encode_varint(length, p);
+                encode_message(batch, p, length, base);
+
+                uint64_t last_id, max_timestamp;
+                message_bounds(batch, last_id, max_timestamp);
+                index->add(last_id, max_timestamp, written + start);
+                removed += batch_removed;
+                const size_t rebuilt_size = out.size() - start;
+                reclaimed += scanner.record_size() > rebuilt_size
+                                 ? scanner.record_size() - rebuilt_size : 0;
+                ++kept;
+            } else if (is_superseded(msg, log_order(number, position, 0))) {
+                ++removed;
+                reclaimed += scanner.record_size();
+            } else {
+                uint64_t last_id, max_timestamp;
+                message_bounds(msg, last_id, max_timestamp);
+                index->add(last_id, max_timestamp, written + out.size());
+                out.insert(out.end(), scanner.record(),
+                           scanner.record() + scanner.record_size());
+                ++kept;
+            }
+            if (out.size() >= WRITE_SIZE) {
+                ok = write_all(fd, out.data(), out.size(), written);
+                throttle.consume(out.size());
+                written += out.size();
+                out.clear();
+            }
+            position = scanner.position();
+        }
+        // A corrupt record would cut the segment short; leave it alone
+        ok = ok && !cancel_ && scanner.at_end() &&
+             write_all(fd, out.data(), out.size(), written) && fdatasync(fd) == 0;
+        throttle.consume(out.size());
+        close(fd);
+        index.reset();
+        if (!ok) {
+            remove_segment(cleaned);
+            continue;
+        }
+
+        if (kept == 0) {
+            remove_segment(cleaned);
+            remove_segment(path);
+            ++stats.segments_deleted;
+        } else {
+            // Without indexes readers scan, so none sees positions of the
+            // other file
+            unlink(offset_index_path(path).c_str());
+            unlink(time_index_path(path).c_str());
+            if (rename(cleaned.c_str(), path.c_str()) != 0) {
+                remove_segment(cleaned);
+                continue;
+            }
+            rename(offset_index_path(cleaned).c_str(), offset_index_path(path).c_str());
+            rename(time_index_path(cleaned).c_str(), time_index_path(path).c_str());
+            ++stats.segments_compacted;
+        }
+        sync_directory(directory_);
+        stats.records_removed += removed;
+        stats.bytes_reclaimed += reclaimed;
+    }
+}
+
+}  // namespace nanomq
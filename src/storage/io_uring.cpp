@@ -0,0 +1,202 @@
+#include "nanomq/io_uring.hpp"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+namespace nanomq {
+
+namespace {
+
+int io_uring_setup(unsigned entries, struct io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(
+        syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int io_uring_register(int fd, unsigned opcode, const void* arg, unsigned nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+template <typename T>
+T* at(void* base, uint32_t offset) {
+    return reinterpret_cast<T*>(static_cast<uint8_t*>(base) + offset);
+}
+
+// The kernel side of the rings is read and written concurrently
+inline unsigned load_acquire(const unsigned* p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+inline void store_release(unsigned* p, unsigned value) {
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+}  // namespace
+
+IoUring::IoUring(unsigned entries)
+    : fd_(-1), entries_(0), sq_ring_(MAP_FAILED), sq_ring_size_(0),
+      cq_ring_(MAP_FAILED), cq_ring_size_(0), sqes_(nullptr), sqes_size_(0),
+      sq_head_(nullptr), sq_tail_(nullptr), sq_mask_(nullptr), sq_array_(nullptr),
+      sqe_tail_(0), sqe_head_(0), cq_head_(nullptr), cq_tail_(nullptr),
+      cq_mask_(nullptr), cqes_(nullptr) {
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    const int fd = io_uring_setup(entries, &params);
+    if (fd < 0) {
+        return;
+    }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap && cq_ring_size_ > sq_ring_size_) {
+        sq_ring_size_ = cq_ring_size_;
+    }
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+        close(fd);
+        return;
+    }
+    if (single_mmap) {
+        cq_ring_ = sq_ring_;
+    } else {
+        cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) {
+            munmap(sq_ring_, sq_ring_size_);
+            sq_ring_ = MAP_FAILED;
+            close(fd);
+            return;
+        }
+    }
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        if (cq_ring_ != sq_ring_) {
+            munmap(cq_ring_, cq_ring_size_);
+        }
+        munmap(sq_ring_, sq_ring_size_);
+        sq_ring_ = cq_ring_ = MAP_FAILED;
+        close(fd);
+        return;
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    sq_head_ = at<unsigned>(sq_ring_, params.sq_off.head);
+    sq_tail_ = at<unsigned>(sq_ring_, params.sq_off.tail);
+    sq_mask_ = at<unsigned>(sq_ring_, params.sq_off.ring_mask);
+    sq_array_ = at<unsigned>(sq_ring_, params.sq_off.array);
+    cq_head_ = at<unsigned>(cq_ring_, params.cq_off.head);
+    cq_tail_ = at<unsigned>(cq_ring_, params.cq_off.tail);
+    cq_mask_ = at<unsigned>(cq_ring_, params.cq_off.ring_mask);
+    cqes_ = at<struct io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+    sqe_tail_ = sqe_head_ = *sq_tail_;
+    entries_ = params.sq_entries;
+    fd_ = fd;
+}
+
+IoUring::~IoUring() {
+    if (fd_ < 0) {
+        return;
+    }
+    munmap(sqes_, sqes_size_);
+    if (cq_ring_ != sq_ring_) {
+        munmap(cq_ring_, cq_ring_size_);
+    }
+    munmap(sq_ring_, sq_ring_size_);
+    close(fd_);
+}
+
+bool IoUring::supported() {
+    static const bool result = IoUring(2).is_open();
+    return result;
+}
+
+bool IoUring::register_buffers(const struct iovec* iovs, unsigned count) {
+    return io_uring_register(fd_, IORING_REGISTER_BUFFERS, iovs, count) == 0;
+}
+
+bool IoUring::unregister_buffers() {
+    return io_uring_register(fd_, IORING_UNREGISTER_BUFFERS, nullptr, 0) == 0;
+}
+
+bool IoUring::register_files(const int* fds, unsigned count) {
+    return io_uring_register(fd_, IORING_REGISTER_FILES, fds, count) == 0;
+}
+
+bool IoUring::update_file(unsigned index, int fd) {
+    struct io_uring_files_update update;
+    std::memset(&update, 0, sizeof(update));
+    update.offset = index;
+    update.fds = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(&fd));
+    return io_uring_register(fd_, IORING_REGISTER_FILES_UPDATE, &update, 1) == 1;
+}
+
+struct io_uring_sqe* IoUring::get_sqe() {
+    if (sqe_tail_ - load_acquire(sq_head_) >= entries_) {
+        return nullptr;
+    }
+    const unsigned index = sqe_tail_ & *sq_mask_;
+    struct io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    ++sqe_tail_;
+    return sqe;
+}
+
+void IoUring::prep_write(struct io_uring_sqe* sqe, int file, const void* buf,
+                         unsigned len, uint64_t offset, int buf_index,
+                         uint64_t user_data) {
+    sqe->opcode = buf_index >= 0 ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = file;
+    sqe->addr = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(buf));
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->buf_index = static_cast<uint16_t>(buf_index >= 0 ? buf_index : 0);
+    sqe->user_data = user_data;
+}
+
+void IoUring::prep_fdatasync(struct io_uring_sqe* sqe, int file, uint64_t user_data) {
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = file;
+    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    sqe->user_data = user_data;
+}
+
+int IoUring::submit(unsigned wait_nr) {
+    const unsigned to_submit = sqe_tail_ - sqe_head_;
+    store_release(sq_tail_, sqe_tail_);
+    for (;;) {
+        const int result = io_uring_enter(fd_, to_submit, wait_nr,
+                                          wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0);
+        if (result >= 0) {
+            sqe_head_ += static_cast<unsigned>(result);
+            return result;
+        }
+        if (errno != EINTR) {
+            return -errno;
+        }
+    }
+}
+
+struct io_uring_cqe* IoUring::peek_cqe() {
+    const unsigned head = *cq_head_;
+    if (head == load_acquire(cq_tail_)) {
+        return nullptr;
+    }
+    return &cqes_[head & *cq_mask_];
+}
+
+void IoUring::cqe_seen() {
+    store_release(cq_head_, *cq_head_ + 1);
+}
+
+}  // namespace nanomq
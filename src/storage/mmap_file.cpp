@@ -1,84 +1,198 @@
+#include "nanomq/mmap_file.hpp"
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <stdexcept>
 
 namespace nanomq {
 
-// Memory-mapped file for zero-copy persistence
-class MMapFile {
-public:
-    MMapFile(const char* path, size_t size, bool create = true)
-        : fd_(-1), data_(nullptr), size_(0) {
-        int flags = O_RDWR;
-        if (create) {
-            flags |= O_CREAT;
-        }
+namespace {
 
-        fd_ = open(path, flags, 0644);
-        if (fd_ < 0) {
-            throw std::runtime_error("Failed to open file");
-        }
+size_t page_size() {
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
 
-        // Resize file if needed
-        if (create) {
-            if (ftruncate(fd_, size) != 0) {
-                close(fd_);
-                throw std::runtime_error("Failed to resize file");
-            }
-        } else {
-            struct stat st;
-            if (fstat(fd_, &st) != 0) {
-                close(fd_);
-                throw std::runtime_error("Failed to stat file");
-            }
-            size = st.st_size;
-        }
+size_t page_down(size_t offset) { return offset & ~(page_size() - 1); }
+size_t page_up(size_t offset) { return page_down(offset + page_size() - 1); }
 
-        // Memory map the file
-        data_ = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
-        if (data_ == MAP_FAILED) {
-            close(fd_);
-            throw std::runtime_error("Failed to mmap file");
-        }
+int advice_flag(MMapAdvice advice) {
+    switch (advice) {
+    case MMapAdvice::SEQUENTIAL: return MADV_SEQUENTIAL;
+    case MMapAdvice::RANDOM: return MADV_RANDOM;
+    case MMapAdvice::WILLNEED: return MADV_WILLNEED;
+    case MMapAdvice::DONTNEED: return MADV_DONTNEED;
+    default: return MADV_NORMAL;
+    }
+}
 
-        size_ = size;
+// Apply the options to [offset, size) of a fresh or grown mapping
+void apply_options(void* data, size_t offset, size_t size, const MMapOptions& options) {
+    uint8_t* start = static_cast<uint8_t*>(data) + page_down(offset);
+    const size_t length = size - page_down(offset);
+    if (length == 0) {
+        return;
+    }
+#ifdef MADV_HUGEPAGE
+    if (options.huge_pages) {
+        madvise(start, length, MADV_HUGEPAGE);
+    }
+#endif
+#ifdef MADV_POPULATE_WRITE
+    // MAP_POPULATE only covers the initial mapping
+    if (options.populate && offset > 0) {
+        madvise(start, length, MADV_POPULATE_WRITE);
     }
+#endif
+}
 
-    ~MMapFile() {
-        if (data_ != nullptr && data_ != MAP_FAILED) {
-            munmap(data_, size_);
+}  // namespace
+
+MMapFile::MMapFile(const char* path, size_t size, bool create, const MMapOptions& options)
+    : fd_(-1), data_(nullptr), size_(0), options_(options), tracking_(false),
+      dirty_begin_(0), dirty_end_(0) {
+    int flags = O_RDWR;
+    if (create) {
+        flags |= O_CREAT;
+    }
+
+    fd_ = open(path, flags, 0644);
+    if (fd_ < 0) {
+        throw std::runtime_error("Failed to open file");
+    }
+
+    // Resize file if needed
+    if (create) {
+        if (ftruncate(fd_, size) != 0) {
+            close(fd_);
+            throw std::runtime_error("Failed to resize file");
         }
-        if (fd_ >= 0) {
+    } else {
+        struct stat st;
+        if (fstat(fd_, &st) != 0) {
             close(fd_);
+            throw std::runtime_error("Failed to stat file");
         }
+        size = st.st_size;
     }
 
-    void* data() { return data_; }
-    const void* data() const { return data_; }
-    size_t size() const { return size_; }
+    // Memory map the file
+    data_ = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | (options.populate ? MAP_POPULATE : 0), fd_, 0);
+    if (data_ == MAP_FAILED) {
+        close(fd_);
+        throw std::runtime_error("Failed to mmap file");
+    }
 
-    // Sync to disk
-    void sync() {
-        if (data_ != nullptr) {
-            msync(data_, size_, MS_SYNC);
-        }
+    size_ = size;
+    apply_options(data_, 0, size_, options_);
+}
+
+MMapFile::~MMapFile() {
+    if (data_ != nullptr && data_ != MAP_FAILED) {
+        munmap(data_, size_);
     }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
 
-    // Async sync
-    void async_sync() {
-        if (data_ != nullptr) {
-            msync(data_, size_, MS_ASYNC);
-        }
+void MMapFile::resize(size_t size) {
+    if (size == size_) {
+        return;
     }
+    if (size == 0) {
+        throw std::runtime_error("Cannot map an empty file");
+    }
+    // Grow the file before the mapping, shrink it after
+    if (size > size_ && ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+        throw std::runtime_error("Failed to resize file");
+    }
+    void* data = mremap(data_, size_, size, MREMAP_MAYMOVE);
+    if (data == MAP_FAILED) {
+        ftruncate(fd_, static_cast<off_t>(size_));
+        throw std::runtime_error("Failed to remap file");
+    }
+    if (size < size_) {
+        ftruncate(fd_, static_cast<off_t>(size));
+    }
+    const size_t old_size = size_;
+    data_ = data;
+    size_ = size;
+    dirty_end_ = std::min(dirty_end_, page_up(size_));
+    dirty_begin_ = std::min(dirty_begin_, dirty_end_);
+    if (size_ > old_size) {
+        apply_options(data_, old_size, size_, options_);
+    }
+}
 
-private:
-    int fd_;
-    void* data_;
-    size_t size_;
-};
+void MMapFile::mark_dirty(size_t offset, size_t length) {
+    tracking_ = true;
+    if (length == 0 || offset >= size_) {
+        return;
+    }
+    const size_t begin = page_down(offset);
+    const size_t end = std::min(page_up(offset + length), page_up(size_));
+    if (dirty_begin_ == dirty_end_) {
+        dirty_begin_ = begin;
+        dirty_end_ = end;
+    } else {
+        dirty_begin_ = std::min(dirty_begin_, begin);
+        dirty_end_ = std::max(dirty_end_, end);
+    }
+}
 
-}  // namespace nanomq
+bool MMapFile::sync_range(size_t offset, size_t length, bool async) {
+    if (data_ == nullptr || length == 0 || offset >= size_) {
+        return true;
+    }
+    const size_t begin = page_down(offset);
+    const size_t end = std::min(page_up(offset + length), page_up(size_));
+    if (msync(static_cast<uint8_t*>(data_) + begin, end - begin,
+              async ? MS_ASYNC : MS_SYNC) != 0) {
+        return false;
+    }
+    // Trim the dirty range where the synced one covers an end of it
+    if (async) {
+        return true;  // Only started
+    } else if (begin <= dirty_begin_ && end >= dirty_end_) {
+        dirty_begin_ = dirty_end_ = 0;
+    } else if (begin <= dirty_begin_ && end > dirty_begin_) {
+        dirty_begin_ = end;
+    } else if (end >= dirty_end_ && begin < dirty_end_) {
+        dirty_end_ = begin;
+    }
+    return true;
+}
+
+void MMapFile::sync_dirty(bool async) {
+    if (!tracking_) {
+        sync_range(0, size_, async);
+    } else if (dirty_end_ > dirty_begin_) {
+        sync_range(dirty_begin_, dirty_end_ - dirty_begin_, async);
+    }
+}
+
+void MMapFile::sync() {
+    sync_dirty(false);
+}
 
+void MMapFile::async_sync() {
+    sync_dirty(true);
+}
+
+bool MMapFile::advise(MMapAdvice advice, size_t offset, size_t length) {
+    if (data_ == nullptr || offset >= size_) {
+        return false;
+    }
+    const size_t begin = page_down(offset);
+    const size_t end = length == 0 ? size_ : std::min(offset + length, size_);
+    return madvise(static_cast<uint8_t*>(data_) + begin, end - begin,
+                   advice_flag(advice)) == 0;
+}
+
+}  // namespace nanomq
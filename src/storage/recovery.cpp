@@ -0,0 +1,146 @@
+#include "nanomq/recovery.hpp"
+#include "nanomq/record_batch.hpp"
+#include "nanomq/segment.hpp"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace nanomq {
+
+namespace {
+
+// What a pass over one segment found
+struct SegmentCheck {
+    bool valid_header = false;
+    bool clean_end = true;  // Nothing but zeros after the last valid record
+    uint64_t records = 0;
+    uint64_t end = 0;       // Byte position after the last valid record
+    uint64_t max_id = 0;
+    uint64_t max_timestamp = 0;
+    std::unordered_map<uint32_t, uint64_t> last_ids;
+};
+
+SegmentCheck check_segment(uint32_t number, const std::string& path) {
+    SegmentCheck check;
+    SegmentScanner scanner;
+    if (!scanner.open(path, number)) {
+        return check;
+    }
+    check.valid_header = true;
+    check.end = scanner.position();
+    Message msg;
+    while (scanner.next(msg)) {
+        if (!msg.verify_checksum()) {
+            break;
+        }
+        ++check.records;
+        check.end = scanner.position();
+        uint64_t last_id, max_timestamp;
+        message_bounds(msg, last_id, max_timestamp);
+        check.max_id = std::max(check.max_id, last_id);
+        check.max_timestamp = std::max(check.max_timestamp, max_timestamp);
+        uint64_t& last = check.last_ids[msg.header.topic_id];
+        last = std::max(last, last_id);
+    }
+    scanner.seek(check.end);
+    check.clean_end = scanner.at_end();
+    return check;
+}
+
+// Run task(0..count-1) on up to threads threads, the caller being one
+void parallel_for(size_t count, unsigned threads, const std::function<void(size_t)>& task) {
+    std::atomic<size_t> next{0};
+    auto worker = [&] {
+        for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+            task(i);
+        }
+    };
+    std::vector<std::thread> helpers;
+    const size_t extra = std::min<size_t>(threads, count) - (count > 0 ? 1 : 0);
+    for (size_t i = 0; i < extra; ++i) {
+        helpers.emplace_back(worker);
+    }
+    worker();
+    for (auto& helper : helpers) {
+        helper.join();
+    }
+}
+
+}  // namespace
+
+RecoveryReport recover(const std::string& directory, unsigned threads) {
+    const auto start = std::chrono::steady_clock::now();
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    RecoveryReport report;
+    const auto files = segment_files(directory);
+    std::vector<SegmentCheck> checks(files.size());
+    parallel_for(files.size(), threads, [&](size_t i) {
+        checks[i] = check_segment(files[i].first, files[i].second);
+    });
+
+    // The log ends in the last segment with a valid record
+    size_t tail = 0;
+    for (size_t i = 0; i < checks.size(); ++i) {
+        if (checks[i].records > 0) {
+            tail = i;
+        }
+    }
+
+    std::vector<bool> kept(files.size(), false);
+    for (size_t i = 0; i < files.size(); ++i) {
+        const SegmentCheck& check = checks[i];
+        const std::string& path = files[i].second;
+        if (i < tail) {
+            if (!check.valid_header || !check.clean_end) {
+                ++report.corrupt_segments;
+            }
+        } else if (!check.valid_header) {
+            remove_segment(path);
+            ++report.removed_segments;
+            continue;
+        } else if (!check.clean_end) {
+            struct stat st;
+            if (stat(path.c_str(), &st) == 0 &&
+                ::truncate(path.c_str(), static_cast<off_t>(check.end)) == 0) {
+                report.truncated_bytes += static_cast<uint64_t>(st.st_size) - check.end;
+            }
+        }
+        if (!check.valid_header) {
+            continue;
+        }
+        kept[i] = true;
+        ++report.segments;
+        report.records += check.records;
+        report.bytes += check.end;
+        report.max_id = std::max(report.max_id, check.max_id);
+        report.max_timestamp = std::max(report.max_timestamp, check.max_timestamp);
+        for (const auto& topic : check.last_ids) {
+            uint64_t& last = report.last_ids[topic.first];
+            last = std::max(last, topic.second);
+        }
+    }
+
+    SegmentManager segments(directory);
+    std::atomic<size_t> rebuilt{0};
+    parallel_for(files.size(), threads, [&](size_t i) {
+        if (kept[i] && segments.rebuild_index(files[i].first, files[i].second)) {
+            rebuilt.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    report.indexes_rebuilt = rebuilt.load();
+
+    report.elapsed_ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    return report;
+}
+
+}  // namespace nanomq
@@ -1,32 +1,641 @@
-#include <string>
+#include "nanomq/segment.hpp"
+#include "nanomq/mmap_file.hpp"
+#include "nanomq/record_batch.hpp"
+#include "nanomq/tiered_storage.hpp"
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
 
 namespace nanomq {
 
-// Log segment management
-class SegmentManager {
-public:
-    explicit SegmentManager(const std::string& directory) {
-        // Implementation stub
-        (void)directory;
-    }
+namespace {
+
+constexpr const char* SEGMENT_SUFFIX = ".wal";
+constexpr const char* ARCHIVED_SUFFIX = ".archived";
+constexpr size_t READ_SIZE = 64 * 1024;
+constexpr size_t MAX_RECORD_SIZE = MAX_COMPACT_HEADER_SIZE + MAX_PAYLOAD_SIZE;
 
-    // Create a new segment
-    int create_segment() {
-        // TODO: Create new segment file
+// Segment number of a file name like 00000042.wal (with suffix ".wal"), 0
+// if it is not one
+uint32_t segment_number(const char* name, const char* suffix_name) {
+    const size_t length = std::strlen(name);
+    const size_t suffix = std::strlen(suffix_name);
+    if (length <= suffix || std::strcmp(name + length - suffix, suffix_name) != 0) {
         return 0;
     }
+    char* end = nullptr;
+    const unsigned long number = std::strtoul(name, &end, 10);
+    return end == name + length - suffix ? static_cast<uint32_t>(number) : 0;
+}
+
+std::string replace_suffix(const std::string& segment_path, const char* suffix) {
+    const size_t dot = segment_path.rfind('.');
+    return segment_path.substr(0, dot == std::string::npos ? segment_path.size() : dot) +
+           suffix;
+}
+
+bool is_archived(const std::string& path) {
+    const size_t suffix = std::strlen(ARCHIVED_SUFFIX);
+    return path.size() > suffix && path.compare(path.size() - suffix, suffix, ARCHIVED_SUFFIX) == 0;
+}
+
+// Largest id (timestamp) in a log entry, which may be a batch
+uint64_t key_of(const Message& msg, bool by_id) {
+    uint64_t last_id, max_timestamp;
+    message_bounds(msg, last_id, max_timestamp);
+    return by_id ? last_id : max_timestamp;
+}
+
+// Segments before the last one with a record, which the WAL is done with
+size_t sealed_count(const std::vector<SegmentInfo>& segments) {
+    for (size_t i = segments.size(); i > 0; --i) {
+        if (segments[i - 1].max_id != 0) {
+            return i - 1;
+        }
+    }
+    return 0;
+}
+
+}  // namespace
+
+SegmentScanner::SegmentScanner()
+    : fd_(-1), number_(0), buffer_start_(0), buffer_size_(0), position_(0),
+      record_size_(0) {}
+
+SegmentScanner::~SegmentScanner() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
 
-    // List all segments
-    void list_segments() {
-        // TODO: Scan directory for segment files
+bool SegmentScanner::open(const std::string& path, uint32_t number) {
+    return open(::open(path.c_str(), O_RDONLY | O_CLOEXEC), number);
+}
+
+bool SegmentScanner::open(int fd, uint32_t number) {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+    fd_ = fd;
+    buffer_start_ = 0;
+    buffer_size_ = 0;
+    if (fd_ < 0) {
+        return false;
+    }
+    number_ = number;
+    position_ = 0;
+    if (available(sizeof(WALSegmentHeader)) < sizeof(WALSegmentHeader)) {
+        return false;
+    }
+    std::memcpy(&header_, buffer_.data(), sizeof(header_));
+    if (header_.magic != WALSegmentHeader::MAGIC ||
+        header_.version != WALSegmentHeader::VERSION) {
+        return false;
+    }
+    base_.id = header_.base_id;
+    base_.timestamp = header_.base_timestamp;
+    position_ = sizeof(WALSegmentHeader);
+    return true;
+}
+
+void SegmentScanner::seek(uint64_t position) {
+    position_ = std::max<uint64_t>(position, sizeof(WALSegmentHeader));
+}
+
+bool SegmentScanner::next(Message& msg) {
+    const size_t head = available(MAX_VARINT_SIZE);
+    uint64_t length = 0;
+    const size_t n = decode_varint(current(), current() + head, length);
+    if (n == 0 || length == 0 || length > MAX_RECORD_SIZE ||
+        available(n + length) < n + length ||
+        decode_message(current() + n, length, msg, base_) != length) {
+        buffer_size_ = 0;  // Look at the file again next time
+        return false;
     }
+    record_size_ = n + length;
+    position_ += record_size_;
+    return true;
+}
+
+bool SegmentScanner::at_end() {
+    const size_t size = available(MAX_VARINT_SIZE + MAX_RECORD_SIZE);
+    const uint8_t* tail = current();
+    const bool zeros = std::all_of(tail, tail + size, [](uint8_t b) { return b == 0; });
+    buffer_size_ = 0;  // The tail may still be written
+    return zeros;
+}
 
-    // Delete old segments (retention policy)
-    void cleanup_old_segments(uint64_t retention_ms) {
-        // TODO: Delete segments older than retention
-        (void)retention_ms;
+size_t SegmentScanner::available(size_t want) {
+    const uint64_t end = buffer_start_ + buffer_size_;
+    if (position_ >= buffer_start_ && position_ + want <= end) {
+        return want;
+    }
+    buffer_.resize(std::max(READ_SIZE, want));
+    buffer_start_ = position_;
+    buffer_size_ = 0;
+    while (buffer_size_ < want) {
+        const ssize_t n = pread(fd_, buffer_.data() + buffer_size_,
+                                buffer_.size() - buffer_size_,
+                                static_cast<off_t>(buffer_start_ + buffer_size_));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        buffer_size_ += static_cast<size_t>(n);
     }
+    return std::min(want, buffer_size_);
+}
+
+namespace {
+
+// Read-only view of the entries in an index file
+class IndexView {
+public:
+    IndexView() : entries_(nullptr), count_(0) {}
+
+    // False if the file is missing or unreadable
+    bool open(const std::string& path) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) {
+            return false;
+        }
+        if (st.st_size < static_cast<off_t>(sizeof(IndexEntry))) {
+            return true;  // No entries
+        }
+        try {
+            file_ = std::make_unique<MMapFile>(path.c_str(), 0, false);
+        } catch (const std::runtime_error&) {
+            return false;
+        }
+        file_->advise(MMapAdvice::WILLNEED);  // Binary searched right away
+        entries_ = static_cast<const IndexEntry*>(file_->data());
+        // Unused space of an index whose writer died is zeroed
+        const size_t capacity = file_->size() / sizeof(IndexEntry);
+        count_ = static_cast<size_t>(
+            std::partition_point(entries_, entries_ + capacity,
+                                 [](const IndexEntry& e) { return e.position != 0; }) -
+            entries_);
+        return true;
+    }
+
+    const IndexEntry* begin() const { return entries_; }
+    const IndexEntry* end() const { return entries_ + count_; }
+    size_t size() const { return count_; }
+
+    // Position to scan from for the first record with key >= target: that
+    // of the last entry with a smaller key, 0 for the segment start
+    uint64_t lookup(uint64_t target) const {
+        const IndexEntry* it = std::lower_bound(
+            begin(), end(), target,
+            [](const IndexEntry& e, uint64_t key) { return e.key < key; });
+        return it == begin() ? 0 : (it - 1)->position;
+    }
+
+private:
+    std::unique_ptr<MMapFile> file_;
+    const IndexEntry* entries_;
+    size_t count_;
 };
 
-}  // namespace nanomq
+// Whether both indexes of segment agree with each other and with it
+bool index_matches(SegmentScanner& segment, const std::string& path) {
+    IndexView offsets;
+    IndexView times;
+    if (!offsets.open(offset_index_path(path)) ||
+        !times.open(time_index_path(path)) || offsets.size() != times.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        const IndexEntry& o = offsets.begin()[i];
+        const IndexEntry& t = times.begin()[i];
+        if (o.position != t.position ||
+            (i > 0 && (o.position <= offsets.begin()[i - 1].position ||
+                       o.key < offsets.begin()[i - 1].key ||
+                       t.key < times.begin()[i - 1].key))) {
+            return false;
+        }
+    }
+    // The first record always gets an entry
+    Message msg;
+    if (offsets.size() == 0) {
+        return !segment.next(msg);
+    }
+    // The last entry must point at a record it covers (entries can run
+    // ahead of the data after a crash)
+    segment.seek((offsets.end() - 1)->position);
+    return segment.next(msg) && key_of(msg, true) <= (offsets.end() - 1)->key &&
+           key_of(msg, false) <= (times.end() - 1)->key;
+}
+
+}  // namespace
+
+namespace {
+
+// Files NNNNNNNN<suffix> in directory, by number
+std::vector<std::pair<uint32_t, std::string>> numbered_files(const std::string& directory,
+                                                            const char* suffix) {
+    std::vector<std::pair<uint32_t, std::string>> segments;
+    if (DIR* dir = opendir(directory.c_str())) {
+        while (struct dirent* entry = readdir(dir)) {
+            const uint32_t number = segment_number(entry->d_name, suffix);
+            if (number != 0) {
+                segments.emplace_back(number, directory + "/" + entry->d_name);
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+}  // namespace
+
+std::vector<std::pair<uint32_t, std::string>> segment_files(const std::string& directory) {
+    return numbered_files(directory, SEGMENT_SUFFIX);
+}
+
+std::vector<std::pair<uint32_t, std::string>> archived_segment_files(const std::string& directory) {
+    return numbered_files(directory, ARCHIVED_SUFFIX);
+}
+
+std::string offset_index_path(const std::string& segment_path) {
+    return replace_suffix(segment_path, ".index");
+}
+
+std::string time_index_path(const std::string& segment_path) {
+    return replace_suffix(segment_path, ".timeindex");
+}
+
+void remove_segment(const std::string& segment_path) {
+    unlink(segment_path.c_str());
+    unlink(offset_index_path(segment_path).c_str());
+    unlink(time_index_path(segment_path).c_str());
+}
+
+SegmentIndexWriter::SegmentIndexWriter(const std::string& segment_path, size_t max_bytes)
+    : offset_path_(offset_index_path(segment_path)),
+      time_path_(time_index_path(segment_path)), offsets_(nullptr), times_(nullptr),
+      capacity_((max_bytes + MAX_RECORD_SIZE) / INTERVAL_BYTES + 1), count_(0),
+      next_position_(0), max_id_(0), max_timestamp_(0) {
+    // Stale entries must not survive past the ones written now
+    ::truncate(offset_path_.c_str(), 0);
+    ::truncate(time_path_.c_str(), 0);
+    offset_file_ = std::make_unique<MMapFile>(offset_path_.c_str(),
+                                              capacity_ * sizeof(IndexEntry));
+    time_file_ = std::make_unique<MMapFile>(time_path_.c_str(),
+                                            capacity_ * sizeof(IndexEntry));
+    offsets_ = static_cast<IndexEntry*>(offset_file_->data());
+    times_ = static_cast<IndexEntry*>(time_file_->data());
+}
+
+SegmentIndexWriter::~SegmentIndexWriter() {
+    offset_file_.reset();
+    time_file_.reset();
+    ::truncate(offset_path_.c_str(), static_cast<off_t>(count_ * sizeof(IndexEntry)));
+    ::truncate(time_path_.c_str(), static_cast<off_t>(count_ * sizeof(IndexEntry)));
+}
+
+SegmentManager::SegmentManager(const std::string& directory,
+                               std::shared_ptr<TieredStorage> tier)
+    : directory_(directory), tier_(std::move(tier)) {}
 
+std::vector<std::pair<uint32_t, std::string>> SegmentManager::files() const {
+    std::vector<std::pair<uint32_t, std::string>> files = segment_files(directory_);
+    if (!tier_) {
+        return files;
+    }
+    // A segment archived but not yet deleted is still read locally
+    const size_t local = files.size();
+    for (auto& stub : archived_segment_files(directory_)) {
+        const auto it = std::lower_bound(
+            files.begin(), files.begin() + local, stub,
+            [](const std::pair<uint32_t, std::string>& a,
+               const std::pair<uint32_t, std::string>& b) { return a.first < b.first; });
+        if (it == files.begin() + local || it->first != stub.first) {
+            files.push_back(std::move(stub));
+        }
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+bool SegmentManager::open_segment(uint32_t number, const std::string& path,
+                                  SegmentScanner& scanner) const {
+    return scanner.open(open_file(number, path), number);
+}
+
+bool SegmentManager::open_from(uint32_t number, SegmentScanner& scanner,
+                               std::string* path) const {
+    for (const auto& file : files()) {
+        if (file.first >= number && open_segment(file.first, file.second, scanner)) {
+            if (path != nullptr) {
+                *path = file.second;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SegmentManager::advance_segment(uint32_t number, SegmentScanner& next,
+                                     const std::function<bool()>& more_in_current,
+                                     std::string* path) const {
+    Message first;
+    if (!open_from(number + 1, next, path) || !next.next(first) || more_in_current()) {
+        return false;
+    }
+    next.seek(0);
+    return true;
+}
+
+int SegmentManager::open_file(uint32_t number, const std::string& path) const {
+    if (!is_archived(path)) {
+        return ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    return tier_ ? tier_->fetch(number) : -1;
+}
+
+uint64_t SegmentManager::records_end(int fd, const std::string& path, uint64_t from,
+                                     uint64_t limit) const {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return from;
+    }
+    const uint64_t file_end = static_cast<uint64_t>(st.st_size);
+    from = std::max<uint64_t>(from, sizeof(WALSegmentHeader));
+
+    // Record lengths are read in small chunks
+    uint8_t buffer[4096];
+    uint64_t buffer_start = 0;
+    size_t buffer_size = 0;
+    const auto next_record = [&](uint64_t position) -> uint64_t {
+        if (position < buffer_start || position + MAX_VARINT_SIZE > buffer_start + buffer_size) {
+            const ssize_t n = pread(fd, buffer, sizeof(buffer), static_cast<off_t>(position));
+            buffer_start = position;
+            buffer_size = n > 0 ? static_cast<size_t>(n) : 0;
+        }
+        const uint8_t* at = buffer + (position - buffer_start);
+        uint64_t length = 0;
+        const size_t n = decode_varint(at, buffer + buffer_size, length);
+        const uint64_t next = position + n + length;
+        return n == 0 || length == 0 || length > MAX_RECORD_SIZE || next > file_end ? 0 : next;
+    };
+
+    // Records before the last indexed one within limit are whole if that
+    // one is (entries can run ahead of what has been written)
+    uint64_t position = from;
+    IndexView index;
+    if (index.open(offset_index_path(path))) {
+        const IndexEntry* it = std::upper_bound(
+            index.begin(), index.end(), limit,
+            [](uint64_t value, const IndexEntry& e) { return value < e.position; });
+        if (it != index.begin() && (it - 1)->position > from &&
+            next_record((it - 1)->position) != 0) {
+            position = (it - 1)->position;
+        }
+    }
+    for (;;) {
+        const uint64_t next = next_record(position);
+        if (next == 0 || (next > limit && position > from)) {
+            return position;
+        }
+        position = next;
+    }
+}
+
+void SegmentManager::remove(const SegmentInfo& info) const {
+    if (info.archived) {
+        tier_->remove(info.number);
+    } else {
+        remove_segment(info.path);
+    }
+}
+
+std::vector<SegmentInfo> SegmentManager::list_segments() const {
+    std::vector<SegmentInfo> segments;
+    for (const auto& file : files()) {
+        SegmentInfo info;
+        info.number = file.first;
+        info.path = file.second;
+        info.index_entries = 0;
+        info.archived = is_archived(file.second);
+        if (info.archived) {
+            // Bounds from the stub, no fetch
+            ArchivedSegment stub;
+            if (!TieredStorage::read_stub(file.second, stub)) {
+                continue;
+            }
+            info.base_id = stub.header.base_id;
+            info.base_timestamp = stub.header.base_timestamp;
+            info.max_id = stub.max_id;
+            info.max_timestamp = stub.max_timestamp;
+            info.end = stub.end;
+            IndexView offsets;
+            if (offsets.open(offset_index_path(file.second))) {
+                info.index_entries = offsets.size();
+            }
+            segments.push_back(std::move(info));
+            continue;
+        }
+        SegmentScanner scanner;
+        if (!scanner.open(file.second, file.first)) {
+            continue;
+        }
+        info.base_id = scanner.header().base_id;
+        info.base_timestamp = scanner.header().base_timestamp;
+        info.max_id = 0;
+        info.max_timestamp = 0;
+
+        // Only the records past the last index entry need reading
+        IndexView offsets;
+        IndexView times;
+        if (offsets.open(offset_index_path(info.path)) &&
+            times.open(time_index_path(info.path)) && offsets.size() > 0 &&
+            offsets.size() == times.size()) {
+            info.max_id = (offsets.end() - 1)->key;
+            info.max_timestamp = (times.end() - 1)->key;
+            info.index_entries = offsets.size();
+            scanner.seek((offsets.end() - 1)->position);
+        }
+        Message msg;
+        uint64_t last_id, max_timestamp;
+        while (scanner.next(msg)) {
+            message_bounds(msg, last_id, max_timestamp);
+            info.max_id = std::max(info.max_id, last_id);
+            info.max_timestamp = std::max(info.max_timestamp, max_timestamp);
+        }
+        info.end = scanner.position();
+        segments.push_back(std::move(info));
+    }
+    return segments;
+}
+
+size_t SegmentManager::rebuild_indexes() const {
+    size_t rebuilt = 0;
+    for (const auto& file : segment_files(directory_)) {
+        if (rebuild_index(file.first, file.second)) {
+            ++rebuilt;
+        }
+    }
+    return rebuilt;
+}
+
+bool SegmentManager::rebuild_index(uint32_t number, const std::string& path) const {
+    SegmentScanner scanner;
+    struct stat st;
+    if (!scanner.open(path, number) || index_matches(scanner, path) ||
+        stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    try {
+        SegmentIndexWriter index(path, static_cast<size_t>(st.st_size));
+        scanner.seek(0);
+        uint64_t position = scanner.position();
+        Message msg;
+        while (scanner.next(msg)) {
+            uint64_t last_id, max_timestamp;
+            message_bounds(msg, last_id, max_timestamp);
+            index.add(last_id, max_timestamp, position);
+            position = scanner.position();
+        }
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+    return true;
+}
+
+size_t SegmentManager::cleanup_old_segments(uint64_t retention_ms) const {
+    const uint64_t now = get_timestamp_ns();
+    const uint64_t cutoff = now > retention_ms * 1000000 ? now - retention_ms * 1000000 : 0;
+    const std::vector<SegmentInfo> segments = list_segments();
+    size_t deleted = 0;
+    for (size_t i = 0; i < sealed_count(segments); ++i) {
+        if (segments[i].max_timestamp >= cutoff) {
+            break;  // Keep the log contiguous
+        }
+        remove(segments[i]);
+        ++deleted;
+    }
+    return deleted;
+}
+
+size_t SegmentManager::cleanup_to_size(uint64_t max_bytes) const {
+    const std::vector<SegmentInfo> segments = list_segments();
+    uint64_t total = 0;
+    for (const SegmentInfo& info : segments) {
+        total += info.end;
+    }
+    size_t deleted = 0;
+    for (size_t i = 0; i < sealed_count(segments) && total > max_bytes; ++i) {
+        total -= segments[i].end;
+        remove(segments[i]);
+        ++deleted;
+    }
+    return deleted;
+}
+
+bool SegmentManager::seek(uint64_t message_id, LogPosition& position) const {
+    return seek_by(Key::ID, message_id, position);
+}
+
+bool SegmentManager::seek_to_timestamp(uint64_t timestamp_ns, LogPosition& position) const {
+    return seek_by(Key::TIMESTAMP, timestamp_ns, position);
+}
+
+bool SegmentManager::seek_by(Key key, uint64_t target, LogPosition& position) const {
+    const bool by_id = key == Key::ID;
+    for (const auto& file : files()) {
+        // Archived segments that end before target are not fetched
+        ArchivedSegment stub;
+        if (is_archived(file.second) && TieredStorage::read_stub(file.second, stub) &&
+            (by_id ? stub.max_id : stub.max_timestamp) < target) {
+            continue;
+        }
+        SegmentScanner scanner;
+        if (!open_segment(file.first, file.second, scanner)) {
+            continue;
+        }
+        // Without an index the whole segment is scanned
+        IndexView index;
+        if (index.open(by_id ? offset_index_path(file.second) : time_index_path(file.second))) {
+            scanner.seek(index.lookup(target));
+        }
+        uint64_t start = scanner.position();
+        Message msg;
+        while (scanner.next(msg)) {
+            if (key_of(msg, by_id) >= target) {
+                position = LogPosition{file.first, start};
+                return true;
+            }
+            start = scanner.position();
+        }
+    }
+    return false;
+}
+
+LogReader::LogReader(const std::string& directory, std::shared_ptr<TieredStorage> tier)
+    : segments_(directory, std::move(tier)), position_{0, 0} {}
+
+LogReader::~LogReader() = default;
+
+bool LogReader::seek(uint64_t message_id) {
+    LogPosition position;
+    if (!segments_.seek(message_id, position)) {
+        return false;
+    }
+    seek(position);
+    return true;
+}
+
+bool LogReader::seek_to_timestamp(uint64_t timestamp_ns) {
+    LogPosition position;
+    if (!segments_.seek_to_timestamp(timestamp_ns, position)) {
+        return false;
+    }
+    seek(position);
+    return true;
+}
+
+void LogReader::seek(const LogPosition& position) {
+    position_ = position;
+    segment_.reset();
+}
+
+bool LogReader::next(Message& msg) {
+    if (!segment_) {
+        segment_ = std::make_unique<SegmentScanner>();
+        if (!segments_.open_from(position_.segment, *segment_)) {
+            segment_.reset();
+            return false;
+        }
+        if (segment_->number() == position_.segment) {
+            segment_->seek(position_.position);
+        }
+    }
+    for (;;) {
+        bool more = segment_->next(msg);
+        if (!more) {
+            auto following = std::make_unique<SegmentScanner>();
+            if (segments_.advance_segment(segment_->number(), *following,
+                                          [&] { return more = segment_->next(msg); })) {
+                segment_ = std::move(following);
+                continue;
+            }
+            if (!more) {
+                return false;
+            }
+        }
+        position_ = LogPosition{segment_->number(), segment_->position()};
+        return true;
+    }
+}
+
+}  // namespace nanomq
@@ -0,0 +1,378 @@
+#include "nanomq/tiered_storage.hpp"
+#include "nanomq/compression.hpp"
+#include "nanomq/crc32c.hpp"
+#include "nanomq/record_batch.hpp"
+#include "nanomq/segment.hpp"
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace nanomq {
+
+namespace {
+
+// Archived object: ObjectHeader, then for every BLOCK_SIZE bytes of the
+// segment a uint32 raw size, a uint32 compressed size and the LZ4 block
+struct ObjectHeader {
+    static constexpr uint32_t MAGIC = 0x5a414e4e;  // "NNAZ"
+    static constexpr uint32_t VERSION = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;    // Of the segment bytes
+    uint32_t crc32c;  // Of the segment bytes
+    uint32_t reserved;
+};
+
+constexpr size_t BLOCK_SIZE = 1024 * 1024;
+
+bool read_file(const std::string& path, std::vector<uint8_t>& data, size_t limit = SIZE_MAX) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    data.resize(std::min(static_cast<size_t>(st.st_size), limit));
+    size_t done = 0;
+    while (done < data.size()) {
+        const ssize_t n = pread(fd, data.data() + done, data.size() - done,
+                                static_cast<off_t>(done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    close(fd);
+    return done == data.size();
+}
+
+// Write path through a temporary file, durably
+bool write_file(const std::string& path, const void* data, size_t size) {
+    const std::string tmp = path + ".tmp";
+    const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    size_t done = 0;
+    while (done < size) {
+        const ssize_t n = write(fd, bytes + done, size - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    const bool ok = done == size && fdatasync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+void sync_directory(const std::string& directory) {
+    const int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+void make_directory(const std::string& directory) {
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("Failed to create directory " + directory);
+    }
+}
+
+void compress_object(const std::vector<uint8_t>& raw, std::vector<uint8_t>& object) {
+    ObjectHeader header{ObjectHeader::MAGIC, ObjectHeader::VERSION, raw.size(),
+                        crc32c(raw.data(), raw.size()), 0};
+    object.resize(sizeof(header));
+    std::memcpy(object.data(), &header, sizeof(header));
+    for (size_t offset = 0; offset < raw.size(); offset += BLOCK_SIZE) {
+        const uint32_t size = static_cast<uint32_t>(std::min(BLOCK_SIZE, raw.size() - offset));
+        const size_t start = object.size();
+        object.resize(start + 8 + lz4_compress_bound(size));
+        const uint32_t compressed = static_cast<uint32_t>(
+            lz4_compress(raw.data() + offset, size, object.data() + start + 8,
+                         lz4_compress_bound(size)));
+        std::memcpy(object.data() + start, &size, 4);
+        std::memcpy(object.data() + start + 4, &compressed, 4);
+        object.resize(start + 8 + compressed);
+    }
+}
+
+bool decompress_object(const std::vector<uint8_t>& object, std::vector<uint8_t>& raw) {
+    ObjectHeader header;
+    if (object.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, object.data(), sizeof(header));
+    if (header.magic != ObjectHeader::MAGIC || header.version != ObjectHeader::VERSION) {
+        return false;
+    }
+    raw.resize(header.size);
+    size_t in = sizeof(header);
+    size_t out = 0;
+    while (out < raw.size()) {
+        uint32_t size;
+        uint32_t compressed;
+        if (object.size() - in < 8) {
+            return false;
+        }
+        std::memcpy(&size, object.data() + in, 4);
+        std::memcpy(&compressed, object.data() + in + 4, 4);
+        in += 8;
+        if (compressed > object.size() - in || size > raw.size() - out ||
+            lz4_decompress(object.data() + in, compressed, raw.data() + out, size) != size) {
+            return false;
+        }
+        in += compressed;
+        out += size;
+    }
+    return crc32c(raw.data(), raw.size()) == header.crc32c;
+}
+
+}  // namespace
+
+LocalArchiveStore::LocalArchiveStore(const std::string& directory) : directory_(directory) {
+    make_directory(directory_);
+}
+
+bool LocalArchiveStore::put(const std::string& name, const std::vector<uint8_t>& data) {
+    if (!write_file(directory_ + "/" + name, data.data(), data.size())) {
+        return false;
+    }
+    sync_directory(directory_);
+    return true;
+}
+
+bool LocalArchiveStore::get(const std::string& name, std::vector<uint8_t>& data) {
+    return read_file(directory_ + "/" + name, data);
+}
+
+bool LocalArchiveStore::remove(const std::string& name) {
+    return unlink((directory_ + "/" + name).c_str()) == 0;
+}
+
+std::vector<std::string> LocalArchiveStore::list() {
+    std::vector<std::string> names;
+    if (DIR* dir = opendir(directory_.c_str())) {
+        while (struct dirent* entry = readdir(dir)) {
+            const std::string name = entry->d_name;
+            if (name[0] != '.' &&
+                (name.size() < 4 || name.compare(name.size() - 4, 4, ".tmp") != 0)) {
+                names.push_back(name);
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+TieredStorage::TieredStorage(const std::string& log_directory,
+                             std::shared_ptr<ArchiveStore> store, const TierPolicy& policy)
+    : log_directory_(log_directory), store_(std::move(store)), policy_(policy),
+      cache_directory_(policy.cache_directory.empty() ? log_directory + "/archive-cache"
+                                                      : policy.cache_directory),
+      cached_bytes_(0), fetches_(0) {
+    make_directory(cache_directory_);
+    // Keep what an earlier run fetched
+    for (const auto& file : segment_files(cache_directory_)) {
+        struct stat st;
+        if (stat(file.second.c_str(), &st) == 0) {
+            lru_.push_back(CacheEntry{file.first, static_cast<uint64_t>(st.st_size)});
+            cached_[file.first] = std::prev(lru_.end());
+            cached_bytes_ += static_cast<uint64_t>(st.st_size);
+        }
+    }
+}
+
+std::string TieredStorage::object_name(uint32_t number) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%08u.wal.lz4", number);
+    return name;
+}
+
+std::string TieredStorage::stub_path(uint32_t number) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%08u.archived", number);
+    return log_directory_ + name;
+}
+
+std::string TieredStorage::cache_path(uint32_t number) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%08u.wal", number);
+    return cache_directory_ + name;
+}
+
+bool TieredStorage::read_stub(const std::string& path, ArchivedSegment& stub) {
+    std::vector<uint8_t> data;
+    if (!read_file(path, data, sizeof(stub)) || data.size() != sizeof(stub)) {
+        return false;
+    }
+    std::memcpy(&stub, data.data(), sizeof(stub));
+    return stub.magic == ArchivedSegment::MAGIC &&
+           stub.header.magic == WALSegmentHeader::MAGIC;
+}
+
+size_t TieredStorage::archive_old_segments() {
+    const uint64_t now = get_timestamp_ns();
+    const uint64_t age_ns = policy_.archive_after_ms * 1000000;
+    const uint64_t cutoff = now > age_ns ? now - age_ns : 0;
+    const std::vector<SegmentInfo> segments = SegmentManager(log_directory_).list_segments();
+    size_t sealed = 0;  // Segments before the last one with a record
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (segments[i].max_id != 0) {
+            sealed = i;
+        }
+    }
+    size_t archived = 0;
+    for (size_t i = 0; i < sealed; ++i) {
+        if (segments[i].max_timestamp < cutoff &&
+            archive_segment(segments[i].number, segments[i].path)) {
+            ++archived;
+        }
+    }
+    return archived;
+}
+
+bool TieredStorage::archive_segment(uint32_t number, const std::string& path) {
+    SegmentScanner scanner;
+    if (!scanner.open(path, number)) {
+        return false;
+    }
+    ArchivedSegment stub;
+    std::memset(&stub, 0, sizeof(stub));
+    stub.magic = ArchivedSegment::MAGIC;
+    stub.header = scanner.header();
+    Message msg;
+    while (scanner.next(msg)) {
+        uint64_t last_id, max_timestamp;
+        message_bounds(msg, last_id, max_timestamp);
+        stub.max_id = std::max(stub.max_id, last_id);
+        stub.max_timestamp = std::max(stub.max_timestamp, max_timestamp);
+    }
+    stub.end = scanner.position();
+
+    // Object first, then the stub, then the segment goes: a crash in
+    // between leaves the segment readable locally
+    std::vector<uint8_t> raw;
+    std::vector<uint8_t> object;
+    if (!read_file(path, raw, stub.end) || raw.size() != stub.end) {
+        return false;
+    }
+    compress_object(raw, object);
+    if (!store_->put(object_name(number), object) ||
+        !write_file(stub_path(number), &stub, sizeof(stub))) {
+        return false;
+    }
+    unlink(path.c_str());
+    sync_directory(log_directory_);
+    return true;
+}
+
+int TieredStorage::fetch(uint32_t number) {
+    const std::string path = cache_path(number);
+    std::unique_lock<std::mutex> lock(mutex_);
+    fetched_.wait(lock, [&]() { return fetching_.count(number) == 0; });
+    const auto it = cached_.find(number);
+    if (it != cached_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    fetching_.insert(number);
+    lock.unlock();
+
+    // Not in the cache yet, so no eviction can remove the copy before it
+    // is open
+    std::vector<uint8_t> object;
+    std::vector<uint8_t> raw;
+    int fd = -1;
+    if (store_->get(object_name(number), object) && decompress_object(object, raw) &&
+        write_file(path, raw.data(), raw.size())) {
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+
+    lock.lock();
+    fetching_.erase(number);
+    if (fd >= 0) {
+        evict(raw.size());
+        lru_.push_front(CacheEntry{number, raw.size()});
+        cached_[number] = lru_.begin();
+        cached_bytes_ += raw.size();
+        ++fetches_;
+    }
+    lock.unlock();
+    fetched_.notify_all();
+    return fd;
+}
+
+void TieredStorage::evict(uint64_t incoming) {
+    // Readers keep unlinked segments they have open (fetch() opens them
+    // before they enter the cache, or under mutex_ on a hit)
+    while (!lru_.empty() && cached_bytes_ + incoming > policy_.cache_bytes) {
+        const CacheEntry& victim = lru_.back();
+        unlink(cache_path(victim.number).c_str());
+        cached_bytes_ -= victim.size;
+        cached_.erase(victim.number);
+        lru_.pop_back();
+    }
+}
+
+void TieredStorage::remove(uint32_t number) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    fetched_.wait(lock, [&]() { return fetching_.count(number) == 0; });
+    const bool cached = cached_.count(number) != 0;
+    if (cached) {
+        const auto it = cached_.find(number);
+        cached_bytes_ -= it->second->size;
+        lru_.erase(it->second);
+        cached_.erase(it);
+    }
+    // Fetches of the segment wait until it is gone, like for a download
+    fetching_.insert(number);
+    lock.unlock();
+
+    store_->remove(object_name(number));
+    remove_segment(stub_path(number));  // Stub and indexes
+    if (cached) {
+        unlink(cache_path(number).c_str());
+    }
+
+    lock.lock();
+    fetching_.erase(number);
+    lock.unlock();
+    fetched_.notify_all();
+}
+
+uint64_t TieredStorage::cached_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cached_bytes_;
+}
+
+uint64_t TieredStorage::fetches() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fetches_;
+}
+
+}  // namespace nanomq
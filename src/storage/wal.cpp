@@ -1,52 +1,714 @@
-#include "nanomq/message.hpp"
+#include "nanomq/wal.hpp"
+#include "nanomq/io_uring.hpp"
+#include "nanomq/record_batch.hpp"
+#include "nanomq/segment.hpp"
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
-#include <string>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <deque>
 #include <stdexcept>
 
 namespace nanomq {
 
-// Write-Ahead Log for durability
-class WAL {
-public:
-    static constexpr size_t SEGMENT_SIZE = 100 * 1024 * 1024;  // 100MB
+namespace {
 
-    explicit WAL(const std::string& directory) : fd_(-1), offset_(0) {
-        // Implementation stub
-        // TODO: Open WAL file, handle rotation
+constexpr const char* SEGMENT_SUFFIX = ".wal";
+
+constexpr const char* SPARE_SEGMENT = "next.wal.tmp";
+
+// Room for a full write buffer, the record that overflowed it and the
+// padding to a page
+constexpr size_t STAGING_BUFFER_SIZE = WAL::WRITE_BUFFER_SIZE + MAX_COMPACT_HEADER_SIZE +
+                                       MAX_PAYLOAD_SIZE + WAL::DIRECT_ALIGNMENT;
+
+constexpr size_t align_down(size_t size) { return size & ~(WAL::DIRECT_ALIGNMENT - 1); }
+constexpr size_t align_up(size_t size) { return align_down(size + WAL::DIRECT_ALIGNMENT - 1); }
+
+bool write_all(int fd, const uint8_t* data, size_t size, uint64_t offset) {
+    while (size > 0) {
+        const ssize_t written = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
     }
+    return true;
+}
 
-    ~WAL() {
-        if (fd_ >= 0) {
-            fsync(fd_);
-            close(fd_);
+bool read_file(const std::string& path, std::vector<uint8_t>& contents) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    contents.resize(static_cast<size_t>(st.st_size));
+    size_t done = 0;
+    while (done < contents.size()) {
+        const ssize_t n = ::read(fd, contents.data() + done, contents.size() - done);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    contents.resize(done);
+    close(fd);
+    return true;
+}
+
+}  // namespace
+
+WAL::WAL(const std::string& directory, WALSyncPolicy policy, WALIoBackend backend,
+         WALWriteMode write_mode)
+    : directory_(directory), policy_(policy), write_mode_(write_mode), next_segment_(1),
+      offset_(0), segment_open_(false), staged_carry_(0), bytes_written_(0),
+      last_lsn_(0), sync_requested_lsn_(0), stopping_(false), spare_fd_(-1),
+      spare_wanted_(write_mode == WALWriteMode::DIRECT), durable_lsn_(0),
+      sync_covered_lsn_(0), unsynced_bytes_(0), failed_(false), fd_(-1),
+      file_offset_(0) {
+    if (mkdir(directory_.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("Failed to create WAL directory");
+    }
+    const auto existing = segment_files(directory_);
+    if (!existing.empty()) {
+        next_segment_ = existing.back().first + 1;
+    }
+    unlink(spare_segment_path().c_str());  // Left over from a crash
+    staged_.reserve(STAGING_BUFFER_SIZE);
+    if (backend == WALIoBackend::IO_URING && !setup_uring()) {
+        ring_.reset();
+        spare_buffers_.clear();
+    }
+    flusher_ = std::thread([this]() {
+        if (ring_) {
+            run_uring_flusher();
+        } else {
+            run_flusher();
         }
+    });
+}
+
+WAL::~WAL() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    flusher_wakeup_.notify_one();
+    flusher_.join();
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+    if (spare_fd_ >= 0) {
+        close(spare_fd_);
+        unlink(spare_segment_path().c_str());
+    }
+}
+
+uint64_t WAL::append(const Message& msg) {
+    uint64_t last_id, max_timestamp;
+    message_bounds(msg, last_id, max_timestamp);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (failed_) {
+        return 0;
+    }
+    if (!segment_open_ || offset_ >= SEGMENT_SIZE) {
+        if (!open_segment(msg)) {
+            return 0;
+        }
+    }
+
+    // Record: varint length, compact message
+    const size_t length = encoded_size(msg, base_);
+    const size_t start = staged_.size();
+    staged_.resize(start + varint_size(length) + length);
+    uint8_t* out = staged_.data() + start;
+    out += encode_varint(length, out);
+    encode_message(msg, out, length, base_);
+
+    if (index_) {
+        index_->add(last_id, max_timestamp, offset_);
+    }
+    const size_t record_size = staged_.size() - start;
+    offset_ += record_size;
+    bytes_written_ += record_size;
+    const uint64_t lsn = ++last_lsn_;
+
+    if (policy_.mode == WALSyncPolicy::ALWAYS) {
+        flusher_wakeup_.notify_one();
+        durable_changed_.wait(lock, [&]() { return durable_lsn_ >= lsn || failed_; });
+        return failed_ ? 0 : lsn;
+    }
+    if (staged_bytes() >= WRITE_BUFFER_SIZE ||
+        (policy_.mode == WALSyncPolicy::BYTES &&
+         unsynced_bytes_ + staged_bytes() >= policy_.bytes)) {
+        flusher_wakeup_.notify_one();
     }
+    return lsn;
+}
 
-    // Append a message to the WAL
-    bool append(const Message& msg) {
-        // TODO: Serialize message and write to WAL
-        // For now, just a stub
-        (void)msg;
+bool WAL::wait_durable(uint64_t lsn) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (lsn > last_lsn_) {
+        lsn = last_lsn_;
+    }
+    if (durable_lsn_ >= lsn || failed_) {
+        return !failed_;
+    }
+    if (sync_requested_lsn_ < lsn) {
+        sync_requested_lsn_ = lsn;
+    }
+    flusher_wakeup_.notify_one();
+    durable_changed_.wait(lock, [&]() { return durable_lsn_ >= lsn || failed_; });
+    return !failed_;
+}
+
+bool WAL::flush() {
+    return wait_durable(last_lsn());
+}
+
+void WAL::rotate() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    segment_open_ = false;
+}
+
+uint64_t WAL::bytes_written() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_written_;
+}
+
+uint64_t WAL::last_lsn() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return last_lsn_;
+}
+
+uint64_t WAL::durable_lsn() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return durable_lsn_;
+}
+
+bool WAL::open_segment(const Message& first) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%08u%s", next_segment_, SEGMENT_SUFFIX);
+    const std::string path = directory_ + "/" + name;
+    int fd = -1;
+    if (write_mode_ == WALWriteMode::DIRECT) {
+        // Direct writes of the new segment start on a page of staged_
+        staged_.resize(align_up(staged_.size()));
+        if (spare_fd_ >= 0) {
+            if (rename(spare_segment_path().c_str(), path.c_str()) == 0) {
+                fd = spare_fd_;
+            } else {
+                close(spare_fd_);
+            }
+            spare_fd_ = -1;
+        }
+        if (!spare_wanted_) {
+            spare_wanted_ = true;
+            flusher_wakeup_.notify_one();
+        }
+    }
+    if (fd < 0) {
+        fd = create_segment_file(path);
+        if (fd < 0) {
+            return false;
+        }
+    }
+    ++next_segment_;
+    try {
+        index_ = std::make_unique<SegmentIndexWriter>(path, SEGMENT_SIZE);
+    } catch (const std::runtime_error&) {
+        index_.reset();  // Rebuilt from the segment when needed
+    }
+    staged_segments_.push_back(SegmentStart{staged_.size(), fd});
+    segment_open_ = true;
+
+    base_.id = first.header.id;
+    base_.timestamp = first.header.timestamp;
+
+    WALSegmentHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = WALSegmentHeader::MAGIC;
+    header.version = WALSegmentHeader::VERSION;
+    header.base_id = base_.id;
+    header.base_timestamp = base_.timestamp;
+
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&header);
+    staged_.insert(staged_.end(), bytes, bytes + sizeof(header));
+    offset_ = sizeof(header);
+    bytes_written_ += sizeof(header);
+    return true;
+}
+
+// Segment file opened for writing; in DIRECT mode with O_DIRECT where the
+// file system allows it, and its space allocated up front
+int WAL::create_segment_file(const std::string& path) const {
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0 || write_mode_ != WALWriteMode::DIRECT) {
+        return fd;
+    }
+    const int flags = fcntl(fd, F_GETFL);
+    if (flags >= 0) {
+        fcntl(fd, F_SETFL, flags | O_DIRECT);  // Unsupported: stay buffered
+    }
+    // Extending the size too keeps fdatasync() from logging size changes;
+    // the zeros past the records read as the end of the segment
+    fallocate(fd, 0, 0, static_cast<off_t>(SEGMENT_SIZE));
+    return fd;
+}
+
+std::string WAL::spare_segment_path() const {
+    return directory_ + "/" + SPARE_SEGMENT;
+}
+
+// Create the next segment file outside the lock (flusher thread)
+void WAL::prepare_spare_segment(std::unique_lock<std::mutex>& lock) {
+    spare_wanted_ = false;
+    if (stopping_ || spare_fd_ >= 0) {
+        return;
+    }
+    const std::string path = spare_segment_path();
+    lock.unlock();
+    const int fd = create_segment_file(path);
+    lock.lock();
+    spare_fd_ = fd;
+}
+
+// Whether the policy wants an fsync now (mutex_ held)
+bool WAL::sync_due(SyncClock::time_point next_sync) const {
+    const bool unsynced = last_lsn_ > sync_covered_lsn_;
+    if (sync_requested_lsn_ > sync_covered_lsn_) {
         return true;
     }
+    if (stopping_) {
+        return unsynced && policy_.mode != WALSyncPolicy::NEVER;
+    }
+    switch (policy_.mode) {
+    case WALSyncPolicy::ALWAYS:
+        return unsynced;
+    case WALSyncPolicy::INTERVAL:
+        return unsynced && SyncClock::now() >= next_sync;
+    case WALSyncPolicy::BYTES:
+        return unsynced && unsynced_bytes_ + staged_bytes() >= policy_.bytes;
+    case WALSyncPolicy::NEVER:
+        break;
+    }
+    return false;
+}
+
+// Whether the flusher has anything to do (mutex_ held)
+bool WAL::flusher_ready(SyncClock::time_point next_sync) const {
+    return stopping_ || spare_wanted_ || staged_bytes() >= WRITE_BUFFER_SIZE ||
+           sync_due(next_sync);
+}
 
-    // Flush to disk
-    void flush() {
+void WAL::wait_for_work(std::unique_lock<std::mutex>& lock,
+                        SyncClock::time_point& next_sync) {
+    const auto ready = [&]() { return flusher_ready(next_sync); };
+    if (policy_.mode != WALSyncPolicy::INTERVAL) {
+        flusher_wakeup_.wait(lock, ready);
+    } else if (!flusher_wakeup_.wait_until(lock, next_sync, ready)) {
+        next_sync = SyncClock::now() + std::chrono::milliseconds(policy_.interval_ms);  // Idle
+    }
+}
+
+// Hand the staged bytes to the flusher; returns the LSN they end at
+// (mutex_ held)
+uint64_t WAL::take_staged(Buffer& buffer, std::vector<SegmentStart>& segments,
+                          bool sync, SyncClock::time_point& next_sync) {
+    const size_t taken = staged_bytes();
+    buffer.swap(staged_);
+    segments.swap(staged_segments_);
+    staged_carry_ = 0;
+    if (write_mode_ == WALWriteMode::DIRECT) {
+        // The partial last page goes out again with the next batch
+        const size_t tail = buffer.size() - align_down(buffer.size());
+        staged_.insert(staged_.end(), buffer.end() - static_cast<ptrdiff_t>(tail),
+                       buffer.end());
+        staged_carry_ = tail;
+    }
+    if (sync) {
+        sync_covered_lsn_ = last_lsn_;
+        unsynced_bytes_ = 0;
+        next_sync = SyncClock::now() + std::chrono::milliseconds(policy_.interval_ms);
+    } else {
+        unsynced_bytes_ += taken;
+    }
+    return last_lsn_;
+}
+
+// Flusher thread (syscalls): take the staged buffer, write it, fsync when due
+void WAL::run_flusher() {
+    Buffer writing;
+    std::vector<SegmentStart> segments;
+    writing.reserve(STAGING_BUFFER_SIZE);
+    auto next_sync = SyncClock::now() + std::chrono::milliseconds(policy_.interval_ms);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        if (failed_) {
+            // Nothing more can become durable; appends are refused
+            flusher_wakeup_.wait(lock, [&]() { return stopping_; });
+            break;
+        }
+        wait_for_work(lock, next_sync);
+        if (spare_wanted_) {
+            prepare_spare_segment(lock);
+        }
+        const bool sync = sync_due(next_sync);
+        if (staged_bytes() == 0 && !sync) {
+            if (stopping_) {
+                break;
+            }
+            continue;
+        }
+
+        // Double buffering: appenders fill the other buffer meanwhile
+        const uint64_t lsn = take_staged(writing, segments, sync, next_sync);
+        lock.unlock();
+
+        const size_t size = writing.size();
+        if (write_mode_ == WALWriteMode::DIRECT) {
+            writing.resize(align_up(size));
+        }
+        bool ok = true;
+        size_t done = 0;
+        for (const SegmentStart& segment : segments) {
+            if (fd_ >= 0) {
+                // A finished segment is always synced before it is closed
+                ok = write_all(fd_, writing.data() + done, segment.offset - done,
+                               file_offset_) &&
+                     fdatasync(fd_) == 0 && ok;
+                close(fd_);
+            }
+            fd_ = segment.fd;
+            file_offset_ = 0;
+            done = segment.offset;
+        }
         if (fd_ >= 0) {
-            fsync(fd_);
+            ok = write_all(fd_, writing.data() + done, writing.size() - done, file_offset_) &&
+                 ok;
+            file_offset_ += write_mode_ == WALWriteMode::DIRECT ? align_down(size - done)
+                                                                 : size - done;
+            if (sync) {
+                ok = fdatasync(fd_) == 0 && ok;
+            }
+        }
+        writing.clear();
+        segments.clear();
+
+        lock.lock();
+        if (!ok) {
+            failed_ = true;
+        } else if (sync) {
+            durable_lsn_ = lsn;
+        }
+        durable_changed_.notify_all();
+        if (stopping_ && staged_bytes() == 0 && !sync_due(next_sync)) {
+            break;
         }
     }
+}
+
+namespace {
+
+constexpr unsigned URING_ENTRIES = 64;
+constexpr size_t URING_MAX_IN_FLIGHT = 4;  // Batches submitted, not completed
+constexpr int URING_FILE = 0;              // Registered file slot of fd_
 
-    // Rotate to a new segment
-    void rotate() {
-        // TODO: Close current segment and open new one
+// Completion tags: batch sequence number and whether it is the fsync
+constexpr uint64_t tag(uint64_t batch, bool fsync) { return batch << 1 | (fsync ? 1 : 0); }
+
+}  // namespace
+
+// Registered buffers: staged_ and the spares it is swapped with
+bool WAL::setup_uring() {
+    if (!IoUring::supported()) {
+        return false;
+    }
+    ring_ = std::make_unique<IoUring>(URING_ENTRIES);
+    if (!ring_->is_open()) {
+        return false;
     }
+    spare_buffers_.resize(URING_MAX_IN_FLIGHT);
+    std::vector<struct iovec> iovs;
+    iovs.push_back({staged_.data(), staged_.capacity()});
+    for (auto& buffer : spare_buffers_) {
+        buffer.reserve(STAGING_BUFFER_SIZE);
+        iovs.push_back({buffer.data(), buffer.capacity()});
+    }
+    // Without pinned buffers writes are just not WRITE_FIXED
+    registered_buffers_ = ring_->register_buffers(iovs.data(),
+                                                  static_cast<unsigned>(iovs.size()))
+                              ? iovs
+                              : std::vector<struct iovec>();
+    const int no_file = -1;
+    return ring_->register_files(&no_file, 1);
+}
 
-private:
-    int fd_;
-    size_t offset_;
-};
+// Flusher thread (io_uring): like run_flusher(), but each batch becomes a
+// write (linked to an fdatasync when due) and the thread goes on staging
+// the next batch while the kernel works; completions advance the durable
+// LSN in submission order
+void WAL::run_uring_flusher() {
+    struct Batch {
+        uint64_t sequence;
+        Buffer buffer;
+        uint64_t lsn;
+        bool sync;
+        unsigned pending;  // Completions outstanding
+        bool ok;
+    };
+    std::deque<Batch> in_flight;
+    uint64_t next_sequence = 0;
+    auto next_sync = SyncClock::now() + std::chrono::milliseconds(policy_.interval_ms);
+    IoUring& ring = *ring_;
 
-}  // namespace nanomq
+    // Queue a write of data to fd_, then the fdatasync if wanted; the fsync
+    // drains everything submitted before it, so it covers earlier batches.
+    // The file offset moves on by advance (less than size for a padded
+    // DIRECT tail)
+    const auto queue = [&](const uint8_t* data, size_t size, size_t advance, int buf_index,
+                           bool sync, uint64_t sequence) -> unsigned {
+        unsigned queued = 0;
+        if (size > 0) {
+            struct io_uring_sqe* sqe = ring.get_sqe();
+            IoUring::prep_write(sqe, URING_FILE, data, static_cast<unsigned>(size),
+                                file_offset_, buf_index, tag(sequence, false));
+            sqe->flags |= IOSQE_FIXED_FILE | (sync ? IOSQE_IO_LINK : 0);
+            file_offset_ += advance;
+            ++queued;
+        }
+        if (sync) {
+            struct io_uring_sqe* sqe = ring.get_sqe();
+            IoUring::prep_fdatasync(sqe, URING_FILE, tag(sequence, true));
+            sqe->flags |= IOSQE_FIXED_FILE | IOSQE_IO_DRAIN;
+            ++queued;
+        }
+        return queued;
+    };
+
+    // Wait for one completion if wait, then account for all that are ready
+    const auto reap = [&](bool wait) {
+        if (wait && ring.peek_cqe() == nullptr) {
+            ring.submit(1);
+        }
+        while (struct io_uring_cqe* cqe = ring.peek_cqe()) {
+            const uint64_t sequence = cqe->user_data >> 1;
+            const bool fsync = (cqe->user_data & 1) != 0;
+            for (Batch& batch : in_flight) {
+                if (batch.sequence == sequence) {
+                    if (cqe->res < 0 ||
+                        (!fsync && static_cast<size_t>(cqe->res) != batch.buffer.size())) {
+                        batch.ok = false;  // Short writes to a file mean ENOSPC
+                    }
+                    --batch.pending;
+                    break;
+                }
+            }
+            ring.cqe_seen();
+        }
+    };
 
+    // Finished batches, oldest first (mutex_ held)
+    const auto retire = [&]() {
+        bool changed = false;
+        while (!in_flight.empty() && in_flight.front().pending == 0) {
+            Batch& batch = in_flight.front();
+            if (!batch.ok) {
+                failed_ = true;
+            } else if (batch.sync) {
+                durable_lsn_ = batch.lsn;
+            }
+            batch.buffer.clear();
+            spare_buffers_.push_back(std::move(batch.buffer));
+            in_flight.pop_front();
+            changed = true;
+        }
+        if (changed) {
+            durable_changed_.notify_all();
+        }
+    };
+
+    // Segment switches are rare: finish everything, then write and sync the
+    // old segment's tail synchronously
+    const auto switch_segments = [&](Batch& batch, const std::vector<SegmentStart>& segments,
+                                     size_t& done) -> bool {
+        while (!in_flight.empty()) {
+            reap(true);
+            std::lock_guard<std::mutex> guard(mutex_);
+            retire();
+        }
+        bool ok = true;
+        for (const SegmentStart& segment : segments) {
+            if (fd_ >= 0) {
+                const size_t size = segment.offset - done;
+                const unsigned queued = queue(batch.buffer.data() + done, size, size, -1,
+                                              true, batch.sequence);
+                ring.submit(queued);
+                for (unsigned i = 0; i < queued; ++i) {
+                    if (ring.peek_cqe() == nullptr) {
+                        ring.submit(1);
+                    }
+                    struct io_uring_cqe* cqe = ring.peek_cqe();
+                    ok = ok && cqe != nullptr && cqe->res >= 0;
+                    ring.cqe_seen();
+                }
+                close(fd_);
+            }
+            fd_ = segment.fd;
+            file_offset_ = 0;
+            ok = ring.update_file(URING_FILE, fd_) && ok;
+            done = segment.offset;
+        }
+        return ok;
+    };
+
+    // A DIRECT batch rewrites the padded last page of the one before it, and
+    // io_uring may complete the two writes in either order
+    const size_t max_in_flight =
+        write_mode_ == WALWriteMode::DIRECT ? 1 : URING_MAX_IN_FLIGHT;
+
+    std::vector<SegmentStart> segments;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        if (failed_ && in_flight.empty()) {
+            flusher_wakeup_.wait(lock, [&]() { return stopping_; });
+            break;
+        }
+        if (in_flight.empty()) {
+            wait_for_work(lock, next_sync);
+        }
+        if (spare_wanted_) {
+            prepare_spare_segment(lock);
+        }
+
+        const bool sync = !failed_ && sync_due(next_sync);
+        const bool take = !failed_ && (staged_bytes() >= WRITE_BUFFER_SIZE || sync ||
+                                       (stopping_ && staged_bytes() > 0));
+        if (take && in_flight.size() < max_in_flight && !spare_buffers_.empty()) {
+            Batch batch;
+            batch.sequence = next_sequence++;
+            batch.buffer = std::move(spare_buffers_.back());
+            spare_buffers_.pop_back();
+            batch.lsn = take_staged(batch.buffer, segments, sync, next_sync);
+            batch.sync = sync;
+            batch.ok = true;
+            lock.unlock();
+
+            size_t done = 0;
+            if (!segments.empty()) {
+                batch.ok = switch_segments(batch, segments, done);
+                segments.clear();
+            }
+            // Keep only the tail in the batch so write sizes match
+            if (done > 0) {
+                batch.buffer.erase(batch.buffer.begin(),
+                                   batch.buffer.begin() + static_cast<ptrdiff_t>(done));
+            }
+            const size_t size = batch.buffer.size();
+            if (write_mode_ == WALWriteMode::DIRECT) {
+                batch.buffer.resize(align_up(size));
+            }
+            // A staged buffer that outgrew its reservation was reallocated;
+            // the pinned pages are gone from it, and nothing else is ever
+            // allocated with exactly the registered capacity
+            int buf_index = -1;
+            for (size_t i = 0; i < registered_buffers_.size(); ++i) {
+                if (registered_buffers_[i].iov_base == batch.buffer.data() &&
+                    registered_buffers_[i].iov_len == batch.buffer.capacity()) {
+                    buf_index = static_cast<int>(i);
+                }
+            }
+            const size_t advance = write_mode_ == WALWriteMode::DIRECT ? align_down(size) : size;
+            batch.pending = fd_ >= 0 ? queue(batch.buffer.data(), batch.buffer.size(), advance,
+                                             buf_index, sync, batch.sequence)
+                                     : 0;
+            if (batch.pending > 0 && ring.submit() < 0) {
+                batch.ok = false;
+                batch.pending = 0;
+            }
+
+            lock.lock();
+            in_flight.push_back(std::move(batch));
+            retire();
+            continue;
+        }
+
+        if (!in_flight.empty()) {
+            lock.unlock();
+            reap(true);
+            lock.lock();
+            retire();
+            continue;
+        }
+        if (stopping_ && staged_bytes() == 0) {
+            break;
+        }
+    }
+}
+
+std::vector<std::string> WAL::segment_paths() const {
+    std::vector<std::string> paths;
+    for (auto& segment : segment_files(directory_)) {
+        paths.push_back(std::move(segment.second));
+    }
+    return paths;
+}
+
+size_t WAL::replay(const std::function<void(const Message&)>& visit) const {
+    size_t visited = 0;
+    std::vector<uint8_t> contents;
+    for (const std::string& path : segment_paths()) {
+        if (!read_file(path, contents) || contents.size() < sizeof(WALSegmentHeader)) {
+            continue;
+        }
+        WALSegmentHeader header;
+        std::memcpy(&header, contents.data(), sizeof(header));
+        if (header.magic != WALSegmentHeader::MAGIC ||
+            header.version != WALSegmentHeader::VERSION) {
+            continue;
+        }
+        EncodingBase base;
+        base.id = header.base_id;
+        base.timestamp = header.base_timestamp;
+
+        const uint8_t* p = contents.data() + sizeof(header);
+        const uint8_t* end = contents.data() + contents.size();
+        while (p < end) {
+            uint64_t length = 0;
+            const size_t n = decode_varint(p, end, length);
+            if (n == 0 || length > static_cast<size_t>(end - p - n)) {
+                break;  // Torn tail
+            }
+            if (length == 0) {
+                break;  // Padding or preallocated space
+            }
+            p += n;
+            Message msg;
+            if (decode_message(p, length, msg, base) != length) {
+                break;
+            }
+            visit(msg);
+            ++visited;
+            p += length;
+        }
+    }
+    return visited;
+}
+
+}  // namespace nanomq
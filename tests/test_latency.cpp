@@ -1,5 +1,8 @@
 #include "nanomq/queue.hpp"
 #include "nanomq/message.hpp"
+#include "nanomq/clock.hpp"
+#include <sys/wait.h>
+#include <unistd.h>
 #include <gtest/gtest.h>
 #include <thread>
 #include <vector>
@@ -36,6 +39,62 @@ LatencyStats calculate_stats(std::vector<uint64_t>& latencies) {
     };
 }
 
+TEST(ClockTest, MonotonicAndCloseToRealtime) {
+    uint64_t previous = Clock::now_ns();
+    for (int i = 0; i < 100000; ++i) {
+        const uint64_t now = Clock::now_ns();
+        ASSERT_GE(now, previous);
+        previous = now;
+    }
+
+    const uint64_t realtime = Clock::realtime_ns();
+    const uint64_t now = Clock::now_ns();
+    const int64_t skew = static_cast<int64_t>(now - realtime);
+    EXPECT_LT(std::abs(skew), 2000000) << "TSC clock is " << skew << " ns off";
+
+    if (Clock::uses_tsc()) {
+        EXPECT_GT(Clock::tsc_hz(), 100000000u);
+    }
+}
+
+TEST(ClockTest, TracksElapsedTime) {
+    Clock::recalibrate();
+    const uint64_t start = Clock::now_ns();
+    const uint64_t real_start = Clock::realtime_ns();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const uint64_t elapsed = Clock::now_ns() - start;
+    const uint64_t real_elapsed = Clock::realtime_ns() - real_start;
+    EXPECT_NEAR(static_cast<double>(elapsed), static_cast<double>(real_elapsed), 1000000.0);
+}
+
+TEST(ClockTest, CoarseClock) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    const uint64_t coarse = Clock::coarse_now_ns();
+    const uint64_t now = Clock::now_ns();
+    // Refreshed every millisecond; allow for scheduling delays
+    EXPECT_LT(now - coarse, 50 * Clock::COARSE_INTERVAL_NS);
+    EXPECT_LE(coarse, now + Clock::COARSE_INTERVAL_NS);
+}
+
+TEST(ClockTest, CoarseClockAfterFork) {
+    Clock::coarse_now_ns();  // The parent's thread is running
+    const pid_t child = fork();
+    ASSERT_GE(child, 0);
+    if (child == 0) {
+        // No calibrator thread was forked; the child must start its own
+        const uint64_t first = Clock::coarse_now_ns();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        const uint64_t second = Clock::coarse_now_ns();
+        const uint64_t realtime = Clock::realtime_ns();
+        const bool ok = second > first && realtime - second < 50 * Clock::COARSE_INTERVAL_NS;
+        _exit(ok ? 0 : 1);
+    }
+    int status = 0;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+}
+
 // Test single-threaded latency
 TEST(LatencyTest, SingleThreaded) {
     SPSCQueue<int, 65536> queue;
@@ -44,15 +103,12 @@ TEST(LatencyTest, SingleThreaded) {
     latencies.reserve(NUM_ITEMS);
 
     for (int i = 0; i < NUM_ITEMS; ++i) {
-        auto start = std::chrono::high_resolution_clock::now();
+        const uint64_t start = Clock::now_ns();
         queue.try_push(i);
         int value;
         queue.try_pop(value);
-        auto end = std::chrono::high_resolution_clock::now();
-        
-        auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
-            end - start).count();
-        latencies.push_back(latency);
+        const uint64_t end = Clock::now_ns();
+        latencies.push_back(end - start);
     }
 
     auto stats = calculate_stats(latencies);
@@ -75,8 +131,7 @@ TEST(LatencyTest, ConcurrentProducerConsumer) {
 
     std::thread producer([&]() {
         for (int i = 0; i < NUM_ITEMS; ++i) {
-            uint64_t timestamp = std::chrono::high_resolution_clock::now()
-                                    .time_since_epoch().count();
+            uint64_t timestamp = Clock::now_ns();
             while (!queue.try_push(timestamp)) {
                 std::this_thread::yield();
             }
@@ -89,8 +144,7 @@ TEST(LatencyTest, ConcurrentProducerConsumer) {
             while (!queue.try_pop(timestamp)) {
                 std::this_thread::yield();
             }
-            uint64_t now = std::chrono::high_resolution_clock::now()
-                              .time_since_epoch().count();
+            uint64_t now = Clock::now_ns();
             latencies.push_back(now - timestamp);
         }
     });
@@ -126,13 +180,10 @@ TEST(LatencyTest, BatchOperations) {
     }
 
     for (int i = 0; i < NUM_BATCHES; ++i) {
-        auto start = std::chrono::high_resolution_clock::now();
+        const uint64_t start = Clock::now_ns();
         queue.try_push_batch(batch_data.data(), BATCH_SIZE);
-        auto end = std::chrono::high_resolution_clock::now();
-        
-        auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
-            end - start).count();
-        latencies.push_back(latency);
+        const uint64_t end = Clock::now_ns();
+        latencies.push_back(end - start);
 
         // Pop to make room
         std::vector<int> out(BATCH_SIZE);
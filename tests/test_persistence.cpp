@@ -1,9 +1,77 @@
+#include "nanomq/compaction.hpp"
+#include "nanomq/compression.hpp"
+#include "nanomq/crc32c.hpp"
+#include "nanomq/io_uring.hpp"
+#include "nanomq/log_streamer.hpp"
 #include "nanomq/message.hpp"
+#include "nanomq/message_ref.hpp"
+#include "nanomq/mmap_file.hpp"
+#include "nanomq/payload_pool.hpp"
+#include "nanomq/protocol.hpp"
+#include "nanomq/queue.hpp"
+#include "nanomq/record_batch.hpp"
+#include "nanomq/recovery.hpp"
+#include "nanomq/segment.hpp"
+#include "nanomq/subscriber.hpp"
+#include "nanomq/tiered_storage.hpp"
+#include "nanomq/topic.hpp"
+#include "nanomq/wal.hpp"
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <fstream>
+#include <iterator>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace nanomq;
 
+namespace {
+
+// Fresh directory under /tmp, unique per test process
+std::string test_directory(const char* tag) {
+    return std::string("/tmp/nanomq-") + tag + "-" + std::to_string(getpid());
+}
+
+void remove_directory(const std::string& dir) {
+    if (DIR* d = opendir(dir.c_str())) {
+        while (struct dirent* entry = readdir(d)) {
+            if (entry->d_name[0] != '.') {
+                unlink((dir + "/" + entry->d_name).c_str());
+            }
+        }
+        closedir(d);
+    }
+    rmdir(dir.c_str());
+}
+
+// Archive store whose reads and deletes are slow, like a remote one
+class SlowStore : public LocalArchiveStore {
+public:
+    using LocalArchiveStore::LocalArchiveStore;
+    bool get(const std::string& name, std::vector<uint8_t>& data) override {
+        ++gets;
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        return LocalArchiveStore::get(name, data);
+    }
+    bool remove(const std::string& name) override {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        return LocalArchiveStore::remove(name);
+    }
+    std::atomic<int> gets{0};
+};
+
+}  // namespace
+
 // Test CRC32 calculation
 TEST(PersistenceTest, CRC32Calculation) {
     const char* data = "Hello, NanoMQ!";
@@ -21,23 +89,380 @@ TEST(PersistenceTest, CRC32Calculation) {
     EXPECT_NE(crc, crc3);
 }
 
+// Test CRC32C against published check values
+TEST(PersistenceTest, CRC32CKnownValues) {
+    EXPECT_EQ(crc32c("123456789", 9), 0xE3069283u);
+    EXPECT_EQ(crc32c(nullptr, 0), 0u);
+
+    std::vector<uint8_t> zeros(32, 0x00);
+    std::vector<uint8_t> ones(32, 0xff);
+    EXPECT_EQ(crc32c(zeros.data(), zeros.size()), 0x8A9136AAu);
+    EXPECT_EQ(crc32c(ones.data(), ones.size()), 0x62A8AB43u);
+}
+
+// Test that every supported implementation agrees with the software one
+TEST(PersistenceTest, CRC32CImplementationsAgree) {
+    std::vector<uint8_t> data(3 * 3 * 8192 + 1000);
+    uint32_t state = 12345;
+    for (uint8_t& byte : data) {
+        state = state * 1103515245 + 12345;
+        byte = static_cast<uint8_t>(state >> 16);
+    }
+
+    const Crc32cImpl original = crc32c_implementation();
+    const size_t sizes[] = {0, 1, 7, 8, 63, 64, 767, 768, 769, 4096,
+                            3 * 8192 - 1, 3 * 8192, 3 * 8192 + 777,
+                            3 * 3 * 8192 + 5};
+    for (size_t offset = 0; offset < 8; offset += 3) {
+        for (size_t size : sizes) {
+            ASSERT_TRUE(crc32c_set_implementation(Crc32cImpl::SOFTWARE));
+            const uint32_t expected = crc32c(data.data() + offset, size);
+            for (Crc32cImpl impl : {Crc32cImpl::SSE42, Crc32cImpl::SSE42_PCLMUL}) {
+                if (!crc32c_set_implementation(impl)) {
+                    continue;
+                }
+                EXPECT_EQ(crc32c(data.data() + offset, size), expected)
+                    << crc32c_implementation_name(impl) << " size " << size
+                    << " offset " << offset;
+            }
+
+            // Split anywhere and continue
+            const size_t split = size / 3;
+            EXPECT_EQ(crc32c_extend(crc32c(data.data() + offset, split),
+                                    data.data() + offset + split, size - split),
+                      expected);
+        }
+    }
+    EXPECT_TRUE(crc32c_set_implementation(original));
+}
+
+// Test that headers written with the old CRC32 still verify
+TEST(PersistenceTest, LegacyCRC32StillVerifies) {
+    const char* payload = "written by an older release";
+    Message msg;
+    msg.header.size = static_cast<uint32_t>(strlen(payload));
+    msg.header.crc32 = Message::calculate_crc32(payload, strlen(payload));
+    msg.data = reinterpret_cast<uint8_t*>(const_cast<char*>(payload));
+    EXPECT_FALSE(msg.has_flag(MSG_FLAG_CRC32C));
+    EXPECT_TRUE(msg.verify_checksum());
+
+    msg.set_checksum(payload);
+    EXPECT_TRUE(msg.has_flag(MSG_FLAG_CRC32C));
+    EXPECT_EQ(msg.header.crc32, crc32c(payload, strlen(payload)));
+    EXPECT_TRUE(msg.verify_checksum());
+}
+
+// Test LZ4 round trips on compressible, incompressible and tiny inputs
+TEST(PersistenceTest, LZ4RoundTrip) {
+    std::string json;
+    for (int i = 0; json.size() < 100000; ++i) {
+        json += "{\"symbol\":\"ACME\",\"seq\":" + std::to_string(i) +
+                ",\"bid\":101." + std::to_string(i % 97) + ",\"side\":\"buy\"}\n";
+    }
+    std::vector<uint8_t> noise(50000);
+    uint32_t state = 7;
+    for (uint8_t& byte : noise) {
+        state = state * 1103515245 + 12345;
+        byte = static_cast<uint8_t>(state >> 16);
+    }
+    const std::string runs(70000, 'x');  // Offsets shorter than 8
+
+    const std::pair<const void*, size_t> inputs[] = {
+        {json.data(), json.size()}, {noise.data(), noise.size()},
+        {runs.data(), runs.size()}, {"abc", 3}, {"", 0},
+        {json.data(), 13}, {json.data(), 1000},
+    };
+    for (const auto& input : inputs) {
+        std::vector<uint8_t> compressed(lz4_compress_bound(input.second));
+        const size_t n = lz4_compress(input.first, input.second,
+                                      compressed.data(), compressed.size());
+        ASSERT_GT(n, 0u);
+        std::vector<uint8_t> restored(input.second + 1);
+        ASSERT_EQ(lz4_decompress(compressed.data(), n, restored.data(), restored.size()),
+                  input.second);
+        EXPECT_EQ(std::memcmp(restored.data(), input.first, input.second), 0);
+
+        // Too small an output buffer is an error, not an overflow
+        if (input.second > 0) {
+            EXPECT_EQ(lz4_decompress(compressed.data(), n, restored.data(),
+                                     input.second - 1), 0u);
+        }
+    }
+
+    std::vector<uint8_t> compressed(lz4_compress_bound(json.size()));
+    const size_t n = lz4_compress(json.data(), json.size(), compressed.data(),
+                                  compressed.size());
+    EXPECT_LT(n, json.size() / 4);
+
+    // Truncated blocks are rejected
+    std::vector<uint8_t> restored(json.size());
+    for (size_t size : {size_t(0), size_t(1), n / 2, n - 1}) {
+        EXPECT_NE(lz4_decompress(compressed.data(), size, restored.data(),
+                                 restored.size()), json.size());
+    }
+}
+
+// Test compressed record batches round trip with their record headers
+TEST(PersistenceTest, CompressedBatch) {
+    std::vector<std::string> payloads;
+    for (int i = 0; i < 200; ++i) {
+        payloads.push_back("{\"order\":" + std::to_string(i) + ",\"qty\":100}");
+    }
+    MessageBatch builder;
+    for (int i = 0; i < 200; ++i) {
+        ASSERT_TRUE(builder.add(500 + i, 1000000 + i, payloads[i].data(), payloads[i].size()));
+    }
+    const Message plain = builder.finish();
+    const size_t plain_size = plain.header.size;
+    const Message batch = builder.finish(true);
+    EXPECT_TRUE(batch.has_flag(MSG_FLAG_BATCH));
+    EXPECT_TRUE(batch.has_flag(MSG_FLAG_COMPRESSED));
+    EXPECT_LT(batch.header.size, plain_size / 2);
+
+    RecordBatchReader reader;
+    ASSERT_TRUE(reader.reset(batch));
+    EXPECT_EQ(reader.remaining(), payloads.size());
+    Message record;
+    for (size_t i = 0; i < payloads.size(); ++i) {
+        ASSERT_TRUE(reader.next(record));
+        EXPECT_EQ(record.header.id, 500 + i);
+        EXPECT_EQ(record.header.timestamp, 1000000 + i);
+        EXPECT_EQ(std::string(reinterpret_cast<const char*>(record.data), record.header.size),
+                  payloads[i]);
+    }
+    EXPECT_FALSE(reader.next(record));
+
+    // Records that do not compress stay plain
+    MessageBatch random;
+    std::vector<uint8_t> noise(1000);
+    uint32_t x = 12345;
+    for (uint8_t& byte : noise) {
+        x = x * 1103515245 + 12345;
+        byte = static_cast<uint8_t>(x >> 24);
+    }
+    ASSERT_TRUE(random.add(1, 1, noise.data(), noise.size()));
+    EXPECT_FALSE(random.finish(true).has_flag(MSG_FLAG_COMPRESSED));
+
+    // Corrupt payloads are refused
+    std::vector<uint8_t> copy(batch.data, batch.data + batch.header.size);
+    Message corrupt = batch;
+    corrupt.data = copy.data();
+    copy[copy.size() / 2] ^= 0x55;
+    EXPECT_FALSE(reader.reset(corrupt));
+}
+
 // Test message checksum verification
 TEST(PersistenceTest, MessageChecksumVerification) {
     const char* payload = "Test message payload";
-    Message msg(1, get_timestamp_ns(), 42, payload, strlen(payload));
-    
-    // Allocate and copy payload
-    msg.data = new uint8_t[strlen(payload)];
-    memcpy(msg.data, payload, strlen(payload));
-    
+    PooledMessage pooled(1, get_timestamp_ns(), 42, payload, strlen(payload));
+    ASSERT_TRUE(pooled);
+    Message& msg = pooled.message;
+
     // Verify checksum matches
     EXPECT_TRUE(msg.verify_checksum());
-    
+
     // Corrupt the data
     msg.data[0] = ~msg.data[0];
     EXPECT_FALSE(msg.verify_checksum());
-    
-    delete[] msg.data;
+}
+
+// Test that MessageRef copies share one payload
+TEST(MessageRefTest, SharesPayload) {
+    const std::string text = "shared payload";
+    MessageRef ref(1, get_timestamp_ns(), 3, text.data(), text.size());
+    ASSERT_TRUE(ref);
+    EXPECT_TRUE(ref.message().verify_checksum());
+    EXPECT_EQ(ref.use_count(), 1u);
+    {
+        MessageRef copy = ref;
+        MessageRef moved = std::move(copy);
+        EXPECT_FALSE(copy);
+        EXPECT_EQ(moved.data(), ref.data());
+        EXPECT_EQ(ref.use_count(), 2u);
+    }
+    EXPECT_EQ(ref.use_count(), 1u);
+
+    // A reference survives a trip through a queue as a plain Message
+    SPSCQueue<Message, 16> queue;
+    MessageRef copy = ref;
+    ASSERT_TRUE(queue.try_push(copy.detach()));
+    EXPECT_FALSE(copy);
+    EXPECT_EQ(ref.use_count(), 2u);
+    Message msg;
+    ASSERT_TRUE(queue.try_pop(msg));
+    MessageRef adopted = MessageRef::adopt(msg);
+    EXPECT_EQ(adopted.data(), ref.data());
+    adopted.reset();
+    EXPECT_EQ(ref.use_count(), 1u);
+
+    // Payloads too large for the pool come from the heap
+    std::vector<uint8_t> large(MAX_PAYLOAD_SIZE, 0x42);
+    MessageRef big(2, 0, 3, large.data(), large.size());
+    ASSERT_TRUE(big);
+    EXPECT_TRUE(big.message().verify_checksum());
+}
+
+// Test fan-out of one payload to several consumer threads
+TEST(MessageRefTest, CrossThreadFanOut) {
+    const int NUM_CONSUMERS = 3;
+    const int NUM_MESSAGES = 20000;
+    std::vector<std::unique_ptr<SPSCQueue<Message, 1024>>> queues;
+    for (int c = 0; c < NUM_CONSUMERS; ++c) {
+        queues.push_back(std::make_unique<SPSCQueue<Message, 1024>>());
+    }
+
+    std::atomic<int> corrupt{0};
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < NUM_CONSUMERS; ++c) {
+        consumers.emplace_back([&, c]() {
+            for (int received = 0; received < NUM_MESSAGES;) {
+                Message msg;
+                if (!queues[c]->try_pop(msg)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                MessageRef ref = MessageRef::adopt(msg);
+                if (!ref.message().verify_checksum()) {
+                    corrupt++;
+                }
+                ++received;
+            }
+        });
+    }
+
+    MessageRef last;
+    for (int i = 0; i < NUM_MESSAGES; ++i) {
+        const std::string text = "fan-out-" + std::to_string(i);
+        MessageRef ref(i + 1, 0, 1, text.data(), text.size());
+        ASSERT_TRUE(ref);
+        ref.share();
+        for (int c = 0; c < NUM_CONSUMERS; ++c) {
+            MessageRef copy = ref;
+            const Message msg = copy.detach();
+            while (!queues[c]->try_push(msg)) {
+                std::this_thread::yield();
+            }
+        }
+        last = std::move(ref);
+    }
+    for (auto& consumer : consumers) {
+        consumer.join();
+    }
+    EXPECT_EQ(corrupt.load(), 0);
+    EXPECT_EQ(last.use_count(), 1u);  // Every consumer let go
+}
+
+// Test payload pool size classes
+TEST(PayloadPoolTest, SizeClasses) {
+    EXPECT_EQ(PayloadPool::size_class(0), 0u);
+    EXPECT_EQ(PayloadPool::size_class(1), 0u);
+    EXPECT_EQ(PayloadPool::size_class(64), 0u);
+    EXPECT_EQ(PayloadPool::size_class(65), 1u);
+    EXPECT_EQ(PayloadPool::size_class(4096), 6u);
+    EXPECT_EQ(PayloadPool::size_class(MAX_PAYLOAD_SIZE),
+              PayloadPool::NUM_SIZE_CLASSES - 1);
+    for (size_t size = 1; size <= MAX_PAYLOAD_SIZE; size = size * 3 + 1) {
+        EXPECT_GE(PayloadPool::class_size(PayloadPool::size_class(size)), size);
+    }
+
+    EXPECT_EQ(PayloadPool::allocate(MAX_PAYLOAD_SIZE + 1), nullptr);
+    uint8_t* largest = PayloadPool::allocate(MAX_PAYLOAD_SIZE);
+    ASSERT_NE(largest, nullptr);
+    std::memset(largest, 0xab, MAX_PAYLOAD_SIZE);
+    PayloadPool::deallocate(largest, MAX_PAYLOAD_SIZE);
+}
+
+// Test that freed buffers are handed out again instead of new slabs
+TEST(PayloadPoolTest, ReusesBuffers) {
+    std::vector<uint8_t*> buffers;
+    for (int i = 0; i < 1000; ++i) {
+        uint8_t* buffer = PayloadPool::allocate(200);
+        ASSERT_NE(buffer, nullptr);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(buffer) % CACHE_LINE_SIZE, 0u);
+        buffers.push_back(buffer);
+    }
+    EXPECT_EQ(std::set<uint8_t*>(buffers.begin(), buffers.end()).size(), 1000u);
+    for (uint8_t* buffer : buffers) {
+        PayloadPool::deallocate(buffer, 200);
+    }
+
+    const size_t reserved = PayloadPool::reserved_bytes();
+    for (int round = 0; round < 10; ++round) {
+        for (uint8_t*& buffer : buffers) {
+            buffer = PayloadPool::allocate(256);
+        }
+        for (uint8_t* buffer : buffers) {
+            PayloadPool::deallocate(buffer, 256);
+        }
+    }
+    EXPECT_EQ(PayloadPool::reserved_bytes(), reserved);
+
+    // Handles give their buffer back
+    {
+        PayloadBuffer first(250);
+        PayloadBuffer second(std::move(first));
+        EXPECT_FALSE(first);
+        EXPECT_TRUE(second);
+    }
+    EXPECT_EQ(PayloadPool::reserved_bytes(), reserved);
+}
+
+// Test the producer-allocates, consumer-frees pattern
+TEST(PayloadPoolTest, CrossThreadFree) {
+    SPSCQueue<Message, 1024> queue;
+    const int NUM_MESSAGES = 200000;
+
+    std::thread consumer([&]() {
+        Message msg;
+        for (int i = 0; i < NUM_MESSAGES; ) {
+            if (queue.try_pop(msg)) {
+                EXPECT_TRUE(msg.verify_checksum());
+                PayloadPool::deallocate(msg.data, msg.header.size);
+                ++i;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    for (int i = 0; i < NUM_MESSAGES; ++i) {
+        const std::string text = "payload-" + std::to_string(i);
+        PooledMessage pooled(i, 0, 1, text.data(), text.size());
+        ASSERT_TRUE(pooled);
+        pooled.buffer.release();  // The consumer owns it from here
+        while (!queue.try_push(pooled.message)) {
+            std::this_thread::yield();
+        }
+    }
+    consumer.join();
+
+    // Buffers circulate between the threads instead of piling up
+    EXPECT_LT(PayloadPool::reserved_bytes(), 16u << 20);
+}
+
+// Test buffers used by thread_local destructors that run after the pool's
+// thread cache is gone
+TEST(PayloadPoolTest, AfterThreadCacheDestroyed) {
+    static std::atomic<bool> reused{false};
+    struct LateUser {
+        uint8_t* buffer = nullptr;
+        ~LateUser() {
+            // The cache of this thread was destroyed first; buffers go
+            // through the global lists
+            PayloadPool::deallocate(buffer, 2000);
+            uint8_t* again = PayloadPool::allocate(2000);
+            reused = again == buffer;
+            PayloadPool::deallocate(again, 2000);
+        }
+    };
+
+    std::thread thread([]() {
+        static thread_local LateUser user;  // Constructed before the cache
+        user.buffer = PayloadPool::allocate(2000);
+        ASSERT_NE(user.buffer, nullptr);
+    });
+    thread.join();
+    EXPECT_TRUE(reused);
 }
 
 // Test message flags
@@ -74,7 +499,7 @@ TEST(PersistenceTest, MessageBatch) {
         batch.add(msg);
     }
     
-    EXPECT_EQ(batch.count, 10);
+    EXPECT_EQ(batch.count(), 10u);
     EXPECT_FALSE(batch.is_empty());
     EXPECT_FALSE(batch.is_full());
     
@@ -82,6 +507,82 @@ TEST(PersistenceTest, MessageBatch) {
     EXPECT_TRUE(batch.is_empty());
 }
 
+// Test the record batch format round trip
+TEST(PersistenceTest, RecordBatchRoundTrip) {
+    MessageBatch batch;
+    const uint64_t start = get_timestamp_ns();
+    std::vector<std::string> payloads;
+    for (size_t i = 0; i < MessageBatch::MAX_BATCH_SIZE; ++i) {
+        payloads.push_back("record-" + std::to_string(i));
+    }
+    for (size_t i = 0; i < payloads.size(); ++i) {
+        ASSERT_TRUE(batch.add(100 + i, start + i * 10, payloads[i].data(),
+                              payloads[i].size()));
+    }
+    EXPECT_TRUE(batch.is_full());
+    EXPECT_FALSE(batch.add(1000, start, "x", 1));
+
+    const Message message = batch.finish();
+    EXPECT_TRUE(message.has_flag(MSG_FLAG_BATCH));
+    EXPECT_EQ(message.header.id, 100u);
+    EXPECT_EQ(message.header.timestamp, start);
+    // A few header bytes per record instead of a 64-byte header
+    size_t payload_bytes = 0;
+    for (const std::string& payload : payloads) {
+        payload_bytes += payload.size();
+    }
+    EXPECT_LE(message.header.size,
+              RECORD_BATCH_PREFIX_SIZE + payload_bytes + payloads.size() * 5);
+
+    RecordBatchReader reader;
+    ASSERT_TRUE(reader.reset(message));
+    EXPECT_EQ(reader.remaining(), payloads.size());
+    Message record;
+    for (size_t i = 0; i < payloads.size(); ++i) {
+        ASSERT_TRUE(reader.next(record));
+        EXPECT_EQ(record.header.id, 100 + i);
+        EXPECT_EQ(record.header.timestamp, start + i * 10);
+        EXPECT_EQ(std::string(reinterpret_cast<const char*>(record.data),
+                              record.header.size), payloads[i]);
+    }
+    EXPECT_FALSE(reader.next(record));
+
+    // The prefix carries the batch's bounds, for logs to index it by
+    uint64_t last_id = 0, max_timestamp = 0;
+    message_bounds(message, last_id, max_timestamp);
+    EXPECT_EQ(last_id, 100 + payloads.size() - 1);
+    EXPECT_EQ(max_timestamp, start + (payloads.size() - 1) * 10);
+
+    // The WAL stores the batch as one record, unchanged
+    const std::string dir = test_directory("wal-batch");
+    {
+        WAL wal(dir);
+        ASSERT_TRUE(wal.append(message));
+        EXPECT_TRUE(wal.flush());
+    }
+    size_t records = 0;
+    WAL(dir).replay([&](const Message& stored) {
+        RecordBatchReader stored_reader;
+        ASSERT_TRUE(stored_reader.reset(stored));
+        while (stored_reader.next(record)) {
+            ++records;
+        }
+    });
+    EXPECT_EQ(records, payloads.size());
+    remove_directory(dir);
+
+    // The size limit holds, and a corrupt batch is refused as a whole
+    MessageBatch small(64);
+    EXPECT_TRUE(small.add(1, start, payloads[0].data(), payloads[0].size()));
+    EXPECT_FALSE(small.add(2, start, std::string(60, 'x').data(), 60));
+    EXPECT_FALSE(small.add(1 + (uint64_t(1) << 32), start, "x", 1));  // Id delta too large
+    std::vector<uint8_t> copy(message.data, message.data + message.header.size);
+    Message corrupt = message;
+    corrupt.data = copy.data();
+    copy[copy.size() / 2] ^= 1;
+    EXPECT_FALSE(reader.reset(corrupt));
+}
+
 // Test MessageHeader alignment
 TEST(PersistenceTest, MessageHeaderAlignment) {
     EXPECT_EQ(sizeof(MessageHeader), CACHE_LINE_SIZE);
@@ -90,8 +591,1037 @@ TEST(PersistenceTest, MessageHeaderAlignment) {
 
 // Placeholder for WAL tests (would require file I/O)
 TEST(PersistenceTest, WALBasicOperation) {
-    // TODO: Test WAL append, flush, recovery
-    EXPECT_TRUE(true);  // Placeholder
+    const std::string dir = test_directory("wal-basic");
+    const uint64_t start = get_timestamp_ns();
+    const int NUM_MESSAGES = 1000;
+    {
+        WAL wal(dir);
+        for (int i = 0; i < NUM_MESSAGES; ++i) {
+            const std::string text = "tick-" + std::to_string(i);
+            Message msg(1000 + i, start + i * 1500, 7, text.data(), text.size());
+            msg.data = reinterpret_cast<uint8_t*>(const_cast<char*>(text.data()));
+            ASSERT_TRUE(wal.append(msg));
+        }
+        EXPECT_TRUE(wal.flush());
+
+        // Compact records: far less than a 64-byte header per message
+        EXPECT_LT(wal.bytes_written(),
+                  NUM_MESSAGES * (16 + std::string("tick-999").size()) +
+                  sizeof(WALSegmentHeader));
+    }
+
+    WAL reopened(dir);
+    int next = 0;
+    bool intact = true;
+    const size_t replayed = reopened.replay([&](const Message& msg) {
+        const std::string text = "tick-" + std::to_string(next);
+        intact = intact && msg.header.id == 1000u + next &&
+                 msg.header.timestamp == start + next * 1500u &&
+                 msg.header.topic_id == 7 && msg.verify_checksum() &&
+                 std::string(reinterpret_cast<const char*>(msg.data),
+                             msg.header.size) == text;
+        ++next;
+    });
+    EXPECT_EQ(replayed, static_cast<size_t>(NUM_MESSAGES));
+    EXPECT_TRUE(intact);
+
+    // A torn last record is dropped, earlier ones survive
+    std::string segment = dir + "/00000001.wal";
+    struct stat st;
+    ASSERT_EQ(stat(segment.c_str(), &st), 0);
+    ASSERT_EQ(truncate(segment.c_str(), st.st_size - 3), 0);
+    EXPECT_EQ(reopened.replay([](const Message&) {}),
+              static_cast<size_t>(NUM_MESSAGES - 1));
+
+    remove_directory(dir);
+}
+
+// Test group commit under each sync policy
+TEST(PersistenceTest, WALSyncPolicies) {
+    const WALSyncPolicy policies[] = {WALSyncPolicy::always(), WALSyncPolicy::every_ms(5),
+                                      WALSyncPolicy::every_bytes(4096),
+                                      WALSyncPolicy::never()};
+    const WALIoBackend backends[] = {WALIoBackend::SYSCALLS, WALIoBackend::IO_URING};
+    const int NUM_THREADS = 4;
+    const int PER_THREAD = 500;
+    for (WALIoBackend backend : backends) {
+        for (const WALSyncPolicy& policy : policies) {
+            const std::string dir = test_directory("wal-sync");
+            {
+                WAL wal(dir, policy, backend);
+                if (backend == WALIoBackend::IO_URING && !IoUring::supported()) {
+                    EXPECT_EQ(wal.io_backend(), WALIoBackend::SYSCALLS);  // Fallback
+                } else {
+                    EXPECT_EQ(wal.io_backend(), backend);
+                }
+                std::vector<std::vector<uint64_t>> lsns(NUM_THREADS);
+                std::vector<std::thread> appenders;
+                std::atomic<bool> durable_on_return{true};
+                for (int t = 0; t < NUM_THREADS; ++t) {
+                    appenders.emplace_back([&, t]() {
+                        for (int i = 0; i < PER_THREAD; ++i) {
+                            const std::string text = std::to_string(t) + ":" + std::to_string(i);
+                            Message msg(t * PER_THREAD + i + 1, get_timestamp_ns(), 1,
+                                        text.data(), text.size());
+                            msg.data = reinterpret_cast<uint8_t*>(const_cast<char*>(text.data()));
+                            const uint64_t lsn = wal.append(msg);
+                            if (policy.mode == WALSyncPolicy::ALWAYS && wal.durable_lsn() < lsn) {
+                                durable_on_return = false;
+                            }
+                            lsns[t].push_back(lsn);
+                        }
+                    });
+                }
+                for (auto& appender : appenders) {
+                    appender.join();
+                }
+                EXPECT_TRUE(durable_on_return);
+
+                // Every append got its own LSN
+                std::set<uint64_t> unique;
+                for (const auto& thread_lsns : lsns) {
+                    unique.insert(thread_lsns.begin(), thread_lsns.end());
+                }
+                EXPECT_EQ(unique.size(), static_cast<size_t>(NUM_THREADS * PER_THREAD));
+                EXPECT_EQ(*unique.begin(), 1u);
+                EXPECT_EQ(wal.last_lsn(), static_cast<uint64_t>(NUM_THREADS * PER_THREAD));
+
+                if (policy.mode == WALSyncPolicy::NEVER) {
+                    EXPECT_EQ(wal.durable_lsn(), 0u);
+                } else if (policy.mode != WALSyncPolicy::ALWAYS) {
+                    // The flusher catches up on its own
+                    for (int i = 0; i < 1000 && wal.durable_lsn() < wal.last_lsn(); ++i) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    }
+                    if (policy.mode == WALSyncPolicy::INTERVAL) {
+                        EXPECT_EQ(wal.durable_lsn(), wal.last_lsn());
+                    } else {
+                        EXPECT_GT(wal.durable_lsn(), 0u);  // The tail may stay below 4 KB
+                    }
+                }
+                EXPECT_TRUE(wal.flush());
+                EXPECT_EQ(wal.durable_lsn(), wal.last_lsn());
+            }
+            EXPECT_EQ(WAL(dir).replay([](const Message&) {}),
+                      static_cast<size_t>(NUM_THREADS * PER_THREAD));
+            remove_directory(dir);
+        }
+    }
+}
+
+// Test the io_uring backend across segment switches
+TEST(PersistenceTest, WALIoUringSegments) {
+    const std::string dir = test_directory("wal-uring");
+    const int SEGMENTS = 5;
+    const int PER_SEGMENT = 2000;
+    std::vector<uint8_t> payload(100);
+    {
+        WAL wal(dir, WALSyncPolicy::every_bytes(16 * 1024), WALIoBackend::IO_URING);
+        for (int s = 0; s < SEGMENTS; ++s) {
+            for (int i = 0; i < PER_SEGMENT; ++i) {
+                const uint64_t id = static_cast<uint64_t>(s * PER_SEGMENT + i + 1);
+                payload[0] = static_cast<uint8_t>(id);
+                Message msg(id, get_timestamp_ns(), 1, payload.data(), payload.size());
+                msg.data = payload.data();
+                ASSERT_EQ(wal.append(msg), id);
+            }
+            wal.rotate();
+        }
+        EXPECT_TRUE(wal.flush());
+    }
+    uint64_t expected = 1;
+    const size_t replayed = WAL(dir).replay([&](const Message& msg) {
+        EXPECT_EQ(msg.header.id, expected);
+        EXPECT_EQ(msg.data[0], static_cast<uint8_t>(expected));
+        ++expected;
+    });
+    EXPECT_EQ(replayed, static_cast<size_t>(SEGMENTS * PER_SEGMENT));
+    remove_directory(dir);
+}
+
+// Test O_DIRECT segments: partial pages written again, preallocated files
+TEST(PersistenceTest, WALDirectSegments) {
+    const WALIoBackend backends[] = {WALIoBackend::SYSCALLS, WALIoBackend::IO_URING};
+    const int SEGMENTS = 3;
+    const int PER_SEGMENT = 1000;
+    for (WALIoBackend backend : backends) {
+        const std::string dir = test_directory("wal-direct");
+        std::vector<uint8_t> payload(300);
+        {
+            WAL wal(dir, WALSyncPolicy::never(), backend, WALWriteMode::DIRECT);
+            EXPECT_EQ(wal.write_mode(), WALWriteMode::DIRECT);
+            for (int s = 0; s < SEGMENTS; ++s) {
+                for (int i = 0; i < PER_SEGMENT; ++i) {
+                    const uint64_t id = static_cast<uint64_t>(s * PER_SEGMENT + i + 1);
+                    const size_t size = 1 + id % payload.size();
+                    std::fill(payload.begin(), payload.begin() + size, static_cast<uint8_t>(id));
+                    Message msg(id, get_timestamp_ns(), 1, payload.data(), size);
+                    msg.data = payload.data();
+                    ASSERT_EQ(wal.append(msg), id);
+                    if (i % 97 == 0) {
+                        ASSERT_TRUE(wal.flush());  // Ends mid-page
+                    }
+                }
+                wal.rotate();
+            }
+            EXPECT_TRUE(wal.flush());
+        }
+
+        // Segments are preallocated; the spare one is gone
+        size_t files = 0;
+        if (DIR* d = opendir(dir.c_str())) {
+            while (struct dirent* entry = readdir(d)) {
+                const std::string name = entry->d_name;
+                if (name.size() < 4 || name.compare(name.size() - 4, 4, ".wal") != 0) {
+                    continue;  // Indexes
+                }
+                struct stat st;
+                ASSERT_EQ(stat((dir + "/" + entry->d_name).c_str(), &st), 0);
+                EXPECT_GE(static_cast<size_t>(st.st_size), WAL::SEGMENT_SIZE) << entry->d_name;
+                ++files;
+            }
+            closedir(d);
+        }
+        EXPECT_EQ(files, static_cast<size_t>(SEGMENTS));
+        EXPECT_NE(access((dir + "/next.wal.tmp").c_str(), F_OK), 0);
+
+        uint64_t expected = 1;
+        const size_t replayed = WAL(dir).replay([&](const Message& msg) {
+            ASSERT_EQ(msg.header.id, expected);
+            ASSERT_EQ(msg.header.size, 1 + expected % payload.size());
+            EXPECT_EQ(msg.data[msg.header.size - 1], static_cast<uint8_t>(expected));
+            ++expected;
+        });
+        EXPECT_EQ(replayed, static_cast<size_t>(SEGMENTS * PER_SEGMENT));
+        remove_directory(dir);
+    }
+}
+
+// Test O_DIRECT under io_uring with several batches in flight: each one
+// rewrites the padded last page of the one before, which must not land last
+TEST(PersistenceTest, WALDirectUringInFlight) {
+    const std::string dir = test_directory("wal-direct-uring");
+    const int THREADS = 4;
+    const int PER_THREAD = 5000;
+    {
+        WAL wal(dir, WALSyncPolicy::never(), WALIoBackend::IO_URING, WALWriteMode::DIRECT);
+        std::vector<std::thread> appenders;
+        for (int t = 0; t < THREADS; ++t) {
+            appenders.emplace_back([&wal, t]() {
+                std::vector<uint8_t> payload(700);
+                for (int i = 0; i < PER_THREAD; ++i) {
+                    const uint64_t id = static_cast<uint64_t>(t * PER_THREAD + i + 1);
+                    const size_t size = 1 + id % payload.size();
+                    std::fill(payload.begin(), payload.begin() + size, static_cast<uint8_t>(id));
+                    Message msg(id, get_timestamp_ns(), 1, payload.data(), size);
+                    msg.data = payload.data();
+                    ASSERT_NE(wal.append(msg), 0u);
+                }
+            });
+        }
+        for (auto& appender : appenders) {
+            appender.join();
+        }
+        EXPECT_TRUE(wal.flush());
+    }
+
+    std::vector<bool> seen(THREADS * PER_THREAD + 1, false);
+    const size_t replayed = WAL(dir).replay([&](const Message& msg) {
+        ASSERT_GE(msg.header.id, 1u);
+        ASSERT_LT(msg.header.id, seen.size());
+        EXPECT_FALSE(seen[msg.header.id]);
+        EXPECT_EQ(msg.data[msg.header.size - 1], static_cast<uint8_t>(msg.header.id));
+        seen[msg.header.id] = true;
+    });
+    EXPECT_EQ(replayed, static_cast<size_t>(THREADS * PER_THREAD));
+    remove_directory(dir);
+}
+
+// Test growing a mapped file and syncing only its dirty pages
+TEST(PersistenceTest, MMapFileResizeAndSync) {
+    const std::string path = test_directory("mmap") + ".dat";
+    const size_t PAGE = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    {
+        MMapOptions options;
+        options.populate = true;
+        options.huge_pages = true;
+        MMapFile file(path.c_str(), PAGE, true, options);
+        std::memset(file.data(), 'a', PAGE);
+
+        file.resize(64 * PAGE);
+        ASSERT_EQ(file.size(), 64 * PAGE);
+        const char* data = static_cast<const char*>(file.data());
+        EXPECT_EQ(data[PAGE - 1], 'a');  // Kept across the remap
+        EXPECT_EQ(data[PAGE], 0);
+        struct stat st;
+        ASSERT_EQ(stat(path.c_str(), &st), 0);
+        EXPECT_EQ(static_cast<size_t>(st.st_size), 64 * PAGE);
+
+        // Dirty pages are tracked as whole pages, and sync covers just them
+        std::memset(static_cast<char*>(file.data()) + 10 * PAGE + 100, 'b', 10);
+        file.mark_dirty(10 * PAGE + 100, 10);
+        EXPECT_EQ(file.dirty_bytes(), PAGE);
+        std::memset(static_cast<char*>(file.data()) + 12 * PAGE - 1, 'c', 2);
+        file.mark_dirty(12 * PAGE - 1, 2);
+        EXPECT_EQ(file.dirty_bytes(), 3 * PAGE);
+        EXPECT_TRUE(file.sync_range(10 * PAGE, PAGE));
+        EXPECT_EQ(file.dirty_bytes(), 2 * PAGE);
+        file.async_sync();
+        EXPECT_EQ(file.dirty_bytes(), 2 * PAGE);  // Not known to be durable
+        file.sync();
+        EXPECT_EQ(file.dirty_bytes(), 0u);
+
+        EXPECT_TRUE(file.advise(MMapAdvice::SEQUENTIAL));
+        EXPECT_TRUE(file.advise(MMapAdvice::WILLNEED, PAGE, 4 * PAGE));
+        EXPECT_TRUE(file.advise(MMapAdvice::DONTNEED, 20 * PAGE, PAGE));
+        EXPECT_FALSE(file.advise(MMapAdvice::NORMAL, 64 * PAGE));
+
+        file.resize(11 * PAGE);  // Shrinking drops the dirty tail
+        EXPECT_EQ(file.dirty_bytes(), 0u);
+        EXPECT_THROW(file.resize(0), std::runtime_error);
+        EXPECT_EQ(file.size(), 11 * PAGE);
+    }
+
+    std::ifstream in(path, std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    ASSERT_EQ(contents.size(), 11 * PAGE);
+    EXPECT_EQ(contents[0], 'a');
+    EXPECT_EQ(contents.substr(10 * PAGE + 100, 10), std::string(10, 'b'));
+    unlink(path.c_str());
+}
+
+// Test seeking through the sparse indexes, and rebuilding them
+TEST(PersistenceTest, SegmentIndexSeek) {
+    const std::string dir = test_directory("wal-index");
+    const uint64_t SEGMENTS = 3;
+    const uint64_t PER_SEGMENT = 5000;
+    const uint64_t COUNT = SEGMENTS * PER_SEGMENT;
+    const auto timestamp_of = [](uint64_t id) { return 1000000 + id * 10; };
+    std::vector<uint8_t> payload(64);
+    {
+        WAL wal(dir);
+        for (uint64_t id = 1; id <= COUNT; ++id) {
+            std::memcpy(payload.data(), &id, sizeof(id));
+            Message msg(id, timestamp_of(id), 1, payload.data(), payload.size());
+            msg.data = payload.data();
+            ASSERT_EQ(wal.append(msg), id);
+            if (id % PER_SEGMENT == 0) {
+                wal.rotate();
+            }
+        }
+        EXPECT_TRUE(wal.flush());
+    }
+
+    SegmentManager segments(dir);
+    const std::vector<SegmentInfo> infos = segments.list_segments();
+    ASSERT_EQ(infos.size(), SEGMENTS);
+    for (uint64_t i = 0; i < SEGMENTS; ++i) {
+        EXPECT_EQ(infos[i].base_id, i * PER_SEGMENT + 1);
+        EXPECT_EQ(infos[i].max_id, (i + 1) * PER_SEGMENT);
+        EXPECT_EQ(infos[i].max_timestamp, timestamp_of((i + 1) * PER_SEGMENT));
+        EXPECT_GT(infos[i].index_entries, infos[i].end / SegmentIndexWriter::INTERVAL_BYTES / 2);
+        struct stat st;
+        ASSERT_EQ(stat(offset_index_path(infos[i].path).c_str(), &st), 0);
+        EXPECT_EQ(static_cast<size_t>(st.st_size), infos[i].index_entries * sizeof(IndexEntry));
+    }
+    EXPECT_EQ(segments.rebuild_indexes(), 0u);
+
+    const auto check_seeks = [&]() {
+        LogReader reader(dir);
+        Message msg;
+        for (uint64_t id : {uint64_t(1), uint64_t(2), uint64_t(777), PER_SEGMENT,
+                            PER_SEGMENT + 1, COUNT - 1, COUNT}) {
+            ASSERT_TRUE(reader.seek(id));
+            ASSERT_TRUE(reader.next(msg));
+            EXPECT_EQ(msg.header.id, id);
+            uint64_t stored;
+            std::memcpy(&stored, msg.data, sizeof(stored));
+            EXPECT_EQ(stored, id);
+        }
+        // Between two timestamps: the later one
+        ASSERT_TRUE(reader.seek_to_timestamp(timestamp_of(PER_SEGMENT + 42) - 5));
+        ASSERT_TRUE(reader.next(msg));
+        EXPECT_EQ(msg.header.id, PER_SEGMENT + 42);
+        EXPECT_FALSE(reader.seek(COUNT + 1));
+        EXPECT_FALSE(reader.seek_to_timestamp(timestamp_of(COUNT) + 1));
+    };
+    check_seeks();
+
+    // A lost index and one pointing past the data, as after a crash
+    unlink(offset_index_path(infos[0].path).c_str());
+    {
+        std::ofstream index(time_index_path(infos[1].path), std::ios::binary | std::ios::app);
+        const IndexEntry bogus{timestamp_of(COUNT), infos[1].end + 4096};
+        index.write(reinterpret_cast<const char*>(&bogus), sizeof(bogus));
+    }
+    {
+        std::ofstream index(offset_index_path(infos[1].path), std::ios::binary | std::ios::app);
+        const IndexEntry bogus{COUNT, infos[1].end + 4096};
+        index.write(reinterpret_cast<const char*>(&bogus), sizeof(bogus));
+    }
+    EXPECT_EQ(segments.rebuild_indexes(), 2u);
+    EXPECT_EQ(segments.rebuild_indexes(), 0u);
+    EXPECT_EQ(segments.list_segments()[1].index_entries, infos[1].index_entries);
+    check_seeks();
+
+    // Replay through the subscriber API
+    Subscriber subscriber("file://" + dir);
+    ASSERT_TRUE(subscriber.subscribe("events"));
+    ASSERT_TRUE(subscriber.seek(COUNT - 99));
+    std::vector<Message> batch = subscriber.poll_batch(256, 1000);
+    ASSERT_EQ(batch.size(), 100u);
+    for (uint64_t i = 0; i < batch.size(); ++i) {
+        uint64_t stored;
+        std::memcpy(&stored, batch[i].data, sizeof(stored));
+        EXPECT_EQ(batch[i].header.id, COUNT - 99 + i);
+        EXPECT_EQ(stored, COUNT - 99 + i);
+    }
+    EXPECT_EQ(subscriber.poll(1000).header.id, 0u);
+    EXPECT_FALSE(Subscriber("shm://nanomq-no-broker").seek(1));  // Rings cannot rewind
+
+    remove_directory(dir);
+}
+
+// Test that seeks land inside batches the WAL stores as one record
+TEST(PersistenceTest, WALRecordBatchSeek) {
+    const std::string dir = test_directory("wal-batch");
+    const uint64_t BATCH = 100;
+    const uint64_t BATCHES = 20;
+    const uint64_t COUNT = BATCH * BATCHES;
+    std::vector<uint8_t> payload(32);
+    {
+        WAL wal(dir);
+        MessageBatch batch;
+        for (uint64_t b = 0; b + 1 < BATCHES; ++b) {
+            batch.clear();
+            for (uint64_t id = b * BATCH + 1; id <= (b + 1) * BATCH; ++id) {
+                std::memcpy(payload.data(), &id, sizeof(id));
+                ASSERT_TRUE(batch.add(id, 1000 + id, payload.data(), payload.size()));
+            }
+            ASSERT_NE(wal.append(batch.finish()), 0u);
+            if (b + 1 == BATCHES / 2) {
+                wal.rotate();
+            }
+        }
+        // The last batch compressed, as a publisher sends it
+        batch.clear();
+        for (uint64_t id = COUNT - BATCH + 1; id <= COUNT; ++id) {
+            std::memset(payload.data(), 0, payload.size());
+            std::memcpy(payload.data(), &id, sizeof(id));
+            ASSERT_TRUE(batch.add(id, 1000 + id, payload.data(), payload.size()));
+        }
+        const Message batch_msg = batch.finish(true);
+        ASSERT_TRUE(batch_msg.has_flag(MSG_FLAG_COMPRESSED));
+        ASSERT_NE(wal.append(batch_msg), 0u);
+        EXPECT_TRUE(wal.flush());
+    }
+
+    // Bounds and index keys are those of the batches' last records
+    SegmentManager segments(dir);
+    const std::vector<SegmentInfo> infos = segments.list_segments();
+    ASSERT_EQ(infos.size(), 2u);
+    EXPECT_EQ(infos[0].max_id, COUNT / 2);
+    EXPECT_EQ(infos[0].max_timestamp, 1000 + COUNT / 2);
+    EXPECT_EQ(infos[1].max_id, COUNT);
+    LogPosition position;
+    ASSERT_TRUE(segments.seek(COUNT / 2 - 30, position));
+    EXPECT_EQ(position.segment, infos[0].number);
+
+    // The subscriber skips the records of a batch before the target
+    Subscriber subscriber("file://" + dir);
+    ASSERT_TRUE(subscriber.subscribe("events"));
+    const auto expect_from = [&](uint64_t first) {
+        uint64_t next = first;
+        while (next <= COUNT) {
+            const std::vector<Message> polled = subscriber.poll_batch(64, 1000);
+            ASSERT_FALSE(polled.empty());
+            for (const Message& msg : polled) {
+                uint64_t stored;
+                std::memcpy(&stored, msg.data, sizeof(stored));
+                ASSERT_EQ(msg.header.id, next);
+                ASSERT_EQ(stored, next);
+                ++next;
+            }
+        }
+        EXPECT_EQ(subscriber.poll(1000).header.id, 0u);
+    };
+    ASSERT_TRUE(subscriber.seek(COUNT / 2 - 30));
+    expect_from(COUNT / 2 - 30);
+    ASSERT_TRUE(subscriber.seek_to_timestamp(1000 + 5 * BATCH + 50));
+    expect_from(5 * BATCH + 50);
+    ASSERT_TRUE(subscriber.seek(COUNT - 10));  // Inside the compressed batch
+    expect_from(COUNT - 10);
+    EXPECT_FALSE(subscriber.seek(COUNT + 1));
+
+    remove_directory(dir);
+}
+
+// Test crash recovery: torn tail, corrupt sealed segment, id counters
+TEST(PersistenceTest, WALCrashRecovery) {
+    const std::string dir = test_directory("wal-recovery");
+    const uint64_t SEGMENTS = 3;
+    const uint64_t PER_SEGMENT = 2000;
+    const uint64_t COUNT = SEGMENTS * PER_SEGMENT;
+    std::vector<uint8_t> payload(64, 0);
+    {
+        WAL wal(dir);
+        for (uint64_t id = 1; id <= COUNT; ++id) {
+            std::memcpy(payload.data(), &id, sizeof(id));
+            Message msg(id, 1000 + id, static_cast<uint32_t>(1 + id % 2), payload.data(),
+                        payload.size());
+            msg.data = payload.data();
+            ASSERT_EQ(wal.append(msg), id);
+            if (id % PER_SEGMENT == 0 && id < COUNT) {
+                wal.rotate();
+            }
+        }
+        EXPECT_TRUE(wal.flush());
+    }
+
+    RecoveryReport clean = recover(dir, 4);
+    EXPECT_EQ(clean.segments, SEGMENTS);
+    EXPECT_EQ(clean.records, COUNT);
+    EXPECT_EQ(clean.corrupt_segments, 0u);
+    EXPECT_EQ(clean.truncated_bytes, 0u);
+    EXPECT_EQ(clean.indexes_rebuilt, 0u);
+    EXPECT_EQ(clean.max_id, COUNT);
+    EXPECT_EQ(clean.max_timestamp, 1000 + COUNT);
+    EXPECT_EQ(clean.last_id(1), COUNT);
+    EXPECT_EQ(clean.last_id(2), COUNT - 1);
+    EXPECT_EQ(clean.last_id(3), 0u);
+
+    const std::vector<SegmentInfo> infos = SegmentManager(dir).list_segments();
+    ASSERT_EQ(infos.size(), SEGMENTS);
+
+    // Flip the last payload byte of record 100, in a sealed segment
+    LogPosition after;
+    ASSERT_TRUE(SegmentManager(dir).seek(101, after));
+    {
+        std::fstream segment(infos[0].path, std::ios::binary | std::ios::in | std::ios::out);
+        segment.seekp(static_cast<std::streamoff>(after.position - 1));
+        segment.put(static_cast<char>(0xff));
+    }
+    // Half a record at the end of the last segment, a segment whose header
+    // never made it and a lost index
+    const std::string& last = infos.back().path;
+    {
+        std::ofstream segment(last, std::ios::binary | std::ios::app);
+        const char torn[] = {60, 1, 2, 3, 4, 5, 6, 7};
+        segment.write(torn, sizeof(torn));
+    }
+    const std::string stray = dir + "/00000099.wal";
+    {
+        std::ofstream segment(stray, std::ios::binary);
+        segment.write("NQ", 2);
+    }
+    unlink(time_index_path(infos[1].path).c_str());
+
+    RecoveryReport report = recover(dir, 4);
+    EXPECT_EQ(report.segments, SEGMENTS);
+    EXPECT_EQ(report.records, COUNT - PER_SEGMENT + 99);
+    EXPECT_EQ(report.corrupt_segments, 1u);
+    EXPECT_EQ(report.truncated_bytes, 8u);
+    EXPECT_EQ(report.removed_segments, 1u);
+    EXPECT_EQ(report.indexes_rebuilt, 1u);
+    EXPECT_EQ(report.last_id(1), COUNT);
+    EXPECT_NE(access(stray.c_str(), F_OK), 0);
+    struct stat st;
+    ASSERT_EQ(stat(last.c_str(), &st), 0);
+    EXPECT_EQ(static_cast<uint64_t>(st.st_size), infos.back().end);
+
+    // Nothing left to repair, and one thread finds the same
+    RecoveryReport again = recover(dir, 1);
+    EXPECT_EQ(again.records, report.records);
+    EXPECT_EQ(again.corrupt_segments, 1u);
+    EXPECT_EQ(again.truncated_bytes, 0u);
+    EXPECT_EQ(again.removed_segments, 0u);
+    EXPECT_EQ(again.indexes_rebuilt, 0u);
+    EXPECT_EQ(again.last_ids, report.last_ids);
+
+    Topic topic("events");
+    topic.restore_message_id(report.last_id(2));
+    topic.restore_message_id(10);  // Never backwards
+    EXPECT_EQ(topic.next_message_id(), COUNT);
+
+    remove_directory(dir);
+}
+
+// Test retention and key-based compaction
+TEST(PersistenceTest, LogRetentionAndCompaction) {
+    const std::string dir = test_directory("wal-compact");
+    const uint64_t SEGMENTS = 4;
+    const uint64_t PER_SEGMENT = 3000;
+    const uint64_t KEYS = 50;
+    const uint64_t COUNT = SEGMENTS * PER_SEGMENT;
+    const auto key_of = [](uint64_t id) { return "key-" + std::to_string(id % KEYS); };
+    const auto write_log = [&](uint64_t first_timestamp) {
+        WAL wal(dir);
+        uint8_t payload[64];
+        for (uint64_t id = 1; id <= COUNT; ++id) {
+            const std::string key = key_of(id);
+            size_t size = sizeof(id);
+            std::memcpy(payload, &id, sizeof(id));
+            const bool keyed = id % 10 != 0;  // Every tenth record has no key
+            if (keyed) {
+                uint8_t value[sizeof(id)];
+                std::memcpy(value, &id, sizeof(id));
+                size = make_keyed_payload(payload, key.data(), static_cast<uint16_t>(key.size()),
+                                          value, sizeof(value));
+            }
+            Message msg(id, first_timestamp + id, 1, payload, size);
+            msg.data = payload;
+            if (keyed) {
+                msg.set_flag(MSG_FLAG_KEYED);
+            }
+            ASSERT_EQ(wal.append(msg), id);
+            if (id % PER_SEGMENT == 0 && id < COUNT) {
+                wal.rotate();
+            }
+        }
+        EXPECT_TRUE(wal.flush());
+    };
+
+    // Retention by age and by size, never touching the last segment
+    write_log(1000);
+    SegmentManager segments(dir);
+    EXPECT_EQ(segments.cleanup_old_segments(60000), SEGMENTS - 1);
+    EXPECT_EQ(segments.list_segments().size(), 1u);
+    remove_directory(dir);
+    write_log(get_timestamp_ns());
+    EXPECT_EQ(segments.cleanup_old_segments(60000), 0u);
+    const uint64_t segment_bytes = segments.list_segments()[0].end;
+    EXPECT_EQ(segments.cleanup_to_size(2 * segment_bytes + 1), SEGMENTS - 2);
+    EXPECT_EQ(segments.cleanup_to_size(0), 1u);
+    EXPECT_EQ(segments.list_segments().size(), 1u);
+    remove_directory(dir);
+
+    // Compaction keeps the latest record per key, unkeyed ones and the
+    // whole last segment
+    write_log(1000);
+    CompactionPolicy policy;
+    policy.max_bytes_per_sec = 0;
+    LogCompactor compactor(dir, policy);
+    const CompactionStats stats = compactor.run_once();
+    EXPECT_EQ(stats.segments_compacted, SEGMENTS - 1);
+    EXPECT_EQ(stats.segments_deleted, 0u);
+    const uint64_t sealed = (SEGMENTS - 1) * PER_SEGMENT;
+    EXPECT_EQ(stats.records_removed, sealed - sealed / 10);  // Every key recurs later
+    EXPECT_EQ(compactor.run_once().records_removed, 0u);
+
+    std::vector<uint64_t> ids;
+    WAL(dir).replay([&](const Message& msg) {
+        uint64_t stored;
+        std::memcpy(&stored, msg.data + msg.header.size - sizeof(stored), sizeof(stored));
+        EXPECT_EQ(stored, msg.header.id);
+        EXPECT_TRUE(msg.verify_checksum());
+        ids.push_back(msg.header.id);
+    });
+    ASSERT_EQ(ids.size(), sealed / 10 + PER_SEGMENT);
+    EXPECT_EQ(ids[0], 10u);
+    EXPECT_EQ(ids[sealed / 10], sealed + 1);
+    EXPECT_EQ(SegmentManager(dir).rebuild_indexes(), 0u);
+    LogReader reader(dir);
+    Message msg;
+    ASSERT_TRUE(reader.seek(15));
+    ASSERT_TRUE(reader.next(msg));
+    EXPECT_EQ(msg.header.id, 20u);
+    remove_directory(dir);
+}
+
+// Test that compaction sees the keyed records inside record batches
+TEST(PersistenceTest, CompactionOfRecordBatches) {
+    const std::string dir = test_directory("wal-compact-batch");
+    const auto keyed = [](uint64_t id, const std::string& key) {
+        const std::string value(200, static_cast<char>('a' + id));  // Compresses well
+        std::string payload(2 + key.size() + value.size(), '\0');
+        make_keyed_payload(reinterpret_cast<uint8_t*>(&payload[0]), key.data(),
+                           static_cast<uint16_t>(key.size()), value.data(), value.size());
+        return payload;
+    };
+    const auto add = [&](MessageBatch& batch, uint64_t id, const std::string& key) {
+        const std::string payload = key.empty() ? std::string(8, 'u') : keyed(id, key);
+        Message msg(id, 1000 + id, 7, payload.data(), payload.size());
+        msg.data = reinterpret_cast<uint8_t*>(const_cast<char*>(payload.data()));
+        if (!key.empty()) {
+            msg.set_flag(MSG_FLAG_KEYED);
+        }
+        return batch.add(msg);
+    };
+
+    MessageBatch batch;
+    uint8_t x = 'x';
+    Message priority(1, 1000, 7, &x, 1);
+    priority.data = &x;
+    priority.set_flag(MSG_FLAG_PRIORITY);
+    EXPECT_FALSE(batch.add(priority));  // A record cannot keep this flag
+    {
+        WAL wal(dir);
+        // Segment 1: a plain batch whose key a recurs inside it and whose
+        // key b recurs in segment 2, then a compressed batch superseded
+        // as a whole
+        ASSERT_TRUE(add(batch, 1, "a") && add(batch, 2, "b") && add(batch, 3, "") &&
+                    add(batch, 4, "a"));
+        ASSERT_TRUE(wal.append(batch.finish()));
+        batch.clear();
+        ASSERT_TRUE(add(batch, 5, "c") && add(batch, 6, "c") && add(batch, 7, "c") &&
+                    add(batch, 8, "d"));
+        const Message compressed = batch.finish(true);
+        ASSERT_TRUE(compressed.has_flag(MSG_FLAG_COMPRESSED));
+        ASSERT_TRUE(wal.append(compressed));
+        wal.rotate();
+
+        // Segment 2: the later versions of b and c
+        const std::string b = keyed(9, "b");
+        Message plain(9, 1009, 7, b.data(), b.size());
+        plain.data = reinterpret_cast<uint8_t*>(const_cast<char*>(b.data()));
+        plain.set_flag(MSG_FLAG_KEYED);
+        ASSERT_TRUE(wal.append(plain));
+        batch.clear();
+        ASSERT_TRUE(add(batch, 10, "c") && add(batch, 11, "e"));
+        ASSERT_TRUE(wal.append(batch.finish(true)));
+        wal.rotate();
+
+        // Segment 3, never compacted: the later version of d
+        batch.clear();
+        ASSERT_TRUE(add(batch, 12, "d"));
+        ASSERT_TRUE(wal.append(batch.finish()));
+        EXPECT_TRUE(wal.flush());
+    }
+
+    CompactionPolicy policy;
+    policy.max_bytes_per_sec = 0;
+    LogCompactor compactor(dir, policy);
+    const CompactionStats stats = compactor.run_once();
+    EXPECT_EQ(stats.segments_compacted, 1u);
+    EXPECT_EQ(stats.records_removed, 6u);
+    EXPECT_GT(stats.bytes_reclaimed, 0u);
+    EXPECT_EQ(compactor.run_once().records_removed, 0u);
+
+    std::vector<uint64_t> ids;
+    std::vector<bool> keys;
+    WAL(dir).replay([&](const Message& stored) {
+        if (!stored.has_flag(MSG_FLAG_BATCH)) {
+            ids.push_back(stored.header.id);
+            keys.push_back(stored.has_flag(MSG_FLAG_KEYED));
+            return;
+        }
+        RecordBatchReader reader;
+        ASSERT_TRUE(reader.reset(stored));
+        Message record;
+        while (reader.next(record)) {
+            EXPECT_EQ(record.header.topic_id, 7u);
+            ids.push_back(record.header.id);
+            keys.push_back(record.has_flag(MSG_FLAG_KEYED));
+        }
+    });
+    EXPECT_EQ(ids, (std::vector<uint64_t>{3, 4, 9, 10, 11, 12}));
+    EXPECT_EQ(keys, (std::vector<bool>{false, true, true, true, true, true}));
+    EXPECT_EQ(SegmentManager(dir).rebuild_indexes(), 0u);
+    remove_directory(dir);
+}
+
+// Test archiving sealed segments and reading them back on demand
+TEST(PersistenceTest, TieredStorageArchive) {
+    const std::string dir = test_directory("wal-tier");
+    const std::string archive = test_directory("wal-tier-archive");
+    const std::string cache = test_directory("wal-tier-cache");
+    const uint64_t SEGMENTS = 4;
+    const uint64_t PER_SEGMENT = 2000;
+    const uint64_t COUNT = SEGMENTS * PER_SEGMENT;
+    std::vector<uint8_t> payload(100, 0x33);
+    {
+        WAL wal(dir);
+        for (uint64_t id = 1; id <= COUNT; ++id) {
+            std::memcpy(payload.data(), &id, sizeof(id));
+            Message msg(id, 1000 + id, 1, payload.data(), payload.size());
+            msg.data = payload.data();
+            ASSERT_EQ(wal.append(msg), id);
+            if (id % PER_SEGMENT == 0 && id < COUNT) {
+                wal.rotate();
+            }
+        }
+        EXPECT_TRUE(wal.flush());
+    }
+    const std::vector<SegmentInfo> before = SegmentManager(dir).list_segments();
+    ASSERT_EQ(before.size(), SEGMENTS);
+
+    auto store = std::make_shared<LocalArchiveStore>(archive);
+    TierPolicy policy;
+    policy.archive_after_ms = 60000;
+    policy.cache_bytes = before[0].end * 3 / 2;  // Room for one segment
+    policy.cache_directory = cache;
+    auto tier = std::make_shared<TieredStorage>(dir, store, policy);
+    EXPECT_EQ(tier->archive_old_segments(), SEGMENTS - 1);  // Not the last one
+    EXPECT_EQ(tier->archive_old_segments(), 0u);
+
+    // Objects are compressed; stubs and indexes stay local
+    const std::vector<std::string> objects = store->list();
+    ASSERT_EQ(objects.size(), SEGMENTS - 1);
+    for (uint64_t i = 0; i + 1 < SEGMENTS; ++i) {
+        EXPECT_EQ(objects[i], TieredStorage::object_name(before[i].number));
+        struct stat st;
+        ASSERT_EQ(stat((archive + "/" + objects[i]).c_str(), &st), 0);
+        EXPECT_LT(static_cast<uint64_t>(st.st_size), before[i].end / 2);
+        EXPECT_NE(access(before[i].path.c_str(), F_OK), 0);
+        EXPECT_EQ(access(offset_index_path(before[i].path).c_str(), F_OK), 0);
+    }
+    EXPECT_EQ(SegmentManager(dir).list_segments().size(), 1u);
+
+    // Bounds come from the stubs, without fetching
+    const std::vector<SegmentInfo> after = SegmentManager(dir, tier).list_segments();
+    ASSERT_EQ(after.size(), SEGMENTS);
+    for (uint64_t i = 0; i < SEGMENTS; ++i) {
+        EXPECT_EQ(after[i].archived, i + 1 < SEGMENTS);
+        EXPECT_EQ(after[i].base_id, before[i].base_id);
+        EXPECT_EQ(after[i].max_id, before[i].max_id);
+        EXPECT_EQ(after[i].end, before[i].end);
+    }
+    EXPECT_EQ(tier->fetches(), 0u);
+
+    // A seek fetches only the segment it lands in
+    LogReader reader(dir, tier);
+    Message msg;
+    ASSERT_TRUE(reader.seek(PER_SEGMENT + 5));
+    ASSERT_TRUE(reader.next(msg));
+    EXPECT_EQ(msg.header.id, PER_SEGMENT + 5);
+    EXPECT_EQ(tier->fetches(), 1u);
+
+    // A full read goes through every segment; the cache stays bounded
+    reader.seek(LogPosition{0, 0});
+    for (uint64_t id = 1; id <= COUNT; ++id) {
+        ASSERT_TRUE(reader.next(msg));
+        ASSERT_EQ(msg.header.id, id);
+        uint64_t stored;
+        std::memcpy(&stored, msg.data, sizeof(stored));
+        ASSERT_EQ(stored, id);
+    }
+    EXPECT_FALSE(reader.next(msg));
+    EXPECT_LE(tier->cached_bytes(), policy.cache_bytes);
+    EXPECT_EQ(tier->fetches(), 4u);  // Segment 2 was evicted in between
+
+    // A fetched copy stays readable when another fetch evicts it
+    const int fd = tier->fetch(before[0].number);
+    ASSERT_GE(fd, 0);
+    const int other = tier->fetch(before[1].number);
+    ASSERT_GE(other, 0);
+    close(other);
+    SegmentScanner evicted;
+    ASSERT_TRUE(evicted.open(fd, before[0].number));
+    for (uint64_t id = 1; id <= PER_SEGMENT; ++id) {
+        ASSERT_TRUE(evicted.next(msg));
+        ASSERT_EQ(msg.header.id, id);
+    }
+
+    // Retention drops archived segments from the store too
+    EXPECT_EQ(SegmentManager(dir, tier).cleanup_old_segments(60000), SEGMENTS - 1);
+    EXPECT_TRUE(store->list().empty());
+    EXPECT_TRUE(archived_segment_files(dir).empty());
+    EXPECT_EQ(tier->cached_bytes(), 0u);
+
+    remove_directory(dir);
+    remove_directory(archive);
+    remove_directory(cache);
+}
+
+// Test that fetches download outside the cache lock, once per segment
+TEST(PersistenceTest, TieredStorageConcurrentFetch) {
+    const std::string dir = test_directory("wal-tier-fetch");
+    const std::string archive = test_directory("wal-tier-fetch-archive");
+    const std::string cache = test_directory("wal-tier-fetch-cache");
+    std::vector<uint8_t> payload(100, 0x55);
+    {
+        WAL wal(dir);
+        for (uint64_t id = 1; id <= 2000; ++id) {
+            Message msg(id, 1000 + id, 1, payload.data(), payload.size());
+            msg.data = payload.data();
+            ASSERT_EQ(wal.append(msg), id);
+            if (id == 1000) {
+                wal.rotate();
+            }
+        }
+        EXPECT_TRUE(wal.flush());
+    }
+    const std::vector<SegmentInfo> segments = SegmentManager(dir).list_segments();
+    ASSERT_EQ(segments.size(), 2u);
+    auto store = std::make_shared<SlowStore>(archive);
+    TierPolicy policy;
+    policy.archive_after_ms = 0;
+    policy.cache_directory = cache;
+    TieredStorage tier(dir, store, policy);
+    ASSERT_TRUE(tier.archive_segment(segments[0].number, segments[0].path));
+
+    std::vector<int> fds(4, -1);
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < fds.size(); ++i) {
+        readers.emplace_back([&, i]() { fds[i] = tier.fetch(segments[0].number); });
+    }
+    // The cache stays usable while the download is in flight
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(tier.cached_bytes(), 0u);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+
+    EXPECT_EQ(store->gets, 1);
+    EXPECT_EQ(tier.fetches(), 1u);
+    EXPECT_EQ(tier.cached_bytes(), segments[0].end);
+    Message msg;
+    for (const int fd : fds) {
+        ASSERT_GE(fd, 0);
+        SegmentScanner scanner;
+        ASSERT_TRUE(scanner.open(fd, segments[0].number));
+        ASSERT_TRUE(scanner.next(msg));
+        EXPECT_EQ(msg.header.id, 1u);
+    }
+    remove_directory(dir);
+    remove_directory(archive);
+    remove_directory(cache);
+}
+
+// Test that removing an archived segment keeps the cache lock free
+TEST(PersistenceTest, TieredStorageRemove) {
+    const std::string dir = test_directory("wal-tier-remove");
+    const std::string archive = test_directory("wal-tier-remove-archive");
+    const std::string cache = test_directory("wal-tier-remove-cache");
+    std::vector<uint8_t> payload(100, 0x66);
+    {
+        WAL wal(dir);
+        for (uint64_t id = 1; id <= 3000; ++id) {
+            Message msg(id, 1000 + id, 1, payload.data(), payload.size());
+            msg.data = payload.data();
+            ASSERT_EQ(wal.append(msg), id);
+            if (id % 1000 == 0 && id < 3000) {
+                wal.rotate();
+            }
+        }
+        EXPECT_TRUE(wal.flush());
+    }
+    const std::vector<SegmentInfo> segments = SegmentManager(dir).list_segments();
+    ASSERT_EQ(segments.size(), 3u);
+    auto store = std::make_shared<SlowStore>(archive);
+    TierPolicy policy;
+    policy.archive_after_ms = 0;
+    policy.cache_directory = cache;
+    TieredStorage tier(dir, store, policy);
+    for (size_t i = 0; i < 2; ++i) {
+        ASSERT_TRUE(tier.archive_segment(segments[i].number, segments[i].path));
+        const int fd = tier.fetch(segments[i].number);
+        ASSERT_GE(fd, 0);
+        close(fd);
+    }
+    EXPECT_EQ(tier.cached_bytes(), segments[0].end + segments[1].end);
+
+    std::thread remover([&]() { tier.remove(segments[1].number); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    // A cache hit for the other segment does not wait for the store
+    const auto start = std::chrono::steady_clock::now();
+    const int fd = tier.fetch(segments[0].number);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+    ASSERT_GE(fd, 0);
+    close(fd);
+    EXPECT_EQ(tier.cached_bytes(), segments[0].end);
+    remover.join();
+
+    EXPECT_EQ(store->gets, 2);
+    EXPECT_EQ(store->list(),
+              std::vector<std::string>{TieredStorage::object_name(segments[0].number)});
+    EXPECT_EQ(tier.fetch(segments[1].number), -1);
+    EXPECT_EQ(archived_segment_files(dir).size(), 1u);
+    remove_directory(dir);
+    remove_directory(archive);
+    remove_directory(cache);
+}
+
+TEST(PersistenceTest, LogStreamerSendfile) {
+    const std::string dir = test_directory("wal-stream");
+    const uint64_t PER_SEGMENT = 3000;
+    const uint64_t COUNT = 3 * PER_SEGMENT;
+    const size_t FRAME_BYTES = 16 * 1024;
+    std::vector<uint8_t> payload(100, 0x44);
+    WAL wal(dir);
+    const auto append = [&](uint64_t first, uint64_t last) {
+        for (uint64_t id = first; id <= last; ++id) {
+            std::memcpy(payload.data(), &id, sizeof(id));
+            Message msg(id, 1000 + id, 1, payload.data(), payload.size());
+            msg.data = payload.data();
+            ASSERT_EQ(wal.append(msg), id);
+            if (id % PER_SEGMENT == 0) {
+                wal.rotate();
+            }
+        }
+        ASSERT_TRUE(wal.flush());
+    };
+    append(1, COUNT - 500);
+
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+    // Reads frames off the socket until it has the messages up to last
+    std::vector<uint8_t> frame;
+    uint64_t next_id = 1;
+    const auto receive = [&](uint64_t last) {
+        while (next_id <= last) {
+            uint32_t header[2];
+            ASSERT_EQ(recv(fds[1], header, sizeof(header), MSG_WAITALL),
+                      static_cast<ssize_t>(sizeof(header)));
+            ASSERT_EQ(header[0], MSG_TYPE_LOG_DATA);
+            ASSERT_LE(header[1], 16 + FRAME_BYTES);
+            frame.resize(header[1]);
+            ASSERT_EQ(recv(fds[1], frame.data(), frame.size(), MSG_WAITALL),
+                      static_cast<ssize_t>(frame.size()));
+            std::vector<Message> messages;
+            ASSERT_TRUE(decode_log_data(frame.data(), frame.size(), messages));
+            ASSERT_FALSE(messages.empty());
+            for (const Message& msg : messages) {
+                ASSERT_EQ(msg.header.id, next_id);
+                ASSERT_EQ(msg.header.timestamp, 1000 + next_id);
+                uint64_t stored;
+                std::memcpy(&stored, msg.data, sizeof(stored));
+                ASSERT_EQ(stored, next_id);
+                ++next_id;
+            }
+        }
+    };
+
+    // Whole records in bounded frames, across segments, up to the tail
+    LogStreamer streamer(dir);
+    std::thread consumer([&] { receive(COUNT - 500); });
+    ssize_t n;
+    while ((n = streamer.send_to(fds[0], FRAME_BYTES)) > 0) {
+    }
+    EXPECT_EQ(n, 0);
+    consumer.join();
+    EXPECT_EQ(next_id, COUNT - 499);
+    EXPECT_EQ(streamer.send_to(fds[0], FRAME_BYTES), 0);
+
+    // Records appended later follow
+    append(COUNT - 499, COUNT);
+    consumer = std::thread([&] { receive(COUNT); });
+    while ((n = streamer.send_to(fds[0], FRAME_BYTES)) > 0) {
+    }
+    EXPECT_EQ(n, 0);
+    consumer.join();
+    EXPECT_EQ(next_id, COUNT + 1);
+    uint64_t record_bytes = 0;
+    for (const SegmentInfo& segment : SegmentManager(dir).list_segments()) {
+        record_bytes += segment.end - sizeof(WALSegmentHeader);
+    }
+    EXPECT_EQ(streamer.bytes_sent(), record_bytes);
+
+    // A seek resumes mid-log
+    ASSERT_TRUE(streamer.seek(PER_SEGMENT + 7));
+    next_id = PER_SEGMENT + 7;
+    consumer = std::thread([&] { receive(COUNT); });
+    while ((n = streamer.send_to(fds[0], FRAME_BYTES)) > 0) {
+    }
+    consumer.join();
+    EXPECT_EQ(next_id, COUNT + 1);
+
+    close(fds[0]);
+    close(fds[1]);
+    remove_directory(dir);
 }
 
 int main(int argc, char** argv) {
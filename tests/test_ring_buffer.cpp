@@ -1,6 +1,14 @@
 #include "nanomq/queue.hpp"
+#include "nanomq/broadcast_ring.hpp"
+#include "nanomq/record_ring.hpp"
 #include "nanomq/message.hpp"
+#include "nanomq/subscription.hpp"
+#include "nanomq/topic.hpp"
 #include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -107,6 +115,133 @@ TEST(SPSCQueueTest, ConcurrentProducerConsumer) {
     EXPECT_TRUE(queue.is_empty());
 }
 
+// Test in-place claim/publish and peek/release
+TEST(SPSCQueueTest, ClaimPublishPeekRelease) {
+    SPSCQueue<int, 16> queue;
+
+    // Claim is capped by free space (capacity - 1)
+    QueueSpan<int> span = queue.claim(32);
+    EXPECT_EQ(span.size, 15);
+    for (size_t i = 0; i < 10; ++i) {
+        span[i] = static_cast<int>(i);
+    }
+    queue.publish(10);
+    EXPECT_EQ(queue.size(), 10);
+
+    QueueSpan<int> ready = queue.peek(16);
+    ASSERT_EQ(ready.size, 10);
+    int expected = 0;
+    for (int value : ready) {
+        EXPECT_EQ(value, expected++);
+    }
+    queue.release(8);
+    EXPECT_EQ(queue.size(), 2);
+
+    // Spans stop at the wrap point
+    span = queue.claim(10);
+    EXPECT_EQ(span.size, 6);
+    for (size_t i = 0; i < span.size; ++i) {
+        span[i] = 100 + static_cast<int>(i);
+    }
+    queue.publish(span.size);
+    span = queue.claim(10);
+    EXPECT_EQ(span.size, 7);
+    queue.publish(0);
+
+    ready = queue.peek(16);
+    EXPECT_EQ(ready.size, 8);
+    EXPECT_EQ(ready[0], 8);
+    EXPECT_EQ(ready[2], 100);
+    queue.release(ready.size);
+    EXPECT_TRUE(queue.is_empty());
+    EXPECT_TRUE(queue.peek(16).empty());
+}
+
+// Test concurrent in-place producer/consumer
+TEST(SPSCQueueTest, ConcurrentClaimPeek) {
+    SPSCQueue<uint64_t, 1024> queue;
+    const uint64_t NUM_ITEMS = 200000;
+
+    std::thread producer([&]() {
+        uint64_t next = 0;
+        while (next < NUM_ITEMS) {
+            QueueSpan<uint64_t> span = queue.claim(64);
+            if (span.empty()) {
+                std::this_thread::yield();
+                continue;
+            }
+            size_t n = 0;
+            while (n < span.size && next < NUM_ITEMS) {
+                span[n++] = next++;
+            }
+            queue.publish(n);
+        }
+    });
+
+    uint64_t expected = 0;
+    while (expected < NUM_ITEMS) {
+        QueueSpan<uint64_t> ready = queue.peek(64);
+        if (ready.empty()) {
+            std::this_thread::yield();
+            continue;
+        }
+        for (uint64_t value : ready) {
+            ASSERT_EQ(value, expected++);
+        }
+        queue.release(ready.size);
+    }
+
+    producer.join();
+    EXPECT_TRUE(queue.is_empty());
+}
+
+// Test blocking pop with each wait strategy
+template <typename Strategy>
+class WaitStrategyTest : public ::testing::Test {};
+
+using WaitStrategies =
+    ::testing::Types<BusySpinWait, SpinYieldWait, BackoffWait, FutexParkWait>;
+TYPED_TEST_SUITE(WaitStrategyTest, WaitStrategies);
+
+TYPED_TEST(WaitStrategyTest, PopWaitTimesOutWhenIdle) {
+    SPSCQueue<int, 16, TypeParam> queue;
+    int value = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(queue.pop_wait(value, 2000));  // 2ms
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_GE(elapsed, std::chrono::microseconds(2000));
+}
+
+TYPED_TEST(WaitStrategyTest, PopWaitWakesOnPush) {
+    SPSCQueue<int, 1024, TypeParam> queue;
+    const int NUM_ITEMS = 2000;
+
+    std::thread producer([&]() {
+        for (int i = 0; i < NUM_ITEMS; ++i) {
+            // Pause now and then so the consumer has to park
+            if (i % 200 == 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            while (!queue.try_push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    int expected = 0;
+    int out[32];
+    while (expected < NUM_ITEMS) {
+        size_t n = queue.pop_batch_wait(out, 32, 1000000);
+        ASSERT_GT(n, 0u) << "timed out waiting for item " << expected;
+        for (size_t i = 0; i < n; ++i) {
+            ASSERT_EQ(out[i], expected++);
+        }
+    }
+
+    producer.join();
+}
+
 // Test with Message struct
 TEST(SPSCQueueTest, MessageQueue) {
     SPSCQueue<Message, 1024> queue;
@@ -132,6 +267,847 @@ TEST(SPSCQueueTest, MessageQueue) {
     }
 }
 
+// Test MPSC basic push/pop
+TEST(MPSCQueueTest, BasicPushPop) {
+    MPSCQueue<int, 16> queue;
+
+    EXPECT_TRUE(queue.is_empty());
+
+    // All slots are usable
+    for (int i = 0; i < 16; ++i) {
+        EXPECT_TRUE(queue.try_push(i));
+    }
+    EXPECT_TRUE(queue.is_full());
+    EXPECT_FALSE(queue.try_push(999));
+
+    for (int i = 0; i < 16; ++i) {
+        int value;
+        EXPECT_TRUE(queue.try_pop(value));
+        EXPECT_EQ(value, i);
+    }
+
+    int value;
+    EXPECT_FALSE(queue.try_pop(value));
+    EXPECT_TRUE(queue.is_empty());
+}
+
+// Test MPSC batch operations across the wrap point
+TEST(MPSCQueueTest, BatchOperations) {
+    MPSCQueue<int, 64> queue;
+    std::vector<int> items(48);
+    for (int i = 0; i < 48; ++i) {
+        items[i] = i;
+    }
+    std::vector<int> out(64);
+
+    EXPECT_EQ(queue.try_push_batch(items.data(), 48), 48);
+    EXPECT_EQ(queue.try_pop_batch(out.data(), 40), 40);
+
+    // Only 56 slots free: the claim is truncated
+    EXPECT_EQ(queue.try_push_batch(items.data(), 48), 48);
+    EXPECT_EQ(queue.try_push_batch(items.data(), 48), 8);
+    EXPECT_EQ(queue.size(), 64);
+
+    EXPECT_EQ(queue.try_pop_batch(out.data(), 64), 64);
+    for (int i = 0; i < 8; ++i) {
+        EXPECT_EQ(out[i], 40 + i);
+    }
+    for (int i = 0; i < 48; ++i) {
+        EXPECT_EQ(out[8 + i], i);
+    }
+    EXPECT_TRUE(queue.is_empty());
+}
+
+// Test many producers: every item arrives once, in per-producer order
+TEST(MPSCQueueTest, ConcurrentProducers) {
+    MPSCQueue<uint64_t, 1024> queue;
+    const int NUM_PRODUCERS = 4;
+    const uint64_t ITEMS_PER_PRODUCER = 50000;
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < NUM_PRODUCERS; ++p) {
+        producers.emplace_back([&, p]() {
+            uint64_t batch[8];
+            uint64_t next = 0;
+            while (next < ITEMS_PER_PRODUCER) {
+                // Mix single and batch pushes
+                if (next % 3 == 0) {
+                    if (!queue.try_push((uint64_t(p) << 32) | next)) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    ++next;
+                } else {
+                    size_t n = 0;
+                    while (n < 8 && next + n < ITEMS_PER_PRODUCER) {
+                        batch[n] = (uint64_t(p) << 32) | (next + n);
+                        ++n;
+                    }
+                    size_t pushed = queue.try_push_batch(batch, n);
+                    if (pushed == 0) {
+                        std::this_thread::yield();
+                    }
+                    next += pushed;
+                }
+            }
+        });
+    }
+
+    std::vector<uint64_t> expected(NUM_PRODUCERS, 0);
+    uint64_t received = 0;
+    uint64_t out[32];
+    while (received < NUM_PRODUCERS * ITEMS_PER_PRODUCER) {
+        size_t n = queue.try_pop_batch(out, 32);
+        if (n == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t producer = out[i] >> 32;
+            uint64_t seq = out[i] & 0xFFFFFFFFULL;
+            ASSERT_LT(producer, uint64_t(NUM_PRODUCERS));
+            EXPECT_EQ(seq, expected[producer]);
+            expected[producer] = seq + 1;
+        }
+        received += n;
+    }
+
+    for (auto& t : producers) {
+        t.join();
+    }
+    EXPECT_TRUE(queue.is_empty());
+}
+
+// Test runtime-sized queue: window grows when full, up to max capacity
+TEST(ElasticSPSCQueueTest, GrowsToMaxCapacity) {
+    ElasticSPSCQueue<int> queue(1000, 4);
+    EXPECT_EQ(queue.capacity(), 4);
+
+    int pushed = 0;
+    while (queue.try_push(pushed)) {
+        ++pushed;
+    }
+    EXPECT_EQ(pushed, 1000);
+    EXPECT_EQ(queue.capacity(), 1000);
+    EXPECT_EQ(queue.size(), 1000);
+
+    for (int i = 0; i < 1000; ++i) {
+        int value;
+        ASSERT_TRUE(queue.try_pop(value));
+        EXPECT_EQ(value, i);
+    }
+    EXPECT_TRUE(queue.is_empty());
+}
+
+// Test that queued items are destroyed in place with the queue, across
+// jumps, without needing a default constructor
+TEST(ElasticSPSCQueueTest, ItemLifetimes) {
+    static int live = 0;
+    struct Tracked {
+        uint64_t value;
+        explicit Tracked(uint64_t v) : value(v) { ++live; }
+        Tracked(const Tracked& other) : value(other.value) { ++live; }
+        Tracked& operator=(const Tracked&) = default;
+        ~Tracked() { --live; }
+    };
+
+    {
+        ElasticSPSCQueue<Tracked> queue(64, 4);
+        for (uint64_t i = 0; i < 4; ++i) {
+            ASSERT_TRUE(queue.try_push(Tracked(i)));
+        }
+        Tracked out(0);
+        ASSERT_TRUE(queue.try_pop(out));
+        ASSERT_TRUE(queue.try_pop(out));
+        EXPECT_EQ(out.value, 1u);
+        // Wraps to slot 0, then extends above the wrap point once full
+        for (uint64_t i = 4; i < 10; ++i) {
+            ASSERT_TRUE(queue.try_push(Tracked(i)));
+        }
+        EXPECT_EQ(live, 9);  // 8 queued and out
+    }
+    EXPECT_EQ(live, 0);
+}
+
+// Test wrap-around, shrinking and trimming keep FIFO order
+TEST(ElasticSPSCQueueTest, WrapResizeTrim) {
+    ElasticSPSCQueue<uint64_t> queue(1 << 16, 64);
+    uint64_t next_push = 0;
+    uint64_t next_pop = 0;
+
+    for (int round = 0; round < 200; ++round) {
+        for (int i = 0; i < 40; ++i) {
+            ASSERT_TRUE(queue.try_push(next_push++));
+        }
+        if (round == 50) {
+            queue.resize(8192);
+        }
+        if (round == 100) {
+            queue.resize(16);
+            queue.trim();
+        }
+        uint64_t out[64];
+        size_t n = queue.try_pop_batch(out, 37);
+        for (size_t i = 0; i < n; ++i) {
+            ASSERT_EQ(out[i], next_pop++);
+        }
+    }
+
+    uint64_t value;
+    while (queue.try_pop(value)) {
+        ASSERT_EQ(value, next_pop++);
+    }
+    EXPECT_EQ(next_pop, next_push);
+}
+
+// Test that a ring wrapped behind a lagging consumer still grows to max
+TEST(ElasticSPSCQueueTest, GrowsAfterWrapWithLaggingConsumer) {
+    ElasticSPSCQueue<uint64_t> queue(65536, 32);
+    uint64_t next_push = 0;
+    uint64_t next_pop = 0;
+    for (int i = 0; i < 32; ++i) {
+        ASSERT_TRUE(queue.try_push(next_push++));
+    }
+    for (int i = 0; i < 20; ++i) {
+        uint64_t value;
+        ASSERT_TRUE(queue.try_pop(value));
+        ASSERT_EQ(value, next_pop++);
+    }
+
+    // The burst wraps into the freed front, then continues above it
+    while (queue.try_push(next_push)) {
+        ++next_push;
+    }
+    EXPECT_EQ(queue.size(), queue.max_capacity() - 1);
+
+    // Drain half, refill, then drain everything in order
+    for (size_t i = 0; i < queue.max_capacity() / 2; ++i) {
+        uint64_t value;
+        ASSERT_TRUE(queue.try_pop(value));
+        ASSERT_EQ(value, next_pop++);
+    }
+    queue.trim();
+    while (queue.try_push(next_push)) {
+        ++next_push;
+    }
+    uint64_t value;
+    while (queue.try_pop(value)) {
+        ASSERT_EQ(value, next_pop++);
+    }
+    EXPECT_EQ(next_pop, next_push);
+    EXPECT_TRUE(queue.is_empty());
+}
+
+// Test concurrent producer/consumer across many wraps and growth steps
+TEST(ElasticSPSCQueueTest, ConcurrentProducerConsumer) {
+    ElasticSPSCQueue<uint64_t> queue(4096, 8);
+    const uint64_t NUM_ITEMS = 200000;
+
+    std::thread producer([&]() {
+        for (uint64_t i = 0; i < NUM_ITEMS; ++i) {
+            while (!queue.try_push(i)) {
+                std::this_thread::yield();
+            }
+            if (i % 50000 == 0) {
+                queue.trim();
+            }
+        }
+    });
+
+    uint64_t expected = 0;
+    while (expected < NUM_ITEMS) {
+        uint64_t value;
+        if (queue.try_pop(value)) {
+            ASSERT_EQ(value, expected++);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    producer.join();
+    EXPECT_TRUE(queue.is_empty());
+}
+
+// Test that a topic uses the queue chosen at construction
+TEST(TopicTest, MultiProducerMode) {
+    Topic topic("orders", TopicMode::MULTI_PRODUCER);
+    EXPECT_EQ(topic.mode(), TopicMode::MULTI_PRODUCER);
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < 4; ++p) {
+        producers.emplace_back([&]() {
+            for (int i = 0; i < 100; ++i) {
+                Message msg;
+                msg.header.id = topic.next_message_id();
+                while (!topic.add_message(msg)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+
+    // IDs are unique across producers
+    std::vector<bool> seen(401, false);
+    Message msg;
+    int count = 0;
+    while (topic.poll_message(msg)) {
+        ASSERT_LE(msg.header.id, 400u);
+        EXPECT_FALSE(seen[msg.header.id]);
+        seen[msg.header.id] = true;
+        ++count;
+    }
+    EXPECT_EQ(count, 400);
+}
+
+// Test MPMC basic push/pop
+TEST(MPMCQueueTest, BasicPushPop) {
+    MPMCQueue<int, 16> queue;
+
+    for (int i = 0; i < 16; ++i) {
+        EXPECT_TRUE(queue.try_push(i));
+    }
+    EXPECT_TRUE(queue.is_full());
+    EXPECT_FALSE(queue.try_push(999));
+
+    std::vector<int> out(16);
+    EXPECT_EQ(queue.try_pop_batch(out.data(), 10), 10);
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_EQ(out[i], i);
+    }
+
+    // Wrap around
+    for (int i = 16; i < 26; ++i) {
+        EXPECT_TRUE(queue.try_push(i));
+    }
+    EXPECT_EQ(queue.try_pop_batch(out.data(), 16), 16);
+    for (int i = 0; i < 16; ++i) {
+        EXPECT_EQ(out[i], 10 + i);
+    }
+
+    int value;
+    EXPECT_FALSE(queue.try_pop(value));
+    EXPECT_TRUE(queue.is_empty());
+}
+
+// Test many producers and consumers: every item is delivered exactly once
+TEST(MPMCQueueTest, ConcurrentProducersConsumers) {
+    MPMCQueue<uint32_t, 1024> queue;
+    const int NUM_PRODUCERS = 2;
+    const int NUM_CONSUMERS = 3;
+    const uint32_t ITEMS_PER_PRODUCER = 50000;
+    const uint32_t TOTAL = NUM_PRODUCERS * ITEMS_PER_PRODUCER;
+
+    std::vector<std::atomic<uint8_t>> seen(TOTAL);
+    for (auto& s : seen) {
+        s = 0;
+    }
+    std::atomic<uint32_t> consumed{0};
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < NUM_PRODUCERS; ++p) {
+        threads.emplace_back([&, p]() {
+            for (uint32_t i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+                while (!queue.try_push(p * ITEMS_PER_PRODUCER + i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (int c = 0; c < NUM_CONSUMERS; ++c) {
+        threads.emplace_back([&]() {
+            uint32_t out[16];
+            while (consumed.load() < TOTAL) {
+                size_t n = queue.try_pop_batch(out, 16);
+                if (n == 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                for (size_t i = 0; i < n; ++i) {
+                    seen[out[i]].fetch_add(1);
+                }
+                consumed.fetch_add(static_cast<uint32_t>(n));
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    EXPECT_EQ(consumed.load(), TOTAL);
+    for (uint32_t i = 0; i < TOTAL; ++i) {
+        ASSERT_EQ(seen[i].load(), 1) << "item " << i;
+    }
+}
+
+// Test runtime-sized MPSC/MPMC rings, whose slots are only mapped on use
+TEST(MPMCQueueTest, RuntimeCapacity) {
+    MPSCQueue<std::string, 1024> mpsc(100);  // Rounded up to a power of 2
+    MPMCQueue<std::string, 1024> mpmc(8);
+    EXPECT_EQ(mpsc.capacity(), 128u);
+    EXPECT_EQ(mpmc.capacity(), 8u);
+    MPSCQueue<int, 1024> by_default;
+    EXPECT_EQ(by_default.capacity(), 1024u);
+
+    // Several laps, with items that own memory
+    std::string value;
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_TRUE(mpsc.try_push(std::string(40, static_cast<char>('a' + i % 26))));
+        ASSERT_TRUE(mpmc.try_push(std::to_string(i)));
+        ASSERT_TRUE(mpsc.try_pop(value));
+        EXPECT_EQ(value, std::string(40, static_cast<char>('a' + i % 26)));
+        ASSERT_TRUE(mpmc.try_pop(value));
+        EXPECT_EQ(value, std::to_string(i));
+    }
+    for (int i = 0; i < 8; ++i) {
+        EXPECT_TRUE(mpmc.try_push(std::to_string(i)));
+    }
+    EXPECT_FALSE(mpmc.try_push("full"));
+    EXPECT_TRUE(mpmc.is_full());
+    // Items left in the rings are destroyed with them
+}
+
+// Test that topics refuse ring capacities their mode cannot honour
+TEST(TopicTest, CapacityPerMode) {
+    EXPECT_TRUE(Topic::supports_capacity(TopicMode::SINGLE_PRODUCER, 1000));
+    EXPECT_TRUE(Topic::supports_capacity(TopicMode::MULTI_PRODUCER, 256));
+    EXPECT_FALSE(Topic::supports_capacity(TopicMode::MULTI_PRODUCER, 1000));
+    EXPECT_FALSE(Topic::supports_capacity(TopicMode::CONSUMER_GROUP, 0));
+    EXPECT_FALSE(Topic::supports_capacity(TopicMode::BROADCAST, 256));
+    EXPECT_THROW(Topic("orders", TopicMode::CONSUMER_GROUP, 1000), std::invalid_argument);
+
+    Topic small("orders", TopicMode::MULTI_PRODUCER, 4);
+    Message msg;
+    for (uint64_t id = 1; id <= 4; ++id) {
+        msg.header.id = id;
+        EXPECT_TRUE(small.add_message(msg));
+    }
+    EXPECT_FALSE(small.add_message(msg));
+}
+
+// Test that consumer group members share one topic ring
+TEST(TopicTest, ConsumerGroupSharesRing) {
+    Topic topic("jobs", TopicMode::CONSUMER_GROUP);
+    Subscription a(topic, "workers");
+    Subscription b(topic, "workers");
+    EXPECT_EQ(a.topic(), "jobs");
+
+    for (uint64_t i = 1; i <= 10; ++i) {
+        Message msg;
+        msg.header.id = i;
+        EXPECT_TRUE(topic.add_message(msg));
+    }
+
+    // Each message goes to exactly one member
+    Message out[8];
+    size_t from_a = a.poll(out, 4);
+    EXPECT_EQ(from_a, 4);
+    EXPECT_EQ(out[0].header.id, 1u);
+    size_t from_b = b.poll(out, 8);
+    EXPECT_EQ(from_b, 6);
+    EXPECT_EQ(out[0].header.id, 5u);
+    EXPECT_EQ(a.poll(out, 8), 0);
+}
+
+// Test move-only items and in-place construction
+TEST(SPSCQueueTest, MoveOnlyItems) {
+    SPSCQueue<std::unique_ptr<int>, 8> queue;
+
+    auto first = std::make_unique<int>(1);
+    EXPECT_TRUE(queue.try_push(std::move(first)));
+    EXPECT_EQ(first, nullptr);
+    EXPECT_TRUE(queue.try_emplace(new int(2)));
+
+    std::unique_ptr<int> out;
+    EXPECT_TRUE(queue.try_pop(out));
+    EXPECT_EQ(*out, 1);
+    EXPECT_TRUE(queue.try_pop(out));
+    EXPECT_EQ(*out, 2);
+    EXPECT_FALSE(queue.try_pop(out));
+}
+
+// Test that every constructed item is destroyed exactly once
+TEST(SPSCQueueTest, ItemLifetimes) {
+    static int live = 0;
+    struct Tracked {
+        std::string value;
+        explicit Tracked(const std::string& v = "") : value(v) { ++live; }
+        Tracked(const Tracked& other) : value(other.value) { ++live; }
+        Tracked& operator=(const Tracked&) = default;
+        Tracked& operator=(Tracked&&) = default;
+        ~Tracked() { --live; }
+    };
+
+    {
+        SPSCQueue<Tracked, 8> queue;
+        EXPECT_EQ(live, 0);  // Empty slots hold no objects
+
+        Tracked batch[5] = {Tracked("a"), Tracked("b"), Tracked("c"),
+                            Tracked("d"), Tracked("e")};
+        EXPECT_EQ(queue.try_push_batch(batch, 5), 5);
+        EXPECT_EQ(live, 10);
+
+        Tracked out[3];
+        EXPECT_EQ(queue.try_pop_batch(out, 3), 3);
+        EXPECT_EQ(out[2].value, "c");
+        EXPECT_EQ(live, 10);  // 5 + 3 outputs + 2 still queued
+
+        EXPECT_TRUE(queue.try_emplace("f"));
+        EXPECT_EQ(live, 11);
+    }
+    EXPECT_EQ(live, 0);  // Queued items destroyed with the queue
+}
+
+// Test that batches split at the wrap point keep their order
+TEST(SPSCQueueTest, BatchAcrossWrap) {
+    SPSCQueue<uint64_t, 16> queue;
+    uint64_t in[12];
+    uint64_t out[12];
+    uint64_t next_in = 0;
+    uint64_t next_out = 0;
+
+    for (int round = 0; round < 10; ++round) {
+        for (uint64_t& v : in) {
+            v = next_in++;
+        }
+        ASSERT_EQ(queue.try_push_batch(in, 12), 12);
+        ASSERT_EQ(queue.try_pop_batch(out, 12), 12);
+        for (uint64_t v : out) {
+            EXPECT_EQ(v, next_out++);
+        }
+    }
+}
+
+// Test that every reader sees every item
+TEST(BroadcastRingTest, FanOut) {
+    BroadcastRing<int, 16> ring;
+    int a = ring.add_reader();
+    int b = ring.add_reader();
+    ASSERT_GE(a, 0);
+    ASSERT_GE(b, 0);
+    EXPECT_EQ(ring.reader_count(), 2);
+
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_TRUE(ring.try_push(i));
+    }
+
+    int out[16];
+    EXPECT_EQ(ring.try_read_batch(a, out, 16), 10);
+    EXPECT_EQ(out[0], 0);
+    EXPECT_EQ(out[9], 9);
+    EXPECT_EQ(ring.lag(b), 10);
+
+    auto span = ring.peek(b, 4);
+    ASSERT_EQ(span.size, 4);
+    EXPECT_EQ(span[3], 3);
+    ring.release(b, 4);
+    EXPECT_EQ(ring.try_read_batch(b, out, 16), 6);
+    EXPECT_EQ(out[0], 4);
+
+    // A late reader starts at the current head
+    int c = ring.add_reader();
+    int value;
+    EXPECT_FALSE(ring.try_read(c, value));
+    EXPECT_TRUE(ring.try_push(42));
+    EXPECT_TRUE(ring.try_read(c, value));
+    EXPECT_EQ(value, 42);
+}
+
+// Test that the slowest reader gates the producer
+TEST(BroadcastRingTest, SlowReaderBlocksProducer) {
+    BroadcastRing<int, 8> ring(SlowReaderPolicy::BLOCK_PRODUCER);
+    int fast = ring.add_reader();
+    int slow = ring.add_reader();
+
+    int out[8];
+    for (int i = 0; i < 8; ++i) {
+        EXPECT_TRUE(ring.try_push(i));
+        EXPECT_TRUE(ring.try_read(fast, out[0]));
+    }
+    EXPECT_FALSE(ring.try_push(8));  // slow is a full ring behind
+
+    EXPECT_EQ(ring.try_read_batch(slow, out, 3), 3);
+    EXPECT_EQ(ring.try_push_batch(out, 8), 3);
+
+    // Removing the slow reader ungates the producer
+    ring.remove_reader(slow);
+    EXPECT_EQ(ring.try_read_batch(fast, out, 8), 3);
+    EXPECT_EQ(ring.try_push_batch(out, 8), 8);
+}
+
+// Test that DROP_READER cuts lagging readers loose
+TEST(BroadcastRingTest, DropSlowReader) {
+    BroadcastRing<int, 8> ring(SlowReaderPolicy::DROP_READER);
+    int fast = ring.add_reader();
+    int slow = ring.add_reader();
+
+    int value;
+    for (int i = 0; i < 20; ++i) {
+        EXPECT_TRUE(ring.try_push(i));
+        EXPECT_TRUE(ring.try_read(fast, value));
+        EXPECT_EQ(value, i);
+    }
+    EXPECT_TRUE(ring.is_dropped(slow));
+    EXPECT_FALSE(ring.is_dropped(fast));
+    EXPECT_FALSE(ring.try_read(slow, value));
+
+    // The dropped cursor can be freed and re-registered
+    ring.remove_reader(slow);
+    slow = ring.add_reader();
+    EXPECT_FALSE(ring.is_dropped(slow));
+    EXPECT_TRUE(ring.try_push(20));
+    EXPECT_TRUE(ring.try_read(slow, value));
+    EXPECT_EQ(value, 20);
+}
+
+// Test concurrent fan-out: every reader sees the full sequence in order
+TEST(BroadcastRingTest, ConcurrentReaders) {
+    BroadcastRing<uint64_t, 1024> ring;
+    const int NUM_READERS = 4;
+    const uint64_t NUM_ITEMS = 50000;
+
+    std::vector<int> ids;
+    for (int r = 0; r < NUM_READERS; ++r) {
+        ids.push_back(ring.add_reader());
+    }
+
+    std::vector<uint64_t> sums(NUM_READERS, 0);
+    std::vector<bool> in_order(NUM_READERS, true);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < NUM_READERS; ++r) {
+        readers.emplace_back([&, r]() {
+            uint64_t expected = 0;
+            uint64_t out[64];
+            while (expected < NUM_ITEMS) {
+                size_t n = ring.try_read_batch(ids[r], out, 64);
+                if (n == 0) {
+                    std::this_thread::yield();
+                }
+                for (size_t i = 0; i < n; ++i) {
+                    if (out[i] != expected) {
+                        in_order[r] = false;
+                    }
+                    sums[r] += out[i];
+                    ++expected;
+                }
+            }
+        });
+    }
+
+    for (uint64_t i = 0; i < NUM_ITEMS; ++i) {
+        while (!ring.try_push(i)) {
+            std::this_thread::yield();
+        }
+    }
+    for (auto& t : readers) {
+        t.join();
+    }
+
+    const uint64_t expected_sum = NUM_ITEMS * (NUM_ITEMS - 1) / 2;
+    for (int r = 0; r < NUM_READERS; ++r) {
+        EXPECT_TRUE(in_order[r]);
+        EXPECT_EQ(sums[r], expected_sum);
+    }
+}
+
+// Test that plain subscriptions on a BROADCAST topic each see every message
+TEST(TopicTest, BroadcastSubscriptions) {
+    Topic topic("prices", TopicMode::BROADCAST);
+    Subscription a(topic, "");
+    Subscription b(topic, "");
+    EXPECT_TRUE(a.is_attached());
+    EXPECT_TRUE(b.is_attached());
+
+    for (uint64_t i = 1; i <= 10; ++i) {
+        Message msg;
+        msg.header.id = i;
+        EXPECT_TRUE(topic.add_message(msg));
+    }
+
+    Message out[16];
+    EXPECT_EQ(a.poll(out, 16), 10);
+    EXPECT_EQ(out[9].header.id, 10u);
+    EXPECT_EQ(b.poll(out, 4), 4);
+    EXPECT_EQ(out[0].header.id, 1u);
+    EXPECT_EQ(b.poll(out, 16), 6);
+    EXPECT_EQ(out[0].header.id, 5u);
+    EXPECT_EQ(a.poll(out, 16), 0);
+}
+
+// Test that a subscription cut loose by DROP_READER says so and can resync
+TEST(TopicTest, DroppedBroadcastSubscription) {
+    Topic topic("prices", TopicMode::BROADCAST, Topic::QUEUE_CAPACITY,
+                SlowReaderPolicy::DROP_READER);
+    Subscription fast(topic, "");
+    Subscription slow(topic, "");
+    Message msg;
+    Message out[64];
+    for (uint64_t i = 1; i <= Topic::QUEUE_CAPACITY + 1; ++i) {
+        msg.header.id = i;
+        ASSERT_TRUE(topic.add_message(msg));
+        while (fast.poll(out, 64) > 0) {
+        }
+    }
+    EXPECT_FALSE(fast.is_dropped());
+    EXPECT_TRUE(slow.is_dropped());
+    EXPECT_TRUE(slow.is_attached());
+    EXPECT_EQ(slow.poll(out, 64), 0u);
+
+    // Back at the head: only what is published from now on
+    ASSERT_TRUE(slow.reattach());
+    EXPECT_FALSE(slow.is_dropped());
+    msg.header.id = Topic::QUEUE_CAPACITY + 2;
+    ASSERT_TRUE(topic.add_message(msg));
+    ASSERT_EQ(slow.poll(out, 64), 1u);
+    EXPECT_EQ(out[0].header.id, Topic::QUEUE_CAPACITY + 2);
+}
+
+// Test that single-consumer topics take one plain subscription at a time
+TEST(TopicTest, SingleReaderSubscriptions) {
+    for (TopicMode mode : {TopicMode::SINGLE_PRODUCER, TopicMode::MULTI_PRODUCER}) {
+        Topic topic("orders", mode);
+        auto first = std::make_unique<Subscription>(topic, "");
+        Subscription second(topic, "");
+        EXPECT_TRUE(first->is_attached());
+        EXPECT_FALSE(second.is_attached());
+
+        Message msg;
+        msg.header.id = 1;
+        EXPECT_TRUE(topic.add_message(msg));
+        Message out[4];
+        EXPECT_EQ(second.poll(out, 4), 0u);  // Never touches the queue
+        EXPECT_EQ(first->poll(out, 4), 1u);
+
+        // The queue is free again once the first one goes
+        first.reset();
+        Subscription third(topic, "");
+        EXPECT_TRUE(third.is_attached());
+    }
+
+    // Group members share an MPMC queue
+    Topic group("work", TopicMode::CONSUMER_GROUP);
+    Subscription a(group, "workers");
+    Subscription b(group, "workers");
+    EXPECT_TRUE(a.is_attached());
+    EXPECT_TRUE(b.is_attached());
+}
+
+// Test that headers and payloads are read back in place
+TEST(RecordRingTest, WriteReadInPlace) {
+    RecordRing<4096> ring;
+    const char payload[] = "hello, ring";
+
+    MessageHeader header;
+    header.id = 7;
+    header.size = sizeof(payload);
+    EXPECT_TRUE(ring.try_write(header, payload));
+
+    MessageHeader* claimed = ring.claim(3);
+    ASSERT_NE(claimed, nullptr);
+    claimed->id = 8;
+    std::memcpy(RecordRing<4096>::payload(claimed), "abc", 3);
+    ring.publish();
+
+    Message msg;
+    ASSERT_TRUE(ring.try_read(msg));
+    EXPECT_EQ(msg.header.id, 7u);
+    EXPECT_EQ(msg.header.size, sizeof(payload));
+    EXPECT_STREQ(reinterpret_cast<const char*>(msg.data), payload);
+    // Payload sits right behind its header inside the ring
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(msg.data) % CACHE_LINE_SIZE, 0u);
+
+    ASSERT_TRUE(ring.try_read(msg));
+    EXPECT_EQ(msg.header.id, 8u);
+    EXPECT_EQ(std::memcmp(msg.data, "abc", 3), 0);
+    EXPECT_FALSE(ring.try_read(msg));
+
+    EXPECT_FALSE(ring.is_empty());
+    ring.release();
+    EXPECT_TRUE(ring.is_empty());
+}
+
+// Test wrap-around padding and back-pressure until release()
+TEST(RecordRingTest, WrapsWithPadding) {
+    RecordRing<1024> ring;
+    uint8_t payload[300];
+    std::memset(payload, 0xab, sizeof(payload));
+    EXPECT_EQ(RecordRing<1024>::record_bytes(300), 384u);
+    EXPECT_EQ(ring.claim(RecordRing<1024>::MAX_RECORD_PAYLOAD + 1), nullptr);
+
+    MessageHeader header;
+    header.size = sizeof(payload);
+    header.id = 1;
+    EXPECT_TRUE(ring.try_write(header, payload));
+    header.id = 2;
+    EXPECT_TRUE(ring.try_write(header, payload));
+    header.id = 3;
+    EXPECT_FALSE(ring.try_write(header, payload));  // 256 bytes left
+
+    Message msg;
+    ASSERT_TRUE(ring.try_read(msg));
+    EXPECT_EQ(msg.header.id, 1u);
+    EXPECT_FALSE(ring.try_write(header, payload));  // Not released yet
+    ring.release();
+
+    // Needs a 256-byte padding record and then the front of the buffer
+    EXPECT_TRUE(ring.try_write(header, payload));
+    ASSERT_TRUE(ring.try_read(msg));
+    EXPECT_EQ(msg.header.id, 2u);
+    ASSERT_TRUE(ring.try_read(msg));
+    EXPECT_EQ(msg.header.id, 3u);
+    EXPECT_FALSE(msg.has_flag(MSG_FLAG_PADDING));
+    EXPECT_EQ(msg.data[299], 0xab);
+    EXPECT_FALSE(ring.try_read(msg));
+    ring.release();
+    EXPECT_EQ(ring.used_bytes(), 0u);
+}
+
+// Test concurrent producer/consumer with variable-sized payloads
+TEST(RecordRingTest, ConcurrentProducerConsumer) {
+    RecordRing<65536> ring;
+    const uint64_t NUM_RECORDS = 50000;
+    bool intact = true;
+
+    std::thread consumer([&]() {
+        uint64_t expected = 0;
+        Message batch[32];
+        while (expected < NUM_RECORDS) {
+            size_t n = ring.try_read_batch(batch, 32);
+            if (n == 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            for (size_t i = 0; i < n; ++i) {
+                const Message& msg = batch[i];
+                if (msg.header.id != expected ||
+                    msg.header.size != expected % 500 ||
+                    (msg.header.size > 0 &&
+                     msg.data[msg.header.size - 1] != static_cast<uint8_t>(expected))) {
+                    intact = false;
+                }
+                ++expected;
+            }
+            ring.release();
+        }
+    });
+
+    for (uint64_t i = 0; i < NUM_RECORDS; ++i) {
+        const uint32_t size = static_cast<uint32_t>(i % 500);
+        MessageHeader* header;
+        while ((header = ring.claim(size)) == nullptr) {
+            std::this_thread::yield();
+        }
+        header->id = i;
+        std::memset(RecordRing<65536>::payload(header), static_cast<uint8_t>(i), size);
+        ring.publish();
+    }
+
+    consumer.join();
+    EXPECT_TRUE(intact);
+}
+
 // Performance benchmark (not a unit test, but useful)
 TEST(SPSCQueueTest, LatencyBenchmark) {
     SPSCQueue<int, 65536> queue;
@@ -1,8 +1,14 @@
 #include "nanomq/queue.hpp"
 #include "nanomq/message.hpp"
+#include "nanomq/topic.hpp"
+#include <unistd.h>
 #include <gtest/gtest.h>
 #include <thread>
 #include <chrono>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
 
 using namespace nanomq;
 
@@ -124,6 +130,59 @@ TEST(ThroughputTest, MemoryOverhead) {
     std::cout << "  MessageHeader: " << sizeof(MessageHeader) << " bytes\n";
 }
 
+// Resident set size of this process in bytes
+static size_t resident_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t total_pages = 0;
+    size_t resident_pages = 0;
+    statm >> total_pages >> resident_pages;
+    return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// Memory footprint of many mostly-idle topics, for each ring flavour
+TEST(ThroughputTest, TopicMemoryFootprint) {
+    const size_t NUM_TOPICS = 100000;
+    // Each mode's topics are kept so the next one cannot reuse their heap
+    std::vector<std::vector<std::unique_ptr<Topic>>> all_topics;
+    for (TopicMode mode : {TopicMode::SINGLE_PRODUCER, TopicMode::MULTI_PRODUCER,
+                           TopicMode::CONSUMER_GROUP}) {
+        all_topics.emplace_back();
+        std::vector<std::unique_ptr<Topic>>& topics = all_topics.back();
+        topics.reserve(NUM_TOPICS);
+        const size_t rss_before = resident_bytes();
+
+        for (size_t i = 0; i < NUM_TOPICS; ++i) {
+            topics.push_back(std::make_unique<Topic>("topic-" + std::to_string(i), mode));
+        }
+        const size_t rss_idle = resident_bytes();
+
+        // 1% of topics see some traffic
+        Message msg;
+        for (size_t i = 0; i < NUM_TOPICS; i += 100) {
+            for (int j = 0; j < 10; ++j) {
+                msg.header.id = topics[i]->next_message_id();
+                EXPECT_TRUE(topics[i]->add_message(msg));
+            }
+        }
+        const size_t rss_active = resident_bytes();
+
+        const double idle_mb = (rss_idle - rss_before) / (1024.0 * 1024.0);
+        const double active_mb = (rss_active - rss_before) / (1024.0 * 1024.0);
+        std::cout << "Topic memory footprint (" << NUM_TOPICS << " topics, mode "
+                  << static_cast<int>(mode) << "):\n";
+        std::cout << "  Idle:        " << idle_mb << " MB ("
+                  << (rss_idle - rss_before) / NUM_TOPICS << " bytes/topic)\n";
+        std::cout << "  1% active:   " << active_mb << " MB\n";
+        std::cout << "  Fixed 64K ring would be: "
+                  << NUM_TOPICS * sizeof(Message) * Topic::QUEUE_CAPACITY /
+                         (1024.0 * 1024.0 * 1024.0)
+                  << " GB\n";
+
+        // Well under 1 KB per idle topic plus a page per active one
+        EXPECT_LT(rss_active - rss_before, NUM_TOPICS * 1024 + (NUM_TOPICS / 100) * 8192);
+    }
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,374 @@
+#include "nanomq/shm_transport.hpp"
+#include "nanomq/protocol.hpp"
+#include "nanomq/publisher.hpp"
+#include "nanomq/subscriber.hpp"
+#include <sys/wait.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace nanomq;
+
+namespace {
+
+// Unique per test process so parallel runs do not collide
+std::string test_shm_name(const char* tag) {
+    return std::string("test-") + tag + "-" + std::to_string(getpid());
+}
+
+// Run the broker side of the transport on a background thread
+class BrokerLoop {
+public:
+    explicit BrokerLoop(ShmServer& server) : server_(server), running_(true) {
+        thread_ = std::thread([this]() {
+            while (running_.load(std::memory_order_relaxed)) {
+                server_.poll_channels();
+                if (server_.route() == 0) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    ~BrokerLoop() {
+        running_ = false;
+        thread_.join();
+    }
+
+private:
+    ShmServer& server_;
+    std::atomic<bool> running_;
+    std::thread thread_;
+};
+
+}  // namespace
+
+// Test varints at their length boundaries
+TEST(ProtocolTest, Varints) {
+    const uint64_t values[] = {0, 1, 127, 128, 16383, 16384, UINT32_MAX, UINT64_MAX};
+    for (uint64_t value : values) {
+        uint8_t buffer[MAX_VARINT_SIZE];
+        const size_t n = encode_varint(value, buffer);
+        EXPECT_EQ(n, varint_size(value));
+        uint64_t decoded = 0;
+        EXPECT_EQ(decode_varint(buffer, buffer + n, decoded), n);
+        EXPECT_EQ(decoded, value);
+        EXPECT_EQ(decode_varint(buffer, buffer + n - 1, decoded), 0u);
+    }
+    for (int64_t value : {int64_t(0), int64_t(-1), int64_t(1), INT64_MIN, INT64_MAX}) {
+        EXPECT_EQ(zigzag_decode(zigzag_encode(value)), value);
+    }
+}
+
+// Test compact encoding against a batch base
+TEST(ProtocolTest, CompactRoundTrip) {
+    const char* text = "bid 101.25 ask 101.27";
+    EncodingBase base;
+    base.id = 5000;
+    base.timestamp = get_timestamp_ns();
+
+    Message msg(5003, base.timestamp + 2500, 12, text, strlen(text));
+    msg.data = reinterpret_cast<uint8_t*>(const_cast<char*>(text));
+    msg.set_flag(MSG_FLAG_PRIORITY);
+
+    uint8_t buffer[256];
+    const size_t n = encode_message(msg, buffer, sizeof(buffer), base);
+    EXPECT_EQ(n, encoded_size(msg, base));
+    EXPECT_LE(n, 12 + strlen(text));
+
+    Message decoded;
+    ASSERT_EQ(decode_message(buffer, n, decoded, base), n);
+    EXPECT_EQ(decoded.header.id, msg.header.id);
+    EXPECT_EQ(decoded.header.timestamp, msg.header.timestamp);
+    EXPECT_EQ(decoded.header.topic_id, 12u);
+    EXPECT_EQ(decoded.header.flags, msg.header.flags);
+    EXPECT_EQ(decoded.header.crc32, msg.header.crc32);
+    EXPECT_TRUE(decoded.verify_checksum());
+
+    // Too small a buffer, truncated input
+    EXPECT_EQ(encode_message(msg, buffer, n - 1, base), 0u);
+    for (size_t size = 0; size < n; ++size) {
+        EXPECT_EQ(decode_message(buffer, size, decoded, base), 0u);
+    }
+
+    // Timestamps before the base still round-trip
+    msg.header.timestamp = base.timestamp - 10;
+    ASSERT_NE(encode_message(msg, buffer, sizeof(buffer), base), 0u);
+    ASSERT_NE(decode_message(buffer, sizeof(buffer), decoded, base), 0u);
+    EXPECT_EQ(decoded.header.timestamp, base.timestamp - 10);
+}
+
+// Test records through a ring shared by two attached views
+TEST(ShmRingTest, WriteReadAcrossViews) {
+    const size_t capacity = 4096;
+    std::vector<uint8_t> memory(ShmRing::segment_size(capacity) + CACHE_LINE_SIZE);
+    void* base = memory.data() + (CACHE_LINE_SIZE -
+        reinterpret_cast<uintptr_t>(memory.data()) % CACHE_LINE_SIZE);
+    ShmRing::initialize(base, capacity);
+
+    ShmRing producer;
+    ShmRing consumer;
+    ASSERT_TRUE(producer.attach(base, ShmRing::segment_size(capacity)));
+    ASSERT_TRUE(consumer.attach(base, ShmRing::segment_size(capacity)));
+
+    // Enough records to wrap the ring several times
+    uint8_t payload[700];
+    for (uint64_t i = 0; i < 50; ++i) {
+        MessageHeader header;
+        header.id = i;
+        header.size = sizeof(payload);
+        std::memset(payload, static_cast<int>(i), sizeof(payload));
+        ASSERT_TRUE(producer.try_write(header, payload));
+
+        Message msg;
+        ASSERT_TRUE(consumer.try_read(msg));
+        EXPECT_EQ(msg.header.id, i);
+        EXPECT_EQ(msg.data[699], static_cast<uint8_t>(i));
+        consumer.release();
+    }
+
+    Message msg;
+    EXPECT_FALSE(consumer.try_read(msg));
+    EXPECT_FALSE(consumer.wait(1000));
+    EXPECT_FALSE(consumer.is_broken());
+}
+
+// Test that a consumer refuses records that point outside the ring
+TEST(ShmRingTest, RejectsCorruptRecords) {
+    const size_t capacity = 4096;
+    std::vector<uint8_t> memory(ShmRing::segment_size(capacity) + CACHE_LINE_SIZE);
+    void* base = memory.data() + (CACHE_LINE_SIZE -
+        reinterpret_cast<uintptr_t>(memory.data()) % CACHE_LINE_SIZE);
+    ShmRing::initialize(base, capacity);
+
+    ShmRing producer;
+    ShmRing consumer;
+    ASSERT_TRUE(producer.attach(base, ShmRing::segment_size(capacity)));
+    ASSERT_TRUE(consumer.attach(base, ShmRing::segment_size(capacity)));
+
+    MessageHeader* header = producer.claim(16);
+    ASSERT_NE(header, nullptr);
+    header->size = 1 << 20;  // Lies about its size after claiming
+    producer.publish();
+
+    Message msg;
+    EXPECT_FALSE(consumer.try_read(msg));
+    EXPECT_TRUE(consumer.is_broken());
+
+    // Garbage that does not look like a ring is not attached to
+    std::memset(base, 0xff, 64);
+    ShmRing other;
+    EXPECT_FALSE(other.attach(base, ShmRing::segment_size(capacity)));
+}
+
+// Test that a name is served by one live broker only
+TEST(ShmTransportTest, OneBrokerPerName) {
+    const std::string name = test_shm_name("owner");
+    ShmServer first(name);
+    ASSERT_TRUE(first.start());
+    EXPECT_EQ(first.address(), "shm://" + name);
+
+    ShmServer second(name);
+    EXPECT_FALSE(second.start());
+
+    std::string parsed;
+    EXPECT_TRUE(parse_shm_address(first.address(), parsed));
+    EXPECT_EQ(parsed, name);
+    EXPECT_FALSE(parse_shm_address("127.0.0.1:9000", parsed));
+}
+
+// Test publisher -> broker -> subscriber over shared memory
+TEST(ShmTransportTest, PublishSubscribe) {
+    const std::string name = test_shm_name("pubsub");
+    ShmServer server(name, 1 << 16);
+    ASSERT_TRUE(server.start());
+    BrokerLoop loop(server);
+
+    Subscriber sub(server.address());
+    ASSERT_TRUE(sub.subscribe("orders"));
+    Publisher pub(server.address());
+    EXPECT_TRUE(pub.is_connected());
+
+    const int NUM_MESSAGES = 2000;
+    std::thread producer([&]() {
+        for (int i = 0; i < NUM_MESSAGES; ++i) {
+            const std::string text = "order-" + std::to_string(i);
+            while (pub.publish("orders", text.data(), text.size()) == 0) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    int received = 0;
+    bool in_order = true;
+    while (received < NUM_MESSAGES) {
+        std::vector<Message> batch = sub.poll_batch(64, 2000000);
+        ASSERT_FALSE(batch.empty());
+        for (const Message& msg : batch) {
+            const std::string expected = "order-" + std::to_string(received);
+            const std::string text(reinterpret_cast<const char*>(msg.data),
+                                   msg.header.size);
+            if (text != expected || !msg.verify_checksum()) {
+                in_order = false;
+            }
+            ++received;
+        }
+    }
+    producer.join();
+    EXPECT_TRUE(in_order);
+    EXPECT_EQ(server.channel_count(), 2u);
+}
+
+// Test that record batches are routed whole and read in place
+TEST(ShmTransportTest, RecordBatches) {
+    const std::string name = test_shm_name("records");
+    ShmServer server(name, 1 << 16);
+    ASSERT_TRUE(server.start());
+    BrokerLoop loop(server);
+
+    Subscriber sub(server.address());
+    ASSERT_TRUE(sub.subscribe("trades"));
+    Publisher pub(server.address());
+
+    const int NUM_BATCHES = 50;
+    const int BATCH_SIZE = 1000;  // Several ring records per batch
+    std::thread producer([&]() {
+        std::vector<std::string> texts(BATCH_SIZE);
+        std::vector<const void*> data(BATCH_SIZE);
+        std::vector<size_t> sizes(BATCH_SIZE);
+        for (int b = 0; b < NUM_BATCHES; ++b) {
+            for (int i = 0; i < BATCH_SIZE; ++i) {
+                texts[i] = "trade-" + std::to_string(b * BATCH_SIZE + i);
+                data[i] = texts[i].data();
+                sizes[i] = texts[i].size();
+            }
+            size_t sent = 0;
+            while (sent < static_cast<size_t>(BATCH_SIZE)) {
+                sent += pub.publish_batch("trades", data.data() + sent,
+                                          sizes.data() + sent, BATCH_SIZE - sent);
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    int received = 0;
+    bool in_order = true;
+    uint64_t last_id = 0;
+    while (received < NUM_BATCHES * BATCH_SIZE) {
+        std::vector<Message> batch = sub.poll_batch(100, 2000000);
+        ASSERT_FALSE(batch.empty());
+        for (const Message& msg : batch) {
+            const std::string expected = "trade-" + std::to_string(received);
+            const std::string text(reinterpret_cast<const char*>(msg.data),
+                                   msg.header.size);
+            if (text != expected || msg.header.id != last_id + 1 ||
+                msg.has_flag(MSG_FLAG_BATCH)) {
+                in_order = false;
+            }
+            last_id = msg.header.id;
+            ++received;
+        }
+    }
+    producer.join();
+    EXPECT_TRUE(in_order);
+}
+
+// Test that compressed batches arrive expanded at the subscriber
+TEST(ShmTransportTest, CompressedBatches) {
+    const std::string name = test_shm_name("compressed");
+    ShmServer server(name, 1 << 16);
+    ASSERT_TRUE(server.start());
+    BrokerLoop loop(server);
+
+    Subscriber sub(server.address());
+    ASSERT_TRUE(sub.subscribe("quotes"));
+    Publisher pub(server.address());
+    pub.set_compression_threshold(256);
+
+    const int NUM_BATCHES = 20;
+    const int BATCH_SIZE = 500;  // More than one ring record per batch
+    std::thread producer([&]() {
+        std::vector<std::string> texts(BATCH_SIZE);
+        std::vector<const void*> data(BATCH_SIZE);
+        std::vector<size_t> sizes(BATCH_SIZE);
+        for (int b = 0; b < NUM_BATCHES; ++b) {
+            for (int i = 0; i < BATCH_SIZE; ++i) {
+                texts[i] = "{\"quote\":" + std::to_string(b * BATCH_SIZE + i) +
+                           ",\"venue\":\"XNAS\",\"px\":\"101.25\"}";
+                data[i] = texts[i].data();
+                sizes[i] = texts[i].size();
+            }
+            size_t sent = 0;
+            while (sent < static_cast<size_t>(BATCH_SIZE)) {
+                sent += pub.publish_batch("quotes", data.data() + sent,
+                                          sizes.data() + sent, BATCH_SIZE - sent);
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    int received = 0;
+    bool in_order = true;
+    while (received < NUM_BATCHES * BATCH_SIZE) {
+        std::vector<Message> batch = sub.poll_batch(64, 2000000);
+        ASSERT_FALSE(batch.empty());
+        for (const Message& msg : batch) {
+            const std::string expected = "{\"quote\":" + std::to_string(received) +
+                                         ",\"venue\":\"XNAS\",\"px\":\"101.25\"}";
+            const std::string text(reinterpret_cast<const char*>(msg.data),
+                                   msg.header.size);
+            // Records of a batch are covered by the batch's checksum only
+            if (text != expected || msg.has_flag(MSG_FLAG_BATCH) ||
+                msg.has_flag(MSG_FLAG_COMPRESSED)) {
+                in_order = false;
+            }
+            ++received;
+        }
+    }
+    producer.join();
+    EXPECT_TRUE(in_order);
+}
+
+// Test that the broker reaps the channel of a client that died
+TEST(ShmTransportTest, ReapsDeadClient) {
+    const std::string name = test_shm_name("reap");
+    ShmServer server(name, 1 << 16);
+    ASSERT_TRUE(server.start());
+
+    pid_t child = fork();
+    ASSERT_GE(child, 0);
+    if (child == 0) {
+        auto channel = ShmChannel::connect(name, "jobs", ShmDirection::PUBLISH);
+        MessageHeader header;
+        bool ok = channel && channel->ring().try_write(header, nullptr);
+        _exit(ok ? 0 : 1);  // Crash-like exit: no close, no destructors
+    }
+
+    int status = 0;
+    bool exited = false;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline) {
+        server.poll_channels();
+        if (!exited && waitpid(child, &status, WNOHANG) == child) {
+            exited = true;
+        }
+        if (exited && server.channel_count() == 0) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_TRUE(exited);
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    EXPECT_EQ(server.channel_count(), 0u);
+
+    // The slot can be used again
+    BrokerLoop loop(server);
+    auto channel = ShmChannel::connect(name, "jobs", ShmDirection::SUBSCRIBE);
+    EXPECT_NE(channel, nullptr);
+}